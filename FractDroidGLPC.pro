@@ -13,14 +13,24 @@ TEMPLATE = app
 SOURCES += main.cpp\
         MandelGLWidget.cpp \
     fractDroidGL.cpp \
-    fractalrenderer.cpp
+    fractalrenderer.cpp \
+    frameprofiler.cpp \
+    resolutioncontroller.cpp \
+    framereadback.cpp \
+    shadercache.cpp
 
 HEADERS  += MandelGLWidget.h \
     fractDroidGL.h \
-    fractalrenderer.h
+    fractalrenderer.h \
+    frameprofiler.h \
+    resolutioncontroller.h \
+    framereadback.h \
+    shadercache.h
 
 RESOURCES += FractDroidGL.qrc
 
+include(fractcore/fractcore.pri)
+
 OTHER_FILES += \
     android/src/org/kde/necessitas/ministro/IMinistro.aidl \
     android/src/org/kde/necessitas/ministro/IMinistroCallback.aidl \
@@ -57,6 +67,8 @@ OTHER_FILES += \
     Resources/vert.glsl \
     Resources/mandelbrot_vert.glsl \
     Resources/mandelbrot_frag.glsl \
+    Resources/mandelbrot_ff_vert.glsl \
+    Resources/mandelbrot_ff_frag.glsl \
     Resources/frag.glsl
 
 
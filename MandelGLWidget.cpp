@@ -21,10 +21,15 @@
 #include "MandelGLWidget.h"
 #include <QtOpenGL/QtOpenGL>
 #include <QtCore/qmath.h>
-#include <QFutureWatcher>
 #include <math.h>
 
 #include "fractalrenderer.h"
+#include "mandelbrotview.h"
+#include "mandelbrotkernel.h"
+#include "pngcodec.h"
+
+#include <memory>
+#include <thread>
 
 // updates with highest framerate
 //#define PERFORMANCE_TEST
@@ -38,6 +43,9 @@
 // updates only when user interact with the mandelbrot set
 //#define INTERACTIVE_UPDATES_ONLY
 
+// paints the pixels the periodicity check stopped early in magenta
+//#define SHOW_PERIODICITY_CHECK
+
 
 // pos, uv and indices array for post effect plane
 const GLfloat quad_vertices[] = { -1.0f,-1.0f, 1.0f,-1.0f, 
@@ -55,35 +63,82 @@ const float LOG_BASE = 8.0f;
 const float LN_LOG_BASE = float(qLn(LOG_BASE));
 const float AUTO_INTERATION_FACTOR = INTERATION_STEP / ZOOM_STEP;
 const float MAX_ONE_SHOT_ZOOM = 50.0f;
+const float MORE_ITERATIONS_STEP = 2.0f;   // iteration limit step of the I key
+
+// mean iterations per pixel of a frame the adaptive limit may spend, and
+// the range it stays in
+const double DEFAULT_ITERATION_BUDGET = 2000.0;
+const int MAX_ADAPTIVE_ITERATIONS = 1 << 20;
+
+// frame time of the mandelbrot shader during the input, and the smallest
+// fraction of the native resolution it may drop to for it
+const double DEFAULT_FRAME_BUDGET = 16.0;
+const double MIN_RESOLUTION_SCALE = 0.25;
+
+// the mandelbrot shader gets the center as a float uniform, below this pixel
+// size the image falls apart and the float-float shader takes over
+const double GPU_FLOAT_PIXEL_SIZE = 5e-7;
+
+// the float-float shader has about 48 bits, after that the cpu takes over
+const double GPU_MIN_PIXEL_SIZE = 1e-12;
 
 const float PIN_ROTATE_THRESHOLD = 0.05f;   // pin rotate threhold in degree
 
 const float RADIAN_TO_DEGREE = 57.295779513082320876798154814105f; // 180 / PI
 const float DEGREE_TO_RADIAN = 0.01745329251994329576923690768489f; // PI / 180
 
+// iteration limit that goes with a scale factor
+static float AutoIterations(double scale)
+{
+    return (scale < LOG_BASE ? 1.0f : (float(qLn(scale)) / LN_LOG_BASE)) * INIT_ITERATION;
+}
+
 MandelGLWidget::MandelGLWidget(QWidget* parentWindow /* = 0 */)
     : QGLWidget(parentWindow)
 {
     renderer = 0;
-
-#ifdef USE_QT_CONCURRENT
-    watcher = new QFutureWatcher<bool>(this);
-#endif
+    deepRenderer = 0;
+
+    cpuRendering = false;
+    renderThreads = 0;
+    renderTileSize = 64;
+    renderSubdivision = false;
+    renderSubdivisionSafeguard = true;
+    renderProgressive = false;
+    renderReprojection = true;
+    renderSupersampling = 1.0;
+    renderTileCacheSize = 32;
+    histogramColoring = false;
+    pyramidFillLevels = 0;
+    frameStatsInterval = 0;
+    readbackInterval = 0;
+    readbackFrames = 0;
+
+    adaptiveIterations = true;
+    iterationBudget = DEFAULT_ITERATION_BUDGET;
+    adaptiveFramePending = false;
 
     mandelProgram = 0;
+    mandelFFProgram = 0;
     currentIndex    = 0;
     nextIndex       = 1;
     for(int i=0; i < MandelGLWidget::PING_PONG_COUNT; i++)
     {
         fbo[i] = 0;
+        fboScale[i] = QVector2D(1.0f, 1.0f);
     }
+    dynamicResolution = true;
+    resolutionController.SetTarget(DEFAULT_FRAME_BUDGET);
+    resolutionController.SetMinimumScale(MIN_RESOLUTION_SCALE);
+    frameProfiler.SetGpuStage(FrameProfiler::STAGE_FRACTAL, dynamicResolution);
     lookupTextureId = 0;
     fboId = 0;
     modelViewProjection.setToIdentity();
     projectMat.setToIdentity();
 
     shaderErrors = "";
-    passCompiled = false;
+    shaderCacheEnabled = true;
+    mandelVariant = 0;
 
     mvpFractLoc     = 0;
     posFractLoc     = 0;
@@ -95,8 +150,25 @@ MandelGLWidget::MandelGLWidget(QWidget* parentWindow /* = 0 */)
     rotPivotFractLoc= 0;
     iterFractLoc    = 0;
     centerFractLoc  = 0;
+    periodicityFractLoc = 0;
     lookupTextureLoc= 0;
 
+    mvpFFLoc        = 0;
+    posFFLoc        = 0;
+    uvFFLoc         = 0;
+    scaleFFLoc      = 0;
+    resFFLoc        = 0;
+
+    rotFFLoc        = 0;
+    rotPivotHiFFLoc = 0;
+    rotPivotLoFFLoc = 0;
+    iterFFLoc       = 0;
+    centerHiFFLoc   = 0;
+    centerLoFFLoc   = 0;
+    oneFFLoc        = 0;
+    periodicityFFLoc = 0;
+    lookupTextureFFLoc = 0;
+
     mvpPostLoc      = 0;
     posPostLoc      = 0;
     uvPostLoc       = 0;
@@ -106,11 +178,14 @@ MandelGLWidget::MandelGLWidget(QWidget* parentWindow /* = 0 */)
     texCoodOffsetLoc= 0;
     rotationOffsetLoc=0;
     fboTextureLoc   = 0;
+    textureScaleLoc = 0;
+    textureLimitLoc = 0;
 
 
     // default values for the shader
-    centerPos = QVector2D(-0.5, 0.0);//QVector2D(-0.74635183346747f, 0.09853820615559f);
-    scaleFactor = 0.8f;//1333333333.333333333f;
+    centerX = BigFloat(-0.5);
+    centerY = BigFloat(0.0);
+    scaleFactor = 0.8;
     previousScale = scaleFactor;
     maxInterations = INIT_ITERATION;
 
@@ -134,6 +209,11 @@ MandelGLWidget::MandelGLWidget(QWidget* parentWindow /* = 0 */)
     imageScale = 1.0f;
     renderMandelbrot = true;
 
+    interacting = false;
+    previewPending = false;
+    requestedRotation = 0.0f;
+    requestedScale = 1.0f;
+
 #ifdef Q_OS_ANDROID
     // turn of touch events
     setAttribute(Qt::WA_AcceptTouchEvents);
@@ -160,31 +240,37 @@ MandelGLWidget::~MandelGLWidget()
     delete renderLoopTimer;
     renderLoopTimer = 0;
 
-#ifdef USE_QT_MULTI_THREAD
     if(renderThread.isRunning())
     {
+        renderer->CancelRendering();
+        if ( deepRenderer )
+            deepRenderer->CancelRendering();
         renderThread.quit();
+        renderThread.wait();
     }
-#endif
-
-#ifdef USE_QT_CONCURRENT
-    delete watcher;
-    watcher = 0;
-#endif
 
     delete renderer;
     renderer = 0;
 
+    delete deepRenderer;
+    deepRenderer = 0;
+
     // shaders
     delete mandelProgram;
     mandelProgram = 0;
 
+    delete mandelFFProgram;
+    mandelFFProgram = 0;
+
     delete postEffectProgram;
     postEffectProgram = 0;
 
     // textures
     glDeleteTextures(1, &lookupTextureId);
 
+    // pack buffers
+    frameReadback.ReleaseGL();
+
 
     // fbo
     for(int i=0; i < MandelGLWidget::PING_PONG_COUNT; i++)
@@ -201,12 +287,182 @@ MandelGLWidget::~MandelGLWidget()
 
 }
 
+void MandelGLWidget::SetCpuRendering(bool enabled)
+{
+    cpuRendering = enabled;
+}
+
+void MandelGLWidget::SetRenderThreads(int threadCount)
+{
+    renderThreads = threadCount;
+}
+
+void MandelGLWidget::SetRenderTileSize(int tileSize)
+{
+    renderTileSize = tileSize;
+}
+
+void MandelGLWidget::SetSubdivision(bool enabled, bool safeguard)
+{
+    renderSubdivision = enabled;
+    renderSubdivisionSafeguard = safeguard;
+}
+
+void MandelGLWidget::SetProgressive(bool enabled)
+{
+    renderProgressive = enabled;
+}
+
+void MandelGLWidget::SetReprojection(bool enabled)
+{
+    renderReprojection = enabled;
+}
+
+void MandelGLWidget::SetSupersampling(double samplesPerPixel)
+{
+    renderSupersampling = samplesPerPixel;
+}
+
+void MandelGLWidget::SetHistogramColoring(bool enabled)
+{
+    histogramColoring = enabled;
+}
+
+void MandelGLWidget::SetTileCacheSize(int megabytes)
+{
+    renderTileCacheSize = megabytes < 0 ? 0 : megabytes;
+}
+
+void MandelGLWidget::SetTilePyramid(const QString& path, int fillLevels)
+{
+    pyramidPath = path;
+    pyramidFillLevels = fillLevels < 0 ? 0 : fillLevels;
+}
+
+void MandelGLWidget::SetStartView(double x, double y, double scale)
+{
+    centerX = BigFloat(x);
+    centerY = BigFloat(y);
+    scaleFactor = scale;
+    previousScale = scaleFactor;
+    maxInterations = AutoIterations(scaleFactor);
+}
+
+void MandelGLWidget::SetIterationBudget(double iterationsPerPixel)
+{
+    iterationBudget = iterationsPerPixel;
+    adaptiveIterations = iterationsPerPixel > 0.0;
+}
+
+void MandelGLWidget::SetFrameBudget(double milliseconds)
+{
+    dynamicResolution = milliseconds > 0.0;
+    resolutionController.SetTarget(milliseconds);
+    frameProfiler.SetGpuStage(FrameProfiler::STAGE_FRACTAL, dynamicResolution);
+}
+
+void MandelGLWidget::SetFrameStatsDump(const QString& path, int intervalSeconds)
+{
+    frameStatsPath = path;
+    frameStatsInterval = intervalSeconds;
+}
+
+void MandelGLWidget::GrabFrame(const FrameReadback::Callback& callback)
+{
+    grabRequests.push_back(callback);
+    update();
+}
+
+void MandelGLWidget::SetReadbackInterval(int frames)
+{
+    readbackInterval = qMax(0, frames);
+}
+
+void MandelGLWidget::SetShaderCache(bool enabled)
+{
+    shaderCacheEnabled = enabled;
+}
+
+void MandelGLWidget::SaveScreenshot()
+{
+    QString directory = QDesktopServices::storageLocation(QDesktopServices::PicturesLocation);
+    if ( directory.isEmpty() || !QDir(directory).exists() )
+        directory = QDir::currentPath();
+
+    QString fileName = QDateTime::currentDateTime().toString("'FractDroidGL-'yyyyMMdd-hhmmss'.png'");
+    std::string path = QDir::toNativeSeparators(QDir(directory).filePath(fileName)).toLocal8Bit().constData();
+
+    GrabFrame([path](const unsigned char* rgba, int width, int height)
+    {
+        // the post effect shows the fbo upside down, its first row is the
+        // top one as the png has it; the buffer goes back to the driver
+        // after the callback, the encoder gets a copy
+        std::shared_ptr<std::vector<unsigned char> > image =
+            std::make_shared<std::vector<unsigned char> >(rgba, rgba + width * height * 4);
+
+        std::thread([path, image, width, height]()
+        {
+            if ( !WritePng(path.c_str(), &(*image)[0], width, height) )
+                qWarning("could not write %s", path.c_str());
+        }).detach();
+    });
+}
+
 void MandelGLWidget::initializeGL()
 {
-    renderer = new FractalRenderer(this);
+    renderer = new FractalRenderer(this, cpuRendering ? FractalRenderer::CPU_BACKEND
+                                                      : FractalRenderer::GPU_BACKEND);
+    renderer->SetThreadCount(renderThreads);
+    renderer->SetTileSize(renderTileSize);
+    renderer->SetSubdivision(renderSubdivision);
+    renderer->SetSubdivisionSafeguard(renderSubdivisionSafeguard);
+    renderer->SetProgressive(renderProgressive);
+    renderer->SetReprojection(renderReprojection);
+    renderer->SetSupersampling(renderSupersampling);
+    renderer->SetTileCacheBudget(size_t(renderTileCacheSize) << 20);
+
+    // the equalized palette of the gpu backend goes into the lookup texture
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    renderer->SetHistogramColoring(histogramColoring, int(maxTextureSize));
+#ifdef SHOW_PERIODICITY_CHECK
+    renderer->SetShowPeriodicityCheck(true);
+#endif
+
+    // the histograms are collected while the budget allows an adaptive
+    // limit, the A key turns it on and off later
+    iterationLimit.SetBudget(iterationBudget);
+    iterationLimit.SetRange(int(INIT_ITERATION), MAX_ADAPTIVE_ITERATIONS);
+    renderer->SetIterationHistogram(iterationBudget > 0.0);
+
+    // deep zooms are beyond the shader, the gpu backend hands them over
+    // to a cpu renderer
+    if ( !cpuRendering )
+    {
+        deepRenderer = new FractalRenderer(this, FractalRenderer::CPU_BACKEND);
+        deepRenderer->SetThreadCount(renderThreads);
+        deepRenderer->SetTileSize(renderTileSize);
+        deepRenderer->SetProgressive(renderProgressive);
+        deepRenderer->SetSupersampling(renderSupersampling);
+        deepRenderer->SetHistogramColoring(histogramColoring);
+        deepRenderer->SetIterationHistogram(iterationBudget > 0.0);
+    }
 
     initializeGLFunctions();
 
+    // gpu timer queries only when somebody looks at the results, the
+    // fractal stage for the resolution controller, see SetGpuStage
+    frameProfiler.InitializeGL();
+    frameReadback.InitializeGL();
+#ifdef SHOW_DEBUG_HUD
+    frameProfiler.SetGpuTiming(true);
+#endif
+    if ( !frameStatsPath.isEmpty() )
+    {
+        frameProfiler.SetGpuTiming(true);
+        frameProfiler.SetDump(frameStatsPath, frameStatsInterval);
+    }
+
 
     glEnable(GL_TEXTURE_2D);
     glDisable(GL_DEPTH_TEST);
@@ -230,52 +486,49 @@ void MandelGLWidget::initializeGL()
     // bind back the default texture id
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    mandelProgram = new QGLShaderProgram(context());
+    // the variants the driver refuses are remembered with the programs, a
+    // warm start loads the one it needs right away
+    shaderCache.InitializeGL(shaderCacheEnabled ? ShaderCache::DefaultDirectory() : QString());
 
-    // add vertex and fragment shaders for mandelbrot program
-    QGLShader mandelbrotVertexShader(QGLShader::Vertex, context());
-    passCompiled = mandelbrotVertexShader.compileSourceFile(":/FractDroidGL/Resources/mandelbrot_vert.glsl");
-
-    if( passCompiled == false )
-    {
-        shaderErrors = mandelbrotVertexShader.log();
-    }
-
-    QGLShader mandelbrotFragShader(QGLShader::Fragment, context());
-
-    // try to load the original shader
-    // if the compilation failed, try to fall back plan
-    QFile fragShaderFile(":/FractDroidGL/Resources/mandelbrot_frag.glsl");
-
-    if (!fragShaderFile.open(QIODevice::ReadOnly | QIODevice::Text))
-        return;
+    int periodicity = ShaderCache::PERIODICITY_CHECK;
+#ifdef SHOW_PERIODICITY_CHECK
+    periodicity |= ShaderCache::SHOW_PERIODICITY;
+#endif
 
-    QTextStream in(&fragShaderFile);
+    // doubles where the driver has them, the fall back shader for the
+    // Tegra 2, and mediump iterations for fragment shaders without highp.
+    // Those go without the periodicity check: the square of its epsilon,
+    // about (pixel size * 1e-3)^2, is 0 in fp16 and the check never hits
+    QList<int> variants;
+#if !defined (QT_OPENGL_ES_2)
+    variants << (periodicity | ShaderCache::FP64)
+             << (periodicity | ShaderCache::FP64 | ShaderCache::FALL_BACK);
+#endif
+    variants << periodicity
+             << (periodicity | ShaderCache::FALL_BACK)
+             << ShaderCache::MEDIUM_PRECISION
+             << (ShaderCache::MEDIUM_PRECISION | ShaderCache::FALL_BACK);
 
-    // read the whole shader in one shot, it is a small text file anyway
-    QString fragShaderContent = in.readAll();
-    fragShaderFile.close();
-    passCompiled = mandelbrotFragShader.compileSourceCode(fragShaderContent);
+    mandelProgram = shaderCache.BuildFirst(":/FractDroidGL/Resources/mandelbrot_vert.glsl",
+                                           ":/FractDroidGL/Resources/mandelbrot_frag.glsl",
+                                           variants, &mandelVariant, &shaderErrors);
 
-    if( passCompiled == false)
-    {
-        shaderErrors += mandelbrotFragShader.log();
-    }
+    //set up the post effect shader program to do the final rendering
+    postEffectProgram = shaderCache.Build(":/FractDroidGL/Resources/vert.glsl",
+                                          ":/FractDroidGL/Resources/frag.glsl", 0, &shaderErrors);
 
-    // use the fallback shader instead
-    if( shaderErrors.isEmpty() == false)
+    if ( !mandelProgram || !postEffectProgram )
     {
-        QString removeString("//#define FALL_BACK");
-        // locate the comment, uncomment it by remove the "//"
-        fragShaderContent.remove(fragShaderContent.indexOf(removeString), 2);
-        passCompiled = mandelbrotFragShader.compileSourceCode(fragShaderContent);
-        shaderErrors = "";
+        QString title = "Please report the following errors to developer, thank you";
+        QMessageBox msgBox(this);
+        msgBox.setWindowTitle(title);
+        msgBox.setText(shaderErrors);
+        msgBox.setStandardButtons(QMessageBox::Ok);
+        msgBox.exec();
+        this->close();
+        return;
     }
 
-    mandelProgram->addShader(&mandelbrotVertexShader);
-    mandelProgram->addShader(&mandelbrotFragShader);
-
-    mandelProgram->link();
     mandelProgram->bind();
 
     // Get the attribute/uniform locations from shaders
@@ -288,43 +541,21 @@ void MandelGLWidget::initializeGL()
     rotPivotFractLoc = mandelProgram->uniformLocation("rotatePivot");
     iterFractLoc = mandelProgram->uniformLocation("maxIterations");
     centerFractLoc = mandelProgram->uniformLocation("center");
+    periodicityFractLoc = mandelProgram->uniformLocation("periodicityEpsilon");
     lookupTextureLoc = mandelProgram->uniformLocation("lookUpTexture");
 
-    //set up the post effect shader program to do the final rendering
-    postEffectProgram = new QGLShaderProgram(context());
-
-    // add vertex and fragment shaders for post effect program
-    QGLShader vertexShader(QGLShader::Vertex, context());
-    passCompiled = vertexShader.compileSourceFile(":/FractDroidGL/Resources/vert.glsl");
+    LoadFloatFloatShader();
 
-    if( passCompiled == false)
-    {
-        shaderErrors = vertexShader.log();
-    }
+    if ( mandelVariant & ShaderCache::MEDIUM_PRECISION )
+        qWarning("mandelbrot shader in mediump, the periodicity check is off");
 
-    QGLShader fragShader(QGLShader::Fragment, context());
-    passCompiled = fragShader.compileSourceFile(":/FractDroidGL/Resources/frag.glsl");
+    // cold when everything was compiled, warm when it all came from the
+    // cache; --no-shader-cache gives the cold time on every start
+    qDebug("shaders: %s, %d from the cache, %d compiled, %d variants refused, %.1f ms (%s start)",
+           qPrintable(ShaderCache::OptionNames(mandelVariant)), shaderCache.Loaded(),
+           shaderCache.Compiled(), shaderCache.Rejected(), shaderCache.Seconds() * 1000.0,
+           shaderCache.Compiled() == 0 ? "warm" : (shaderCache.Loaded() == 0 ? "cold" : "partly warm"));
 
-    if( passCompiled == false)
-    {
-        shaderErrors += fragShader.log();
-    }
-
-    if( shaderErrors.isEmpty() == false)
-    {
-        QString title = "Please report the following errors to developer, thank you";
-        QMessageBox msgBox(this);
-        msgBox.setWindowTitle(title);
-        msgBox.setText(shaderErrors);
-        msgBox.setStandardButtons(QMessageBox::Ok);
-        msgBox.exec();
-        this->close();
-    }
-
-    postEffectProgram->addShader(&vertexShader);
-    postEffectProgram->addShader(&fragShader);
-
-    postEffectProgram->link();
     postEffectProgram->bind();
 
     mvpPostLoc = postEffectProgram->uniformLocation("MVP");
@@ -337,6 +568,8 @@ void MandelGLWidget::initializeGL()
     rotationOffsetLoc = postEffectProgram->uniformLocation("rotation");
     rotationPivotLoc = postEffectProgram->uniformLocation("rotationPivot");
     fboTextureLoc = postEffectProgram->uniformLocation("fboTexture");
+    textureScaleLoc = postEffectProgram->uniformLocation("textureScale");
+    textureLimitLoc = postEffectProgram->uniformLocation("textureLimit");
 
     //postEffectProgram->enableAttributeArray(posAttrLoc);
     //postEffectProgram->enableAttributeArray(uvAttrLoc);
@@ -344,7 +577,7 @@ void MandelGLWidget::initializeGL()
     //init fbo
     for(int i=0; i < MandelGLWidget::PING_PONG_COUNT; i++)
     {
-        fbo[i] = new QGLFramebufferObject(width(), height());
+        fbo[i] = CreateFBO(width(), height());
     }
 
     // Clear the background with black color
@@ -363,22 +596,65 @@ void MandelGLWidget::initializeGL()
     renderLoopTimer->start();
 #endif
 
-#if defined ( USE_QT_CONCURRENT )
-    connect(watcher, SIGNAL(finished()), this, SLOT(updateRenderFBO()));
-#else
     connect(renderer, SIGNAL(FinishedRendering()),
         this, SLOT(updateRenderFBO()));
     connect(this, SIGNAL(StartFractalRendering()),
         renderer, SLOT(StartRendering()));
-#if defined (USE_QT_MULTI_THREAD)
-    renderer->moveToThread(&renderThread);
-#endif  //USE_QT_MULTI_THREAD
-#endif  //USE_QT_CONCURRENT
+
+    // the gpu renders on the gui thread, the cpu backend gets its own thread
+    // to drive the tile workers from so the ui stays responsive
+    if ( renderer->Backend() == FractalRenderer::CPU_BACKEND )
+    {
+        renderer->moveToThread(&renderThread);
+        renderThread.start();
+    }
+    else
+    {
+        connect(renderer, SIGNAL(FinishedProbe(bool)),
+            this, SLOT(updateProbe(bool)));
+
+        connect(deepRenderer, SIGNAL(FinishedRendering()),
+            this, SLOT(updateRenderFBO()));
+        connect(this, SIGNAL(StartDeepRendering()),
+            deepRenderer, SLOT(StartRendering()));
+
+        deepRenderer->moveToThread(&renderThread);
+        renderThread.start();
+    }
     
     //StopInteraction();
 
 }
 
+void MandelGLWidget::LoadFloatFloatShader()
+{
+    // optional, without it deep views go to the cpu a bit earlier
+    QString errors;
+    mandelFFProgram = shaderCache.Build(":/FractDroidGL/Resources/mandelbrot_ff_vert.glsl",
+                                        ":/FractDroidGL/Resources/mandelbrot_ff_frag.glsl",
+                                        mandelVariant & ShaderCache::SHOW_PERIODICITY, &errors);
+    if ( !mandelFFProgram )
+    {
+        qWarning("float-float shader disabled: %s", qPrintable(errors));
+        return;
+    }
+
+    mvpFFLoc = mandelFFProgram->uniformLocation("MVP");
+    posFFLoc = mandelFFProgram->attributeLocation("Position");
+    uvFFLoc = mandelFFProgram->attributeLocation("InTexCoord");
+    scaleFFLoc = mandelFFProgram->uniformLocation("scale");
+    resFFLoc = mandelFFProgram->uniformLocation("whScale");
+    rotFFLoc = mandelFFProgram->uniformLocation("rotRadian");
+    rotPivotHiFFLoc = mandelFFProgram->uniformLocation("rotatePivotHi");
+    rotPivotLoFFLoc = mandelFFProgram->uniformLocation("rotatePivotLo");
+    iterFFLoc = mandelFFProgram->uniformLocation("maxIterations");
+    centerHiFFLoc = mandelFFProgram->uniformLocation("centerHi");
+    centerLoFFLoc = mandelFFProgram->uniformLocation("centerLo");
+    oneFFLoc = mandelFFProgram->uniformLocation("ffOne");
+    periodicityFFLoc = mandelFFProgram->uniformLocation("periodicityEpsilon");
+    lookupTextureFFLoc = mandelFFProgram->uniformLocation("lookUpTexture");
+}
+
 void MandelGLWidget::resizeGL(int width, int height)
 {
 
@@ -413,30 +689,77 @@ void MandelGLWidget::resizeGL(int width, int height)
         if (fbo[i]->width() != width || fbo[i]->height() != height)
         {
             delete fbo[i];
-            fbo[i] = new QGLFramebufferObject(width, height);
+            fbo[i] = CreateFBO(width, height);
         }
+        fboScale[i] = QVector2D(1.0f, 1.0f);
     }
 
     // re-compute the rect for HUD after resizing
     isHUDDirty = true;
 
+    // the pyramid tiles depend on the pixel size, the first size the
+    // widget gets is the one the start view is filled in
+    if ( cpuRendering && !pyramidPath.isEmpty() )
+    {
+        std::vector<MandelbrotView> fillViews;
+        for ( int level = 0; level < pyramidFillLevels; level ++)
+        {
+            MandelbrotView view = CurrentView();
+            view.scale = scaleFactor * double(1 << level);
+            view.maxIterations = int(AutoIterations(view.scale) + 0.5f);
+            fillViews.push_back(view);
+        }
+
+        renderer->SetTilePyramid(QFile::encodeName(pyramidPath).constData(), fillViews);
+        pyramidPath.clear();
+    }
+
     StopInteraction();
 
 }
 
 void MandelGLWidget::paintGL()
 {
+    // the adaptive limit grew, render the view again with it; before
+    // makeCurrent, the gpu backend renders on its own context right away
+    if ( adaptiveFramePending && !interacting )
+    {
+        adaptiveFramePending = false;
+        RequestFrame();
+    }
+
     makeCurrent();
 
+    frameProfiler.Begin(FrameProfiler::STAGE_PAINT);
+
+    // reads of the frames before that are done by now
+    if ( frameReadback.Pending() > 0 )
+    {
+        ScopedStageTimer deliveryTimer(frameProfiler, FrameProfiler::STAGE_DELIVERY);
+        frameReadback.Poll();
+    }
+
     //first time init
     if(fboId == 0)
         StopInteraction();
 
+    // the gpu follows the input at the resolution that fits the frame
+    // budget, once per view the input gets to; before makeCurrent as well
+    if ( interacting && dynamicResolution && ActiveRenderer()->Backend() == FractalRenderer::GPU_BACKEND &&
+         CurrentView() != requestedView )
+        RequestFrame();
+
+    // the coarse pass of a cpu frame is quick enough to follow the input,
+    // ask for the next one as soon as the last one is on the screen
+    if ( interacting && !previewPending && ActiveRenderer()->Backend() == FractalRenderer::CPU_BACKEND )
+        RequestFrame();
+
     glDisable(GL_CULL_FACE);
 
     glClear(GL_COLOR_BUFFER_BIT);
 
     //render the post effect
+    frameProfiler.Begin(FrameProfiler::STAGE_POST_EFFECT);
     postEffectProgram->bind();
 
     glActiveTexture(GL_TEXTURE0);
@@ -459,6 +782,13 @@ void MandelGLWidget::paintGL()
     postEffectProgram->setUniformValue( rotationPivotLoc, rotationPivotSS);
     postEffectProgram->setUniformValue( fboTextureLoc, 0);
 
+    // half a texel inside the rendered part
+    QVector2D shownScale = fboScale[nextIndex];
+    QVector2D shownLimit(shownScale.x() - 0.5f / float(fbo[nextIndex]->width()),
+                         shownScale.y() - 0.5f / float(fbo[nextIndex]->height()));
+    postEffectProgram->setUniformValue( textureScaleLoc, shownScale);
+    postEffectProgram->setUniformValue( textureLimitLoc, shownLimit);
+
     // draw the quad
     glDrawElements(GL_TRIANGLES, 2*3, GL_UNSIGNED_SHORT, quad_indices );
 
@@ -469,9 +799,41 @@ void MandelGLWidget::paintGL()
 
     //render the mandelbrot image ends
     postEffectProgram->release();
+    frameProfiler.End(FrameProfiler::STAGE_POST_EFFECT);
+
+    if ( readbackInterval > 0 && ++ readbackFrames >= readbackInterval )
+    {
+        readbackFrames = 0;
+        grabRequests.push_back([](const unsigned char*, int, int) {});
+    }
+
+    // the shown frame goes out to the pack buffers while the next one
+    // renders, the rendered part of it
+    if ( !grabRequests.empty() )
+    {
+        ScopedStageTimer readbackTimer(frameProfiler, FrameProfiler::STAGE_READBACK);
+        int readWidth = qMax(1, int(fbo[nextIndex]->width() * fboScale[nextIndex].x() + 0.5f));
+        int readHeight = qMax(1, int(fbo[nextIndex]->height() * fboScale[nextIndex].y() + 0.5f));
+
+        // the requests that found every buffer in flight wait for the
+        // next frame, which comes right away
+        std::vector<FrameReadback::Callback> refused;
+        fbo[nextIndex]->bind();
+        for ( size_t i = 0; i < grabRequests.size(); i ++)
+        {
+            if ( !frameReadback.Request(readWidth, readHeight, grabRequests[i]) )
+                refused.push_back(grabRequests[i]);
+        }
+        fbo[nextIndex]->release();
+
+        grabRequests.swap(refused);
+        if ( !grabRequests.empty() )
+            update();
+    }
 
     if ( showHUD )
     {
+        ScopedStageTimer hudTimer(frameProfiler, FrameProfiler::STAGE_HUD);
 
         // build the HUG message
 
@@ -490,25 +852,265 @@ void MandelGLWidget::paintGL()
         //shader paremeters
 
         hudMessage += "\nZoom: ";
-        tempStr.setNum(scaleFactor, 'f', 2);
+        tempStr.setNum(scaleFactor, scaleFactor < 1e6 ? 'f' : 'e', 2);
         hudMessage += tempStr;
 
         hudMessage += "\nRotation: ";
         tempStr.setNum(rotation * RADIAN_TO_DEGREE, 'f', 1);
         hudMessage += tempStr;
 
+        if ( fboScale[nextIndex].y() < 1.0f )
+        {
+            hudMessage += "\nResolution: ";
+            tempStr.setNum(int(fboScale[nextIndex].y() * 100.0f + 0.5f));
+            hudMessage += tempStr;
+            hudMessage += "%";
+        }
+
         hudMessage += "\nIterations: ";
         tempStr.setNum(int(maxInterations));
         hudMessage += tempStr;
 
+        // what the adaptive limit made of the last frame
+        if ( adaptiveIterations && lastHistogram.pixels > 0 )
+        {
+            hudMessage += " (";
+            hudMessage += AdaptiveIterationLimit::DecisionName(iterationLimit.LastDecision());
+            hudMessage += ")\nCapped: ";
+            tempStr.setNum(lastHistogram.CappedFraction() * 100.0, 'f', 1);
+            hudMessage += tempStr;
+            hudMessage += "%, boundary ";
+            tempStr.setNum(lastHistogram.BoundaryCappedFraction() * 100.0, 'f', 2);
+            hudMessage += tempStr;
+            hudMessage += "%";
+        }
+
+        // deep zoom frames start all pixels past the iterations the series
+        // approximation covers
+        FractalRenderer* frameRenderer = ActiveRenderer();
+        HistogramColoringStats coloringStats;
+        if ( frameRenderer->Backend() == FractalRenderer::CPU_BACKEND )
+        {
+            int imageWidth, imageHeight;
+            frameRenderer->LockResult(imageWidth, imageHeight);
+
+            coloringStats = frameRenderer->LastHistogramColoringStats();
+
+            if ( frameRenderer->LastFrameWasDeep() )
+            {
+                hudMessage += "\nSkipped: ";
+                tempStr.setNum(frameRenderer->LastPerturbationStats().skippedIterations);
+                hudMessage += tempStr;
+            }
+
+            if ( frameRenderer->LastProgressivePass() >= 0 )
+            {
+                hudMessage += "\nPass: ";
+                tempStr.setNum(frameRenderer->LastProgressivePass() + 1);
+                hudMessage += tempStr;
+                hudMessage += "/";
+                tempStr.setNum(PROGRESSIVE_PASSES);
+                hudMessage += tempStr;
+            }
+
+            SupersamplingStats supersamplingStats = frameRenderer->LastSupersamplingStats();
+            if ( supersamplingStats.pixels > 0 )
+            {
+                hudMessage += "\nSamples: ";
+                tempStr.setNum(supersamplingStats.SamplesPerPixel(), 'f', 2);
+                hudMessage += tempStr;
+                hudMessage += " per pixel, ";
+                tempStr.setNum(supersamplingStats.RefinedFraction() * 100.0, 'f', 1);
+                hudMessage += tempStr;
+                hudMessage += "% refined";
+            }
+
+            if ( frameRenderer->LastResumedIterations() > 0 )
+            {
+                hudMessage += "\nResumed from: ";
+                tempStr.setNum(frameRenderer->LastResumedIterations());
+                hudMessage += tempStr;
+            }
+
+            if ( frameRenderer->LastFrameWasReprojected() )
+            {
+                hudMessage += "\nReused: ";
+                tempStr.setNum(frameRenderer->LastReprojectionStats().ReusedFraction() * 100.0, 'f', 1);
+                hudMessage += tempStr;
+                hudMessage += "%";
+            }
+
+            // deep zoom frames do not go through the cache
+            if ( renderTileCacheSize > 0 && !frameRenderer->LastFrameWasDeep() )
+            {
+                TileCacheStats cacheTotals = frameRenderer->TileCacheTotals();
+
+                hudMessage += "\nTiles: ";
+                tempStr.setNum(cacheTotals.hits);
+                hudMessage += tempStr;
+                hudMessage += " hit / ";
+                if ( cacheTotals.pyramidHits > 0 )
+                {
+                    tempStr.setNum(cacheTotals.pyramidHits);
+                    hudMessage += tempStr;
+                    hudMessage += " disk / ";
+                }
+                tempStr.setNum(cacheTotals.misses);
+                hudMessage += tempStr;
+                hudMessage += " miss";
+
+                hudMessage += "\nCache: ";
+                tempStr.setNum(frameRenderer->TileCacheBytes() / 1048576.0, 'f', 1);
+                hudMessage += tempStr;
+                hudMessage += " MB";
+            }
+
+            if ( frameRenderer->LastFrameWasSubdivided() )
+            {
+                hudMessage += "\nFilled: ";
+                tempStr.setNum(frameRenderer->LastSubdivisionStats().SkippedFraction() * 100.0, 'f', 1);
+                hudMessage += tempStr;
+                hudMessage += "%";
+            }
+
+            frameRenderer->UnlockResult();
+        }
+        else
+        {
+            // the gpu renderer probes its views on a thread of its own
+            int imageWidth, imageHeight;
+            frameRenderer->LockResult(imageWidth, imageHeight);
+            coloringStats = frameRenderer->LastHistogramColoringStats();
+            frameRenderer->UnlockResult();
+        }
+
+        // time of the counting and recoloring, the gpu backend only counts
+        if ( coloringStats.pixels > 0 )
+        {
+            hudMessage += "\nColoring: ";
+            tempStr.setNum(coloringStats.Seconds() * 1000.0, 'f', 2);
+            hudMessage += tempStr;
+            hudMessage += " ms, ";
+            tempStr.setNum(coloringStats.histograms);
+            hudMessage += tempStr;
+            hudMessage += coloringStats.histograms == 1 ? " histogram" : " histograms";
+        }
+
 #ifdef SHOW_DEBUG_HUD
+        if ( frameRenderer->Backend() == FractalRenderer::CPU_BACKEND )
+        {
+            int imageWidth, imageHeight;
+            frameRenderer->LockResult(imageWidth, imageHeight);
+
+            hudMessage += "\nThreads: ";
+            tempStr.setNum(frameRenderer->ThreadCount());
+            hudMessage += tempStr;
+
+            hudMessage += "\nFrame time: ";
+            tempStr.setNum(frameRenderer->LastFrameSeconds() * 1000.0, 'f', 1);
+            hudMessage += tempStr;
+            hudMessage += " ms";
+
+            if ( frameRenderer->LastFrameWasReprojected() )
+            {
+                hudMessage += "\nSaved: ";
+                tempStr.setNum(frameRenderer->LastSavedSeconds() * 1000.0, 'f', 1);
+                hudMessage += tempStr;
+                hudMessage += " ms";
+            }
+
+            hudMessage += "\nUtilization: ";
+            tempStr.setNum(frameRenderer->LastUtilization() * 100.0, 'f', 1);
+            hudMessage += tempStr;
+            hudMessage += "%";
+
+            hudMessage += "\nGiter/s: ";
+            tempStr.setNum(frameRenderer->LastKernelStats().iterations / (frameRenderer->LastFrameSeconds() * 1e9 + 1e-9), 'f', 2);
+            hudMessage += tempStr;
+
+            hudMessage += "\nPeriodic: ";
+            tempStr.setNum(frameRenderer->LastKernelStats().periodicPixels);
+            hudMessage += tempStr;
+
+            if ( frameRenderer->LastFrameWasDeep() )
+            {
+                PerturbationStats deepStats = frameRenderer->LastPerturbationStats();
+
+                hudMessage += "\nReferences: ";
+                tempStr.setNum(deepStats.references);
+                hudMessage += tempStr;
+
+                hudMessage += "\nGlitched: ";
+                tempStr.setNum(deepStats.glitchedPixels);
+                hudMessage += tempStr;
+                hudMessage += " / ";
+                tempStr.setNum(deepStats.unresolvedPixels);
+                hudMessage += tempStr;
+            }
+
+            frameRenderer->UnlockResult();
+        }
+
+        // median / 95th percentile of the last frames per stage on the cpu,
+        // the gpu median behind them
+        hudMessage += "\nStages (ms): ";
+        hudMessage += frameProfiler.GpuTiming() ? "cpu / gpu" : "cpu";
+        for ( int i = 0; i < FrameProfiler::STAGE_COUNT; i ++)
+        {
+            FrameProfiler::Stage stage = FrameProfiler::Stage(i);
+            FrameProfiler::StageStats cpuStats = frameProfiler.CpuStats(stage);
+            if ( cpuStats.samples == 0 )
+                continue;
+
+            hudMessage += "\n";
+            hudMessage += FrameProfiler::StageName(stage);
+            hudMessage += ": ";
+            tempStr.setNum(cpuStats.p50Ms, 'f', 2);
+            hudMessage += tempStr;
+            hudMessage += " / ";
+            tempStr.setNum(cpuStats.p95Ms, 'f', 2);
+            hudMessage += tempStr;
+
+            FrameProfiler::StageStats gpuStats = frameProfiler.GpuStats(stage);
+            if ( gpuStats.samples > 0 )
+            {
+                hudMessage += ", ";
+                tempStr.setNum(gpuStats.p50Ms, 'f', 2);
+                hudMessage += tempStr;
+            }
+        }
+
+        if ( frameReadback.Delivered() > 0 || frameReadback.Dropped() > 0 )
+        {
+            hudMessage += "\nReadback: ";
+            hudMessage += FrameReadback::ModeName(frameReadback.GetMode());
+            hudMessage += ", ";
+            tempStr.setNum(frameReadback.Delivered());
+            hudMessage += tempStr;
+            hudMessage += " / ";
+            tempStr.setNum(frameReadback.Dropped());
+            hudMessage += tempStr;
+            hudMessage += " dropped";
+        }
+
+        // startup cost of the shaders, and the variant the driver took
+        hudMessage += "\nShaders: ";
+        tempStr.setNum(shaderCache.Seconds() * 1000.0, 'f', 1);
+        hudMessage += tempStr;
+        hudMessage += " ms, ";
+        tempStr.setNum(shaderCache.Loaded());
+        hudMessage += tempStr;
+        hudMessage += " cached\n";
+        hudMessage += ShaderCache::OptionNames(mandelVariant);
+
+        // enough digits to tell two neighbouring pixels apart
+        int centerDigits = qMax(8, int(-log10(4.0 / (scaleFactor * height()))) + 2);
+
         hudMessage += "\nCenter position: ";
-        tempStr.setNum(centerPos.x(), 'f', 8);
         hudMessage += "\n";
-        hudMessage += tempStr;
-        tempStr.setNum(centerPos.y(), 'f', 8);
+        hudMessage += QString::fromLatin1(centerX.ToString(centerDigits).c_str());
         hudMessage += "\n";
-        hudMessage += tempStr;
+        hudMessage += QString::fromLatin1(centerY.ToString(centerDigits).c_str());
 
 #endif
 
@@ -528,9 +1130,14 @@ void MandelGLWidget::paintGL()
     }
 
 
+    frameProfiler.Begin(FrameProfiler::STAGE_SWAP);
     swapBuffers();
+    frameProfiler.End(FrameProfiler::STAGE_SWAP);
     //emit NeedSwapBuffer();
 
+    frameProfiler.End(FrameProfiler::STAGE_PAINT);
+    frameProfiler.FrameFinished();
+
     doneCurrent();
 }
 
@@ -608,14 +1215,14 @@ void MandelGLWidget::keyPressEvent(QKeyEvent *event)
     case Qt::Key_Z:
         scaleFactor *= ZOOM_STEP;
         // interation = log10(scaleFactor) * INIT_ITERATION when scaleFactor > 10
-        maxInterations = (scaleFactor < LOG_BASE ? 1.0f : (float(qLn(scaleFactor)) / LN_LOG_BASE)) * INIT_ITERATION;  // *= INTERATION_STEP;
+        FollowZoomIterations(scaleFactor / ZOOM_STEP);  // *= INTERATION_STEP;
 
         StartInteraction();
         break;
     // zoom out
     case Qt::Key_X:
         scaleFactor /= ZOOM_STEP;
-        maxInterations  = (scaleFactor < LOG_BASE ? 1.0f : (float(qLn(scaleFactor)) / LN_LOG_BASE)) * INIT_ITERATION; //  /= INTERATION_STEP;
+        FollowZoomIterations(scaleFactor * ZOOM_STEP); //  /= INTERATION_STEP;
 
         StartInteraction();
         break;
@@ -638,6 +1245,39 @@ void MandelGLWidget::keyPressEvent(QKeyEvent *event)
         StartInteraction();
         break;
 
+    // more iterations for the same view, the cpu renderers go on from the
+    // pixels that hit the old limit
+    case Qt::Key_I:
+        maxInterations *= MORE_ITERATIONS_STEP;
+
+        // the limit stays where it is put until the A key
+        adaptiveIterations = false;
+        adaptiveFramePending = false;
+
+        RequestFrame();
+        break;
+
+    // adaptive iteration limit on and off, off it follows the zoom level
+    case Qt::Key_A:
+        adaptiveIterations = !adaptiveIterations && iterationBudget > 0.0;
+        adaptiveFramePending = false;
+        if ( adaptiveIterations )
+        {
+            // the last frame has its histogram already
+            AdaptIterations(ActiveRenderer());
+        }
+        else
+        {
+            maxInterations = AutoIterations(scaleFactor);
+            RequestFrame();
+        }
+        break;
+
+    // screenshot of the shown frame
+    case Qt::Key_S:
+        SaveScreenshot();
+        break;
+
     case Qt::Key_Escape:
         this->close();
         break;
@@ -824,7 +1464,7 @@ void MandelGLWidget::handelPinchGesture(QPinchGesture *gesture)
             float scaleLevel = scaleFactor / previousScale;
             if( scaleLevel > ZOOM_STEP || scaleLevel  < 1.0f / ZOOM_STEP )
             {
-                maxInterations = (scaleFactor < LOG_BASE ? 1.0f : (float(qLn(scaleFactor)) / LN_LOG_BASE)) * INIT_ITERATION;
+                FollowZoomIterations(previousScale);
                 previousScale = scaleFactor;
             }
 
@@ -875,8 +1515,12 @@ void MandelGLWidget::UpdateMandelbrotCenter(QPointF& pixelOffset)
                            pixelOffset.y() * cos(-rotation) + pixelOffset.x() * sin(-rotation));
 
     // remap the pixel offset from [0, width][0, height] to [-2, 1][-1, 1]
-    centerPos.setX(centerPos.x() + rotatedOffset.x() * projectedScaleFactor.x() / scaleFactor);
-    centerPos.setY(centerPos.y() + rotatedOffset.y() * projectedScaleFactor.y() / scaleFactor);
+    //
+    // the offset itself is fine in double, adding it to the center is not:
+    // the center keeps enough bits to resolve a pixel at the current zoom
+    int centerBits = BigFloat::BitsForPixelSize(4.0 / (scaleFactor * height()));
+    centerX += BigFloat(rotatedOffset.x() * projectedScaleFactor.x() / scaleFactor, centerBits);
+    centerY += BigFloat(rotatedOffset.y() * projectedScaleFactor.y() / scaleFactor, centerBits);
 
     // update rotation pivot
     UpdateRotationPivot();
@@ -898,7 +1542,7 @@ void MandelGLWidget::UpdateRotationPivot()
 
 //    rotationPivotSS.setX(screenPivot.x()/fWidth);
 //    rotationPivotSS.setY(screenPivot.y()/fHeight);
-    rotationPivot = centerPos;
+    rotationPivot = QVector2D(centerX.ToDouble(), centerY.ToDouble());
     rotationPivotSS.setX(0.5f);
     rotationPivotSS.setY(0.5f);
 }
@@ -912,17 +1556,105 @@ void MandelGLWidget::UpdateProjectedScales()
 
 void MandelGLWidget::RenderFractal()
 {
+    // a reduced resolution while the input goes on, the native one once
+    // the view settles; the post effect stretches the part that is rendered
+    double scale = interacting && dynamicResolution ? resolutionController.Scale() : 1.0;
+    int renderWidth = qMax(1, int(width() * scale + 0.5));
+    int renderHeight = qMax(1, int(height() * scale + 0.5));
+    fboScale[currentIndex] = QVector2D(float(renderWidth) / float(width()), float(renderHeight) / float(height()));
+
+    // the timer query of the pass is tagged with its scale
+    ScopedStageTimer fractalTimer(frameProfiler, FrameProfiler::STAGE_FRACTAL, scale);
+
+    // the gpu time of an earlier pass, read without waiting for it
+    double passMs, passScale;
+    if ( dynamicResolution && frameProfiler.TakeGpuResult(FrameProfiler::STAGE_FRACTAL, passMs, passScale) )
+        resolutionController.AddPass(passScale, passMs);
+
+    QElapsedTimer passTimer;
+    passTimer.start();
+
     BindFBO();
+    glViewport(0, 0, renderWidth, renderHeight);
+    DrawFractal(renderHeight);
+    ReleaseFBO();
+
+    // without timer queries the pass has to be done for its time; only
+    // while the input goes on, the scale does not matter otherwise
+    if ( dynamicResolution && interacting && !frameProfiler.HasGpuTimer() )
+    {
+        glFinish();
+        resolutionController.AddPass(scale, passTimer.nsecsElapsed() * 1e-6);
+    }
+}
 
+void MandelGLWidget::SetLookupColors(const unsigned char* rgba, int count)
+{
+    if ( !rgba || count <= 0 )
+        return;
+
+    // lookup.png went in as the bytes of a QImage, BGRA, and the shaders
+    // swap them back with .bgra
+    std::vector<unsigned char> bgra(rgba, rgba + count * 4);
+    for ( int i = 0; i < count; i ++)
+        qSwap(bgra[i * 4], bgra[i * 4 + 2]);
+
+    glBindTexture(GL_TEXTURE_2D, lookupTextureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, count, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &bgra[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void MandelGLWidget::DrawFractal(int renderHeight)
+{
     glDisable(GL_CULL_FACE);
     glClear(GL_COLOR_BUFFER_BIT);// | GL_DEPTH_BUFFER_BIT);
 
-    //render the mandelbrot image beigns
-    mandelProgram->bind();
-
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, lookupTextureId);
 
+    if ( UseFloatFloatShader() )
+    {
+        // center and pivot as hi + lo float pairs, split from the double
+        // rounding of the precise center; the pivot is the center, see
+        // UpdateRotationPivot
+        double centerXd = centerX.ToDouble();
+        double centerYd = centerY.ToDouble();
+        QVector2D centerHi(float(centerXd), float(centerYd));
+        QVector2D centerLo(float(centerXd - double(centerHi.x())), float(centerYd - double(centerHi.y())));
+
+        mandelFFProgram->bind();
+
+        mandelFFProgram->enableAttributeArray(posFFLoc);
+        mandelFFProgram->setAttributeArray(posFFLoc, quad_vertices, 2 );
+
+        mandelFFProgram->enableAttributeArray(uvFFLoc);
+        mandelFFProgram->setAttributeArray(uvFFLoc, quad_uvs, 2 );
+
+        mandelFFProgram->setUniformValue(mvpFFLoc, modelViewProjection );
+        mandelFFProgram->setUniformValue(scaleFFLoc, float(scaleFactor));
+        mandelFFProgram->setUniformValue(resFFLoc, whScale);
+        mandelFFProgram->setUniformValue(rotFFLoc, rotation);
+        mandelFFProgram->setUniformValue(rotPivotHiFFLoc, centerHi);
+        mandelFFProgram->setUniformValue(rotPivotLoFFLoc, centerLo);
+        mandelFFProgram->setUniformValue(iterFFLoc, int(maxInterations + 0.5f));
+        mandelFFProgram->setUniformValue(centerHiFFLoc, centerHi);
+        mandelFFProgram->setUniformValue(centerLoFFLoc, centerLo);
+        mandelFFProgram->setUniformValue(oneFFLoc, 1.0f);
+        mandelFFProgram->setUniformValue(periodicityFFLoc, float(PeriodicityEpsilon(4.0 / (scaleFactor * renderHeight))));
+        mandelFFProgram->setUniformValue(lookupTextureFFLoc, 0);
+
+        glDrawElements(GL_TRIANGLES, 2*3, GL_UNSIGNED_SHORT, quad_indices );
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        mandelFFProgram->disableAttributeArray(uvFFLoc);
+        mandelFFProgram->disableAttributeArray(posFFLoc);
+        mandelFFProgram->release();
+        return;
+    }
+
+    //render the mandelbrot image beigns
+    mandelProgram->bind();
 
     // Set vertexarray to the shader
     mandelProgram->enableAttributeArray(posFractLoc);
@@ -933,12 +1665,13 @@ void MandelGLWidget::RenderFractal()
 
     //shader's parameters
     mandelProgram->setUniformValue(mvpFractLoc, modelViewProjection );
-    mandelProgram->setUniformValue(scaleFractLoc, scaleFactor);
+    mandelProgram->setUniformValue(scaleFractLoc, float(scaleFactor));
     mandelProgram->setUniformValue(resFractLoc, whScale);
     mandelProgram->setUniformValue(rotFractLoc, rotation);
     mandelProgram->setUniformValue(rotPivotFractLoc, rotationPivot);
     mandelProgram->setUniformValue(iterFractLoc, int(maxInterations + 0.5f));
-    mandelProgram->setUniformValue(centerFractLoc, centerPos);
+    mandelProgram->setUniformValue(centerFractLoc, QVector2D(centerX.ToDouble(), centerY.ToDouble()));
+    mandelProgram->setUniformValue(periodicityFractLoc, float(PeriodicityEpsilon(4.0 / (scaleFactor * renderHeight))));
     mandelProgram->setUniformValue(lookupTextureLoc, 0);
 
     // draw the quad
@@ -951,43 +1684,144 @@ void MandelGLWidget::RenderFractal()
 
     //render the mandelbrot image ends
     mandelProgram->release();
-
-    ReleaseFBO();
 }
 
 void MandelGLWidget::StartInteraction()
 {
-#if  defined ( USE_QT_CONCURRENT )
-
-    if(watcher->isRunning())
+    // every gesture update comes through here, only the first one drops
+    // the cpu frame in flight; the stretched copy of the last frame is
+    // shown until RequestFrame() has the coarse pass of the new view
+    if ( !interacting )
     {
-        watcher->waitForFinished();
-    }
+        renderer->CancelRendering();
+        if ( deepRenderer )
+            deepRenderer->CancelRendering();
 
-#elif defined ( USE_QT_MULTI_THREAD )
-
-    if(renderThread.isRunning())
-    {
-        renderThread.quit();
+        previewPending = false;
+        requestedView = MandelbrotView();
     }
-#endif
+
+    interacting = true;
 }
 
 void MandelGLWidget::StopInteraction()
 {
-#if defined ( USE_QT_CONCURRENT )
-    QFuture<bool> future = QtConcurrent::run(renderer, &FractalRenderer::StartRendering);
-    watcher->setFuture(future);
-#else
-#if defined ( USE_QT_MULTI_THREAD )
-    if(!renderThread.isRunning())
+    interacting = false;
+
+    RequestFrame();
+}
+
+void MandelGLWidget::RequestFrame()
+{
+    FractalRenderer* target = ActiveRenderer();
+    MandelbrotView view = CurrentView();
+
+    if ( target->Backend() == FractalRenderer::CPU_BACKEND )
     {
-        renderThread.start();
+        // the frame of this view is still refining or done already
+        if ( view == requestedView )
+            return;
+
+        // a cpu frame of an older view would only hold the new one up
+        target->CancelRendering();
     }
-#endif  //USE_QT_MULTI_THREAD
-    emit StartFractalRendering();
-#endif  //USE_QT_CONCURRENT
 
+    requestedView = view;
+    requestedOffset = textCoordOffset;
+    requestedRotation = rotationOffset;
+    requestedScale = imageScale;
+
+    bool newView = target->SetView(requestedView);
+    previewPending = newView && target->Backend() == FractalRenderer::CPU_BACKEND;
+
+    if ( target == deepRenderer )
+        emit StartDeepRendering();
+    else
+        emit StartFractalRendering();
+}
+
+void MandelGLWidget::FollowZoomIterations(double previousScaleFactor)
+{
+    // the adaptive limit keeps its distance to the zoom level formula, the
+    // next frame corrects it
+    if ( adaptiveIterations )
+        maxInterations *= AutoIterations(scaleFactor) / AutoIterations(previousScaleFactor);
+    else
+        maxInterations = AutoIterations(scaleFactor);
+}
+
+void MandelGLWidget::AdaptIterations(FractalRenderer* source)
+{
+    int imageWidth, imageHeight;
+    source->LockResult(imageWidth, imageHeight);
+    IterationHistogram histogram = source->LastIterationHistogram();
+    int pass = source->LastProgressivePass();
+    source->UnlockResult();
+
+    // a coarse pass is not the whole frame, and a frame of another limit
+    // says nothing about the current one
+    if ( !adaptiveIterations || (pass >= 0 && pass < PROGRESSIVE_PASSES - 1) ||
+         histogram.maxIterations != int(maxInterations + 0.5f) )
+        return;
+
+    lastHistogram = histogram;
+    int limit = iterationLimit.NextLimit(histogram);
+    if ( limit == histogram.maxIterations )
+        return;
+
+    // a higher limit resumes the capped pixels of a cpu frame, a lower one
+    // waits for the next view
+    maxInterations = float(limit);
+    if ( limit > histogram.maxIterations )
+        adaptiveFramePending = true;
+}
+
+FractalRenderer* MandelGLWidget::ActiveRenderer() const
+{
+    double minPixelSize = mandelFFProgram ? GPU_MIN_PIXEL_SIZE : GPU_FLOAT_PIXEL_SIZE;
+
+    if ( deepRenderer && 4.0 / (scaleFactor * height()) < minPixelSize )
+        return deepRenderer;
+
+    return renderer;
+}
+
+bool MandelGLWidget::UseFloatFloatShader() const
+{
+    return mandelFFProgram && 4.0 / (scaleFactor * height()) < GPU_FLOAT_PIXEL_SIZE;
+}
+
+MandelbrotView MandelGLWidget::CurrentView() const
+{
+    MandelbrotView view;
+
+    view.width = width();
+    view.height = height();
+    view.SetCenter(centerX, centerY);
+
+    // the rotation pivot is the center (see UpdateRotationPivot), take it
+    // from the precise one and not from the float copy
+    view.pivotX = view.centerX;
+    view.pivotY = view.centerY;
+    view.scale = scaleFactor;
+    view.rotation = rotation;
+    view.maxIterations = int(maxInterations + 0.5f);
+
+    return view;
+}
+
+QGLFramebufferObject* MandelGLWidget::CreateFBO(int width, int height)
+{
+    QGLFramebufferObject* frameBuffer = new QGLFramebufferObject(width, height);
+
+    glBindTexture(GL_TEXTURE_2D, frameBuffer->texture());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return frameBuffer;
 }
 
 void MandelGLWidget::BindFBO()
@@ -1001,17 +1835,76 @@ void MandelGLWidget::ReleaseFBO()
 
 }
 
+bool MandelGLWidget::UploadRenderedImage(FractalRenderer* source)
+{
+    int imageWidth, imageHeight;
+    MandelbrotView imageView;
+    const unsigned char* pixels = source->LockResult(imageWidth, imageHeight, &imageView);
+
+    // the widget got resized while the frame was rendered, or the frame
+    // belongs to a request that got overtaken; a new frame is on its way
+    bool sizeMatches = pixels != 0 && imageView == requestedView &&
+        imageWidth == fbo[currentIndex]->width() && imageHeight == fbo[currentIndex]->height();
+
+    // the top row of the image goes to the first texture row, the post
+    // effect quad shows that one at the top of the screen
+    if ( sizeMatches )
+    {
+        makeCurrent();
+        ScopedStageTimer uploadTimer(frameProfiler, FrameProfiler::STAGE_UPLOAD);
+        fboScale[currentIndex] = QVector2D(1.0f, 1.0f);
+        glBindTexture(GL_TEXTURE_2D, fbo[currentIndex]->texture());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageWidth, imageHeight,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    source->UnlockResult();
+
+    return sizeMatches;
+}
+
 void MandelGLWidget::updateRenderFBO()
 {
+    // either renderer may have finished, the gpu one has drawn into the fbo
+    // already, the cpu ones hand over their pixels
+    FractalRenderer* source = qobject_cast<FractalRenderer*>(sender());
+    if ( source && source->Backend() == FractalRenderer::CPU_BACKEND && !UploadRenderedImage(source) )
+        return;
+
+    // the histogram of a gpu frame comes later, see updateProbe
+    if ( source && source->Backend() == FractalRenderer::CPU_BACKEND )
+        AdaptIterations(source);
+
     currentIndex = (currentIndex + 1) % PING_PONG_COUNT;
     nextIndex = (nextIndex + 1) % PING_PONG_COUNT;
     fboId = fbo[nextIndex]->texture();
 
-    // zero the temp offset after we update the actual computing result
-    textCoordOffset.setX(0);
-    textCoordOffset.setY(0);
-    rotationOffset = 0.0f;
+    // the new frame shows the requested view, only the input since the
+    // request is left for the post effect; the next passes of the same
+    // frame have nothing left to take off
+    textCoordOffset -= requestedOffset;
+    rotationOffset -= requestedRotation;
     rotationPivotSS.setX(0.5);
     rotationPivotSS.setY(0.5);
-    imageScale = 1.0f;
+    imageScale /= requestedScale;
+
+    requestedOffset = QVector2D(0.0f, 0.0f);
+    requestedRotation = 0.0f;
+    requestedScale = 1.0f;
+    previewPending = false;
+}
+
+void MandelGLWidget::updateProbe(bool lookupChanged)
+{
+    // the deep renderer took over since the probe was started
+    if ( ActiveRenderer() != renderer )
+        return;
+
+    AdaptIterations(renderer);
+
+    // the shown frame still has the palette of an earlier probe; a higher
+    // limit renders the view again anyway
+    if ( lookupChanged && !interacting && !adaptiveFramePending )
+        RequestFrame();
 }
@@ -20,15 +20,6 @@
 #ifndef MandelGLWidget_h__
 #define MandelGLWidget_h__
 
-//use QtConcurrent to handel thread
-//#define USE_QT_CONCURRENT
-
-//use qthread to do low level threading
-//#define USE_QT_MULTI_THREAD
-
-//use single threading
-#define USE_SINGLE_THREAD
-
 #include <QMatrix4x4>
 #include <QVector2D>
 #include <QTime>
@@ -36,6 +27,14 @@
 #include <QGLFunctions>
 #include <QThread>
 
+#include "bigfloat.h"
+#include "frameprofiler.h"
+#include "framereadback.h"
+#include "iterationlimit.h"
+#include "mandelbrotview.h"
+#include "resolutioncontroller.h"
+#include "shadercache.h"
+
 QT_BEGIN_NAMESPACE
     // opengl classes
 	class QGLShaderProgram;
@@ -47,11 +46,6 @@ QT_BEGIN_NAMESPACE
     class QPinchGesture;
     class QTapAndHoldGesture;
     class QTapGesture;
-
-#ifdef USE_QT_CONCURRENT
-    template <typename T>
-    class QFutureWatcher;
-#endif
 QT_END_NAMESPACE
 
 
@@ -75,15 +69,81 @@ public:
 
     void RenderFractal();
 
+    // replaces the colors of the lookup texture, RGBA; the renderer calls it
+    // with its context current
+    void SetLookupColors(const unsigned char* rgba, int count);
+
+    // render settings, take effect when the gl context gets initialized
+    //
+    // the gpu renders the whole frame in one job on the shared context, the
+    // cpu splits it into tiles for a work-stealing thread pool
+    void SetCpuRendering(bool enabled);
+    void SetRenderThreads(int threadCount);     // 0 = one per core
+    void SetRenderTileSize(int tileSize);
+    void SetSubdivision(bool enabled, bool safeguard = true);  // cpu only
+    void SetProgressive(bool enabled);  // cpu only, off by default
+    void SetReprojection(bool enabled); // cpu only, on by default
+    void SetSupersampling(double samplesPerPixel);  // cpu only, 1 = off (default)
+    void SetTileCacheSize(int megabytes);   // cpu only, 0 = no tile cache
+    void SetHistogramColoring(bool enabled);    // palette spread over the escapes, off by default
+
+    // file of precomputed tiles for the tile cache (cpu only), the first
+    // fillLevels zoom levels of the start view, each twice the scale of the
+    // one before, are rendered into it where tiles are missing
+    void SetTilePyramid(const QString& path, int fillLevels = 0);
+
+    // center and scale factor to start at, the iteration limit follows the
+    // scale as for a zoom
+    void SetStartView(double x, double y, double scale);
+
+    // mean iterations per pixel the adaptive iteration limit may spend on a
+    // frame, 0 sets the limit from the zoom level only
+    void SetIterationBudget(double iterationsPerPixel);
+
+    // time the mandelbrot shader may take per frame while the input goes
+    // on, it renders at a reduced resolution to stay within it and at the
+    // native one once the view settles; 0 keeps showing the stretched last
+    // frame during the input instead
+    void SetFrameBudget(double milliseconds);
+
+    // appends the frame stage timings to a file every intervalSeconds as
+    // one json object per line, with gpu timer queries where the context
+    // has them
+    void SetFrameStatsDump(const QString& path, int intervalSeconds);
+
+    // hands the shown frame to the callback a few frames later, read back
+    // without waiting for the gpu where the context allows it; the rendered
+    // part only while the resolution is reduced
+    void GrabFrame(const FrameReadback::Callback& callback);
+
+    // reads the shown frame back every n-th paint and drops it, to measure
+    // what thumbnails cost; 0 = off
+    void SetReadbackInterval(int frames);
+
+    // keeps the linked shader programs between two starts where the driver
+    // has program binaries; off compiles them all from source, to compare
+    // the startup times
+    void SetShaderCache(bool enabled);
+
+    // current view as parameters for the cpu renderer
+    MandelbrotView CurrentView() const;
+
+    // a pan, zoom or rotation goes on
+    bool Interacting() const { return interacting; }
+
 signals:
     // emit the swap buffer signal after all the gl calls
     //void NeedSwapBuffer();
     void StartFractalRendering();
+    void StartDeepRendering();
 
 public slots:
     //void startRendering();
     void updateRenderFBO();
 
+    // the gpu renderer probed a view, after the frame it was started for
+    void updateProbe(bool lookupChanged);
+
 protected:
 
     // override gl functions
@@ -123,24 +183,80 @@ private:
     //       need to get the rotation pivot by reading the gesture center point
     void UpdateRotationPivot();
     void UpdateProjectedScales();
+    bool UploadRenderedImage(FractalRenderer* source);
+
+    // hands the current view to the active renderer, the post effect keeps
+    // moving the shown frame until the new one is there
+    void RequestFrame();
+
+    // iteration limit after a zoom from previousScaleFactor to scaleFactor
+    void FollowZoomIterations(double previousScaleFactor);
+
+    // next iteration limit from the escape histogram of a finished frame
+    void AdaptIterations(FractalRenderer* source);
+
+    // renderer of the current zoom level, deepRenderer once the view is
+    // beyond the precision of the mandelbrot shader
+    FractalRenderer* ActiveRenderer() const;
+
+    // mandelbrot_ff_*.glsl once the plain float shader runs out of bits
+    bool UseFloatFloatShader() const;
+    void LoadFloatFloatShader();
+
+    // the mandelbrot pass into the bound fbo, renderHeight pixels high
+    void DrawFractal(int renderHeight);
+
+    // native size fbo with filtering for the reduced resolution frames
+    QGLFramebufferObject* CreateFBO(int width, int height);
+
     void DrawHUD();
     void ComputeHUDRect();
 
+    // png of the shown frame into the pictures directory, written on a
+    // thread of its own
+    void SaveScreenshot();
+
 private:
 
     FractalRenderer* renderer;
+    FractalRenderer* deepRenderer;      // cpu renderer for the gpu backend, 0 otherwise
     QThread          renderThread;
 
-#ifdef USE_QT_CONCURRENT
-    QFutureWatcher<bool>*  watcher;
-#endif
+    bool cpuRendering;
+    int renderThreads;
+    int renderTileSize;
+    bool renderSubdivision;
+    bool renderSubdivisionSafeguard;
+    bool renderProgressive;
+    bool renderReprojection;
+    double renderSupersampling;         // samples per pixel
+    int renderTileCacheSize;            // megabytes
+    bool histogramColoring;
+    QString pyramidPath;                // handed to the renderer on the first resize
+    int pyramidFillLevels;
+
+    // time of the paintGL stages, RenderFractal and the cpu frame uploads
+    FrameProfiler frameProfiler;
+    QString frameStatsPath;
+    int frameStatsInterval;             // seconds
+
+    // GrabFrame callbacks for the next paint, and the ones the last paint
+    // could not read back
+    FrameReadback frameReadback;
+    std::vector<FrameReadback::Callback> grabRequests;
+    int readbackInterval;
+    int readbackFrames;
 
     // shader objects
 	QGLShaderProgram* mandelProgram;
+    QGLShaderProgram* mandelFFProgram;  // float-float variant, 0 if it did not compile
 
     QGLShaderProgram* postEffectProgram;
 
-    bool passCompiled;
+    // shader variants and the program binaries of earlier starts
+    ShaderCache shaderCache;
+    bool shaderCacheEnabled;
+    int mandelVariant;                  // ShaderCache options of mandelProgram
 
     // frame buffer object
     QGLFramebufferObject* fbo[2];
@@ -148,6 +264,11 @@ private:
     int nextIndex;
     const static int PING_PONG_COUNT = 2;
 
+    // part of each fbo its frame was rendered into, see ResolutionController
+    QVector2D fboScale[2];
+    ResolutionController resolutionController;
+    bool dynamicResolution;
+
     // shader errors
     QString shaderErrors;
 
@@ -175,8 +296,26 @@ private:
     GLint rotPivotFractLoc;          //rotatePivot
     GLint iterFractLoc;              //maxIterations
     GLint centerFractLoc;            //center
+    GLint periodicityFractLoc;       //periodicityEpsilon
     GLint lookupTextureLoc;          //lookUpTexture
 
+    // attribute/uniform locations for the float-float mandelbrot shader
+    GLint mvpFFLoc;                  //MVP
+    GLint posFFLoc;                  //Position
+    GLint uvFFLoc;                   //InTexCoord
+    GLint scaleFFLoc;                //scale
+    GLint resFFLoc;                  //whScale
+
+    GLint rotFFLoc;                  //rotRadian
+    GLint rotPivotHiFFLoc;           //rotatePivotHi
+    GLint rotPivotLoFFLoc;           //rotatePivotLo
+    GLint iterFFLoc;                 //maxIterations
+    GLint centerHiFFLoc;             //centerHi
+    GLint centerLoFFLoc;             //centerLo
+    GLint oneFFLoc;                  //ffOne
+    GLint periodicityFFLoc;          //periodicityEpsilon
+    GLint lookupTextureFFLoc;        //lookUpTexture
+
     // uniform locations for post process  shader (fast data updating)
     GLint mvpPostLoc;               //MVP
     GLint posPostLoc;               //Position
@@ -188,6 +327,8 @@ private:
     GLint rotationOffsetLoc;        //rotation
     GLint rotationPivotLoc;         //rotationPivot
     GLint fboTextureLoc;            //fbo
+    GLint textureScaleLoc;          //textureScale
+    GLint textureLimitLoc;          //textureLimit
 
 
     
@@ -195,12 +336,13 @@ private:
     QPointF pixelOffset;
     QPointF lastDragPos;
 
-    // center point of mandelbrot
-    QVector2D centerPos;
+    // center point of mandelbrot, in as many bits as the zoom level needs
+    BigFloat centerX;
+    BigFloat centerY;
 
     // scale factor of current rendering
-    float scaleFactor;
-    float previousScale;
+    double scaleFactor;
+    double previousScale;
     float currentScaleFactor;
     QPointF projectedScaleFactor;
 
@@ -212,6 +354,15 @@ private:
 
     float maxInterations;
 
+    // the iteration limit follows the escapes of the last frame instead of
+    // the zoom level; a grown limit renders the view again once the input
+    // is over
+    AdaptiveIterationLimit iterationLimit;
+    bool adaptiveIterations;
+    double iterationBudget;
+    bool adaptiveFramePending;
+    IterationHistogram lastHistogram;
+
     // image manipulate parameters for final image
     QVector2D textCoordOffset;
     float rotationOffset;
@@ -222,6 +373,18 @@ private:
     // whether to render a new frame of mandelbrot
     bool renderMandelbrot;
 
+    // the cpu renderers show their coarse passes while the input goes on,
+    // a new frame is only requested once the last one has shown up
+    bool interacting;
+    bool previewPending;
+
+    // view of the last requested frame and the image manipulate parameters
+    // it already includes
+    MandelbrotView requestedView;
+    QVector2D requestedOffset;
+    float requestedRotation;
+    float requestedScale;
+
     // current gesture
     MultiTouchGestures currentGesture;
 
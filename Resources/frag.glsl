@@ -20,10 +20,15 @@
 uniform sampler2D fboTexture;
 varying mediump vec2 TexCoord;
 
+// part of the fbo the frame fills, a reduced resolution frame only covers
+// its lower left corner; the limit keeps the filter off the texels beyond
+uniform mediump vec2 textureScale;
+uniform mediump vec2 textureLimit;
+
 void main(void)
 {
     if(TexCoord.x > 1.0 || TexCoord.x < 0.0 || TexCoord.y > 1.0 || TexCoord.y < 0.0)
         gl_FragColor = vec4(0.0, 0.0, 0.0, 0.5);
     else
-        gl_FragColor = texture2D(fboTexture, TexCoord);
+        gl_FragColor = texture2D(fboTexture, min(TexCoord * textureScale, textureLimit));
 }
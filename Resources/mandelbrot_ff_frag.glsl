@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// float-float variant of mandelbrot_frag.glsl
+//
+// GL ES has no doubles, so c and z are kept as unevaluated sums hi + lo of
+// two floats, packed as vec2(hi, lo). The error-free transformations of
+// Dekker and Knuth give about 48 bits of mantissa on fp32-only hardware,
+// at roughly ten times the cost of the plain shader per iteration.
+// MandelGLWidget switches to it once the plain float shader runs out of bits.
+//
+// the transformations only work if the compiler keeps every rounding step,
+// but GLSL ES 1.0 has no "precise" and drivers happily fold t - (t - a)
+// into a (Mesa does). Running the critical operand through the ffOne
+// uniform, always 1.0, hides the pattern from them.
+//
+// the periodicity check is the one of mandelbrot_frag.glsl, on the high
+// parts of the difference
+
+// SHOW_PERIODICITY_CHECK, put in front of the source by ShaderCache, paints
+// the pixels the periodicity check stopped in magenta
+
+#ifdef GL_ES
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+#endif
+
+uniform sampler2D lookUpTexture;
+uniform int maxIterations;
+
+uniform float rotRadian;        //rotation in radian
+uniform vec2 rotatePivotHi;     //rotatePivot = rotatePivotHi + rotatePivotLo
+uniform vec2 rotatePivotLo;
+uniform vec2 centerHi;          //center = centerHi + centerLo
+uniform vec2 centerLo;
+uniform float ffOne;            //1.0, see above
+uniform float periodicityEpsilon;   //0 turns the periodicity check off
+
+varying highp vec2 TexCoord;
+
+const float LOG_2 = 0.69314718055994530942;
+
+// first iteration whose z replaces c as the saved value
+const int PERIODICITY_FIRST_SAVE = 16;
+
+// 2^12 + 1, splits a 24 bit mantissa into two halves
+const float SPLITTER = 4097.0;
+
+// a + b = s + e exactly
+vec2 TwoSum(float a, float b)
+{
+    float s = a + b;
+    float v = s * ffOne - a;
+    float e = (a - (s - v)) + (b - v);
+    return vec2(s, e);
+}
+
+// a + b = s + e exactly, |a| >= |b|
+vec2 QuickTwoSum(float a, float b)
+{
+    float s = a + b;
+    float e = b - (s * ffOne - a);
+    return vec2(s, e);
+}
+
+vec2 Split(float a)
+{
+    float t = SPLITTER * a;
+    float hi = t * ffOne - (t - a);
+    return vec2(hi, a - hi);
+}
+
+// a * b = p + e exactly
+vec2 TwoProd(float a, float b)
+{
+    float p = a * b;
+    vec2 as = Split(a);
+    vec2 bs = Split(b);
+    float e = ((as.x * bs.x - p) + as.x * bs.y + as.y * bs.x) + as.y * bs.y;
+    return vec2(p, e);
+}
+
+vec2 FFAdd(vec2 a, vec2 b)
+{
+    vec2 s = TwoSum(a.x, b.x);
+    s.y += a.y + b.y;
+    return QuickTwoSum(s.x, s.y);
+}
+
+vec2 FFSub(vec2 a, vec2 b)
+{
+    return FFAdd(a, -b);
+}
+
+vec2 FFMul(vec2 a, vec2 b)
+{
+    vec2 p = TwoProd(a.x, b.x);
+    p.y += a.x * b.y + a.y * b.x;
+    return QuickTwoSum(p.x, p.y);
+}
+
+vec2 FFMulFloat(vec2 a, float b)
+{
+    vec2 p = TwoProd(a.x, b);
+    p.y += a.y * b;
+    return QuickTwoSum(p.x, p.y);
+}
+
+void main (void)
+{
+    int iterationCount = maxIterations;
+
+    // c = rotate(TexCoord + center - pivot) + pivot, the pixel offset is
+    // small enough for a single float
+    vec2 pivotX = vec2(rotatePivotHi.x, rotatePivotLo.x);
+    vec2 pivotY = vec2(rotatePivotHi.y, rotatePivotLo.y);
+
+    vec2 texCoordModX = FFAdd(FFSub(vec2(centerHi.x, centerLo.x), pivotX), vec2(TexCoord.x, 0.0));
+    vec2 texCoordModY = FFAdd(FFSub(vec2(centerHi.y, centerLo.y), pivotY), vec2(TexCoord.y, 0.0));
+
+    float cosRot = cos(rotRadian);
+    float sinRot = sin(rotRadian);
+
+    vec2 cx = FFAdd(FFSub(FFMulFloat(texCoordModX, cosRot), FFMulFloat(texCoordModY, sinRot)), pivotX);
+    vec2 cy = FFAdd(FFAdd(FFMulFloat(texCoordModY, cosRot), FFMulFloat(texCoordModX, sinRot)), pivotY);
+
+    vec2 s = vec2(1.0, 0.0);
+    bool periodic = false;
+
+    // optimization. early out, the high parts are plenty for it
+
+    // cardioid
+    // q = ( x - 1/4 )^2 + y^2
+    // q ( q + ( x - 1/4 )) < 1/4 y^2
+    float x = cx.x - 0.25;
+    float y2 = cy.x * cy.x;
+    float q = x * x + y2;
+
+    if ( 4.0 * q * (q + x) >= y2 )
+    {
+        // period-2 bulb
+        // (x + 1) ^2 + y ^ 2 < 1/16
+        float xp12 = (cx.x + 1.0) * (cx.x + 1.0);
+
+        if ( xp12 + y2 >= 0.0625 )
+        {
+            vec2 zx = cx;
+            vec2 zy = cy;
+            vec2 zx2 = FFMul(zx, zx);
+            vec2 zy2 = FFMul(zy, zy);
+
+            vec2 savedX = cx;
+            vec2 savedY = cy;
+            int savePoint = PERIODICITY_FIRST_SAVE;
+            float epsilon2 = periodicityEpsilon * periodicityEpsilon;
+
+            int i;
+
+            for ( i = 0; i < iterationCount && zx2.x + zy2.x < 4.0; i ++)
+            {
+                vec2 zxy = FFMul(zx, zy);
+
+                zx = FFAdd(FFSub(zx2, zy2), cx);
+                zy = FFAdd(zxy * 2.0, cy);
+
+                zx2 = FFMul(zx, zx);
+                zy2 = FFMul(zy, zy);
+
+                // caught in an attracting cycle, it never escapes
+                float dx = FFSub(zx, savedX).x;
+                float dy = FFSub(zy, savedY).x;
+                if ( dx * dx + dy * dy < epsilon2 )
+                {
+                    periodic = true;
+                    break;
+                }
+
+                if ( i + 1 == savePoint )
+                {
+                    savedX = zx;
+                    savedY = zy;
+                    savePoint *= 2;
+                }
+            }
+
+            //Normalized Iteration Count to get a smoother image
+            //smooth iter = iter + ( log(log(bailout)-log(log(cabs(z))) )/log(2)
+            if ( !periodic )
+                s.x = (float(i) - log(log(zx2.x + zy2.x) / 2.0) / LOG_2) / float(iterationCount);
+        }
+    }
+
+    gl_FragColor = texture2D(lookUpTexture, s).bgra;
+
+#ifdef SHOW_PERIODICITY_CHECK
+    if ( periodic )
+        gl_FragColor = vec4(1.0, 0.0, 1.0, 1.0);
+#endif
+}
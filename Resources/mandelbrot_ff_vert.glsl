@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// float-float variant of mandelbrot_vert.glsl, see mandelbrot_ff_frag.glsl
+//
+// same attributes/uniforms in the same order, only in highp: the texture
+// coordinate is the pixel offset from the center and gets tiny at deep zooms
+
+//DONT CHANAGE THE ORDER OF THE FOLLOWING ATTRIBUTES/UNIFORMS
+//SINCE IT SHARE VARIABLE POSITION INDEXES WITH OTHER SHADERS
+
+//===============BEGIN===================================
+uniform highp mat4 MVP; // model-view-project matrix
+attribute highp vec2 Position;
+attribute highp vec2 InTexCoord;
+uniform highp float scale;        //zoom factor
+uniform highp float whScale;    //use to keep the proportion of mandelbrot set
+//===============END=====================================
+
+
+varying highp vec2 TexCoord;
+
+
+void main(void)
+{
+    gl_Position = MVP *  vec4(Position, 0.0, 1.0);
+
+    highp vec2 scaledTexCoord;
+    scaledTexCoord.x = (InTexCoord.x -0.5) * whScale;
+    scaledTexCoord.y = InTexCoord.y - 0.5;
+
+    TexCoord = scaledTexCoord * (4.0 / scale);
+}
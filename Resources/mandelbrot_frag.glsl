@@ -17,19 +17,29 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#if defined GL_ES
+// the variant comes from the defines ShaderCache puts in front of the
+// source, see ShaderCache::Defines():
+//
+//   USE_FP64                   doubles through GL_ARB_gpu_shader_fp64
+//   FALL_BACK                  fall back shader code for Tegra 2 GPU
+//   ENABLE_PERIODICITY_CHECK   Brent's cycle detection for interior points, see
+//                              IterateEscapePeriodic() in fractcore/mandelbrotkernel.h;
+//                              periodicityEpsilon = 0 turns it off. highp only,
+//                              the squared epsilon underflows mediump
+//   SHOW_PERIODICITY_CHECK     paints the pixels the periodicity check stopped in magenta
+//   ITERATION_PRECISION        precision of c and z, mediump where fragment
+//                              shaders have no highp
+
+#if defined USE_FP64
+#extension GL_ARB_gpu_shader_fp64 : enable
+#else
 #define double float
 #define dvec2 vec2
-#else
-#extension GL_ARB_gpu_shader_fp64 : enable
 #endif
 
-//#define ENABLE_PERIODICITY_CHECK
-//#define SHOW_PERIODICITY_CHECK
-
-
-// enable/disable fall back shader code for Tegra 2 GPU
-//#define FALL_BACK
+#ifndef ITERATION_PRECISION
+#define ITERATION_PRECISION highp
+#endif
 
 #ifdef FALL_BACK
 const int FIX_ITERATION = 256;
@@ -41,12 +51,15 @@ uniform int maxIterations;
 uniform mediump float rotRadian;    //rotation in radian
 uniform mediump vec2 rotatePivot;
 uniform mediump vec2 center;
+uniform ITERATION_PRECISION float periodicityEpsilon;     // scales with the pixel size
 
 varying mediump vec2 TexCoord;
 
-const mediump float epsilon = 1e-6;
 const mediump float LOG_2 = log(2.0);
 
+// first iteration whose z replaces c as the saved value
+const int PERIODICITY_FIRST_SAVE = 16;
+
 void main (void)
 {
 #ifdef FALL_BACK
@@ -55,7 +68,7 @@ void main (void)
     int iterationCount = maxIterations;
 #endif
 
-    highp dvec2 c;
+    ITERATION_PRECISION dvec2 c;
     mediump dvec2 TexCoordMod;
 
     TexCoordMod.x = double(TexCoord.x) - rotatePivot.x + center.x;
@@ -65,7 +78,8 @@ void main (void)
     c.y = TexCoordMod.y * cos(rotRadian) + TexCoordMod.x * sin(rotRadian) + rotatePivot.y;
 
     mediump vec2 s = vec2(1.0, 0.0);
-    
+    bool periodic = false;
+
     // optimization. early out
 
     // cardioid
@@ -83,22 +97,16 @@ void main (void)
 
         if ( cxp12 + cy2 >= 0.0625 )
         {
-#ifdef ENABLE_PERIODICITY_CHECK
-            int check = 3;
-            int checkCounter = 0;
-
-            int update = 10;
-            int updateCounter = 0;
-
-            highp double checkPeriodicityX = 0.0;
-            highp double checkPeriodicityY = 0.0;
-
-            bool periodicityCheckFailed = false;
+            ITERATION_PRECISION dvec2 z = c;
 
+#ifdef ENABLE_PERIODICITY_CHECK
+            // z of the iterations 16, 32, 64, ..., every step is compared
+            // against the last one
+            ITERATION_PRECISION dvec2 saved = c;
+            int savePoint = PERIODICITY_FIRST_SAVE;
+            ITERATION_PRECISION float epsilon2 = periodicityEpsilon * periodicityEpsilon;
 #endif
 
-            highp dvec2 z = c;
-
             // tegra 2 CPU need to have constant loop count
             // (e.g.  i < 64 instead of i < maxIterations)
             int i;
@@ -108,40 +116,24 @@ void main (void)
                 z = dvec2(z.x*z.x - z.y*z.y, 2.0*z.x*z.y) + c;
 
 #ifdef ENABLE_PERIODICITY_CHECK
-
-                //periodicity check
-                if ( abs(checkPeriodicityX - z.x) < epsilon && abs(checkPeriodicityY - z.y) < epsilon)
+                // caught in an attracting cycle, it never escapes
+                ITERATION_PRECISION dvec2 d = z - saved;
+                if ( dot(d, d) < epsilon2 )
                 {
-                    periodicityCheckFailed = true;
+                    periodic = true;
                     break;
                 }
 
-                //Update history
-                if (check == checkCounter)
+                if ( i + 1 == savePoint )
                 {
-                    checkCounter = 0;
-
-                    //Double the value of check
-                    if (update == updateCounter)
-                    {
-                        updateCounter = 0;
-                        check *= 2;
-                    }
-                    updateCounter++;
-
-                    checkPeriodicityX = z.x;
-                    checkPeriodicityY = z.y;
+                    saved = z;
+                    savePoint *= 2;
                 }
-                checkCounter++;
 #endif
 
             }
 
-#ifdef ENABLE_PERIODICITY_CHECK
-            if ( periodicityCheckFailed == false && i < iterationCount + 1 )
-#else
-            if ( i < iterationCount + 1 )
-#endif
+            if ( !periodic )
             {
                 //Normalized Iteration Count to get a smoother image
                 //smooth iter = iter + ( log(log(bailout)-log(log(cabs(z))) )/log(2)
@@ -152,10 +144,11 @@ void main (void)
         }
     }
 
-#ifdef SHOW_PERIODICITY_CHECK
-    mediump vec4 bgColor = vec4(1.0, 0.0, 1.0, 1.0);
-#else
     mediump vec4 bgColor = texture2D(lookUpTexture, s).bgra;
+
+#ifdef SHOW_PERIODICITY_CHECK
+    if ( periodic )
+        bgColor = vec4(1.0, 0.0, 1.0, 1.0);
 #endif
 
 
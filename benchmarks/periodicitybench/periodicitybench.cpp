@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// cost of the interior points with and without Brent's periodicity check,
+// single threaded through MandelbrotEngine
+//
+// the views are picked to be mostly interior away from the main cardioid
+// and the period-2 bulb, where the early-out tests do not help; the last
+// one has no interior at all and shows what the check costs when it cannot
+// stop anything. Besides the times it counts the pixels whose iteration
+// count changed, which is what a too large epsilon would do.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mandelbrotengine.h"
+#include "simdkernel.h"
+
+struct BenchView
+{
+    const char* name;
+    double centerX;
+    double centerY;
+    double scale;
+};
+
+static const BenchView BENCH_VIEWS[] =
+{
+    { "period-3 bulb",   -0.1225611669, 0.7448617666, 200.0 },
+    { "minibrot",        -1.7548776662, 0.0,          2000.0 },
+    { "cardioid edge",   -0.75,         0.1,          8.0 },
+    { "elephant valley",  0.2850,       0.0110,       500.0 },
+    { "no interior",      0.0,          1.0,          1e4 }
+};
+
+static double RenderSeconds(const MandelbrotEngine& engine, const MandelbrotView& view, FractalBuffer& buffer,
+                            int frames, KernelStats& stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for ( int f = 0; f < frames; f ++)
+    {
+        stats = KernelStats();
+        engine.Render(view, buffer, &stats);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+}
+
+static void PrintUsage()
+{
+    printf("usage: periodicitybench [--size w h] [--frames n] [--iterations n]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 640;
+    int height = 360;
+    int frames = 3;
+    int iterations = 4096;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument(argv[i]);
+
+        if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++ i]);
+            height = atoi(argv[++ i]);
+        }
+        else if ( argument == "--frames" && i + 1 < argc )
+            frames = atoi(argv[++ i]);
+        else if ( argument == "--iterations" && i + 1 < argc )
+            iterations = atoi(argv[++ i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( width <= 0 || height <= 0 || frames <= 0 || iterations <= 0 )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    MandelbrotEngine engine;
+    printf("simd level: %s, %dx%d, %d iterations\n", SimdLevelName(engine.GetSimdLevel()), width, height, iterations);
+    printf("%-16s %10s %10s %8s %9s %8s\n", "view", "off ms", "on ms", "speedup", "periodic", "changed");
+
+    std::vector<int> plainIterations(size_t(width) * height);
+    std::vector<int> checkedIterations(plainIterations.size());
+
+    for ( size_t v = 0; v < sizeof(BENCH_VIEWS) / sizeof(BENCH_VIEWS[0]); v ++)
+    {
+        MandelbrotView view;
+        view.width = width;
+        view.height = height;
+        view.centerX = view.pivotX = BENCH_VIEWS[v].centerX;
+        view.centerY = view.pivotY = BENCH_VIEWS[v].centerY;
+        view.scale = BENCH_VIEWS[v].scale;
+        view.maxIterations = iterations;
+
+        FractalBuffer plainBuffer(width, height, 0, &plainIterations[0], 0);
+        FractalBuffer checkedBuffer(width, height, 0, &checkedIterations[0], 0);
+        KernelStats plainStats, checkedStats;
+
+        engine.SetPeriodicityCheck(false);
+        double plainSeconds = RenderSeconds(engine, view, plainBuffer, frames, plainStats);
+
+        engine.SetPeriodicityCheck(true);
+        double checkedSeconds = RenderSeconds(engine, view, checkedBuffer, frames, checkedStats);
+
+        long long changed = 0;
+        for ( size_t i = 0; i < plainIterations.size(); i ++)
+        {
+            if ( plainIterations[i] != checkedIterations[i] )
+                changed ++;
+        }
+
+        printf("%-16s %10.1f %10.1f %7.2fx %8.1f%% %8lld\n", BENCH_VIEWS[v].name,
+               plainSeconds * 1000.0, checkedSeconds * 1000.0, plainSeconds / checkedSeconds,
+               100.0 * double(checkedStats.periodicPixels) / double(plainIterations.size()), changed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-----------------------------------------------------------
+#
+# cpu escape time with and without the periodicity check
+# on interior heavy views
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = periodicitybench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += periodicitybench.cpp
+
+include(../../fractcore/fractcore.pri)
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// what reprojecting the previous frame saves on the typical view changes,
+// single threaded through MandelbrotEngine and ReprojectionRenderer
+//
+// every change starts from a freshly rendered base frame. Pans are in
+// whole pixels like the widget moves them, zoom and rotation steps are the
+// ones of the keyboard controls. Besides the times it counts the pixels
+// whose iteration count differs from a frame rendered from scratch; after
+// a pan those are points so close to the boundary that the last bit of
+// their coordinate decides, after a zoom or a rotation the error bound
+// adds the ones whose value comes from up to that far away.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "mandelbrotengine.h"
+#include "reprojectionrenderer.h"
+
+struct ViewChange
+{
+    const char* name;
+    double panX;            // pixels
+    double panY;
+    double zoom;
+    double rotation;        // degree
+};
+
+static const ViewChange VIEW_CHANGES[] =
+{
+    { "pan 20 px",      20.0,  0.0,  1.0,  0.0 },
+    { "pan 7, -13 px",   7.0, -13.0, 1.0,  0.0 },
+    { "pan 200 px",    200.0,  0.0,  1.0,  0.0 },
+    { "zoom in 1.2",     0.0,  0.0,  1.2,  0.0 },
+    { "zoom out 1.2",    0.0,  0.0,  1.0 / 1.2, 0.0 },
+    { "rotate 5 deg",    0.0,  0.0,  1.0,  5.0 },
+    { "no change",       0.0,  0.0,  1.0,  0.0 }
+};
+
+static const double DEGREE_TO_RADIAN = 0.01745329251994329576923690768489;
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void PrintUsage()
+{
+    printf("usage: reprojectionbench [--size w h] [--iterations n] [--max-error pixels]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 640;
+    int height = 360;
+    int iterations = 1024;
+    double maxError = 0.25;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument(argv[i]);
+
+        if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++ i]);
+            height = atoi(argv[++ i]);
+        }
+        else if ( argument == "--iterations" && i + 1 < argc )
+            iterations = atoi(argv[++ i]);
+        else if ( argument == "--max-error" && i + 1 < argc )
+            maxError = atof(argv[++ i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( width <= 0 || height <= 0 || iterations <= 0 || maxError < 0.0 )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    MandelbrotEngine engine;
+    ReprojectionRenderer reprojection;
+    reprojection.SetEngine(&engine);
+    reprojection.SetMaxError(maxError);
+
+    MandelbrotView base;
+    base.width = width;
+    base.height = height;
+    base.SetCenter(BigFloat(-0.7453), BigFloat(0.1127));
+    base.pivotX = base.centerX;
+    base.pivotY = base.centerY;
+    base.scale = 200.0;
+    base.maxIterations = iterations;
+
+    ReprojectionFrame previous;
+    previous.Reset(base);
+    FractalBuffer previousBuffer = previous.Buffer(0);
+    KernelStats baseStats;
+    engine.Render(base, previousBuffer, &baseStats);
+    previous.valid = true;
+
+    const double secondsPerPixel = baseStats.seconds / double(baseStats.pixels);
+
+    printf("simd level: %s, %dx%d, %d iterations, max error %.2f px\n",
+           SimdLevelName(engine.GetSimdLevel()), width, height, iterations, maxError);
+    printf("%-14s %9s %9s %8s %8s %9s %8s\n", "change", "full ms", "reuse ms", "speedup", "reused", "saved ms", "changed");
+
+    std::vector<int> fullIterations(size_t(width) * height);
+
+    for ( size_t c = 0; c < sizeof(VIEW_CHANGES) / sizeof(VIEW_CHANGES[0]); c ++)
+    {
+        // the widget moves the center by whole pixels of the base view
+        MandelbrotView view = base;
+        double pixelSize = base.PixelSize();
+        view.SetCenter(base.PreciseCenterX() - BigFloat(VIEW_CHANGES[c].panX * pixelSize),
+                       base.PreciseCenterY() + BigFloat(VIEW_CHANGES[c].panY * pixelSize));
+        view.pivotX = view.centerX;
+        view.pivotY = view.centerY;
+        view.scale = base.scale * VIEW_CHANGES[c].zoom;
+        view.rotation = VIEW_CHANGES[c].rotation * DEGREE_TO_RADIAN;
+
+        FractalBuffer fullBuffer(width, height, 0, &fullIterations[0], 0);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        engine.Render(view, fullBuffer);
+        double fullSeconds = Seconds(start);
+
+        ReprojectionFrame current;
+        current.Reset(view);
+        FractalBuffer currentBuffer = current.Buffer(0);
+        ReprojectionStats stats;
+        start = std::chrono::steady_clock::now();
+        reprojection.RenderRegion(view, previous, 0, 0, width, height, currentBuffer, &current.error[0], 0, &stats);
+        double reuseSeconds = Seconds(start);
+
+        long long changed = 0;
+        for ( size_t i = 0; i < fullIterations.size(); i ++)
+        {
+            if ( fullIterations[i] != current.iterations[i] )
+                changed ++;
+        }
+
+        printf("%-14s %9.1f %9.1f %7.2fx %7.1f%% %9.1f %8lld\n", VIEW_CHANGES[c].name,
+               fullSeconds * 1000.0, reuseSeconds * 1000.0, fullSeconds / reuseSeconds,
+               100.0 * stats.ReusedFraction(), stats.SavedSeconds(secondsPerPixel) * 1000.0, changed);
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-----------------------------------------------------------
+#
+# cpu frame time after a view change, rendered from scratch
+# and reprojected from the frame before
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = reprojectionbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += reprojectionbench.cpp
+
+include(../../fractcore/fractcore.pri)
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// throughput of the plain float mandelbrot shader against the float-float
+// one, off-screen through EGL + GLES 2
+//
+// meant for Mesa llvmpipe so the numbers are comparable on any machine:
+//
+//      EGL_PLATFORM=surfaceless LIBGL_ALWAYS_SOFTWARE=1 ./shaderbench
+//
+// besides the frame times it compares every image against the double
+// precision cpu engine, to show where each shader runs out of bits. The
+// default center is the Misiurewicz point c = i: it has detail at every
+// zoom level and few chaotic pixels that would blur the comparison.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mandelbrotengine.h"
+#include "mandelbrotkernel.h"
+#include "mandelbrotpalette.h"
+#include "pngcodec.h"
+
+// same quad as MandelGLWidget
+const GLfloat quad_vertices[] = { -1.0f,-1.0f, 1.0f,-1.0f,
+                                   1.0f, 1.0f, -1.0f, 1.0f };
+const GLfloat quad_uvs[]      = { 0.0f, 1.0f, 1.0f, 1.0f,
+                                   1.0f, 0.0f, 0.0f, 0.0f };
+const GLushort quad_indices[] = {0,1,2, 2,3,0};
+
+struct ShaderPass
+{
+    const char* name;
+    const char* vertexFile;
+    const char* fragmentFile;
+    const char* defines;        // in front of both sources, as ShaderCache::Defines() has them
+    bool floatFloat;
+    GLuint program;
+};
+
+static bool ReadTextFile(const std::string& fileName, std::string& text)
+{
+    std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+    if ( !file )
+        return false;
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+static GLuint CompileShader(GLenum type, const std::string& source, const std::string& fileName)
+{
+    GLuint shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, 0);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if ( !compiled )
+    {
+        char log[4096];
+        glGetShaderInfoLog(shader, sizeof(log), 0, log);
+        fprintf(stderr, "%s: %s\n", fileName.c_str(), log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static GLuint LinkProgram(const std::string& resources, const ShaderPass& pass)
+{
+    std::string vertexSource, fragmentSource;
+    std::string vertexFile = resources + "/" + pass.vertexFile;
+    std::string fragmentFile = resources + "/" + pass.fragmentFile;
+
+    if ( !ReadTextFile(vertexFile, vertexSource) || !ReadTextFile(fragmentFile, fragmentSource) )
+    {
+        fprintf(stderr, "cannot read the %s shaders from %s\n", pass.name, resources.c_str());
+        return 0;
+    }
+
+    vertexSource = pass.defines + vertexSource;
+    fragmentSource = pass.defines + fragmentSource;
+
+    GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource, vertexFile);
+    GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource, fragmentFile);
+    if ( !vertexShader || !fragmentShader )
+        return 0;
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if ( !linked )
+    {
+        char log[4096];
+        glGetProgramInfoLog(program, sizeof(log), 0, log);
+        fprintf(stderr, "%s: %s\n", pass.name, log);
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
+
+static bool InitEGL(EGLDisplay& display, EGLContext& context)
+{
+    display = EGL_NO_DISPLAY;
+
+    // no window system needed, fall back to the default display otherwise
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if ( getPlatformDisplay )
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+#endif
+    if ( display == EGL_NO_DISPLAY )
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if ( display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0) )
+        return false;
+
+    const EGLint configAttributes[] =
+    {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if ( !eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0 )
+        return false;
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    const EGLint contextAttributes[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if ( context == EGL_NO_CONTEXT )
+        return false;
+
+    // everything goes to a framebuffer object, no surface needed
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) == EGL_TRUE;
+}
+
+static void SetUniforms(const ShaderPass& pass, const MandelbrotView& view, bool periodicity)
+{
+    GLuint program = pass.program;
+    glUseProgram(program);
+
+    const GLfloat identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    glUniformMatrix4fv(glGetUniformLocation(program, "MVP"), 1, GL_FALSE, identity);
+    glUniform1f(glGetUniformLocation(program, "scale"), float(view.scale));
+    glUniform1f(glGetUniformLocation(program, "whScale"), float(view.WHScale()));
+    glUniform1f(glGetUniformLocation(program, "rotRadian"), float(view.rotation));
+    glUniform1i(glGetUniformLocation(program, "maxIterations"), view.maxIterations);
+    glUniform1i(glGetUniformLocation(program, "lookUpTexture"), 0);
+    glUniform1f(glGetUniformLocation(program, "periodicityEpsilon"),
+                periodicity ? float(PeriodicityEpsilon(view.PixelSize())) : 0.0f);
+
+    if ( pass.floatFloat )
+    {
+        // the same split as MandelGLWidget::RenderFractal
+        float centerHiX = float(view.centerX);
+        float centerHiY = float(view.centerY);
+        float pivotHiX = float(view.pivotX);
+        float pivotHiY = float(view.pivotY);
+
+        glUniform1f(glGetUniformLocation(program, "ffOne"), 1.0f);
+        glUniform2f(glGetUniformLocation(program, "centerHi"), centerHiX, centerHiY);
+        glUniform2f(glGetUniformLocation(program, "centerLo"),
+                    float(view.centerX - centerHiX), float(view.centerY - centerHiY));
+        glUniform2f(glGetUniformLocation(program, "rotatePivotHi"), pivotHiX, pivotHiY);
+        glUniform2f(glGetUniformLocation(program, "rotatePivotLo"),
+                    float(view.pivotX - pivotHiX), float(view.pivotY - pivotHiY));
+    }
+    else
+    {
+        glUniform2f(glGetUniformLocation(program, "center"), float(view.centerX), float(view.centerY));
+        glUniform2f(glGetUniformLocation(program, "rotatePivot"), float(view.pivotX), float(view.pivotY));
+    }
+
+    GLint position = glGetAttribLocation(program, "Position");
+    GLint texCoord = glGetAttribLocation(program, "InTexCoord");
+    glEnableVertexAttribArray(position);
+    glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, quad_vertices);
+    glEnableVertexAttribArray(texCoord);
+    glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, 0, quad_uvs);
+}
+
+// share of pixels more than a few color steps away from the reference
+static double MismatchRatio(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference)
+{
+    size_t mismatches = 0;
+    for ( size_t i = 0; i < image.size(); i += 4)
+    {
+        for ( int c = 0; c < 3; c ++)
+        {
+            if ( abs(int(image[i + c]) - int(reference[i + c])) > 24 )
+            {
+                mismatches ++;
+                break;
+            }
+        }
+    }
+
+    return double(mismatches) / double(image.size() / 4);
+}
+
+static void PrintUsage()
+{
+    printf("usage: shaderbench [--resources dir] [--size w h] [--frames n]\n"
+           "                   [--iterations n] [--center x y] [--no-periodicity]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string resources = "../../Resources";
+    int width = 640;
+    int height = 360;
+    int frames = 5;
+    int iterations = 256;
+    double centerX = 0.0;
+    double centerY = 1.0;
+    bool periodicity = true;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument(argv[i]);
+
+        if ( argument == "--resources" && i + 1 < argc )
+            resources = argv[++ i];
+        else if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++ i]);
+            height = atoi(argv[++ i]);
+        }
+        else if ( argument == "--frames" && i + 1 < argc )
+            frames = atoi(argv[++ i]);
+        else if ( argument == "--iterations" && i + 1 < argc )
+            iterations = atoi(argv[++ i]);
+        else if ( argument == "--center" && i + 2 < argc )
+        {
+            centerX = atof(argv[++ i]);
+            centerY = atof(argv[++ i]);
+        }
+        else if ( argument == "--no-periodicity" )
+            periodicity = false;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    EGLDisplay display;
+    EGLContext context;
+    if ( !InitEGL(display, context) )
+    {
+        fprintf(stderr, "cannot create an OpenGL ES 2 context\n");
+        return 1;
+    }
+
+    printf("renderer: %s\n", (const char*)glGetString(GL_RENDERER));
+
+    // the widget uploads a QImage, its bytes are BGRA and the shaders
+    // swizzle them back; do the same with the png
+    int lookupWidth, lookupHeight;
+    std::vector<unsigned char> lookup;
+    if ( !ReadPng((resources + "/lookup.png").c_str(), lookupWidth, lookupHeight, lookup) )
+    {
+        fprintf(stderr, "cannot read %s/lookup.png\n", resources.c_str());
+        return 1;
+    }
+
+    MandelbrotPalette palette;
+    palette.SetColors(&lookup[0], lookupWidth);
+
+    for ( size_t i = 0; i < lookup.size(); i += 4)
+        std::swap(lookup[i], lookup[i + 2]);
+
+    GLuint lookupTexture;
+    glGenTextures(1, &lookupTexture);
+    glBindTexture(GL_TEXTURE_2D, lookupTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, lookupWidth, lookupHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, &lookup[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    GLuint targetTexture;
+    glGenTextures(1, &targetTexture);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targetTexture, 0);
+    if ( glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE )
+    {
+        fprintf(stderr, "incomplete framebuffer\n");
+        return 1;
+    }
+
+    glViewport(0, 0, width, height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lookupTexture);
+
+    ShaderPass passes[2] =
+    {
+        { "float", "mandelbrot_vert.glsl", "mandelbrot_frag.glsl",
+          "#define ENABLE_PERIODICITY_CHECK\n#define ITERATION_PRECISION highp\n", false, 0 },
+        { "float-float", "mandelbrot_ff_vert.glsl", "mandelbrot_ff_frag.glsl", "", true, 0 }
+    };
+
+    for ( int p = 0; p < 2; p ++)
+    {
+        passes[p].program = LinkProgram(resources, passes[p]);
+        if ( !passes[p].program )
+            return 1;
+    }
+
+    MandelbrotEngine engine;
+    engine.SetPalette(&palette);
+    engine.SetPeriodicityCheck(periodicity);
+
+    std::vector<unsigned char> image(size_t(width) * height * 4);
+    std::vector<unsigned char> reference(image.size());
+
+    printf("%-12s %10s %12s %10s %10s\n", "shader", "zoom", "ms/frame", "Mpix/s", "mismatch");
+
+    const double zooms[] = { 1e2, 1e4, 1e5, 1e6, 1e8, 1e10, 1e12, 1e13 };
+    for ( size_t z = 0; z < sizeof(zooms) / sizeof(zooms[0]); z ++)
+    {
+        MandelbrotView view;
+        view.width = width;
+        view.height = height;
+        view.centerX = view.pivotX = centerX;
+        view.centerY = view.pivotY = centerY;
+        view.preciseCenterX = BigFloat(centerX);
+        view.preciseCenterY = BigFloat(centerY);
+        view.scale = zooms[z];
+        view.maxIterations = iterations;
+
+        // row 0 of the framebuffer is the bottom one, where the quad has
+        // uv.y = 1, which is row 0 of the cpu image as well
+        FractalBuffer buffer(width, height, &reference[0], 0, 0);
+        engine.Render(view, buffer);
+
+        for ( int p = 0; p < 2; p ++)
+        {
+            SetUniforms(passes[p], view, periodicity);
+
+            // warm up, the first draw compiles the shader for real
+            glDrawElements(GL_TRIANGLES, 2*3, GL_UNSIGNED_SHORT, quad_indices);
+            glFinish();
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for ( int f = 0; f < frames; f ++)
+                glDrawElements(GL_TRIANGLES, 2*3, GL_UNSIGNED_SHORT, quad_indices);
+            glFinish();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &image[0]);
+
+            double frameMs = seconds * 1000.0 / frames;
+            double megaPixels = double(width) * height * frames / seconds / 1e6;
+
+            printf("%-12s %10.0e %12.2f %10.2f %9.2f%%\n", passes[p].name, zooms[z],
+                   frameMs, megaPixels, MismatchRatio(image, reference) * 100.0);
+        }
+    }
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+
+    return 0;
+}
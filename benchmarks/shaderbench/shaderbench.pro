@@ -0,0 +1,19 @@
+#-----------------------------------------------------------
+#
+# float vs float-float mandelbrot shader throughput,
+# off-screen GLES 2 through EGL (e.g. Mesa llvmpipe)
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = shaderbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += shaderbench.cpp
+
+include(../../fractcore/fractcore.pri)
+
+LIBS += -lEGL -lGLESv2
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// load generator for tileserver, run against a server on this machine
+//
+// every connection keeps one keep-alive socket and asks for one tile after
+// the other, picked at random from a fixed set around a few well known
+// regions; the set is small enough that connections often ask for a tile
+// another one is waiting for, which the server renders only once. Tiles
+// turned away with 503 are counted and asked for again after a short wait.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Region
+{
+    const char* name;
+    double x;
+    double y;
+};
+
+static const Region REGIONS[] =
+{
+    { "seahorse valley",  -0.7453,  0.1127 },
+    { "elephant valley",   0.2750,  0.0060 },
+    { "minibrot",         -1.7687,  0.0017 },
+    { "spiral",           -0.7616, -0.0848 }
+};
+
+// level 0 of the server, see TileService
+static const double WORLD_LEFT = -2.5;
+static const double WORLD_TOP = 2.0;
+static const double WORLD_SIZE = 4.0;
+
+struct Tile
+{
+    int zoom;
+    long long x;
+    long long y;
+};
+
+struct ConnectionStats
+{
+    ConnectionStats() : ok(0), busy(0), failed(0), bytes(0) {}
+
+    long long ok;
+    long long busy;
+    long long failed;
+    long long bytes;
+    std::vector<double> latencies;
+};
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int Connect(const std::string& host, int port)
+{
+    int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+    if ( socket < 0 )
+        return -1;
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)(port));
+    if ( inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+         connect(socket, (sockaddr*)(&address), sizeof(address)) != 0 )
+    {
+        close(socket);
+        return -1;
+    }
+
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return socket;
+}
+
+// sends a GET and reads the whole response, returns the status code or -1;
+// keepAlive is cleared if the server closes the connection after it
+static int Get(int socket, const std::string& path, std::string& buffered, std::string& body, bool& keepAlive)
+{
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    if ( send(socket, request.data(), request.size(), MSG_NOSIGNAL) != ssize_t(request.size()) )
+        return -1;
+
+    char chunk[16384];
+    size_t headerEnd;
+    while ( (headerEnd = buffered.find("\r\n\r\n")) == std::string::npos )
+    {
+        ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+        if ( count <= 0 )
+            return -1;
+        buffered.append(chunk, size_t(count));
+    }
+
+    int status = 0;
+    if ( sscanf(buffered.c_str(), "HTTP/1.1 %d", &status) != 1 )
+        return -1;
+
+    size_t length = 0;
+    size_t field = buffered.find("Content-Length:");
+    if ( field != std::string::npos && field < headerEnd )
+        length = size_t(strtoull(buffered.c_str() + field + 15, 0, 10));
+
+    size_t end = headerEnd + 4 + length;
+    while ( buffered.size() < end )
+    {
+        ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+        if ( count <= 0 )
+            return -1;
+        buffered.append(chunk, size_t(count));
+    }
+
+    keepAlive = buffered.find("Connection: close") > headerEnd;
+    body = buffered.substr(headerEnd + 4, length);
+    buffered.erase(0, end);
+    return status;
+}
+
+static void PrintUsage()
+{
+    printf("usage: tileserverbench [--port n] [--connections n] [--seconds s] [--zoom min max] [--tiles n]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 16;
+    double seconds = 10.0;
+    int minZoom = 4;
+    int maxZoom = 16;
+    int tileCount = 256;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument = argv[i];
+        if ( argument == "--port" && i + 1 < argc )
+            port = atoi(argv[++i]);
+        else if ( argument == "--connections" && i + 1 < argc )
+            connections = atoi(argv[++i]);
+        else if ( argument == "--seconds" && i + 1 < argc )
+            seconds = atof(argv[++i]);
+        else if ( argument == "--zoom" && i + 2 < argc )
+        {
+            minZoom = atoi(argv[++i]);
+            maxZoom = atoi(argv[++i]);
+        }
+        else if ( argument == "--tiles" && i + 1 < argc )
+            tileCount = atoi(argv[++i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( connections < 1 || tileCount < 1 || minZoom < 0 || maxZoom < minZoom )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    // tiles of a few neighbourhoods around the regions, on every level
+    std::mt19937 random(12345);
+    std::vector<Tile> tiles;
+    for ( int i = 0; i < tileCount; i ++)
+    {
+        const Region& region = REGIONS[random() % (sizeof(REGIONS) / sizeof(REGIONS[0]))];
+
+        Tile tile;
+        tile.zoom = minZoom + int(random() % (maxZoom - minZoom + 1));
+
+        long long count = 1LL << tile.zoom;
+        double size = WORLD_SIZE / double(count);
+        long long x = (long long)((region.x - WORLD_LEFT) / size) + (long long)(random() % 5) - 2;
+        long long y = (long long)((WORLD_TOP - region.y) / size) + (long long)(random() % 5) - 2;
+        tile.x = std::min(std::max(x, 0LL), count - 1);
+        tile.y = std::min(std::max(y, 0LL), count - 1);
+        tiles.push_back(tile);
+    }
+
+    printf("%d connections for %.0f s, %d tiles on levels %d to %d\n", connections, seconds, tileCount, minZoom, maxZoom);
+
+    std::vector<ConnectionStats> stats(connections);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for ( int c = 0; c < connections; c ++)
+    {
+        threads.push_back(std::thread([&, c]()
+        {
+            std::mt19937 pick(1000 + c);
+            ConnectionStats& own = stats[c];
+            int socket = -1;
+            std::string buffered, body;
+
+            while ( Seconds(start) < seconds )
+            {
+                if ( socket < 0 )
+                {
+                    buffered.clear();
+                    socket = Connect(host, port);
+                    if ( socket < 0 )
+                    {
+                        own.failed ++;
+                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                        continue;
+                    }
+                }
+
+                const Tile& tile = tiles[pick() % tiles.size()];
+                char path[128];
+                snprintf(path, sizeof(path), "/%d/%lld/%lld.png", tile.zoom, tile.x, tile.y);
+
+                std::chrono::steady_clock::time_point requested = std::chrono::steady_clock::now();
+                bool keepAlive = true;
+                int status = Get(socket, path, buffered, body, keepAlive);
+
+                if ( status == 200 )
+                {
+                    own.ok ++;
+                    own.bytes += (long long)(body.size());
+                    own.latencies.push_back(Seconds(requested));
+                }
+                else if ( status == 503 )
+                {
+                    own.busy ++;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                else
+                {
+                    own.failed ++;
+                    keepAlive = false;
+                }
+
+                if ( !keepAlive )
+                {
+                    close(socket);
+                    socket = -1;
+                }
+            }
+
+            if ( socket >= 0 )
+                close(socket);
+        }));
+    }
+
+    for ( size_t i = 0; i < threads.size(); i ++)
+        threads[i].join();
+    double elapsed = Seconds(start);
+
+    ConnectionStats all;
+    for ( int c = 0; c < connections; c ++)
+    {
+        all.ok += stats[c].ok;
+        all.busy += stats[c].busy;
+        all.failed += stats[c].failed;
+        all.bytes += stats[c].bytes;
+        all.latencies.insert(all.latencies.end(), stats[c].latencies.begin(), stats[c].latencies.end());
+    }
+    std::sort(all.latencies.begin(), all.latencies.end());
+
+    printf("%-12s %8lld\n", "tiles", all.ok);
+    printf("%-12s %8lld\n", "503 busy", all.busy);
+    printf("%-12s %8lld\n", "failed", all.failed);
+    printf("%-12s %8.1f\n", "tiles/s", double(all.ok) / elapsed);
+    printf("%-12s %8.1f\n", "KB/tile", all.ok > 0 ? double(all.bytes) / double(all.ok) / 1024.0 : 0.0);
+
+    if ( !all.latencies.empty() )
+    {
+        const double fractions[] = { 0.5, 0.9, 0.99, 1.0 };
+        const char* names[] = { "p50 ms", "p90 ms", "p99 ms", "max ms" };
+        for ( int i = 0; i < 4; i ++)
+        {
+            size_t index = std::min(all.latencies.size() - 1, size_t(fractions[i] * double(all.latencies.size())));
+            printf("%-12s %8.2f\n", names[i], all.latencies[index] * 1000.0);
+        }
+    }
+
+    // the server's side of it
+    int socket = Connect(host, port);
+    std::string buffered, body;
+    bool keepAlive;
+    if ( socket >= 0 && Get(socket, "/stats", buffered, body, keepAlive) == 200 )
+        printf("server: %s", body.c_str());
+    if ( socket >= 0 )
+        close(socket);
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-----------------------------------------------------------
+#
+# load generator for tileserver: tiles/s and latency of
+# keep-alive connections against localhost
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = tileserverbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += tileserverbench.cpp
+
+unix:LIBS += -lpthread
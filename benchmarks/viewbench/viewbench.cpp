@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// frame time of every cpu render path on a fixed catalog of views
+//
+// the catalog covers the widget's start view, an interior heavy and a
+// boundary heavy view, a deep zoom for the perturbation renderer and a
+// rotated view. Every path renders the whole frame, after warm-up frames
+// that are not counted; the runs after them give the mean, the spread and
+// the median frame time, Mpixels/s and Giterations/s come from the median.
+//
+// --json writes the same numbers for a later --compare: run the bench on
+// two commits on the same machine and the second run prints the change
+// of every view and path, flagged where it is beyond the noise of both.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adaptivesampler.h"
+#include "bigfloat.h"
+#include "histogramcoloring.h"
+#include "mandelbrotengine.h"
+#include "perturbationrenderer.h"
+#include "progressiverenderer.h"
+#include "simdkernel.h"
+#include "subdivisionrenderer.h"
+#include "tilescheduler.h"
+
+struct CatalogView
+{
+    const char* name;
+    const char* centerX;        // decimal, as many digits as the zoom needs
+    const char* centerY;
+    double scale;
+    double rotation;            // radian
+    int iterations;
+};
+
+static const CatalogView CATALOG[] =
+{
+    { "default",  "-0.5",          "0.0",          0.8,    0.0, 64 },      // MandelGLWidget start view
+    { "interior", "-0.1225611669", "0.7448617666", 200.0,  0.0, 2048 },    // period-3 bulb
+    { "boundary", "-0.7436438870", "0.1318259042", 1e4,    0.0, 1024 },    // seahorse valley
+    { "deep",     "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 1e11, 0.0, 2000 },
+    { "rotated",  "0.2850",        "0.0110",       500.0,  0.6, 512 }      // elephant valley
+};
+
+enum RenderPath
+{
+    PATH_SCALAR = 0,        // MandelbrotEngine, scalar kernel, one thread
+    PATH_SIMD,              // MandelbrotEngine, widest kernel, one thread
+    PATH_FLOAT,             // same in single precision, as on GL_ES
+    PATH_TILED,             // MandelbrotEngine tiles over the TileScheduler
+    PATH_SUBDIVISION,       // SubdivisionRenderer tiles over the TileScheduler
+    PATH_PROGRESSIVE,       // all ProgressiveRenderer passes over the TileScheduler
+    PATH_ANTIALIASED,       // tiled, then AdaptiveSupersampler with 4 samples per pixel at most
+    PATH_HISTOGRAM,         // tiled without colors, then HistogramColoring over the frame
+    PATH_PERTURBATION,      // PerturbationRenderer over the TileScheduler, deep views only
+    PATH_COUNT
+};
+
+static const char* PATH_NAMES[PATH_COUNT] =
+{
+    "scalar", "simd", "float", "tiled", "subdivision", "progressive", "antialiased", "histogram", "perturbation"
+};
+
+// frame times of one view and path
+struct BenchResult
+{
+    std::string view;
+    std::string path;
+    long long pixels;
+    long long iterations;           // escape iterations of one frame
+    std::vector<double> seconds;    // per run
+
+    double Mean() const;
+    double Stddev() const;
+    double Median() const;
+    double Min() const { return *std::min_element(seconds.begin(), seconds.end()); }
+    double Max() const { return *std::max_element(seconds.begin(), seconds.end()); }
+};
+
+double BenchResult::Mean() const
+{
+    double sum = 0.0;
+    for ( size_t i = 0; i < seconds.size(); i ++)
+        sum += seconds[i];
+    return sum / double(seconds.size());
+}
+
+double BenchResult::Stddev() const
+{
+    if ( seconds.size() < 2 )
+        return 0.0;
+
+    double mean = Mean();
+    double sum = 0.0;
+    for ( size_t i = 0; i < seconds.size(); i ++)
+        sum += (seconds[i] - mean) * (seconds[i] - mean);
+    return sqrt(sum / double(seconds.size() - 1));
+}
+
+double BenchResult::Median() const
+{
+    std::vector<double> sorted(seconds);
+    std::sort(sorted.begin(), sorted.end());
+    size_t middle = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[middle] : 0.5 * (sorted[middle - 1] + sorted[middle]);
+}
+
+// everything a path renders with
+struct BenchContext
+{
+    MandelbrotEngine scalarEngine;
+    MandelbrotEngine engine;
+    MandelbrotEngine floatEngine;
+    SubdivisionRenderer subdivision;
+    ProgressiveRenderer progressive;
+    AdaptiveSupersampler supersampler;
+    MandelbrotPalette grayPalette;
+    HistogramColoring coloring;
+    PerturbationRenderer perturbation;
+    TileScheduler* scheduler;
+};
+
+// renders one frame, returns its wall time; the kernel counters go to stats
+static double RenderFrame(BenchContext& context, RenderPath path, const MandelbrotView& view,
+                          FractalBuffer& buffer, KernelStats& stats)
+{
+    TileScheduler& scheduler = *context.scheduler;
+    std::vector<KernelStats> workerStats(scheduler.ThreadCount());
+    stats = KernelStats();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    switch ( path )
+    {
+    case PATH_SCALAR:
+        context.scalarEngine.Render(view, buffer, &stats);
+        break;
+
+    case PATH_SIMD:
+        context.engine.Render(view, buffer, &stats);
+        break;
+
+    case PATH_FLOAT:
+        context.floatEngine.Render(view, buffer, &stats);
+        break;
+
+    case PATH_TILED:
+        scheduler.Run(view.width, view.height, [&](const RenderTile& tile, int worker)
+        {
+            FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+            context.engine.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+        });
+        break;
+
+    case PATH_SUBDIVISION:
+        scheduler.Run(view.width, view.height, [&](const RenderTile& tile, int worker)
+        {
+            SubdivisionStats tileStats;
+            FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+            context.subdivision.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &tileStats);
+            workerStats[worker].Add(tileStats.kernel);
+        });
+        break;
+
+    case PATH_PROGRESSIVE:
+        for ( int pass = 0; pass < PROGRESSIVE_PASSES; pass ++)
+        {
+            scheduler.Run(view.width, view.height, [&](const RenderTile& tile, int worker)
+            {
+                ProgressiveStats tileStats;
+                FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                context.progressive.RenderPass(view, pass, tile.x, tile.y, tile.width, tile.height, tileBuffer, &tileStats);
+                workerStats[worker].Add(tileStats.kernel);
+            });
+        }
+        break;
+
+    case PATH_ANTIALIASED:
+        {
+            scheduler.Run(view.width, view.height, [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                context.engine.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+            });
+
+            SupersamplingStats frameStats;
+            context.supersampler.Refine(view, buffer, scheduler, &frameStats);
+            stats = frameStats.kernel;
+        }
+        break;
+
+    case PATH_HISTOGRAM:
+        {
+            // the recolor gives every pixel its color
+            FractalBuffer uncolored = buffer;
+            uncolored.rgba = 0;
+            scheduler.Run(view.width, view.height, [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = uncolored.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                context.engine.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+            });
+
+            context.coloring.Collect(buffer, view.maxIterations, &scheduler);
+            context.coloring.Equalize();
+            context.coloring.Recolor(buffer, view.maxIterations, true, &scheduler);
+        }
+        break;
+
+    case PATH_PERTURBATION:
+        {
+            PerturbationStats frameStats;
+            context.perturbation.Render(view, buffer, &scheduler, &frameStats);
+            stats = frameStats.kernel;
+        }
+        break;
+
+    default:
+        break;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for ( size_t i = 0; i < workerStats.size(); i ++)
+        stats.Add(workerStats[i]);
+    return seconds;
+}
+
+// the engine paths stop at double precision, the perturbation renderer
+// only makes sense past it
+static bool PathFitsView(RenderPath path, const MandelbrotView& view)
+{
+    bool deep = PerturbationRenderer::IsDeepView(view);
+    return path == PATH_PERTURBATION ? deep : !deep;
+}
+
+// comma separated names, empty selects everything
+static bool Selected(const std::string& list, const char* name)
+{
+    if ( list.empty() )
+        return true;
+    return ("," + list + ",").find("," + std::string(name) + ",") != std::string::npos;
+}
+
+static std::string JsonEscape(const std::string& text)
+{
+    std::string escaped;
+    for ( size_t i = 0; i < text.size(); i ++)
+    {
+        if ( text[i] == '"' || text[i] == '\\' )
+            escaped += '\\';
+        if ( (unsigned char)(text[i]) >= 0x20 )
+            escaped += text[i];
+    }
+    return escaped;
+}
+
+// one result per line, so --compare can read it back without a json parser
+static bool WriteJson(const std::string& path, const std::string& label, int width, int height, int threads,
+                      int warmup, int runs, const std::vector<BenchResult>& results)
+{
+    FILE* file = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if ( !file )
+        return false;
+
+    char date[32];
+    time_t now = time(0);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"benchmark\": \"viewbench\",\n");
+    fprintf(file, "  \"label\": \"%s\",\n", JsonEscape(label).c_str());
+    fprintf(file, "  \"date\": \"%s\",\n", date);
+#if defined(__VERSION__)
+    fprintf(file, "  \"compiler\": \"%s\",\n", JsonEscape(__VERSION__).c_str());
+#endif
+    fprintf(file, "  \"simd\": \"%s\",\n", SimdLevelName(DetectSimdLevel()));
+    fprintf(file, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    fprintf(file, "  \"threads\": %d,\n", threads);
+    fprintf(file, "  \"width\": %d,\n", width);
+    fprintf(file, "  \"height\": %d,\n", height);
+    fprintf(file, "  \"warmup\": %d,\n", warmup);
+    fprintf(file, "  \"runs\": %d,\n", runs);
+    fprintf(file, "  \"results\": [\n");
+    for ( size_t i = 0; i < results.size(); i ++)
+    {
+        const BenchResult& result = results[i];
+        double median = result.Median();
+        fprintf(file, "    { \"view\": \"%s\", \"path\": \"%s\", \"median_ms\": %.4f, \"mean_ms\": %.4f, \"stddev_ms\": %.4f, "
+                      "\"min_ms\": %.4f, \"max_ms\": %.4f, \"mpixels_per_s\": %.3f, \"giterations_per_s\": %.4f, "
+                      "\"pixels\": %lld, \"iterations\": %lld }%s\n",
+                result.view.c_str(), result.path.c_str(), median * 1000.0, result.Mean() * 1000.0, result.Stddev() * 1000.0,
+                result.Min() * 1000.0, result.Max() * 1000.0, double(result.pixels) / median * 1e-6,
+                double(result.iterations) / median * 1e-9, result.pixels, result.iterations,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    if ( file != stdout )
+        fclose(file);
+    return true;
+}
+
+// median and stddev of a view / path of an earlier --json file
+struct BaselineResult
+{
+    double medianMs;
+    double stddevMs;
+};
+
+static bool ReadJsonString(const char* line, const char* key, std::string& value)
+{
+    const char* found = strstr(line, key);
+    if ( !found )
+        return false;
+
+    const char* start = strchr(found + strlen(key), '"');
+    const char* end = start ? strchr(start + 1, '"') : 0;
+    if ( !end )
+        return false;
+
+    value.assign(start + 1, end);
+    return true;
+}
+
+static bool ReadJsonNumber(const char* line, const char* key, double& value)
+{
+    const char* found = strstr(line, key);
+    return found && sscanf(found + strlen(key), " : %lf", &value) == 1;
+}
+
+static bool ReadBaseline(const std::string& path, std::map<std::string, BaselineResult>& baseline)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if ( !file )
+        return false;
+
+    char line[1024];
+    while ( fgets(line, sizeof(line), file) )
+    {
+        std::string view, renderPath;
+        BaselineResult result;
+        if ( ReadJsonString(line, "\"view\":", view) && ReadJsonString(line, "\"path\":", renderPath) &&
+             ReadJsonNumber(line, "\"median_ms\"", result.medianMs) && ReadJsonNumber(line, "\"stddev_ms\"", result.stddevMs) )
+        {
+            baseline[view + "/" + renderPath] = result;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static void PrintUsage()
+{
+    printf("usage: viewbench [--size w h] [--threads n] [--warmup n] [--runs n]\n"
+           "                 [--views a,b] [--paths a,b] [--json file|-] [--label text] [--compare file]\n"
+           "views: ");
+    for ( size_t v = 0; v < sizeof(CATALOG) / sizeof(CATALOG[0]); v ++)
+        printf("%s ", CATALOG[v].name);
+    printf("\npaths: ");
+    for ( int p = 0; p < PATH_COUNT; p ++)
+        printf("%s ", PATH_NAMES[p]);
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int width = 1280;
+    int height = 720;
+    int threads = 0;
+    int warmup = 1;
+    int runs = 5;
+    std::string views;
+    std::string paths;
+    std::string jsonPath;
+    std::string label;
+    std::string comparePath;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument(argv[i]);
+
+        if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++ i]);
+            height = atoi(argv[++ i]);
+        }
+        else if ( argument == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++ i]);
+        else if ( argument == "--warmup" && i + 1 < argc )
+            warmup = atoi(argv[++ i]);
+        else if ( argument == "--runs" && i + 1 < argc )
+            runs = atoi(argv[++ i]);
+        else if ( argument == "--views" && i + 1 < argc )
+            views = argv[++ i];
+        else if ( argument == "--paths" && i + 1 < argc )
+            paths = argv[++ i];
+        else if ( argument == "--json" && i + 1 < argc )
+            jsonPath = argv[++ i];
+        else if ( argument == "--label" && i + 1 < argc )
+            label = argv[++ i];
+        else if ( argument == "--compare" && i + 1 < argc )
+            comparePath = argv[++ i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( width <= 0 || height <= 0 || warmup < 0 || runs <= 0 )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::map<std::string, BaselineResult> baseline;
+    if ( !comparePath.empty() && !ReadBaseline(comparePath, baseline) )
+    {
+        fprintf(stderr, "could not read %s\n", comparePath.c_str());
+        return 1;
+    }
+
+    TileScheduler scheduler(threads);
+    BenchContext context;
+    context.scalarEngine.SetSimdLevel(SIMD_SCALAR);
+    context.floatEngine.SetPrecision(MandelbrotEngine::SINGLE_PRECISION);
+    context.subdivision.SetEngine(&context.engine);
+    context.progressive.SetEngine(&context.engine);
+    context.supersampler.SetEngine(&context.engine);
+    context.scheduler = &scheduler;
+
+    // the engines color in gray without a palette, the histogram path
+    // equalizes the same ramp
+    std::vector<unsigned char> ramp(256 * 4);
+    for ( int i = 0; i < 256; i ++)
+    {
+        ramp[i * 4 + 0] = ramp[i * 4 + 1] = ramp[i * 4 + 2] = (unsigned char)i;
+        ramp[i * 4 + 3] = 255;
+    }
+    context.grayPalette.SetColors(&ramp[0], 256);
+    context.coloring.SetPalette(&context.grayPalette);
+
+    // with --json - the table goes to stderr
+    FILE* table = jsonPath == "-" ? stderr : stdout;
+    fprintf(table, "simd level: %s, %dx%d, %d threads, %d warm-up + %d runs\n",
+            SimdLevelName(context.engine.GetSimdLevel()), width, height, scheduler.ThreadCount(), warmup, runs);
+    fprintf(table, "%-9s %-13s %10s %9s %7s %10s %10s", "view", "path", "median ms", "mean ms", "+-%", "Mpixels/s", "Giter/s");
+    if ( !baseline.empty() )
+        fprintf(table, " %9s", "change");
+    fprintf(table, "\n");
+
+    size_t pixels = size_t(width) * height;
+    std::vector<unsigned char> rgba(pixels * 4);
+    std::vector<int> iterations(pixels);
+    std::vector<float> smooth(pixels);
+    FractalBuffer buffer(width, height, &rgba[0], &iterations[0], &smooth[0]);
+
+    std::vector<BenchResult> results;
+    for ( size_t v = 0; v < sizeof(CATALOG) / sizeof(CATALOG[0]); v ++)
+    {
+        const CatalogView& entry = CATALOG[v];
+        if ( !Selected(views, entry.name) )
+            continue;
+
+        MandelbrotView view;
+        view.width = width;
+        view.height = height;
+        view.scale = entry.scale;
+        view.rotation = entry.rotation;
+        view.maxIterations = entry.iterations;
+
+        BigFloat centerX, centerY;
+        int bits = BigFloat::BitsForPixelSize(view.PixelSize());
+        BigFloat::FromString(entry.centerX, bits, centerX);
+        BigFloat::FromString(entry.centerY, bits, centerY);
+        view.SetCenter(centerX, centerY);
+        view.pivotX = view.centerX;
+        view.pivotY = view.centerY;
+
+        for ( int p = 0; p < PATH_COUNT; p ++)
+        {
+            RenderPath path = RenderPath(p);
+            if ( !Selected(paths, PATH_NAMES[p]) || !PathFitsView(path, view) )
+                continue;
+
+            BenchResult result;
+            result.view = entry.name;
+            result.path = PATH_NAMES[p];
+            result.pixels = (long long)(pixels);
+
+            KernelStats stats;
+            for ( int run = 0; run < warmup; run ++)
+                RenderFrame(context, path, view, buffer, stats);
+            for ( int run = 0; run < runs; run ++)
+                result.seconds.push_back(RenderFrame(context, path, view, buffer, stats));
+            result.iterations = stats.iterations;
+
+            double median = result.Median();
+            double mean = result.Mean();
+            fprintf(table, "%-9s %-13s %10.2f %9.2f %6.1f%% %10.2f %10.3f", entry.name, PATH_NAMES[p],
+                    median * 1000.0, mean * 1000.0, 100.0 * result.Stddev() / mean,
+                    double(result.pixels) / median * 1e-6, double(result.iterations) / median * 1e-9);
+
+            // beyond twice the spread of either run counts as a change
+            std::map<std::string, BaselineResult>::const_iterator before = baseline.find(result.view + "/" + result.path);
+            if ( before != baseline.end() && before->second.medianMs > 0.0 )
+            {
+                double medianMs = median * 1000.0;
+                double change = medianMs / before->second.medianMs - 1.0;
+                double noise = 2.0 * std::max(before->second.stddevMs, result.Stddev() * 1000.0);
+                bool significant = fabs(medianMs - before->second.medianMs) > noise;
+                fprintf(table, " %+8.1f%%%s", 100.0 * change,
+                        !significant ? "" : (change > 0.0 ? " slower" : " faster"));
+            }
+            fprintf(table, "\n");
+            fflush(table);
+
+            results.push_back(result);
+        }
+    }
+
+    if ( !jsonPath.empty() && !WriteJson(jsonPath, label, width, height, scheduler.ThreadCount(), warmup, runs, results) )
+    {
+        fprintf(stderr, "could not write %s\n", jsonPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#-----------------------------------------------------------
+#
+# cpu render paths over a fixed catalog of views, repeated
+# runs with variance and json output for comparisons
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = viewbench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += viewbench.cpp
+
+include(../../fractcore/fractcore.pri)
@@ -1,30 +1,301 @@
 #include "fractalrenderer.h"
 #include <QtOpenGL/QtOpenGL>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <limits>
 #include "MandelGLWidget.h"
+#include "tilescheduler.h"
 
-FractalRenderer::FractalRenderer(MandelGLWidget *parent) :
+// reprojected frames need to take over at least this much of the view
+const double MIN_REPROJECTED_FRACTION = 0.25;
+
+// frames from the tile cache have no coarse passes, so at least this much
+// of them has to be cached already
+const double MIN_CACHED_FRACTION = 0.5;
+
+// the gpu backend takes its escape histogram from a render at this
+// fraction of the width and height
+const int PROBE_DIVISOR = 8;
+
+FractalRenderer::FractalRenderer(MandelGLWidget *parent, RenderBackend backend) :
     QObject()
 {
     glWidget = parent;
+    this->backend = backend;
+    scheduler = 0;
+    viewDirty = false;
+    hasRenderedView = false;
+    pendingTicket = 0;
+    pyramidPending = false;
+    resultWidth = 0;
+    resultHeight = 0;
+    lastFrameSeconds = 0.0;
+    lastUtilization = 0.0;
+    lastFrameWasDeep = false;
+    lastFrameWasSubdivided = false;
+    subdivisionEnabled = false;
+    progressiveEnabled = false;
+    lastProgressivePass = -1;
+    reprojectionEnabled = false;
+    supersamplingEnabled = false;
+    previousFrame = 0;
+    resultIsPreviousFrame = false;
+    secondsPerPixel = 0.0;
+    lastFrameWasReprojected = false;
+    lastSavedSeconds = 0.0;
+    lastFrameWasCached = false;
+    lastTileCacheBytes = 0;
+    lastResumedIterations = 0;
+    histogramEnabled = false;
+    coloringEnabled = false;
+    coloringPaletteSize = HistogramColoring::PALETTE_SIZE;
+    lookupChanged = false;
+    showPeriodicityCheck = false;
+    hasProbeView = false;
+    probeRequested = false;
+    probeQuit = false;
 
     //create a shared context glwidget
     sharedWidget = new QGLWidget(0, parent);
     int width = glWidget->width();
     int height = glWidget->height();
-    sharedWidget->resize(width, height);    
-    
+    sharedWidget->resize(width, height);
+
+    // same lookup table as the mandelbrot shader, the gpu backend only
+    // equalizes it for the histogram coloring
+    QImage lookupImage(QString(":/FractDroidGL/Resources/lookup.png"));
+    std::vector<unsigned char> colors;
+    for ( int x = 0; x < lookupImage.width(); x ++)
+    {
+        QRgb color = lookupImage.pixel(x, 0);
+        colors.push_back((unsigned char)qRed(color));
+        colors.push_back((unsigned char)qGreen(color));
+        colors.push_back((unsigned char)qBlue(color));
+        colors.push_back((unsigned char)qAlpha(color));
+    }
+    if ( !colors.empty() )
+        palette.SetColors(&colors[0], lookupImage.width());
+    coloring.SetPalette(&palette);
+
+    if ( backend == FractalRenderer::CPU_BACKEND )
+    {
+        engine.SetPalette(&palette);
+        perturbation.SetPalette(&palette);
+        subdivision.SetEngine(&engine);
+        progressive.SetEngine(&engine);
+        reprojection.SetEngine(&engine);
+        supersampler.SetEngine(&engine);
+        scheduler = new TileScheduler();
+    }
 }
 
 FractalRenderer::~FractalRenderer()
 {
+    // a probe in flight is not cancelled, it is a small render
+    if ( probeThread.joinable() )
+    {
+        {
+            QMutexLocker locker(&probeMutex);
+            probeQuit = true;
+            probeCondition.wakeOne();
+        }
+        probeThread.join();
+    }
+
+    delete scheduler;
+    scheduler = 0;
+
     delete sharedWidget;
     sharedWidget = 0;
 }
 
+void FractalRenderer::SetThreadCount(int threadCount)
+{
+    if ( scheduler )
+        scheduler->SetThreadCount(threadCount);
+}
+
+void FractalRenderer::SetTileSize(int tileSize)
+{
+    if ( scheduler )
+        scheduler->SetTileSize(tileSize);
+}
+
+void FractalRenderer::SetSubdivision(bool enabled)
+{
+    subdivisionEnabled = enabled;
+}
+
+void FractalRenderer::SetSupersampling(double samplesPerPixel)
+{
+    supersamplingEnabled = samplesPerPixel > 1.0;
+    supersampler.SetSampleBudget(samplesPerPixel);
+}
+
+void FractalRenderer::SetSubdivisionSafeguard(bool enabled)
+{
+    subdivision.SetSafeguard(enabled);
+}
+
+void FractalRenderer::SetProgressive(bool enabled)
+{
+    progressiveEnabled = enabled;
+}
+
+void FractalRenderer::SetReprojection(bool enabled)
+{
+    reprojectionEnabled = enabled;
+}
+
+void FractalRenderer::SetTileCacheBudget(size_t bytes)
+{
+    tileCache.SetBudget(bytes);
+}
+
+void FractalRenderer::SetTilePyramid(const std::string& path, const std::vector<MandelbrotView>& fillViews)
+{
+    QMutexLocker locker(&viewMutex);
+
+    pendingPyramidPath = path;
+    pendingPyramidViews = fillViews;
+    pyramidPending = true;
+}
+
+void FractalRenderer::OpenTilePyramid(const std::string& path, const std::vector<MandelbrotView>& fillViews)
+{
+    tileCache.SetPyramid(0);
+    tilePyramid.Close();
+
+    // an interaction during the fill leaves the rest of the tiles of that
+    // view missing, the next fill renders them; every view goes to the
+    // file before the next one, so only its tiles are held in memory
+    if ( !fillViews.empty() )
+    {
+        TilePyramidWriter writer(tileCache.TileSize());
+        if ( writer.Open(path) )
+        {
+            for ( size_t i = 0; i < fillViews.size(); i ++)
+            {
+                writer.FillView(engine, fillViews[i], scheduler);
+                writer.Save();
+            }
+        }
+    }
+
+    if ( tilePyramid.Open(path) && !tileCache.SetPyramid(&tilePyramid) )
+        tilePyramid.Close();
+}
+
+void FractalRenderer::SetHistogramColoring(bool enabled, int paletteSize)
+{
+    coloringEnabled = enabled;
+    coloringPaletteSize = paletteSize;
+
+    // the passes before the recolor show the palette of the frame before
+    if ( backend == FractalRenderer::CPU_BACKEND )
+    {
+        engine.SetPalette(enabled ? &coloring.Palette() : &palette);
+        perturbation.SetPalette(enabled ? &coloring.Palette() : &palette);
+    }
+}
+
+void FractalRenderer::SetShowPeriodicityCheck(bool enabled)
+{
+    showPeriodicityCheck = enabled;
+    engine.SetShowPeriodicityCheck(enabled);
+}
+
+int FractalRenderer::ThreadCount() const
+{
+    return scheduler ? scheduler->ThreadCount() : 1;
+}
+
+bool FractalRenderer::SetView(const MandelbrotView& view)
+{
+    QMutexLocker locker(&viewMutex);
+
+    // nothing changed since the last finished frame
+    if ( !viewDirty && hasRenderedView && view == renderedView )
+        return false;
+
+    pendingView = view;
+    viewDirty = true;
+
+    // a CancelRendering() from now on stops the frame of this view, also
+    // before the render thread picked it up
+    if ( scheduler )
+        pendingTicket = scheduler->NewTicket();
+    return true;
+}
+
+void FractalRenderer::CancelRendering()
+{
+    // the frame in flight and the one waiting for the render thread
+    if ( scheduler )
+        scheduler->Cancel();
+}
+
+bool FractalRenderer::FrameOutdated(long long ticket)
+{
+    QMutexLocker locker(&viewMutex);
+    return viewDirty || scheduler->Cancelled(ticket);
+}
+
+const unsigned char* FractalRenderer::LockResult(int& width, int& height, MandelbrotView* view)
+{
+    resultMutex.lock();
+    width = resultWidth;
+    height = resultHeight;
+    if ( view )
+        *view = resultView;
+    return resultPixels.empty() ? 0 : &resultPixels[0];
+}
+
+void FractalRenderer::UnlockResult()
+{
+    resultMutex.unlock();
+}
+
+void FractalRenderer::SetIterationHistogram(bool enabled)
+{
+    histogramEnabled = enabled;
+}
+
 bool FractalRenderer::StartRendering()
 {
+    if ( backend == FractalRenderer::CPU_BACKEND )
+        return RenderOnCPU();
+
+    return RenderOnGPU();
+}
+
+bool FractalRenderer::RenderOnGPU()
+{
+    // the shader does not wait for the probe, it takes the palette of the
+    // last one that finished; the input changes the view faster than the
+    // probes could follow
+    if ( (histogramEnabled || coloringEnabled) && !glWidget->Interacting() )
+    {
+        MandelbrotView view;
+        {
+            QMutexLocker locker(&viewMutex);
+            view = pendingView;
+        }
+        RequestProbe(view);
+    }
+
     sharedWidget->makeCurrent();
 
+    // the texture is shared with the widget's context
+    {
+        QMutexLocker locker(&resultMutex);
+        if ( lookupChanged )
+        {
+            glWidget->SetLookupColors(coloring.Palette().Colors(), coloring.Palette().Size());
+            lookupChanged = false;
+        }
+    }
+
     glViewport(0, 0, glWidget->width(), glWidget->height());
 
     glWidget->RenderFractal();
@@ -35,3 +306,445 @@ bool FractalRenderer::StartRendering()
 
     return true;
 }
+
+void FractalRenderer::RequestProbe(const MandelbrotView& view)
+{
+    QMutexLocker locker(&probeMutex);
+
+    // a frame of the same view again, for the palette of its probe
+    if ( hasProbeView && view == probeView )
+        return;
+
+    probeView = view;
+    hasProbeView = true;
+    probeRequested = true;
+
+    if ( !probeThread.joinable() )
+        probeThread = std::thread(&FractalRenderer::ProbeLoop, this);
+    probeCondition.wakeOne();
+}
+
+void FractalRenderer::ProbeLoop()
+{
+    for (;;)
+    {
+        // views that came in while the last probe ran are skipped, only
+        // the latest one is probed
+        MandelbrotView view;
+        {
+            QMutexLocker locker(&probeMutex);
+            while ( !probeRequested && !probeQuit )
+                probeCondition.wait(&probeMutex);
+            if ( probeQuit )
+                return;
+            view = probeView;
+            probeRequested = false;
+        }
+
+        bool changed = ProbeIterations(view);
+        emit FinishedProbe(changed);
+    }
+}
+
+bool FractalRenderer::ProbeIterations(const MandelbrotView& probedView)
+{
+    // the same region with fewer, larger pixels
+    MandelbrotView view = probedView;
+    view.width = std::max(1, view.width / PROBE_DIVISOR);
+    view.height = std::max(1, view.height / PROBE_DIVISOR);
+    size_t pixels = size_t(view.width) * view.height;
+    probeIterations.resize(pixels);
+    probeOrbitX.resize(pixels);
+    probeOrbitY.resize(pixels);
+    if ( coloringEnabled )
+        probeSmooth.resize(pixels);
+
+    FractalBuffer buffer(view.width, view.height, 0, &probeIterations[0], coloringEnabled ? &probeSmooth[0] : 0,
+                         &probeOrbitX[0], &probeOrbitY[0]);
+    engine.Render(view, buffer, 0);
+
+    IterationHistogram histogram;
+    if ( histogramEnabled )
+        histogram.Collect(buffer, view.maxIterations);
+
+    // a single histogram does for the few probe pixels; the palette only
+    // changes when something escaped, and not while a frame uploads it
+    HistogramColoringStats coloringStats;
+    bool collected = coloringEnabled && coloring.Collect(buffer, view.maxIterations, 0, &coloringStats);
+
+    QMutexLocker locker(&resultMutex);
+    bool changed = collected && coloring.Equalize(coloringPaletteSize);
+    if ( changed )
+        lookupChanged = true;
+    lastIterationHistogram = histogram;
+    lastHistogramColoringStats = coloringStats;
+    return changed;
+}
+
+bool FractalRenderer::RenderOnCPU()
+{
+    MandelbrotView view;
+    bool openPyramid;
+    std::string pyramidPath;
+    std::vector<MandelbrotView> pyramidViews;
+    long long ticket;
+
+    {
+        // several start requests may be queued up by now, only the first one
+        // renders and it picks the latest view
+        QMutexLocker locker(&viewMutex);
+        if ( !viewDirty )
+            return false;
+        view = pendingView;
+        viewDirty = false;
+        ticket = pendingTicket;
+
+        openPyramid = pyramidPending;
+        pyramidPath.swap(pendingPyramidPath);
+        pyramidViews.swap(pendingPyramidViews);
+        pyramidPending = false;
+    }
+
+    if ( openPyramid )
+        OpenTilePyramid(pyramidPath, pyramidViews);
+
+    if ( view.width <= 0 || view.height <= 0 )
+        return false;
+
+    // every run of the frame, the ones of the perturbation renderer, the
+    // coloring and the antialiasing included, stops on a cancel of its view
+    ScopedTileJob job(scheduler, ticket);
+
+    // frames of the tile cache sit on its grid, less than half a pixel off;
+    // the result still carries the requested view so the widget takes it
+    const MandelbrotView requestedView = view;
+    if ( tileCache.Budget() > 0 )
+        view = TileCache::AlignView(view);
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+
+    workPixels.resize(size_t(view.width) * view.height * 4);
+
+    // past double precision only the perturbation renderer still resolves
+    // single pixels, it is also a lot slower so it only takes these views
+    bool deep = PerturbationRenderer::IsDeepView(view);
+    PerturbationStats deepStats;
+    SubdivisionStats subdivisionStats;
+    ReprojectionStats reprojectionStats;
+    TileCacheStats tileCacheStats;
+    KernelStats frameStats;
+    int lastPass = -1;
+    bool finished;
+
+    // the double precision paths keep their iterations for the next frame
+    const ReprojectionFrame& previous = frames[previousFrame];
+    ReprojectionFrame& current = frames[1 - previousFrame];
+    if ( !deep )
+        current.Reset(view);
+
+    bool deepIterationPlane = deep && (histogramEnabled || coloringEnabled);
+    if ( deepIterationPlane )
+        deepIterations.resize(size_t(view.width) * view.height);
+    if ( deep && coloringEnabled )
+        deepSmooth.resize(size_t(view.width) * view.height);
+
+    FractalBuffer buffer = deep ? FractalBuffer(view.width, view.height, &workPixels[0],
+                                                deepIterationPlane ? &deepIterations[0] : 0,
+                                                coloringEnabled ? &deepSmooth[0] : 0)
+                                : current.Buffer(&workPixels[0]);
+
+    // the histogram coloring recolors every pixel of a finished frame, the
+    // paths that write all of them fresh can leave the colors out; not the
+    // debug colors of the periodicity check
+    bool colorless = coloringEnabled && !showPeriodicityCheck;
+    FractalBuffer uncolored = buffer;
+    if ( colorless )
+        uncolored.rgba = 0;
+    bool recolorInterior = false;
+
+    // only the iteration limit went up: the escaped pixels stay as they
+    // are and the others go on from where they stopped
+    MandelbrotView raised = previous.view;
+    raised.maxIterations = view.maxIterations;
+    bool resume = !deep && previous.valid && raised == view &&
+                  view.maxIterations > previous.view.maxIterations;
+
+    // a zoom or a rotation keeps a few pixels here and there, not worth a
+    // frame without the progressive passes; coming back to a region the
+    // cache usually has more of it than the last frame
+    double reuse = !deep && !resume && reprojectionEnabled ? reprojection.EstimateReuse(view, previous) : 0.0;
+    double coverage = !deep && !resume && tileCache.Budget() > 0 ? tileCache.Coverage(view) : 0.0;
+    bool cached = coverage >= MIN_CACHED_FRACTION && coverage >= reuse;
+    bool reproject = !cached && reuse >= MIN_REPROJECTED_FRACTION;
+
+    if ( deep )
+    {
+        finished = perturbation.Render(view, uncolored, scheduler, &deepStats);
+        frameStats = deepStats.kernel;
+        recolorInterior = colorless;
+    }
+    else if ( resume )
+    {
+        std::vector<KernelStats> workerStats(scheduler->ThreadCount());
+
+        // the paths that do not keep the orbits start those pixels over
+        current.iterations = previous.iterations;
+        current.smooth = previous.smooth;
+        current.error = previous.error;
+        if ( previous.hasOrbits )
+        {
+            current.orbitX = previous.orbitX;
+            current.orbitY = previous.orbitY;
+        }
+        else
+        {
+            std::fill(current.orbitX.begin(), current.orbitX.end(), std::numeric_limits<double>::quiet_NaN());
+            std::fill(current.orbitY.begin(), current.orbitY.end(), std::numeric_limits<double>::quiet_NaN());
+        }
+
+        finished = scheduler->Run(view.width, view.height,
+            [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = uncolored.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                engine.ResumeRegion(view, previous.view.maxIterations, tile.x, tile.y, tile.width, tile.height,
+                                    tileBuffer, &workerStats[worker]);
+            });
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            frameStats.Add(workerStats[i]);
+        recolorInterior = colorless;
+    }
+    else if ( reproject )
+    {
+        std::vector<ReprojectionStats> workerStats(scheduler->ThreadCount());
+        const unsigned char* previousRgba = resultIsPreviousFrame ? &resultPixels[0] : 0;
+
+        // resultPixels is only written from this thread, the workers can
+        // read it while the widget holds the lock
+        finished = scheduler->Run(view.width, view.height,
+            [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                float* tileError = &current.error[size_t(tile.y) * view.width + tile.x];
+                reprojection.RenderRegion(view, previous, tile.x, tile.y, tile.width, tile.height,
+                                          tileBuffer, tileError, previousRgba, &workerStats[worker]);
+            });
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            reprojectionStats.Add(workerStats[i]);
+        frameStats = reprojectionStats.kernel;
+    }
+    else if ( cached )
+    {
+        std::vector<TileCacheStats> workerStats(scheduler->ThreadCount());
+
+        // the tiles follow the grid of the cache instead of the frame
+        finished = scheduler->Run(tileCache.Tiles(view),
+            [&](const RenderTile& tile, int worker)
+            {
+                tileCache.FillTile(engine, view, tile, buffer, &workerStats[worker]);
+            });
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            tileCacheStats.Add(workerStats[i]);
+        frameStats = tileCacheStats.kernel;
+    }
+    else if ( subdivisionEnabled )
+    {
+        std::vector<SubdivisionStats> workerStats(scheduler->ThreadCount());
+
+        // every tile is subdivided on its own, the tile border is the
+        // outermost rectangle
+        finished = scheduler->Run(view.width, view.height,
+            [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                subdivision.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+            });
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            subdivisionStats.Add(workerStats[i]);
+        frameStats = subdivisionStats.kernel;
+    }
+    else if ( progressiveEnabled )
+    {
+        // all passes run over the same tiles, the samples of a pass are
+        // still in workPixels for the next one; only the last pass is not
+        // shown before the recolor
+        finished = false;
+        for ( int pass = 0; pass < PROGRESSIVE_PASSES; pass ++)
+        {
+            std::vector<ProgressiveStats> workerStats(scheduler->ThreadCount());
+            const FractalBuffer& passBuffer = pass == PROGRESSIVE_PASSES - 1 ? uncolored : buffer;
+
+            finished = scheduler->Run(view.width, view.height,
+                [&](const RenderTile& tile, int worker)
+                {
+                    FractalBuffer tileBuffer = passBuffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                    progressive.RenderPass(view, pass, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+                });
+
+            for ( size_t i = 0; i < workerStats.size(); i ++)
+                frameStats.Add(workerStats[i].kernel);
+
+            lastPass = pass;
+            if ( !finished || pass == PROGRESSIVE_PASSES - 1 )
+            {
+                recolorInterior = colorless;
+                break;
+            }
+
+            // new input came in between two passes, the next frame takes over
+            if ( FrameOutdated(ticket) )
+            {
+                finished = false;
+                break;
+            }
+
+            PublishPass(requestedView, pass, frameTimer.elapsed() / 1000.0, frameStats);
+        }
+    }
+    else
+    {
+        std::vector<KernelStats> workerStats(scheduler->ThreadCount());
+
+        finished = scheduler->Run(view.width, view.height,
+            [&](const RenderTile& tile, int worker)
+            {
+                FractalBuffer tileBuffer = uncolored.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                engine.RenderRegion(view, tile.x, tile.y, tile.width, tile.height, tileBuffer, &workerStats[worker]);
+            });
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            frameStats.Add(workerStats[i]);
+        recolorInterior = colorless;
+    }
+
+    // interrupted by a new interaction, keep showing the previous frame
+    if ( !finished )
+        return false;
+
+    // the palette follows the escapes of the finished frame, before the
+    // antialiasing so that its samples get the same colors. Every worker
+    // counts into a histogram of its own, they are merged at the end
+    HistogramColoringStats coloringStats;
+    if ( coloringEnabled )
+    {
+        if ( !coloring.Collect(buffer, view.maxIterations, scheduler, &coloringStats) )
+            return false;
+        coloring.Equalize();
+        if ( !coloring.Recolor(buffer, view.maxIterations, recolorInterior, scheduler, &coloringStats) )
+            return false;
+    }
+
+    // antialiasing goes on from the finished frame, which is shown in the
+    // meantime; new input skips it like a progressive pass. The iteration
+    // planes keep the first sample of every pixel
+    SupersamplingStats supersamplingStats;
+    if ( supersamplingEnabled && !deep )
+    {
+        PublishPass(requestedView, lastPass, frameTimer.elapsed() / 1000.0, frameStats);
+        if ( FrameOutdated(ticket) || !supersampler.Refine(view, buffer, *scheduler, &supersamplingStats) )
+            return false;
+    }
+
+    {
+        QMutexLocker locker(&viewMutex);
+        renderedView = requestedView;
+        hasRenderedView = true;
+    }
+
+    // the reused pixels would have cost about what they cost in the last
+    // frame that computed all of its pixels
+    double savedSeconds = reproject ? reprojectionStats.SavedSeconds(secondsPerPixel) : 0.0;
+    if ( !reproject && !cached && !resume && frameStats.pixels > 0 )
+        secondsPerPixel = frameStats.seconds / double(frameStats.pixels);
+
+    if ( !deep )
+    {
+        // reprojected pixels that show a nearby point stay out of the cache
+        if ( tileCache.Budget() > 0 )
+            tileCache.StoreFrame(view, buffer, &current.error[0]);
+
+        // the engine and the progressive passes write the orbits, the
+        // other paths copy or fill pixels
+        current.valid = true;
+        current.hasOrbits = resume || (!reproject && !cached && !subdivisionEnabled);
+        previousFrame = 1 - previousFrame;
+    }
+    else
+    {
+        frames[previousFrame].valid = false;
+    }
+
+    // the orbit planes only tell the known interior pixels apart where the
+    // path wrote them
+    IterationHistogram histogram;
+    if ( histogramEnabled )
+    {
+        FractalBuffer planes = buffer;
+        if ( deep || !current.hasOrbits )
+            planes.orbitX = planes.orbitY = 0;
+        histogram.Collect(planes, view.maxIterations);
+    }
+
+    {
+        QMutexLocker locker(&resultMutex);
+        lastFrameSeconds = frameTimer.elapsed() / 1000.0;
+        lastUtilization = scheduler->LastUtilization();
+        lastKernelStats = frameStats;
+        lastFrameWasDeep = deep;
+        lastPerturbationStats = deepStats;
+        lastFrameWasSubdivided = !deep && !resume && !reproject && !cached && subdivisionEnabled;
+        lastSubdivisionStats = subdivisionStats;
+        lastProgressivePass = lastPass;
+        lastFrameWasReprojected = reproject;
+        lastReprojectionStats = reprojectionStats;
+        lastSavedSeconds = savedSeconds;
+        lastFrameWasCached = cached;
+        lastTileCacheStats = tileCacheStats;
+        lastTileCacheTotals.Add(tileCacheStats);
+        lastTileCacheBytes = tileCache.Bytes();
+        lastResumedIterations = resume ? previous.view.maxIterations : 0;
+        lastIterationHistogram = histogram;
+        lastSupersamplingStats = supersamplingStats;
+        lastHistogramColoringStats = coloringStats;
+
+        resultPixels.swap(workPixels);
+        resultIsPreviousFrame = !deep;
+        resultWidth = view.width;
+        resultHeight = view.height;
+        resultView = requestedView;
+    }
+
+    emit FinishedRendering();
+
+    return true;
+}
+
+void FractalRenderer::PublishPass(const MandelbrotView& view, int pass, double seconds, const KernelStats& frameStats)
+{
+    {
+        // workPixels goes on with the next pass, the widget gets a copy
+        QMutexLocker locker(&resultMutex);
+        lastFrameSeconds = seconds;
+        lastUtilization = scheduler->LastUtilization();
+        lastKernelStats = frameStats;
+        lastFrameWasDeep = false;
+        lastFrameWasSubdivided = false;
+        lastProgressivePass = pass;
+        lastFrameWasReprojected = false;
+        lastSavedSeconds = 0.0;
+        lastFrameWasCached = false;
+        lastResumedIterations = 0;
+
+        resultPixels = workPixels;
+        resultIsPreviousFrame = false;
+        resultWidth = view.width;
+        resultHeight = view.height;
+        resultView = view;
+    }
+
+    emit FinishedRendering();
+}
@@ -2,6 +2,23 @@
 #define FRACTALRENDERER_H
 
 #include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include <thread>
+#include <vector>
+
+#include "adaptivesampler.h"
+#include "histogramcoloring.h"
+#include "iterationlimit.h"
+#include "mandelbrotengine.h"
+#include "mandelbrotpalette.h"
+#include "perturbationrenderer.h"
+#include "progressiverenderer.h"
+#include "reprojectionrenderer.h"
+#include "subdivisionrenderer.h"
+#include "tilecache.h"
+#include "tilepyramid.h"
 
 QT_BEGIN_NAMESPACE
     class MandelGLWidget;
@@ -9,23 +26,258 @@ QT_BEGIN_NAMESPACE
     class QTimer;
 QT_END_NAMESPACE
 
+class TileScheduler;
+
 class FractalRenderer : public QObject
 {
     Q_OBJECT
 public:
-    FractalRenderer(MandelGLWidget *parent = 0);
+
+    enum RenderBackend
+    {
+        GPU_BACKEND = 0,    // mandelbrot shader on the shared gl context
+        CPU_BACKEND = 1     // fractcore engine on a work-stealing thread pool
+    };
+
+    FractalRenderer(MandelGLWidget *parent = 0, RenderBackend backend = GPU_BACKEND);
     ~FractalRenderer();
-    
+
+    RenderBackend Backend() const { return backend; }
+
+    // cpu backend settings, 0 threads means one per core
+    void SetThreadCount(int threadCount);
+    void SetTileSize(int tileSize);
+
+    // mariani-silver subdivision for the double precision views (cpu
+    // backend), off by default; the safeguard re-checks every filled
+    // rectangle for thin filaments
+    void SetSubdivision(bool enabled);
+    void SetSubdivisionSafeguard(bool enabled);
+
+    // coarse-to-fine passes for the double precision views (cpu backend),
+    // every pass is handed out through FinishedRendering(); ignored while
+    // subdivision is on
+    void SetProgressive(bool enabled);
+
+    // takes over the pixels of the last frame that are still valid after a
+    // pan, zoom or rotation (cpu backend), off by default; only used when
+    // enough of the frame can be taken over
+    void SetReprojection(bool enabled);
+
+    // adaptive antialiasing of the double precision views (cpu backend)
+    // with at most this many samples per pixel on average, 1 by default
+    // which turns it off; the frame is handed out once before it
+    void SetSupersampling(double samplesPerPixel);
+
+    // memory for the iteration tiles of earlier frames (cpu backend), 0 by
+    // default which turns the cache off; frames over a cached region are
+    // assembled from it
+    void SetTileCacheBudget(size_t bytes);
+
+    // file of precomputed tiles for the tile cache (cpu backend), opened
+    // before the next frame; the tiles of fillViews that are not in the
+    // file yet are rendered into it first. Safe to call from any thread
+    void SetTilePyramid(const std::string& path,
+                        const std::vector<MandelbrotView>& fillViews = std::vector<MandelbrotView>());
+
+    // escape histogram of every finished frame, off by default; the gpu
+    // backend renders the view at an eighth of its width and height on the
+    // cpu for it, on a thread of its own and not while the input goes on,
+    // see FinishedProbe()
+    void SetIterationHistogram(bool enabled);
+
+    // histogram equalized colors instead of the plain palette, off by
+    // default; set before the first frame. The cpu backend equalizes every
+    // finished frame (coarse passes keep the palette of the frame before),
+    // the gpu one the coarse cpu render of the iteration histogram and
+    // hands the next frame of the shader a lookup texture of at most
+    // paletteSize colors
+    void SetHistogramColoring(bool enabled, int paletteSize = HistogramColoring::PALETTE_SIZE);
+
+    // debug, magenta for the pixels the periodicity check stopped (cpu backend)
+    void SetShowPeriodicityCheck(bool enabled);
+
+    // view of the next frame (cpu backend), safe to call from any thread;
+    // returns false if that view is rendered already
+    bool SetView(const MandelbrotView& view);
+
+    // stop the frame in flight (cpu backend), safe to call from any thread
+    void CancelRendering();
+
+    // last finished cpu frame as RGBA rows, top row first, and the view it
+    // shows if asked for; the result stays valid until UnlockResult()
+    const unsigned char* LockResult(int& width, int& height, MandelbrotView* view = 0);
+    void UnlockResult();
+
+    // statistics of the last finished cpu frame, updated together with the result
+    int ThreadCount() const;
+    double LastFrameSeconds() const { return lastFrameSeconds; }
+    double LastUtilization() const { return lastUtilization; }
+    KernelStats LastKernelStats() const { return lastKernelStats; }
+
+    // reference orbits of the last frame, only set for deep zoom frames
+    bool LastFrameWasDeep() const { return lastFrameWasDeep; }
+    PerturbationStats LastPerturbationStats() const { return lastPerturbationStats; }
+
+    // pixels filled instead of iterated, only set for subdivided frames
+    bool LastFrameWasSubdivided() const { return lastFrameWasSubdivided; }
+    SubdivisionStats LastSubdivisionStats() const { return lastSubdivisionStats; }
+
+    // pass of the last finished frame, -1 if it was not rendered progressively
+    int LastProgressivePass() const { return lastProgressivePass; }
+
+    // pixels taken over from the frame before, only set for reprojected
+    // frames; the saved time is kernel time summed over the workers
+    bool LastFrameWasReprojected() const { return lastFrameWasReprojected; }
+    ReprojectionStats LastReprojectionStats() const { return lastReprojectionStats; }
+    double LastSavedSeconds() const { return lastSavedSeconds; }
+
+    // tiles of the last frame found in the cache and rendered, only set if
+    // it was assembled from the cache; the totals count all such frames
+    bool LastFrameWasCached() const { return lastFrameWasCached; }
+    TileCacheStats LastTileCacheStats() const { return lastTileCacheStats; }
+    TileCacheStats TileCacheTotals() const { return lastTileCacheTotals; }
+    size_t TileCacheBytes() const { return lastTileCacheBytes; }
+
+    // iteration limit the last frame went on from, 0 if it was not resumed;
+    // a frame of the same view with only a higher limit resumes the one
+    // before (cpu backend)
+    int LastResumedIterations() const { return lastResumedIterations; }
+
+    // escapes of the last finished frame, empty unless SetIterationHistogram()
+    // is on; not updated by the coarse passes. The gpu backend has the one
+    // of its last finished probe, a frame or more behind
+    IterationHistogram LastIterationHistogram() const { return lastIterationHistogram; }
+
+    // samples of the last antialiased frame, pixels is 0 if it was not
+    SupersamplingStats LastSupersamplingStats() const { return lastSupersamplingStats; }
+
+    // counting and recoloring of the last frame, pixels is 0 unless
+    // SetHistogramColoring() is on; the gpu backend only counts its probe
+    HistogramColoringStats LastHistogramColoringStats() const { return lastHistogramColoringStats; }
+
 signals:
     void FinishedRendering();
-    
+
+    // gpu backend, the probe of a view is done, from the probe thread;
+    // lookupChanged if the next frame gets another palette
+    void FinishedProbe(bool lookupChanged);
+
 public slots:
     bool StartRendering();
 
 private:
+    bool RenderOnGPU();
+    bool RenderOnCPU();
+
+    // a new view or a cancel of the ticket came in since the frame in
+    // flight was started
+    bool FrameOutdated(long long ticket);
+
+    // fills and opens the pending tile pyramid
+    void OpenTilePyramid(const std::string& path, const std::vector<MandelbrotView>& fillViews);
+
+    // hands the view to the probe thread unless it has it already, the
+    // thread starts with the first one
+    void RequestProbe(const MandelbrotView& view);
+    void ProbeLoop();
+
+    // escape histogram and equalized palette of a gpu frame from a coarse
+    // cpu render of its view; true if the palette changed
+    bool ProbeIterations(const MandelbrotView& view);
+
+    // hands out a copy of a pass that is not the last one
+    void PublishPass(const MandelbrotView& view, int pass, double seconds, const KernelStats& frameStats);
+
     MandelGLWidget *glWidget;
     QGLWidget *sharedWidget;
-    
+
+    RenderBackend backend;
+
+    // cpu backend
+    MandelbrotEngine engine;
+    PerturbationRenderer perturbation;  // views beyond double precision
+    SubdivisionRenderer subdivision;    // skips uniform rectangles
+    bool subdivisionEnabled;
+    ProgressiveRenderer progressive;    // coarse passes first
+    bool progressiveEnabled;
+    ReprojectionRenderer reprojection;  // reuses the last frame
+    bool reprojectionEnabled;
+    AdaptiveSupersampler supersampler;  // more samples on the edges
+    bool supersamplingEnabled;
+    TileCache tileCache;                // tiles of earlier frames
+    TilePyramid tilePyramid;            // precomputed tiles behind the cache
+    MandelbrotPalette palette;
+    HistogramColoring coloring;         // equalized palette, the engines use it while it is on
+    bool coloringEnabled;
+    int coloringPaletteSize;
+    bool lookupChanged;                 // gpu backend, the lookup texture is behind the palette, under resultMutex
+    bool showPeriodicityCheck;
+    TileScheduler* scheduler;
+
+    // escape histograms, deep frames and the gpu probe have no iteration
+    // planes of their own
+    bool histogramEnabled;
+    std::vector<int> deepIterations;
+    std::vector<float> deepSmooth;
+    std::vector<int> probeIterations;
+    std::vector<float> probeSmooth;
+    std::vector<double> probeOrbitX;
+    std::vector<double> probeOrbitY;
+
+    // gpu backend, the probe thread renders the latest view handed to it
+    std::thread probeThread;
+    QMutex probeMutex;
+    QWaitCondition probeCondition;
+    MandelbrotView probeView;
+    bool hasProbeView;
+    bool probeRequested;
+    bool probeQuit;
+
+    QMutex viewMutex;
+    MandelbrotView pendingView;
+    MandelbrotView renderedView;
+    bool viewDirty;
+    bool hasRenderedView;
+    long long pendingTicket;            // TileScheduler ticket of pendingView
+    bool pyramidPending;
+    std::string pendingPyramidPath;
+    std::vector<MandelbrotView> pendingPyramidViews;
+
+    QMutex resultMutex;
+    std::vector<unsigned char> workPixels;
+    std::vector<unsigned char> resultPixels;
+    int resultWidth;
+    int resultHeight;
+    MandelbrotView resultView;
+
+    // iteration planes of the last finished frame and the one in flight,
+    // resultPixels holds the colors of the former unless a pass or a deep
+    // frame came out since
+    ReprojectionFrame frames[2];
+    int previousFrame;
+    bool resultIsPreviousFrame;
+    double secondsPerPixel;             // kernel time per pixel of the last frame that was not reprojected
+
+    double lastFrameSeconds;
+    double lastUtilization;
+    KernelStats lastKernelStats;
+    bool lastFrameWasDeep;
+    PerturbationStats lastPerturbationStats;
+    bool lastFrameWasSubdivided;
+    SubdivisionStats lastSubdivisionStats;
+    int lastProgressivePass;
+    bool lastFrameWasReprojected;
+    ReprojectionStats lastReprojectionStats;
+    double lastSavedSeconds;
+    bool lastFrameWasCached;
+    TileCacheStats lastTileCacheStats;
+    TileCacheStats lastTileCacheTotals;
+    size_t lastTileCacheBytes;
+    int lastResumedIterations;
+    IterationHistogram lastIterationHistogram;
+    SupersamplingStats lastSupersamplingStats;
+    HistogramColoringStats lastHistogramColoringStats;
 };
 
 #endif // FRACTALRENDERER_H
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adaptivesampler.h"
+#include "perturbationrenderer.h"
+#include "tilescheduler.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+// a pixel that takes extra samples, the sums run over all of its samples
+struct SamplePixel
+{
+    int index;              // y * width + x
+    int samples;
+    float priority;         // contrast to the neighbours, later the standard error
+    float sum[3];
+    float sumSquares[3];
+};
+
+bool ByPriority(const SamplePixel& a, const SamplePixel& b)
+{
+    return a.priority > b.priority;
+}
+
+// largest difference of a color channel
+int Contrast(const unsigned char* a, const unsigned char* b)
+{
+    return std::max(std::max(abs(a[0] - b[0]), abs(a[1] - b[1])), abs(a[2] - b[2]));
+}
+
+// cell of the 4x4 grid for sample quarter of a round, one per quarter of the
+// pixel and every cell once over MAX_EXTRA_SAMPLES / SAMPLES_PER_ROUND rounds
+void SamplePosition(int round, int quarter, double& offsetX, double& offsetY)
+{
+    int cellX = 2 * (quarter & 1) + ((round & 1) ^ (quarter >> 1));
+    int cellY = 2 * (quarter >> 1) + ((round >> 1) ^ (quarter & 1));
+    offsetX = (cellX + 0.5) / 4.0;
+    offsetY = (cellY + 0.5) / 4.0;
+}
+
+void AddSample(SamplePixel& pixel, const unsigned char* rgba)
+{
+    for ( int c = 0; c < 3; c ++)
+    {
+        pixel.sum[c] += rgba[c];
+        pixel.sumSquares[c] += float(rgba[c]) * float(rgba[c]);
+    }
+    pixel.samples ++;
+}
+
+// of the mean color, the largest of the channels
+float StandardError(const SamplePixel& pixel)
+{
+    float n = float(pixel.samples);
+    float largest = 0.0f;
+    for ( int c = 0; c < 3; c ++)
+    {
+        float mean = pixel.sum[c] / n;
+        float variance = std::max(pixel.sumSquares[c] / n - mean * mean, 0.0f) * n / (n - 1.0f);
+        largest = std::max(largest, variance / n);
+    }
+    return sqrtf(largest);
+}
+
+void WriteMean(const SamplePixel& pixel, unsigned char* rgba)
+{
+    for ( int c = 0; c < 3; c ++)
+        rgba[c] = (unsigned char)(pixel.sum[c] / float(pixel.samples) + 0.5f);
+}
+
+} // namespace
+
+SupersamplingStats::SupersamplingStats()
+{
+    pixels = 0;
+    refinedPixels = 0;
+    samples = 0;
+    convergedPixels = 0;
+    budgetPixels = 0;
+    rounds = 0;
+}
+
+void SupersamplingStats::Add(const SupersamplingStats& other)
+{
+    pixels += other.pixels;
+    refinedPixels += other.refinedPixels;
+    samples += other.samples;
+    convergedPixels += other.convergedPixels;
+    budgetPixels += other.budgetPixels;
+    rounds = std::max(rounds, other.rounds);
+    kernel.Add(other.kernel);
+}
+
+AdaptiveSupersampler::AdaptiveSupersampler()
+{
+    engine = 0;
+    threshold = 16;
+    tolerance = 3.0f;
+    sampleBudget = 4.0;
+}
+
+void AdaptiveSupersampler::SetEngine(const MandelbrotEngine* engine)
+{
+    this->engine = engine;
+}
+
+void AdaptiveSupersampler::SetThreshold(int threshold)
+{
+    this->threshold = std::max(threshold, 0);
+}
+
+void AdaptiveSupersampler::SetTolerance(float tolerance)
+{
+    this->tolerance = std::max(tolerance, 0.0f);
+}
+
+void AdaptiveSupersampler::SetSampleBudget(double samplesPerPixel)
+{
+    sampleBudget = std::max(samplesPerPixel, 1.0);
+}
+
+bool AdaptiveSupersampler::Refine(const MandelbrotView& view, FractalBuffer& buffer, TileScheduler& scheduler,
+                                  SupersamplingStats* stats) const
+{
+    const int width = view.width;
+    const int height = view.height;
+
+    SupersamplingStats frameStats;
+    frameStats.pixels = (long long)(width) * height;
+    frameStats.samples = frameStats.pixels;
+
+    if ( engine == 0 || PerturbationRenderer::IsDeepView(view) )
+    {
+        if ( stats )
+            stats->Add(frameStats);
+        return true;
+    }
+
+    // contrast of every pixel to its neighbours, before any color changes
+    std::vector<unsigned char> contrast(size_t(width) * height);
+    bool finished = scheduler.Run(width, height,
+        [&](const RenderTile& tile, int)
+        {
+            for ( int y = tile.y; y < tile.y + tile.height; y ++)
+            {
+                for ( int x = tile.x; x < tile.x + tile.width; x ++)
+                {
+                    const unsigned char* center = buffer.rgba + (size_t(y) * buffer.stride + x) * 4;
+                    size_t row = size_t(buffer.stride) * 4;
+                    int value = 0;
+                    if ( x > 0 )
+                        value = std::max(value, Contrast(center, center - 4));
+                    if ( x + 1 < width )
+                        value = std::max(value, Contrast(center, center + 4));
+                    if ( y > 0 )
+                        value = std::max(value, Contrast(center, center - row));
+                    if ( y + 1 < height )
+                        value = std::max(value, Contrast(center, center + row));
+                    contrast[size_t(y) * width + x] = (unsigned char)(value);
+                }
+            }
+        });
+    if ( !finished )
+        return false;
+
+    std::vector<SamplePixel> active;
+    for ( int y = 0; y < height; y ++)
+    {
+        for ( int x = 0; x < width; x ++)
+        {
+            int index = y * width + x;
+            if ( contrast[index] <= threshold )
+                continue;
+
+            SamplePixel pixel;
+            pixel.index = index;
+            pixel.samples = 0;
+            pixel.priority = contrast[index];
+            pixel.sum[0] = pixel.sum[1] = pixel.sum[2] = 0.0f;
+            pixel.sumSquares[0] = pixel.sumSquares[1] = pixel.sumSquares[2] = 0.0f;
+            AddSample(pixel, buffer.rgba + (size_t(y) * buffer.stride + x) * 4);
+            active.push_back(pixel);
+        }
+    }
+    frameStats.refinedPixels = (long long)(active.size());
+
+    long long budget = (long long)(sampleBudget * double(frameStats.pixels)) - frameStats.pixels;
+    std::vector<KernelStats> workerStats(scheduler.ThreadCount());
+
+    for ( int round = 0; round * SAMPLES_PER_ROUND < MAX_EXTRA_SAMPLES && !active.empty(); round ++)
+    {
+        // what is left of the budget goes to the pixels that need it most,
+        // the others keep the samples they have
+        size_t affordable = size_t(std::max(budget, 0LL) / SAMPLES_PER_ROUND);
+        if ( active.size() > affordable )
+        {
+            std::nth_element(active.begin(), active.begin() + affordable, active.end(), ByPriority);
+            for ( size_t i = affordable; i < active.size(); i ++)
+            {
+                const SamplePixel& pixel = active[i];
+                WriteMean(pixel, buffer.rgba + (size_t(pixel.index / width) * buffer.stride + pixel.index % width) * 4);
+            }
+            frameStats.budgetPixels += (long long)(active.size() - affordable);
+            active.resize(affordable);
+            if ( active.empty() )
+                break;
+        }
+        budget -= (long long)(active.size()) * SAMPLES_PER_ROUND;
+
+        // the active pixels as a one row frame
+        finished = scheduler.Run(int(active.size()), 1,
+            [&](const RenderTile& tile, int worker)
+            {
+                int count = tile.width * SAMPLES_PER_ROUND;
+                std::vector<double> sx(count), sy(count);
+                std::vector<int> iterations(count);
+                std::vector<float> smooth(count);
+
+                for ( int i = 0; i < tile.width; i ++)
+                {
+                    const SamplePixel& pixel = active[tile.x + i];
+                    for ( int q = 0; q < SAMPLES_PER_ROUND; q ++)
+                    {
+                        double offsetX, offsetY;
+                        SamplePosition(round, q, offsetX, offsetY);
+                        sx[i * SAMPLES_PER_ROUND + q] = pixel.index % width + offsetX;
+                        sy[i * SAMPLES_PER_ROUND + q] = pixel.index / width + offsetY;
+                    }
+                }
+
+                engine->RenderSamples(view, &sx[0], &sy[0], count, &iterations[0], &smooth[0], &workerStats[worker]);
+
+                for ( int i = 0; i < count; i ++)
+                {
+                    unsigned char color[4];
+                    engine->Colorize(smooth[i], view.maxIterations, color);
+                    AddSample(active[tile.x + i / SAMPLES_PER_ROUND], color);
+                }
+            });
+        if ( !finished )
+            return false;
+
+        frameStats.rounds ++;
+        frameStats.samples += (long long)(active.size()) * SAMPLES_PER_ROUND;
+
+        // pixels whose mean settled or that used up the grid are done
+        size_t kept = 0;
+        for ( size_t i = 0; i < active.size(); i ++)
+        {
+            SamplePixel& pixel = active[i];
+            float error = StandardError(pixel);
+            if ( error < tolerance || pixel.samples > MAX_EXTRA_SAMPLES )
+            {
+                WriteMean(pixel, buffer.rgba + (size_t(pixel.index / width) * buffer.stride + pixel.index % width) * 4);
+                frameStats.convergedPixels += error < tolerance ? 1 : 0;
+            }
+            else
+            {
+                pixel.priority = error;
+                active[kept ++] = pixel;
+            }
+        }
+        active.resize(kept);
+    }
+
+    for ( size_t i = 0; i < workerStats.size(); i ++)
+        frameStats.kernel.Add(workerStats[i]);
+
+    if ( stats )
+        stats->Add(frameStats);
+
+    return true;
+}
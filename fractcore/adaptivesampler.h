@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ADAPTIVESAMPLER_H
+#define ADAPTIVESAMPLER_H
+
+#include "mandelbrotengine.h"
+
+class TileScheduler;
+
+// counters of the adaptive supersampler
+struct SupersamplingStats
+{
+    SupersamplingStats();
+
+    void Add(const SupersamplingStats& other);
+
+    long long pixels;           // pixels of the frame
+    long long refinedPixels;    // pixels that got more than their first sample
+    long long samples;          // all samples, the first one of every pixel included
+    long long convergedPixels;  // refined pixels that settled before the sample limit
+    long long budgetPixels;     // refined pixels the frame budget stopped
+    int rounds;                 // rounds of extra samples
+    KernelStats kernel;         // the extra samples
+
+    double SamplesPerPixel() const { return pixels > 0 ? double(samples) / double(pixels) : 0.0; }
+    double RefinedFraction() const { return pixels > 0 ? double(refinedPixels) / double(pixels) : 0.0; }
+};
+
+// antialiasing where the frame needs it, on top of MandelbrotEngine
+//
+// the frame is rendered with one sample per pixel first. Pixels whose
+// color differs from one of their 4 neighbours by more than the threshold
+// get SAMPLES_PER_ROUND more samples per round, one in every quarter of
+// the pixel on a 4x4 grid, and their color becomes the mean of all
+// samples. A pixel stops once the standard error of that mean is below
+// the tolerance or the grid is used up; a filament gets all 17 samples,
+// the first one and one in every cell of the grid, the smooth parts of
+// the escape bands and the interior only their first.
+//
+// the extra samples of a frame are limited by the sample budget, the
+// pixels with the most contrast (later the most variance) get them first.
+// Only the colors change, the iteration planes keep the first sample
+//
+// like MandelbrotEngine the sampler is immutable while refining
+class AdaptiveSupersampler
+{
+public:
+    static const int SAMPLES_PER_ROUND = 4;
+    static const int MAX_EXTRA_SAMPLES = 16;
+
+    AdaptiveSupersampler();
+
+    // engine that evaluates the samples, also used for the colors
+    void SetEngine(const MandelbrotEngine* engine);
+
+    // largest difference of a color channel (0..255) to a neighbour that
+    // leaves a pixel alone
+    void SetThreshold(int threshold);
+    int Threshold() const { return threshold; }
+
+    // standard error of the mean color (0..255) a pixel stops at
+    void SetTolerance(float tolerance);
+    float Tolerance() const { return tolerance; }
+
+    // mean samples per pixel a frame may take, the first one included
+    void SetSampleBudget(double samplesPerPixel);
+    double SampleBudget() const { return sampleBudget; }
+
+    // refines the colors of a frame the engine rendered for view, the
+    // samples are spread over the scheduler; false if it was cancelled,
+    // the colors are partly refined then. Views past double precision are
+    // left alone
+    bool Refine(const MandelbrotView& view, FractalBuffer& buffer, TileScheduler& scheduler,
+                SupersamplingStats* stats = 0) const;
+
+private:
+    const MandelbrotEngine* engine;
+    int threshold;
+    float tolerance;
+    double sampleBudget;
+};
+
+#endif // ADAPTIVESAMPLER_H
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bigfloat.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+BigFloat::BigFloat()
+{
+    negative = false;
+    limbs.assign(LimbsForBits(DEFAULT_FRACTION_BITS), 0);
+}
+
+BigFloat::BigFloat(double value, int fractionBits)
+{
+    negative = value < 0.0;
+    limbs.assign(LimbsForBits(fractionBits), 0);
+
+    double magnitude = fabs(value);
+
+    // integer part, saturates outside of the supported range
+    double integer = floor(magnitude);
+    if ( integer >= 4294967295.0 )
+        integer = 4294967295.0;
+    limbs[0] = uint32_t(integer);
+
+    // peel off 32 bits at a time, exact since a double has 53 bits
+    double fraction = magnitude - floor(magnitude);
+    for ( size_t i = 1; i < limbs.size() && fraction > 0.0; i ++)
+    {
+        fraction *= 4294967296.0;
+        double digit = floor(fraction);
+        limbs[i] = uint32_t(digit);
+        fraction -= digit;
+    }
+
+    if ( IsZero() )
+        negative = false;
+}
+
+int BigFloat::LimbsForBits(int fractionBits)
+{
+    if ( fractionBits < 32 )
+        fractionBits = 32;
+    return 1 + (fractionBits + 31) / 32;
+}
+
+int BigFloat::BitsForPixelSize(double pixelSize)
+{
+    if ( !(pixelSize > 0.0) )
+        return DEFAULT_FRACTION_BITS;
+
+    int bits = int(ceil(-log(pixelSize) / log(2.0))) + 64;
+    return bits < DEFAULT_FRACTION_BITS ? DEFAULT_FRACTION_BITS : bits;
+}
+
+void BigFloat::SetFractionBits(int fractionBits)
+{
+    limbs.resize(LimbsForBits(fractionBits), 0);
+
+    if ( IsZero() )
+        negative = false;
+}
+
+bool BigFloat::IsZero() const
+{
+    for ( size_t i = 0; i < limbs.size(); i ++)
+    {
+        if ( limbs[i] != 0 )
+            return false;
+    }
+    return true;
+}
+
+double BigFloat::ToDouble() const
+{
+    // the first three limbs carry more than the 53 bits of a double
+    double value = 0.0;
+    double weight = 1.0;
+    for ( size_t i = 0; i < limbs.size() && i < 4; i ++)
+    {
+        value += double(limbs[i]) * weight;
+        weight /= 4294967296.0;
+    }
+
+    // tiny numbers, find the first non-zero limb
+    if ( value == 0.0 )
+    {
+        weight = 1.0;
+        for ( size_t i = 0; i < limbs.size(); i ++, weight /= 4294967296.0)
+        {
+            if ( limbs[i] == 0 )
+                continue;
+
+            for ( size_t j = i; j < limbs.size() && j < i + 3; j ++)
+            {
+                value += double(limbs[j]) * weight;
+                weight /= 4294967296.0;
+            }
+            break;
+        }
+    }
+
+    return negative ? -value : value;
+}
+
+int BigFloat::CompareMagnitude(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    size_t count = a.size() > b.size() ? a.size() : b.size();
+    for ( size_t i = 0; i < count; i ++)
+    {
+        uint32_t x = i < a.size() ? a[i] : 0;
+        uint32_t y = i < b.size() ? b[i] : 0;
+        if ( x != y )
+            return x < y ? -1 : 1;
+    }
+    return 0;
+}
+
+// a += b, a is at least as long as b
+void BigFloat::AddMagnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    uint64_t carry = 0;
+    for ( size_t i = a.size(); i > 0; i --)
+    {
+        uint64_t sum = uint64_t(a[i - 1]) + (i - 1 < b.size() ? b[i - 1] : 0) + carry;
+        a[i - 1] = uint32_t(sum);
+        carry = sum >> 32;
+    }
+}
+
+// a -= b, |a| >= |b| and a is at least as long as b
+void BigFloat::SubMagnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b)
+{
+    int64_t borrow = 0;
+    for ( size_t i = a.size(); i > 0; i --)
+    {
+        int64_t diff = int64_t(a[i - 1]) - (i - 1 < b.size() ? b[i - 1] : 0) - borrow;
+        borrow = diff < 0 ? 1 : 0;
+        a[i - 1] = uint32_t(diff + (borrow << 32));
+    }
+}
+
+BigFloat BigFloat::operator-() const
+{
+    BigFloat result(*this);
+    if ( !result.IsZero() )
+        result.negative = !negative;
+    return result;
+}
+
+BigFloat& BigFloat::operator+=(const BigFloat& other)
+{
+    if ( other.limbs.size() > limbs.size() )
+        limbs.resize(other.limbs.size(), 0);
+
+    if ( negative == other.negative )
+    {
+        AddMagnitude(limbs, other.limbs);
+    }
+    else if ( CompareMagnitude(limbs, other.limbs) >= 0 )
+    {
+        SubMagnitude(limbs, other.limbs);
+    }
+    else
+    {
+        std::vector<uint32_t> result(other.limbs);
+        result.resize(limbs.size(), 0);
+        SubMagnitude(result, limbs);
+        limbs.swap(result);
+        negative = other.negative;
+    }
+
+    if ( IsZero() )
+        negative = false;
+
+    return *this;
+}
+
+BigFloat& BigFloat::operator-=(const BigFloat& other)
+{
+    return *this += -other;
+}
+
+BigFloat& BigFloat::operator*=(const BigFloat& other)
+{
+    *this = *this * other;
+    return *this;
+}
+
+BigFloat BigFloat::operator+(const BigFloat& other) const
+{
+    BigFloat result(*this);
+    result += other;
+    return result;
+}
+
+BigFloat BigFloat::operator-(const BigFloat& other) const
+{
+    BigFloat result(*this);
+    result -= other;
+    return result;
+}
+
+BigFloat BigFloat::operator*(const BigFloat& other) const
+{
+    const size_t count = limbs.size() > other.limbs.size() ? limbs.size() : other.limbs.size();
+    const size_t na = limbs.size();
+    const size_t nb = other.limbs.size();
+
+    // full product, limb k of the product has weight 2^(-32 * k) just like
+    // the operands since both have the integer limb first
+    std::vector<uint64_t> product(na + nb, 0);
+    for ( size_t i = 0; i < na; i ++)
+    {
+        if ( limbs[i] == 0 )
+            continue;
+
+        uint64_t carry = 0;
+        for ( size_t j = nb; j > 0; j --)
+        {
+            uint64_t cur = product[i + j - 1] + uint64_t(limbs[i]) * other.limbs[j - 1] + carry;
+            product[i + j - 1] = cur & 0xffffffffu;
+            carry = cur >> 32;
+        }
+
+        // ripple the carry into the more significant limbs
+        for ( size_t k = i; carry != 0; k --)
+        {
+            if ( k == 0 )
+                break;
+            uint64_t cur = product[k - 1] + carry;
+            product[k - 1] = cur & 0xffffffffu;
+            carry = cur >> 32;
+        }
+    }
+
+    BigFloat result;
+    result.negative = negative != other.negative;
+    result.limbs.assign(count, 0);
+    for ( size_t i = 0; i < count; i ++)
+        result.limbs[i] = uint32_t(product[i]);
+
+    if ( result.IsZero() )
+        result.negative = false;
+
+    return result;
+}
+
+BigFloat BigFloat::Doubled() const
+{
+    BigFloat result(*this);
+    result += *this;
+    return result;
+}
+
+bool BigFloat::operator==(const BigFloat& other) const
+{
+    if ( negative != other.negative )
+        return false;
+    return CompareMagnitude(limbs, other.limbs) == 0;
+}
+
+void BigFloat::DivideSmall(uint32_t divisor)
+{
+    uint64_t remainder = 0;
+    for ( size_t i = 0; i < limbs.size(); i ++)
+    {
+        uint64_t cur = (remainder << 32) | limbs[i];
+        limbs[i] = uint32_t(cur / divisor);
+        remainder = cur % divisor;
+    }
+}
+
+uint32_t BigFloat::MultiplySmall(uint32_t factor)
+{
+    uint64_t carry = 0;
+    for ( size_t i = limbs.size(); i > 0; i --)
+    {
+        uint64_t cur = uint64_t(limbs[i - 1]) * factor + carry;
+        limbs[i - 1] = uint32_t(cur);
+        carry = cur >> 32;
+    }
+    return uint32_t(carry);
+}
+
+bool BigFloat::FromString(const std::string& text, int fractionBits, BigFloat& value)
+{
+    size_t pos = 0;
+    bool isNegative = false;
+
+    if ( pos < text.size() && (text[pos] == '-' || text[pos] == '+') )
+    {
+        isNegative = text[pos] == '-';
+        pos ++;
+    }
+
+    std::string integerDigits;
+    std::string fractionDigits;
+
+    while ( pos < text.size() && text[pos] >= '0' && text[pos] <= '9' )
+        integerDigits += text[pos ++];
+
+    if ( pos < text.size() && text[pos] == '.' )
+    {
+        pos ++;
+        while ( pos < text.size() && text[pos] >= '0' && text[pos] <= '9' )
+            fractionDigits += text[pos ++];
+    }
+
+    if ( integerDigits.empty() && fractionDigits.empty() )
+        return false;
+
+    int exponent = 0;
+    if ( pos < text.size() && (text[pos] == 'e' || text[pos] == 'E') )
+    {
+        pos ++;
+        char* end = 0;
+        exponent = int(strtol(text.c_str() + pos, &end, 10));
+        pos = size_t(end - text.c_str());
+    }
+
+    if ( pos != text.size() )
+        return false;
+
+    // move the decimal point so the exponent is gone, the fixed point
+    // format has no room for anything beyond 2^32 anyway
+    while ( exponent > 0 )
+    {
+        if ( !fractionDigits.empty() )
+        {
+            integerDigits += fractionDigits[0];
+            fractionDigits.erase(0, 1);
+        }
+        else
+        {
+            integerDigits += '0';
+        }
+        exponent --;
+    }
+    while ( exponent < 0 )
+    {
+        fractionDigits.insert(fractionDigits.begin(), integerDigits.empty() ? '0' : integerDigits[integerDigits.size() - 1]);
+        if ( !integerDigits.empty() )
+            integerDigits.erase(integerDigits.size() - 1);
+        exponent ++;
+    }
+
+    BigFloat result(0.0, fractionBits);
+
+    // fraction, Horner from the last digit: f = (f + d) / 10, with a few
+    // guard limbs so the divisions do not lose the last bits
+    BigFloat fraction(0.0, fractionBits + 64);
+    for ( size_t i = fractionDigits.size(); i > 0; i --)
+    {
+        fraction.limbs[0] += uint32_t(fractionDigits[i - 1] - '0');
+        fraction.DivideSmall(10);
+    }
+    fraction.SetFractionBits(fractionBits);
+
+    uint64_t integer = 0;
+    for ( size_t i = 0; i < integerDigits.size(); i ++)
+    {
+        integer = integer * 10 + uint64_t(integerDigits[i] - '0');
+        if ( integer > 0xffffffffu )
+            integer = 0xffffffffu;
+    }
+
+    result.limbs = fraction.limbs;
+    result.limbs[0] = uint32_t(integer);
+    result.negative = isNegative && !result.IsZero();
+
+    value = result;
+    return true;
+}
+
+std::string BigFloat::ToString(int digits) const
+{
+    std::string text;
+    if ( negative )
+        text += '-';
+
+    char integerText[16];
+    unsigned int integer = limbs[0];
+    int length = 0;
+    do
+    {
+        integerText[length ++] = char('0' + integer % 10);
+        integer /= 10;
+    }
+    while ( integer > 0 );
+
+    while ( length > 0 )
+        text += integerText[-- length];
+
+    if ( digits <= 0 )
+        return text;
+
+    text += '.';
+
+    BigFloat fraction(*this);
+    fraction.limbs[0] = 0;
+    for ( int i = 0; i < digits; i ++)
+    {
+        fraction.limbs[0] = 0;
+        text += char('0' + fraction.MultiplySmall(10) + fraction.limbs[0]);
+    }
+
+    return text;
+}
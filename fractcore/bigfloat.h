@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BIGFLOAT_H
+#define BIGFLOAT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// arbitrary precision fixed point number for deep zoom coordinates
+//
+// everything the mandelbrot set needs stays well inside |x| < 2^31, so the
+// value is kept as a sign, one 32 bit integer limb and as many 32 bit
+// fraction limbs as the zoom level asks for. The result of an operation
+// gets the precision of the more precise operand, extra bits are truncated.
+class BigFloat
+{
+public:
+    BigFloat();
+    explicit BigFloat(double value, int fractionBits = DEFAULT_FRACTION_BITS);
+
+    static const int DEFAULT_FRACTION_BITS = 64;
+
+    // fraction bits needed to resolve a pixel of the given size, with
+    // enough guard bits left for the reference orbit
+    static int BitsForPixelSize(double pixelSize);
+
+    // parses decimal text like "-0.743643887037158704752191506114774"
+    // or "1.5e-20", returns false if the text is not a number
+    static bool FromString(const std::string& text, int fractionBits, BigFloat& value);
+
+    // decimal text with the given number of fraction digits (truncated)
+    std::string ToString(int digits) const;
+
+    double ToDouble() const;
+
+    int FractionBits() const { return int(limbs.size() - 1) * 32; }
+
+    // changes the precision, rounds towards zero when narrowing
+    void SetFractionBits(int fractionBits);
+
+    bool IsZero() const;
+    bool IsNegative() const { return negative; }
+
+    BigFloat operator-() const;
+    BigFloat operator+(const BigFloat& other) const;
+    BigFloat operator-(const BigFloat& other) const;
+    BigFloat operator*(const BigFloat& other) const;
+
+    BigFloat& operator+=(const BigFloat& other);
+    BigFloat& operator-=(const BigFloat& other);
+    BigFloat& operator*=(const BigFloat& other);
+
+    // multiply by two, exact
+    BigFloat Doubled() const;
+
+    bool operator==(const BigFloat& other) const;
+    bool operator!=(const BigFloat& other) const { return !(*this == other); }
+
+private:
+    static int LimbsForBits(int fractionBits);
+
+    // magnitude helpers, limbs[0] is the integer part
+    static int CompareMagnitude(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+    static void AddMagnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+    static void SubMagnitude(std::vector<uint32_t>& a, const std::vector<uint32_t>& b);
+
+    void DivideSmall(uint32_t divisor);
+    uint32_t MultiplySmall(uint32_t factor);
+
+    bool negative;
+    std::vector<uint32_t> limbs;
+};
+
+#endif // BIGFLOAT_H
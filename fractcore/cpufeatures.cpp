@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cpufeatures.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(FRACT_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(FRACT_X86)
+
+static void CpuId(unsigned int leaf, unsigned int subLeaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, int(leaf), int(subLeaf));
+    for ( int i = 0; i < 4; i ++)
+        regs[i] = (unsigned int)(info[i]);
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// register state the os saves on context switches (XCR0)
+static unsigned long long XGetBV()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile (".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)(edx) << 32) | eax;
+#endif
+}
+
+static SimdLevel DetectX86()
+{
+    unsigned int regs[4];
+
+    CpuId(0, 0, regs);
+    unsigned int maxLeaf = regs[0];
+
+    CpuId(1, 0, regs);
+    bool sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+
+    SimdLevel level = sse2 ? SIMD_SSE2 : SIMD_SCALAR;
+
+    if ( !osxsave || !avx || maxLeaf < 7 )
+        return level;
+
+    unsigned long long xcr0 = XGetBV();
+
+    // xmm + ymm state
+    if ( (xcr0 & 0x6) != 0x6 )
+        return level;
+
+    CpuId(7, 0, regs);
+    bool avx2 = (regs[1] & (1u << 5)) != 0;
+    bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+    if ( avx2 )
+        level = SIMD_AVX2;
+
+    // opmask + zmm state
+    if ( avx512f && (xcr0 & 0xe6) == 0xe6 )
+        level = SIMD_AVX512;
+
+    return level;
+}
+
+#endif
+
+SimdLevel DetectHardwareSimdLevel()
+{
+#if defined(FRACT_X86)
+    return DetectX86();
+#elif defined(FRACT_NEON)
+    return SIMD_NEON;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+
+SimdLevel DetectSimdLevel()
+{
+    SimdLevel level = DetectHardwareSimdLevel();
+
+    const char* cap = getenv("FRACTCORE_SIMD");
+    if ( cap == 0 )
+        return level;
+
+    SimdLevel capLevel = level;
+    if ( strcmp(cap, "scalar") == 0 )
+        capLevel = SIMD_SCALAR;
+    else if ( strcmp(cap, "sse2") == 0 )
+        capLevel = SIMD_SSE2;
+    else if ( strcmp(cap, "neon") == 0 )
+        capLevel = SIMD_NEON;
+    else if ( strcmp(cap, "avx2") == 0 )
+        capLevel = SIMD_AVX2;
+    else if ( strcmp(cap, "avx512") == 0 )
+        capLevel = SIMD_AVX512;
+
+    // neon and the x86 levels are not comparable, an x86 cap on an arm cpu
+    // (or the other way around) falls back to scalar
+    if ( capLevel == SIMD_SCALAR )
+        return SIMD_SCALAR;
+    if ( (capLevel == SIMD_NEON) != (level == SIMD_NEON) )
+        return SIMD_SCALAR;
+
+    return capLevel < level ? capLevel : level;
+}
+
+const char* SimdLevelName(SimdLevel level)
+{
+    switch ( level )
+    {
+    case SIMD_SSE2:   return "sse2";
+    case SIMD_NEON:   return "neon";
+    case SIMD_AVX2:   return "avx2";
+    case SIMD_AVX512: return "avx512";
+    default:          return "scalar";
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRACT_X86
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FRACT_NEON
+#endif
+
+// per function instruction set, the simd kernels are built in the same
+// translation units as everything else and only run after DetectSimdLevel()
+// said the cpu can do it
+#if defined(__GNUC__) || defined(__clang__)
+#define FRACT_TARGET(isa) __attribute__((target(isa)))
+#else
+#define FRACT_TARGET(isa)
+#endif
+
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2   = 1,
+    SIMD_NEON   = 2,
+    SIMD_AVX2   = 3,
+    SIMD_AVX512 = 4
+};
+
+// widest vector unit of this cpu the binary has a kernel for
+//
+// the FRACTCORE_SIMD environment variable (scalar, sse2, neon, avx2, avx512)
+// caps the result, handy to compare the kernels on one machine
+SimdLevel DetectSimdLevel();
+
+// widest vector unit of this cpu, ignoring FRACTCORE_SIMD
+SimdLevel DetectHardwareSimdLevel();
+
+const char* SimdLevelName(SimdLevel level);
+
+#endif // CPUFEATURES_H
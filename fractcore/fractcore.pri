@@ -0,0 +1,67 @@
+#-----------------------------------------------------------
+#
+# FractDroidGL headless rendering core
+#
+# include this file to build the core into another target,
+# fractcore.pro builds it as a standalone static library
+#
+#-----------------------------------------------------------
+
+INCLUDEPATH += $$PWD
+DEPENDPATH  += $$PWD
+
+# the simd kernels and the scalar code have to round the same way,
+# never let the compiler fuse a*b+c into an fma
+*-g++*|*-clang* {
+    QMAKE_CXXFLAGS += -std=c++11 -ffp-contract=off
+}
+
+SOURCES += $$PWD/mandelbrotview.cpp \
+    $$PWD/mandelbrotengine.cpp \
+    $$PWD/mandelbrotpalette.cpp \
+    $$PWD/pngcodec.cpp \
+    $$PWD/cpufeatures.cpp \
+    $$PWD/simdkernel.cpp \
+    $$PWD/simdkernel_sse2.cpp \
+    $$PWD/simdkernel_avx2.cpp \
+    $$PWD/simdkernel_avx512.cpp \
+    $$PWD/simdkernel_neon.cpp \
+    $$PWD/tilescheduler.cpp \
+    $$PWD/bigfloat.cpp \
+    $$PWD/perturbationrenderer.cpp \
+    $$PWD/seriesapproximation.cpp \
+    $$PWD/subdivisionrenderer.cpp \
+    $$PWD/progressiverenderer.cpp \
+    $$PWD/reprojectionrenderer.cpp \
+    $$PWD/tilecache.cpp \
+    $$PWD/tilepyramid.cpp \
+    $$PWD/iterationlimit.cpp \
+    $$PWD/adaptivesampler.cpp \
+    $$PWD/histogramcoloring.cpp
+
+HEADERS += $$PWD/mandelbrotview.h \
+    $$PWD/mandelbrotengine.h \
+    $$PWD/mandelbrotkernel.h \
+    $$PWD/mandelbrotpalette.h \
+    $$PWD/pngcodec.h \
+    $$PWD/cpufeatures.h \
+    $$PWD/simdkernel.h \
+    $$PWD/simdkernel_impl.h \
+    $$PWD/tilescheduler.h \
+    $$PWD/bigfloat.h \
+    $$PWD/perturbationrenderer.h \
+    $$PWD/seriesapproximation.h \
+    $$PWD/subdivisionrenderer.h \
+    $$PWD/progressiverenderer.h \
+    $$PWD/reprojectionrenderer.h \
+    $$PWD/tilecache.h \
+    $$PWD/tilepyramid.h \
+    $$PWD/iterationlimit.h \
+    $$PWD/adaptivesampler.h \
+    $$PWD/histogramcoloring.h
+
+# png decoding for the lookup palette, tile pyramid files
+LIBS += -lz
+
+# tile workers
+unix:!android:LIBS += -lpthread
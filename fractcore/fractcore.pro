@@ -0,0 +1,13 @@
+#-----------------------------------------------------------
+#
+# FractDroidGL headless rendering core, no Qt dependency
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = fractcore
+TEMPLATE = lib
+CONFIG += staticlib
+
+include(fractcore.pri)
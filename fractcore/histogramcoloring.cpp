@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "histogramcoloring.h"
+#include "tilescheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+namespace
+{
+
+// bin (or table entry) of a continuous iteration count, NaN and the few
+// slightly negative counts go to the first one
+inline int BinOf(float smooth, float binsPerIteration, int bins)
+{
+    float position = smooth * binsPerIteration;
+    if ( !(position >= 0.0f) )
+        return 0;
+
+    int bin = int(position);
+    return bin < bins ? bin : bins - 1;
+}
+
+void CountRegion(const FractalBuffer& buffer, int x, int y, int width, int height,
+                 int maxIterations, unsigned int* histogram)
+{
+    float binsPerIteration = float(HistogramColoring::BINS) / float(maxIterations);
+
+    for ( int row = y; row < y + height; row ++)
+    {
+        const int* iterations = buffer.iterations + size_t(row) * buffer.stride;
+        const float* smooth = buffer.smooth + size_t(row) * buffer.stride;
+
+        for ( int column = x; column < x + width; column ++)
+        {
+            if ( iterations[column] < maxIterations )
+                histogram[BinOf(smooth[column], binsPerIteration, HistogramColoring::BINS)] ++;
+        }
+    }
+}
+
+void RecolorRegion(const FractalBuffer& buffer, int x, int y, int width, int height,
+                   int maxIterations, bool interior, const std::vector<unsigned int>& table,
+                   unsigned int interiorColor)
+{
+    int entries = int(table.size());
+    float entriesPerIteration = float(entries) / float(maxIterations);
+
+    for ( int row = y; row < y + height; row ++)
+    {
+        size_t offset = size_t(row) * buffer.stride;
+
+        for ( int column = x; column < x + width; column ++)
+        {
+            if ( buffer.iterations[offset + column] < maxIterations )
+            {
+                int entry = BinOf(buffer.smooth[offset + column], entriesPerIteration, entries);
+                memcpy(buffer.rgba + (offset + column) * 4, &table[entry], 4);
+            }
+            else if ( interior )
+            {
+                memcpy(buffer.rgba + (offset + column) * 4, &interiorColor, 4);
+            }
+        }
+    }
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+HistogramColoringStats::HistogramColoringStats()
+{
+    pixels = 0;
+    escaped = 0;
+    histograms = 0;
+    countSeconds = 0.0;
+    recolorSeconds = 0.0;
+}
+
+HistogramColoring::HistogramColoring()
+{
+    source = 0;
+    counts.assign(BINS, 0);
+    escaped = 0;
+    countedIterations = 0;
+    interiorColor = 0;
+}
+
+void HistogramColoring::SetPalette(const MandelbrotPalette* palette)
+{
+    source = palette;
+    if ( palette )
+        equalized = *palette;
+    else
+        equalized = MandelbrotPalette();
+
+    BakeRecolorTable();
+}
+
+bool HistogramColoring::Collect(const FractalBuffer& buffer, int maxIterations, TileScheduler* scheduler,
+                                HistogramColoringStats* stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if ( maxIterations <= 0 || !buffer.iterations || !buffer.smooth )
+        return false;
+
+    int workers = scheduler ? scheduler->ThreadCount() : 1;
+    localCounts.assign(size_t(workers) * HISTOGRAM_STRIDE, 0);
+
+    // every worker counts into its own histogram
+    bool finished = true;
+    if ( scheduler )
+    {
+        finished = scheduler->Run(buffer.width, buffer.height,
+            [&](const RenderTile& tile, int worker)
+            {
+                CountRegion(buffer, tile.x, tile.y, tile.width, tile.height, maxIterations,
+                            &localCounts[size_t(worker) * HISTOGRAM_STRIDE]);
+            });
+    }
+    else
+    {
+        CountRegion(buffer, 0, 0, buffer.width, buffer.height, maxIterations, &localCounts[0]);
+    }
+
+    if ( !finished )
+        return false;
+
+    // and only the merge sees all of them
+    escaped = 0;
+    for ( int bin = 0; bin < BINS; bin ++)
+    {
+        long long count = 0;
+        for ( int worker = 0; worker < workers; worker ++)
+            count += localCounts[size_t(worker) * HISTOGRAM_STRIDE + bin];
+
+        counts[bin] = count;
+        escaped += count;
+    }
+    countedIterations = maxIterations;
+
+    if ( stats )
+    {
+        stats->pixels = (long long)buffer.width * buffer.height;
+        stats->escaped = escaped;
+        stats->histograms = workers;
+        stats->countSeconds = SecondsSince(start);
+    }
+
+    return true;
+}
+
+bool HistogramColoring::Equalize(int size)
+{
+    if ( escaped == 0 || !source || source->IsEmpty() )
+        return false;
+
+    if ( size > PALETTE_SIZE )
+        size = PALETTE_SIZE;
+    if ( size < 2 )
+        size = 2;
+
+    std::vector<unsigned char> colors(size_t(size) * 4);
+
+    // the texel centers are where the lookup returns a texel as it is,
+    // the cumulative histogram is linear within a bin
+    long long below = 0;
+    int bin = 0;
+    for ( int i = 0; i < size - 1; i ++)
+    {
+        double position = (i + 0.5) / size * BINS;
+        while ( bin < BINS - 1 && bin + 1 <= position )
+            below += counts[bin ++];
+
+        double rank = (double(below) + double(counts[bin]) * (position - bin)) / double(escaped);
+        source->Lookup(float(rank), &colors[size_t(i) * 4]);
+    }
+
+    // interior pixels look up 1.0, the last texel
+    source->Lookup(1.0f, &colors[size_t(size - 1) * 4]);
+
+    equalized.SetColors(&colors[0], size);
+    BakeRecolorTable();
+
+    return true;
+}
+
+void HistogramColoring::BakeRecolorTable()
+{
+    // the engine colors interior pixels with the lookup at 1.0
+    unsigned char color[4];
+    ColorizeIteration(&equalized, 1.0f, 1, color);
+    memcpy(&interiorColor, color, 4);
+
+    int entries = std::max(equalized.Size(), 1) * RECOLOR_STEPS;
+    recolorTable.resize(entries);
+    for ( int i = 0; i < entries; i ++)
+    {
+        ColorizeIteration(&equalized, (i + 0.5f) / entries, 1, color);
+        memcpy(&recolorTable[i], color, 4);
+    }
+}
+
+bool HistogramColoring::Recolor(FractalBuffer& buffer, int maxIterations, bool interior, TileScheduler* scheduler,
+                                HistogramColoringStats* stats) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    if ( maxIterations <= 0 || !buffer.rgba || !buffer.iterations || !buffer.smooth )
+        return false;
+
+    bool finished = true;
+    if ( scheduler )
+    {
+        finished = scheduler->Run(buffer.width, buffer.height,
+            [&](const RenderTile& tile, int)
+            {
+                RecolorRegion(buffer, tile.x, tile.y, tile.width, tile.height, maxIterations, interior,
+                              recolorTable, interiorColor);
+            });
+    }
+    else
+    {
+        RecolorRegion(buffer, 0, 0, buffer.width, buffer.height, maxIterations, interior,
+                      recolorTable, interiorColor);
+    }
+
+    if ( stats )
+        stats->recolorSeconds = SecondsSince(start);
+
+    return finished;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef HISTOGRAMCOLORING_H
+#define HISTOGRAMCOLORING_H
+
+#include "mandelbrotengine.h"
+#include "mandelbrotpalette.h"
+
+#include <vector>
+
+class TileScheduler;
+
+// counters of the histogram coloring passes of a frame
+struct HistogramColoringStats
+{
+    HistogramColoringStats();
+
+    long long pixels;           // pixels of the frame
+    long long escaped;          // pixels below the iteration limit, the ones that get equalized
+    int histograms;             // local histograms merged, one per worker
+    double countSeconds;        // wall time of counting and merging
+    double recolorSeconds;      // wall time of the recolor pass, 0 if there was none
+
+    double Seconds() const { return countSeconds + recolorSeconds; }
+};
+
+// histogram equalized coloring
+//
+// the plain coloring spreads the palette over the iteration range, so
+// where the escapes bunch up (most of a deep view) a few colors cover the
+// whole frame. This one spreads it over the escaped pixels by their rank:
+// the lookup coordinate smooth / maxIterations goes through the cumulative
+// histogram of the frame first, every color covers about the same area.
+//
+// Collect() counts a frame into one local histogram per worker, the hot
+// loop has no shared counters; they are merged once all tiles are done.
+// Equalize() bakes the cumulative histogram into a palette of its own that
+// is indexed like the plain one, so the engine and the lookup texture of
+// the shader take it as it is. Interior pixels keep the right edge color
+// of the plain palette.
+//
+// Recolor() runs over every pixel of a finished frame, so a frame that is
+// recolored anyway can be rendered without colors. A filtered palette
+// lookup per pixel would cost as much as the coloring in the engine, it
+// takes the nearest of RECOLOR_STEPS colors per palette texel instead,
+// which is within a rounding step of the lookup
+//
+// the baked palette is only written by Equalize(), it may be read from
+// any number of threads in between
+class HistogramColoring
+{
+public:
+    static const int BINS = 4096;           // histogram bins over [0, maxIterations)
+    static const int PALETTE_SIZE = 4096;   // colors of the baked palette
+    static const int RECOLOR_STEPS = 8;     // recolor table entries per palette color
+
+    HistogramColoring();
+
+    // palette that is equalized, the baked palette starts as a copy of it
+    void SetPalette(const MandelbrotPalette* palette);
+
+    // counts the escaped pixels of a frame rendered with maxIterations,
+    // the buffer needs its iteration and smooth planes. The tiles are
+    // spread over the scheduler, without one the calling thread counts
+    // them; false if it was cancelled
+    bool Collect(const FractalBuffer& buffer, int maxIterations, TileScheduler* scheduler,
+                 HistogramColoringStats* stats = 0);
+
+    // bakes the last counts into Palette() with size colors, at most
+    // PALETTE_SIZE; false and the palette stays as it was if nothing escaped
+    bool Equalize(int size = PALETTE_SIZE);
+
+    // gives the escaped pixels the colors of Palette(), the interior ones
+    // too if asked for, the others keep theirs; false if it was cancelled
+    bool Recolor(FractalBuffer& buffer, int maxIterations, bool interior, TileScheduler* scheduler,
+                 HistogramColoringStats* stats = 0) const;
+
+    const MandelbrotPalette& Palette() const { return equalized; }
+
+    // iteration limit of the last counts, 0 before the first frame
+    int MaxIterations() const { return countedIterations; }
+
+private:
+    void BakeRecolorTable();
+
+    // local histograms are this far apart, no two workers write the same cache line
+    static const int HISTOGRAM_STRIDE = BINS + 16;
+
+    const MandelbrotPalette* source;
+    MandelbrotPalette equalized;
+    std::vector<unsigned int> recolorTable;     // RGBA, Palette() sampled between its texels
+    unsigned int interiorColor;
+
+    std::vector<unsigned int> localCounts;
+    std::vector<long long> counts;
+    long long escaped;
+    int countedIterations;
+};
+
+#endif // HISTOGRAMCOLORING_H
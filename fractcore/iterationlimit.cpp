@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "iterationlimit.h"
+
+#include <algorithm>
+
+// share of the frame that has to be predicted false interior to grow
+const double GROW_FRACTION = 0.002;
+
+// share of a frame without escapes that has to be unresolved to grow
+const double UNRESOLVED_FRACTION = 0.5;
+
+// the limit doubles at most per frame and shrinks when nothing escaped
+// above this share of it
+const double GROW_FACTOR = 2.0;
+const double SHRINK_FRACTION = 0.25;
+
+// growth worth a new limit when the budget only allows a part of it
+const double MIN_GROWTH = 1.1;
+
+IterationHistogram::IterationHistogram()
+{
+    maxIterations = 0;
+    pixels = 0;
+    escaped = 0;
+    capped = 0;
+    boundaryCapped = 0;
+    periodic = 0;
+    escapeIterations = 0;
+    highestEscape = 0;
+    std::fill(buckets, buckets + BUCKETS, 0LL);
+}
+
+void IterationHistogram::Collect(const FractalBuffer& buffer, int maxIterations)
+{
+    *this = IterationHistogram();
+    this->maxIterations = maxIterations;
+
+    const int width = buffer.width;
+    const int height = buffer.height;
+    const int stride = buffer.stride;
+    if ( !buffer.iterations || width <= 0 || height <= 0 || maxIterations <= 0 )
+        return;
+
+    const bool orbits = buffer.orbitX && buffer.orbitY;
+    for ( int y = 0; y < height; y ++)
+    {
+        size_t rowOffset = size_t(y) * stride;
+        const int* row = buffer.iterations + rowOffset;
+        for ( int x = 0; x < width; x ++)
+        {
+            int n = row[x];
+            if ( n >= maxIterations )
+            {
+                capped ++;
+                if ( orbits && buffer.orbitX[rowOffset + x] == 0.0 && buffer.orbitY[rowOffset + x] == 0.0 )
+                    periodic ++;
+
+                bool boundary = (x > 0 && row[x - 1] < maxIterations) ||
+                                (x + 1 < width && row[x + 1] < maxIterations) ||
+                                (y > 0 && row[x - stride] < maxIterations) ||
+                                (y + 1 < height && row[x + stride] < maxIterations);
+                if ( boundary )
+                    boundaryCapped ++;
+                continue;
+            }
+
+            escaped ++;
+            escapeIterations += n;
+            highestEscape = std::max(highestEscape, n);
+            buckets[int((long long)(n) * BUCKETS / maxIterations)] ++;
+        }
+    }
+
+    pixels = (long long)(width) * height;
+}
+
+long long IterationHistogram::EscapedBetween(double from, double to) const
+{
+    long long count = 0;
+    int first = std::max(0, int(from * BUCKETS + 0.5));
+    int end = std::min(int(BUCKETS), int(to * BUCKETS + 0.5));
+    for ( int i = first; i < end; i ++)
+        count += buckets[i];
+    return count;
+}
+
+double IterationHistogram::IterationsPerPixel() const
+{
+    if ( pixels == 0 )
+        return 0.0;
+    return (double(escapeIterations) + double(Unresolved()) * maxIterations) / double(pixels);
+}
+
+AdaptiveIterationLimit::AdaptiveIterationLimit()
+{
+    budget = 0.0;
+    minimum = 64;
+    maximum = 1 << 20;
+    lastDecision = KEEP;
+    lastFalseInterior = 0.0;
+}
+
+const char* AdaptiveIterationLimit::DecisionName(Decision decision)
+{
+    switch ( decision )
+    {
+    case GROW:
+        return "grow";
+    case SHRINK:
+        return "shrink";
+    case AT_BUDGET:
+        return "at budget";
+    default:
+        return "keep";
+    }
+}
+
+void AdaptiveIterationLimit::SetBudget(double iterationsPerPixel)
+{
+    budget = std::max(0.0, iterationsPerPixel);
+}
+
+void AdaptiveIterationLimit::SetRange(int minimum, int maximum)
+{
+    this->minimum = std::max(1, minimum);
+    this->maximum = std::max(this->minimum, maximum);
+}
+
+int AdaptiveIterationLimit::NextLimit(const IterationHistogram& histogram)
+{
+    const int limit = histogram.maxIterations;
+    lastDecision = KEEP;
+    lastFalseInterior = 0.0;
+    if ( histogram.pixels == 0 || limit <= 0 )
+        return limit;
+
+    // the next octave loses about as much as the top one lost against the
+    // one below it; only capped pixels can still escape
+    double topOctave = double(histogram.EscapedBetween(0.5, 1.0));
+    double octaveBelow = double(histogram.EscapedBetween(0.25, 0.5));
+    double decay = octaveBelow > 0.0 ? std::min(1.0, topOctave / octaveBelow) : 1.0;
+    double unresolved = double(std::max(0LL, histogram.Unresolved()));
+    double falseInterior = std::min(unresolved, topOctave * decay);
+    lastFalseInterior = falseInterior / double(histogram.pixels);
+
+    // zoomed past the limit, all of the view still iterating at the cap
+    bool noEscapes = histogram.escaped < GROW_FRACTION * histogram.pixels;
+    if ( noEscapes && unresolved > UNRESOLVED_FRACTION * histogram.pixels )
+        lastFalseInterior = unresolved / double(histogram.pixels);
+
+    bool grow = lastFalseInterior > GROW_FRACTION &&
+                (noEscapes || histogram.BoundaryCappedFraction() > GROW_FRACTION);
+    if ( grow )
+    {
+        double grown = std::min(double(maximum), limit * GROW_FACTOR);
+
+        // every unresolved pixel runs to the new limit in the worst case
+        if ( budget > 0.0 )
+        {
+            double spare = budget - histogram.IterationsPerPixel();
+            double affordable = limit + spare * double(histogram.pixels) / unresolved;
+            grown = std::min(grown, affordable);
+        }
+
+        if ( grown < limit * MIN_GROWTH )
+        {
+            lastDecision = AT_BUDGET;
+            return std::max(limit, minimum);
+        }
+
+        lastDecision = GROW;
+        return int(grown);
+    }
+
+    if ( histogram.highestEscape < limit * SHRINK_FRACTION )
+    {
+        int shrunk = std::max(minimum, 2 * histogram.highestEscape);
+        if ( shrunk < limit )
+        {
+            lastDecision = SHRINK;
+            return shrunk;
+        }
+    }
+
+    return std::max(minimum, std::min(maximum, limit));
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ITERATIONLIMIT_H
+#define ITERATIONLIMIT_H
+
+#include "mandelbrotengine.h"
+
+// escape iterations of a finished frame
+struct IterationHistogram
+{
+    // bucket i counts the pixels that escaped in
+    // [i, i + 1) * maxIterations / BUCKETS
+    static const int BUCKETS = 32;
+
+    IterationHistogram();
+
+    // counts the pixels of a frame rendered with maxIterations, the buffer
+    // needs its iteration plane. A pixel that hit the limit lies on the
+    // boundary of the capped area when one of its 4 neighbours escaped, and
+    // is known interior when the buffer has orbit planes with a (0, 0)
+    // orbit for it
+    void Collect(const FractalBuffer& buffer, int maxIterations);
+
+    // pixels that escaped in [maxIterations * from, maxIterations * to)
+    long long EscapedBetween(double from, double to) const;
+
+    double CappedFraction() const { return pixels > 0 ? double(capped) / double(pixels) : 0.0; }
+    double BoundaryCappedFraction() const { return pixels > 0 ? double(boundaryCapped) / double(pixels) : 0.0; }
+
+    // capped pixels that may still escape with a higher limit
+    long long Unresolved() const { return capped - periodic; }
+
+    // mean iterations per pixel, the unresolved pixels at the full limit
+    // and the periodic ones for free
+    double IterationsPerPixel() const;
+
+    int maxIterations;          // limit the frame was rendered with, 0 if none
+    long long pixels;
+    long long escaped;
+    long long capped;           // reached maxIterations
+    long long boundaryCapped;   // capped next to an escaped pixel
+    long long periodic;         // capped and known to never escape
+    long long escapeIterations; // summed over the escaped pixels
+    int highestEscape;          // largest escape iteration, 0 if nothing escaped
+    long long buckets[BUCKETS];
+};
+
+// iteration limit that follows the escape histogram of the last frame
+//
+// the escape counts near the boundary fall off about geometrically, so the
+// pixels that escaped in the top octave [limit / 2, limit) estimate how
+// many capped pixels would escape if the limit were doubled. When that is
+// more than a small fraction of the frame, and the frame has capped pixels
+// next to escaped ones, the limit grows. When nothing escaped in the top
+// three quarters of the range the limit shrinks to twice the highest escape.
+// A frame without escapes says nothing about the limit, it only grows when
+// most of it is capped without being known interior.
+// Growth is held back by the budget, the mean iterations per pixel the next
+// frame may cost with every unresolved pixel running to the new limit
+class AdaptiveIterationLimit
+{
+public:
+
+    enum Decision
+    {
+        KEEP = 0,           // the limit fits the frame
+        GROW,               // too many false interior pixels
+        SHRINK,             // nothing came near the limit
+        AT_BUDGET           // would grow but the budget or the maximum is reached
+    };
+
+    AdaptiveIterationLimit();
+
+    static const char* DecisionName(Decision decision);
+
+    // mean iterations per pixel a frame may cost, 0 = no budget
+    void SetBudget(double iterationsPerPixel);
+    double Budget() const { return budget; }
+
+    void SetRange(int minimum, int maximum);
+
+    // limit for the next frame of about the same view, the histogram's own
+    // limit if it has no pixels
+    int NextLimit(const IterationHistogram& histogram);
+
+    Decision LastDecision() const { return lastDecision; }
+
+    // capped pixels the last histogram predicted to escape below twice its
+    // limit, as a fraction of its pixels
+    double LastFalseInterior() const { return lastFalseInterior; }
+
+private:
+    double budget;
+    int minimum;
+    int maximum;
+    Decision lastDecision;
+    double lastFalseInterior;
+};
+
+#endif // ITERATIONLIMIT_H
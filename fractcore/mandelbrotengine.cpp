@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mandelbrotengine.h"
+#include "mandelbrotkernel.h"
+#include "mandelbrotpalette.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+FractalBuffer::FractalBuffer()
+{
+    width = 0;
+    height = 0;
+    stride = 0;
+    rgba = 0;
+    iterations = 0;
+    smooth = 0;
+    orbitX = 0;
+    orbitY = 0;
+}
+
+FractalBuffer::FractalBuffer(int width, int height, unsigned char* rgba, int* iterations, float* smooth,
+                             double* orbitX, double* orbitY)
+{
+    this->width = width;
+    this->height = height;
+    this->stride = width;
+    this->rgba = rgba;
+    this->iterations = iterations;
+    this->smooth = smooth;
+    this->orbitX = orbitX;
+    this->orbitY = orbitY;
+}
+
+FractalBuffer FractalBuffer::SubBuffer(int x, int y, int width, int height) const
+{
+    FractalBuffer sub(*this);
+    int offset = y * stride + x;
+
+    sub.width = width;
+    sub.height = height;
+    if ( rgba )
+        sub.rgba = rgba + offset * 4;
+    if ( iterations )
+        sub.iterations = iterations + offset;
+    if ( smooth )
+        sub.smooth = smooth + offset;
+    if ( orbitX )
+        sub.orbitX = orbitX + offset;
+    if ( orbitY )
+        sub.orbitY = orbitY + offset;
+
+    return sub;
+}
+
+MandelbrotEngine::MandelbrotEngine()
+{
+    palette = 0;
+    precision = MandelbrotEngine::DOUBLE_PRECISION;
+    kernels = GetEscapeKernels(DetectSimdLevel());
+    periodicityCheck = true;
+    showPeriodicityCheck = false;
+}
+
+void MandelbrotEngine::SetPalette(const MandelbrotPalette* palette)
+{
+    this->palette = palette;
+}
+
+void MandelbrotEngine::SetPrecision(Precision precision)
+{
+    this->precision = precision;
+}
+
+void MandelbrotEngine::SetPeriodicityCheck(bool enabled)
+{
+    periodicityCheck = enabled;
+}
+
+void MandelbrotEngine::SetShowPeriodicityCheck(bool enabled)
+{
+    showPeriodicityCheck = enabled;
+}
+
+void MandelbrotEngine::SetSimdLevel(SimdLevel level)
+{
+    kernels = GetEscapeKernels(level);
+}
+
+void MandelbrotEngine::Render(const MandelbrotView& view, FractalBuffer& buffer, KernelStats* stats) const
+{
+    RenderRegion(view, 0, 0, view.width, view.height, buffer, stats);
+}
+
+void MandelbrotEngine::RenderRegion(const MandelbrotView& view, int x, int y, int width, int height,
+                                    FractalBuffer& buffer, KernelStats* stats) const
+{
+    RenderGrid(view, x, y, width, height, 1, 1, buffer, stats);
+}
+
+void MandelbrotEngine::RenderGrid(const MandelbrotView& view, int x, int y, int width, int height, int stepX, int stepY,
+                                  FractalBuffer& buffer, KernelStats* stats) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    KernelStats regionStats;
+
+    if ( width > 0 && height > 0 && stepX > 0 && stepY > 0 )
+    {
+        if ( precision == MandelbrotEngine::SINGLE_PRECISION )
+            RenderRows<float>(view, x, y, width, height, stepX, stepY, buffer, kernels.escapeFloat, regionStats);
+        else
+            RenderRows<double>(view, x, y, width, height, stepX, stepY, buffer, kernels.escapeDouble, regionStats);
+    }
+
+    if ( stats )
+    {
+        regionStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->Add(regionStats);
+    }
+}
+
+template <typename Real, typename Kernel>
+void MandelbrotEngine::RenderRows(const MandelbrotView& view, int x, int y, int width, int height, int stepX, int stepY,
+                                  FractalBuffer& buffer, Kernel kernel, KernelStats& stats) const
+{
+    const int maxIterations = view.maxIterations;
+    const ViewTransform transform(view);
+    const Real epsilon2 = Real(PeriodicityEpsilon2(view));
+
+    // the check costs about half an iteration per step, so a row only runs
+    // it if the row above had interior points that got past the early-out
+    // tests; in the rest of the frame it could not stop anything anyway
+    bool checkRow = true;
+
+    // the points of a row that survive the early-out tests are packed
+    // together, so the vector lanes never idle on interior pixels; a grid
+    // packs as many of its rows as it takes to get the points of a full
+    // row, the lanes idle at the end of every kernel call
+    const int rowsPerCall = stepX;
+    const int capacity = (width + stepX - 1) / stepX * rowsPerCall;
+    std::vector<Real> packedCx(capacity), packedCy(capacity), packedNorm2(capacity);
+    std::vector<int> packedOffset(capacity), packedIterations(capacity);
+
+    // with the orbit planes the points are handed to the kernel as resumed
+    // from c after no iterations, so it writes back where they stopped
+    const bool orbits = buffer.orbitX && buffer.orbitY;
+    std::vector<Real> packedZx(orbits ? capacity : 0), packedZy(orbits ? capacity : 0);
+
+    for ( int firstRow = 0; firstRow < height; firstRow += stepY * rowsPerCall )
+    {
+        int lastRow = std::min(height, firstRow + stepY * rowsPerCall);
+        int count = 0;
+
+        for ( int row = firstRow; row < lastRow; row += stepY )
+        {
+            int rowOffset = row * buffer.stride;
+
+            for ( int column = 0; column < width; column += stepX )
+            {
+                double cx, cy;
+                transform.Map(x + column + 0.5, y + row + 0.5, cx, cy);
+
+                if ( IsInCardioidOrBulb(cx, cy) )
+                {
+                    int offset = rowOffset + column;
+                    if ( buffer.iterations )
+                        buffer.iterations[offset] = maxIterations;
+                    if ( buffer.smooth )
+                        buffer.smooth[offset] = float(maxIterations);
+                    if ( buffer.rgba )
+                        Colorize(float(maxIterations), maxIterations, buffer.rgba + offset * 4);
+                    if ( orbits )
+                        buffer.orbitX[offset] = buffer.orbitY[offset] = 0.0;
+                    continue;
+                }
+
+                packedCx[count] = Real(cx);
+                packedCy[count] = Real(cy);
+                packedOffset[count] = rowOffset + column;
+                if ( orbits )
+                {
+                    packedZx[count] = Real(cx);
+                    packedZy[count] = Real(cy);
+                    packedIterations[count] = 0;
+                }
+                count ++;
+            }
+        }
+
+        if ( count > 0 )
+            kernel(&packedCx[0], &packedCy[0], count, maxIterations, checkRow ? epsilon2 : Real(0),
+                   &packedIterations[0], &packedNorm2[0], orbits ? &packedZx[0] : 0, orbits ? &packedZy[0] : 0);
+
+        checkRow = false;
+
+        for ( int i = 0; i < count; i ++)
+        {
+            int offset = packedOffset[i];
+
+            if ( packedIterations[i] >= maxIterations )
+                checkRow = true;
+
+            StorePixel(packedIterations[i], double(packedNorm2[i]), maxIterations,
+                       buffer.iterations ? buffer.iterations + offset : 0,
+                       buffer.smooth ? buffer.smooth + offset : 0,
+                       buffer.rgba ? buffer.rgba + offset * 4 : 0, stats);
+
+            if ( orbits )
+                StoreOrbit(double(packedNorm2[i]), double(packedZx[i]), double(packedZy[i]),
+                           buffer.orbitX + offset, buffer.orbitY + offset);
+        }
+    }
+
+    stats.pixels += (long long)((width + stepX - 1) / stepX) * ((height + stepY - 1) / stepY);
+}
+
+void MandelbrotEngine::ResumeRegion(const MandelbrotView& view, int previousIterations, int x, int y,
+                                    int width, int height, FractalBuffer& buffer, KernelStats* stats) const
+{
+    if ( view.maxIterations <= previousIterations || !buffer.iterations || !buffer.smooth )
+    {
+        RenderRegion(view, x, y, width, height, buffer, stats);
+        return;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    KernelStats regionStats;
+
+    if ( precision == MandelbrotEngine::SINGLE_PRECISION )
+        ResumeRows<float>(view, previousIterations, x, y, width, height, buffer, kernels.escapeFloat, regionStats);
+    else
+        ResumeRows<double>(view, previousIterations, x, y, width, height, buffer, kernels.escapeDouble, regionStats);
+
+    if ( stats )
+    {
+        regionStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->Add(regionStats);
+    }
+}
+
+template <typename Real, typename Kernel>
+void MandelbrotEngine::ResumeRows(const MandelbrotView& view, int previousIterations, int x, int y,
+                                  int width, int height, FractalBuffer& buffer, Kernel kernel, KernelStats& stats) const
+{
+    const int maxIterations = view.maxIterations;
+    const ViewTransform transform(view);
+
+    // only points that did not escape below the old limit get here, most
+    // of them are interior, so the cycle check runs on every row
+    const Real epsilon2 = Real(PeriodicityEpsilon2(view));
+    const bool orbits = buffer.orbitX && buffer.orbitY;
+
+    std::vector<Real> packedCx(width), packedCy(width), packedNorm2(width);
+    std::vector<Real> packedZx(width), packedZy(width);
+    std::vector<int> packedColumn(width), packedIterations(width);
+
+    for ( int row = 0; row < height; row ++)
+    {
+        int rowOffset = row * buffer.stride;
+        int count = 0;
+        long long resumedIterations = 0;
+
+        for ( int column = 0; column < width; column ++)
+        {
+            int offset = rowOffset + column;
+
+            // escaped below the old limit, final
+            if ( buffer.iterations[offset] < previousIterations )
+            {
+                if ( buffer.rgba )
+                    Colorize(buffer.smooth[offset], maxIterations, buffer.rgba + offset * 4);
+                continue;
+            }
+
+            double orbitX = orbits ? buffer.orbitX[offset] : 0.0;
+            double orbitY = orbits ? buffer.orbitY[offset] : 0.0;
+            bool known = orbits && orbitX == orbitX && orbitY == orbitY;
+
+            double cx, cy;
+            transform.Map(x + column + 0.5, y + row + 0.5, cx, cy);
+
+            if ( known ? orbitX == 0.0 && orbitY == 0.0 : IsInCardioidOrBulb(cx, cy) )
+            {
+                buffer.iterations[offset] = maxIterations;
+                buffer.smooth[offset] = float(maxIterations);
+                if ( buffer.rgba )
+                    Colorize(float(maxIterations), maxIterations, buffer.rgba + offset * 4);
+                if ( orbits )
+                    buffer.orbitX[offset] = buffer.orbitY[offset] = 0.0;
+                continue;
+            }
+
+            packedCx[count] = Real(cx);
+            packedCy[count] = Real(cy);
+            packedZx[count] = known ? Real(orbitX) : Real(cx);
+            packedZy[count] = known ? Real(orbitY) : Real(cy);
+            packedIterations[count] = known ? buffer.iterations[offset] : 0;
+            packedColumn[count] = column;
+            resumedIterations += packedIterations[count];
+            count ++;
+        }
+
+        if ( count > 0 )
+            kernel(&packedCx[0], &packedCy[0], count, maxIterations, epsilon2,
+                   &packedIterations[0], &packedNorm2[0], &packedZx[0], &packedZy[0]);
+
+        for ( int i = 0; i < count; i ++)
+        {
+            int offset = rowOffset + packedColumn[i];
+
+            StorePixel(packedIterations[i], double(packedNorm2[i]), maxIterations,
+                       buffer.iterations + offset, buffer.smooth + offset,
+                       buffer.rgba ? buffer.rgba + offset * 4 : 0, stats);
+
+            if ( orbits )
+                StoreOrbit(double(packedNorm2[i]), double(packedZx[i]), double(packedZy[i]),
+                           buffer.orbitX + offset, buffer.orbitY + offset);
+        }
+
+        // the counts include the iterations done before
+        stats.iterations -= resumedIterations;
+    }
+
+    stats.pixels += (long long)(width) * height;
+}
+
+void MandelbrotEngine::RenderPixels(const MandelbrotView& view, const int* px, const int* py, int count,
+                                    int* iterations, float* smooth, double* orbitX, double* orbitY,
+                                    KernelStats* stats) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    KernelStats pixelStats;
+
+    if ( precision == MandelbrotEngine::SINGLE_PRECISION )
+        RenderPixelList<float>(view, px, py, 0.5, count, iterations, smooth, orbitX, orbitY, kernels.escapeFloat, pixelStats);
+    else
+        RenderPixelList<double>(view, px, py, 0.5, count, iterations, smooth, orbitX, orbitY, kernels.escapeDouble, pixelStats);
+
+    if ( stats )
+    {
+        pixelStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->Add(pixelStats);
+    }
+}
+
+void MandelbrotEngine::RenderSamples(const MandelbrotView& view, const double* sx, const double* sy, int count,
+                                     int* iterations, float* smooth, KernelStats* stats) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    KernelStats sampleStats;
+
+    if ( precision == MandelbrotEngine::SINGLE_PRECISION )
+        RenderPixelList<float>(view, sx, sy, 0.0, count, iterations, smooth, 0, 0, kernels.escapeFloat, sampleStats);
+    else
+        RenderPixelList<double>(view, sx, sy, 0.0, count, iterations, smooth, 0, 0, kernels.escapeDouble, sampleStats);
+
+    if ( stats )
+    {
+        sampleStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->Add(sampleStats);
+    }
+}
+
+template <typename Real, typename Kernel, typename Position>
+void MandelbrotEngine::RenderPixelList(const MandelbrotView& view, const Position* px, const Position* py, double offset, int count,
+                                       int* iterations, float* smooth, double* orbitX, double* orbitY,
+                                       Kernel kernel, KernelStats& stats) const
+{
+    const int maxIterations = view.maxIterations;
+    const ViewTransform transform(view);
+    const Real epsilon2 = Real(PeriodicityEpsilon2(view));
+    const bool orbits = orbitX && orbitY;
+
+    std::vector<Real> packedCx(count), packedCy(count), packedNorm2(count);
+    std::vector<Real> packedZx(orbits ? count : 0), packedZy(orbits ? count : 0);
+    std::vector<int> packedIndex(count), packedIterations(count);
+    int packed = 0;
+
+    for ( int i = 0; i < count; i ++)
+    {
+        double cx, cy;
+        transform.Map(px[i] + offset, py[i] + offset, cx, cy);
+
+        if ( IsInCardioidOrBulb(cx, cy) )
+        {
+            iterations[i] = maxIterations;
+            smooth[i] = float(maxIterations);
+            if ( orbits )
+                orbitX[i] = orbitY[i] = 0.0;
+            continue;
+        }
+
+        packedCx[packed] = Real(cx);
+        packedCy[packed] = Real(cy);
+        packedIndex[packed] = i;
+        if ( orbits )
+        {
+            packedZx[packed] = Real(cx);
+            packedZy[packed] = Real(cy);
+            packedIterations[packed] = 0;
+        }
+        packed ++;
+    }
+
+    if ( packed > 0 )
+        kernel(&packedCx[0], &packedCy[0], packed, maxIterations, epsilon2, &packedIterations[0], &packedNorm2[0],
+               orbits ? &packedZx[0] : 0, orbits ? &packedZy[0] : 0);
+
+    for ( int i = 0; i < packed; i ++)
+    {
+        int index = packedIndex[i];
+        StorePixel(packedIterations[i], double(packedNorm2[i]), maxIterations,
+                   iterations + index, smooth + index, 0, stats);
+
+        if ( orbits )
+            StoreOrbit(double(packedNorm2[i]), double(packedZx[i]), double(packedZy[i]),
+                       orbitX + index, orbitY + index);
+    }
+
+    stats.pixels += count;
+}
+
+double MandelbrotEngine::PeriodicityEpsilon2(const MandelbrotView& view) const
+{
+    if ( !periodicityCheck )
+        return 0.0;
+
+    double epsilon = PeriodicityEpsilon(view.PixelSize());
+    return epsilon * epsilon;
+}
+
+void MandelbrotEngine::StorePixel(int iterations, double norm2, int maxIterations, int* iterationsOut,
+                                  float* smoothOut, unsigned char* rgbaOut, KernelStats& stats) const
+{
+    // a negative norm2 is a point the periodicity check stopped, it holds
+    // the iterations actually spent
+    bool periodic = norm2 < 0.0;
+    float smooth = periodic ? float(maxIterations) : SmoothIteration(iterations, norm2, maxIterations);
+
+    if ( iterationsOut )
+        *iterationsOut = iterations;
+    if ( smoothOut )
+        *smoothOut = smooth;
+
+    if ( rgbaOut )
+    {
+        if ( periodic && showPeriodicityCheck )
+        {
+            rgbaOut[0] = 255;
+            rgbaOut[1] = 0;
+            rgbaOut[2] = 255;
+            rgbaOut[3] = 255;
+        }
+        else
+        {
+            Colorize(smooth, maxIterations, rgbaOut);
+        }
+    }
+
+    if ( periodic )
+    {
+        stats.iterations += (long long)(-norm2);
+        stats.periodicPixels ++;
+    }
+    else
+    {
+        stats.iterations += iterations;
+    }
+}
+
+void MandelbrotEngine::StoreOrbit(double norm2, double zx, double zy, double* orbitXOut, double* orbitYOut)
+{
+    // a point caught in a cycle never needs more iterations
+    bool periodic = norm2 < 0.0;
+
+    *orbitXOut = periodic ? 0.0 : zx;
+    *orbitYOut = periodic ? 0.0 : zy;
+}
+
+void MandelbrotEngine::Colorize(float smooth, int maxIterations, unsigned char* rgba) const
+{
+    ColorizeIteration(palette, smooth, maxIterations, rgba);
+}
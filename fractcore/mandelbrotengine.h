@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MANDELBROTENGINE_H
+#define MANDELBROTENGINE_H
+
+#include "mandelbrotview.h"
+#include "simdkernel.h"
+
+class MandelbrotPalette;
+
+// caller owned output of the cpu renderer
+//
+// any of the planes may be 0 if the caller is not interested in it,
+// stride is counted in pixels and shared by all planes
+struct FractalBuffer
+{
+    FractalBuffer();
+    FractalBuffer(int width, int height, unsigned char* rgba, int* iterations, float* smooth,
+                  double* orbitX = 0, double* orbitY = 0);
+
+    // a window into this buffer, no pixels are copied
+    FractalBuffer SubBuffer(int x, int y, int width, int height) const;
+
+    int width;
+    int height;
+    int stride;
+
+    unsigned char* rgba;    // 4 bytes per pixel, RGBA (GL_RGBA / GL_UNSIGNED_BYTE)
+    int* iterations;        // escape iteration, maxIterations for interior pixels
+    float* smooth;          // continuous iteration count, see SmoothIteration()
+
+    // z where the iteration of a pixel stopped, so a higher iteration limit
+    // can go on from there (see MandelbrotEngine::ResumeRegion()); (0, 0)
+    // for interior pixels that are known to never escape (an orbit through
+    // 0 is periodic), NaN where it is not known
+    double* orbitX;
+    double* orbitY;
+};
+
+// headless version of the mandelbrot pass
+//
+// the engine is immutable while rendering, any number of threads may call
+// RenderRegion() on the same instance as long as they write different pixels
+class MandelbrotEngine
+{
+public:
+
+    enum Precision
+    {
+        SINGLE_PRECISION = 0,     // GL_ES, "#define double float"
+        DOUBLE_PRECISION = 1      // GL_ARB_gpu_shader_fp64
+    };
+
+    MandelbrotEngine();
+
+    void SetPalette(const MandelbrotPalette* palette);
+    void SetPrecision(Precision precision);
+    Precision GetPrecision() const { return precision; }
+
+    // stops interior points that settled on a cycle early, on by default;
+    // the distance is PeriodicityEpsilon() of the view's pixel size
+    void SetPeriodicityCheck(bool enabled);
+    bool PeriodicityCheckEnabled() const { return periodicityCheck; }
+
+    // debug, paints the pixels the periodicity check stopped in magenta
+    void SetShowPeriodicityCheck(bool enabled);
+
+    // picks the escape time kernel, DetectSimdLevel() by default
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const { return kernels.level; }
+
+    // renders the whole view, buffer has to be at least view.width x view.height
+    void Render(const MandelbrotView& view, FractalBuffer& buffer, KernelStats* stats = 0) const;
+
+    // renders the image rect [x, x + width) x [y, y + height) of the view,
+    // buffer pixel (0, 0) receives image pixel (x, y)
+    //
+    // the counters of the call are added to stats if given
+    void RenderRegion(const MandelbrotView& view, int x, int y, int width, int height,
+                      FractalBuffer& buffer, KernelStats* stats = 0) const;
+
+    // same for every stepX-th pixel of every stepY-th row of the rect,
+    // starting at its top left corner; the pixels in between are left as
+    // they are. For renderers that fill in a grid of samples, it runs the
+    // row kernel like RenderRegion() does
+    void RenderGrid(const MandelbrotView& view, int x, int y, int width, int height, int stepX, int stepY,
+                    FractalBuffer& buffer, KernelStats* stats = 0) const;
+
+    // continues the image rect of a buffer rendered with previousIterations
+    // to the iteration limit of the view, which has to be higher; the rest
+    // of the view has to be the same
+    //
+    // escaped pixels keep their values, interior pixels known to stay
+    // inside are just raised to the new limit and the others go on from
+    // their orbit, or start again from c where it is not known (or the
+    // buffer has no orbit planes). All colors are written again, they
+    // depend on the limit
+    void ResumeRegion(const MandelbrotView& view, int previousIterations, int x, int y, int width, int height,
+                      FractalBuffer& buffer, KernelStats* stats = 0) const;
+
+    // evaluates count scattered pixels (px[i], py[i]) of the view, for
+    // renderers that pick their own pixels; no colors are written, the
+    // orbits only if orbitX / orbitY are given
+    void RenderPixels(const MandelbrotView& view, const int* px, const int* py, int count,
+                      int* iterations, float* smooth, double* orbitX, double* orbitY,
+                      KernelStats* stats = 0) const;
+
+    // same for samples anywhere in the image, (sx[i], sy[i]) is an image
+    // position as in MandelbrotView::PixelToComplex(), so pixel centers are
+    // at +0.5; for renderers that take several samples per pixel
+    void RenderSamples(const MandelbrotView& view, const double* sx, const double* sy, int count,
+                       int* iterations, float* smooth, KernelStats* stats = 0) const;
+
+    // maps a continuous iteration count to a color of the palette
+    void Colorize(float smooth, int maxIterations, unsigned char* rgba) const;
+
+private:
+    template <typename Real, typename Kernel>
+    void RenderRows(const MandelbrotView& view, int x, int y, int width, int height, int stepX, int stepY,
+                    FractalBuffer& buffer, Kernel kernel, KernelStats& stats) const;
+
+    template <typename Real, typename Kernel>
+    void ResumeRows(const MandelbrotView& view, int previousIterations, int x, int y, int width, int height,
+                    FractalBuffer& buffer, Kernel kernel, KernelStats& stats) const;
+
+    // positions are px[i] + offset, py[i] + offset
+    template <typename Real, typename Kernel, typename Position>
+    void RenderPixelList(const MandelbrotView& view, const Position* px, const Position* py, double offset, int count,
+                         int* iterations, float* smooth, double* orbitX, double* orbitY,
+                         Kernel kernel, KernelStats& stats) const;
+
+    // kernel argument of the view, 0 if the check is off
+    double PeriodicityEpsilon2(const MandelbrotView& view) const;
+
+    // fills one pixel from a kernel result
+    void StorePixel(int iterations, double norm2, int maxIterations, int* iterationsOut,
+                    float* smoothOut, unsigned char* rgbaOut, KernelStats& stats) const;
+    static void StoreOrbit(double norm2, double zx, double zy, double* orbitXOut, double* orbitYOut);
+
+    const MandelbrotPalette* palette;
+    Precision precision;
+    EscapeKernels kernels;
+    bool periodicityCheck;
+    bool showPeriodicityCheck;
+};
+
+#endif // MANDELBROTENGINE_H
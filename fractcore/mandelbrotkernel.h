@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MANDELBROTKERNEL_H
+#define MANDELBROTKERNEL_H
+
+// scalar version of the math in mandelbrot_frag.glsl
+//
+// every cpu render path goes through these functions (or a vectorized copy
+// of them), keep them in sync with the shader
+
+#include <math.h>
+
+const float MANDEL_BAILOUT = 4.0f;
+const float MANDEL_LOG_2 = 0.69314718055994530942f;
+
+// optimization. early out
+//
+// the shader does both tests in mediump float, so do we
+inline bool IsInCardioidOrBulb(double cx, double cy)
+{
+    // cardioid
+    // q = ( x - 1/4 )^2 + y^2
+    // q ( q + ( x - 1/4 )) < 1/4 y^2
+    float x = float(cx - 0.25);
+    float y2 = float(cy * cy);
+    float q = x * x + y2;
+
+    if ( 4.0f * q * (q + x) < y2 )
+        return true;
+
+    // period-2 bulb
+    // (x + 1) ^2 + y ^ 2 < 1/16
+    float xp12 = float((cx + 1.0) * (cx + 1.0));
+
+    return xp12 + y2 < 0.0625f;
+}
+
+// escape time loop of an orbit that is at z after start iterations, the
+// rest of IterateEscape()
+template <typename Real>
+inline int ContinueEscape(Real cx, Real cy, int start, int maxIterations, Real& zx, Real& zy)
+{
+    int i;
+    for ( i = start; i < maxIterations && zx * zx + zy * zy < Real(MANDEL_BAILOUT); i ++)
+    {
+        Real x = zx * zx - zy * zy;
+        Real y = Real(2.0) * zx * zy;
+        zx = x + cx;
+        zy = y + cy;
+    }
+
+    return i;
+}
+
+// escape time loop, z starts at c like in the shader
+//
+// returns the iteration count i, z is left at the value the shader uses
+// for the smooth coloring
+template <typename Real>
+inline int IterateEscape(Real cx, Real cy, int maxIterations, Real& zx, Real& zy)
+{
+    zx = cx;
+    zy = cy;
+
+    return ContinueEscape<Real>(cx, cy, 0, maxIterations, zx, zy);
+}
+
+// periodicity check, orbits that come back closer than this to an earlier
+// point are taken as captured by an attracting cycle
+//
+// the distance scales with the pixel size: at that distance two orbits are
+// as far apart as neighbouring pixels, anything closer is below what the
+// view can show anyway
+const double PERIODICITY_EPSILON_SCALE = 1e-3;
+
+inline double PeriodicityEpsilon(double pixelSize)
+{
+    return pixelSize * PERIODICITY_EPSILON_SCALE;
+}
+
+// first iteration whose z replaces c as the saved value, most escaping
+// points are gone before and never pay for a save
+const int PERIODICITY_FIRST_SAVE = 16;
+
+// IterateEscape() with Brent's cycle detection: z is saved at the
+// iterations 16, 32, 64, ... and every step is compared against the last
+// saved value (c before the first save). Once the save interval exceeds the
+// period and the orbit has settled onto the cycle, the check fires within
+// one interval.
+//
+// returns the iteration the cycle was found at with periodic set, or the
+// same as IterateEscape(); epsilon2 is the squared distance
+//
+// ContinueEscapePeriodic() picks up an orbit at z after start iterations,
+// the check starts over from there
+template <typename Real>
+inline int ContinueEscapePeriodic(Real cx, Real cy, int start, int maxIterations, Real epsilon2,
+                                  Real& zx, Real& zy, bool& periodic)
+{
+    periodic = false;
+
+    Real savedX = zx;
+    Real savedY = zy;
+    int savePoint = start + PERIODICITY_FIRST_SAVE;
+
+    int i;
+    for ( i = start; i < maxIterations && zx * zx + zy * zy < Real(MANDEL_BAILOUT); i ++)
+    {
+        Real x = zx * zx - zy * zy;
+        Real y = Real(2.0) * zx * zy;
+        zx = x + cx;
+        zy = y + cy;
+
+        Real dx = zx - savedX;
+        Real dy = zy - savedY;
+        if ( dx * dx + dy * dy < epsilon2 )
+        {
+            periodic = true;
+            return i + 1;
+        }
+
+        if ( i + 1 == savePoint )
+        {
+            savedX = zx;
+            savedY = zy;
+            savePoint *= 2;
+        }
+    }
+
+    return i;
+}
+
+template <typename Real>
+inline int IterateEscapePeriodic(Real cx, Real cy, int maxIterations, Real epsilon2,
+                                 Real& zx, Real& zy, bool& periodic)
+{
+    zx = cx;
+    zy = cy;
+
+    return ContinueEscapePeriodic<Real>(cx, cy, 0, maxIterations, epsilon2, zx, zy, periodic);
+}
+
+// Normalized Iteration Count to get a smoother image
+// smooth iter = iter + ( log(log(bailout)-log(log(cabs(z))) )/log(2)
+//
+// returns the continuous iteration count, the shader divides it by
+// maxIterations to get the lookup texture coordinate
+//
+// pixels that never escape keep the full iteration count: in the shader
+// they end up at or beyond the right edge of the lookup texture (or at NaN
+// when |z| < 1), which is the same color as the early-out pixels
+inline float SmoothIteration(int iterations, double norm2, int maxIterations)
+{
+    if ( iterations >= maxIterations )
+        return float(maxIterations);
+
+    return float(iterations) - logf(logf(float(norm2)) / 2.0f) / MANDEL_LOG_2;
+}
+
+// full per pixel evaluation, returns the iteration count
+template <typename Real>
+inline int EvaluatePixel(double cx, double cy, int maxIterations, float& smooth)
+{
+    if ( IsInCardioidOrBulb(cx, cy) )
+    {
+        smooth = float(maxIterations);
+        return maxIterations;
+    }
+
+    Real zx, zy;
+    int i = IterateEscape<Real>(Real(cx), Real(cy), maxIterations, zx, zy);
+    smooth = SmoothIteration(i, double(zx * zx + zy * zy), maxIterations);
+    return i;
+}
+
+#endif // MANDELBROTKERNEL_H
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mandelbrotpalette.h"
+#include "pngcodec.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+// the tools are built in their own directory of the source tree or in a
+// shadow build directory next to it
+static const int TOOL_PALETTE_LEVELS = 3;
+
+MandelbrotPalette::MandelbrotPalette()
+{
+}
+
+bool MandelbrotPalette::LoadFromPng(const char* fileName)
+{
+    int width, height;
+    std::vector<unsigned char> rgba;
+
+    if ( !ReadPng(fileName, width, height, rgba) )
+        return false;
+
+    // the texture is sampled at t = 0.0, the first row
+    SetColors(&rgba[0], width);
+    return true;
+}
+
+void MandelbrotPalette::SetColors(const unsigned char* rgba, int count)
+{
+    colors.assign(rgba, rgba + count * 4);
+}
+
+void MandelbrotPalette::Lookup(float s, unsigned char* rgba) const
+{
+    int size = Size();
+
+    if ( size == 0 )
+    {
+        rgba[0] = rgba[1] = rgba[2] = 0;
+        rgba[3] = 255;
+        return;
+    }
+
+    // NaN goes to the right edge, like the interior pixels
+    if ( !(s == s) )
+        s = 1.0f;
+
+    // linear filtering between the two nearest texel centers,
+    // clamp to edge at both ends
+    float texel = s * float(size) - 0.5f;
+    if ( texel < 0.0f )
+        texel = 0.0f;
+    if ( texel > float(size - 1) )
+        texel = float(size - 1);
+
+    int index0 = int(texel);
+    int index1 = index0 + 1 < size ? index0 + 1 : index0;
+    float weight = texel - float(index0);
+
+    const unsigned char* c0 = &colors[index0 * 4];
+    const unsigned char* c1 = &colors[index1 * 4];
+
+    for ( int i = 0; i < 4; i ++)
+    {
+        float value = float(c0[i]) + (float(c1[i]) - float(c0[i])) * weight;
+        rgba[i] = (unsigned char)(value + 0.5f);
+    }
+}
+
+void ColorizeIteration(const MandelbrotPalette* palette, float smooth, int maxIterations, unsigned char* rgba)
+{
+    float s = smooth / float(maxIterations);
+
+    if ( palette && !palette->IsEmpty() )
+    {
+        palette->Lookup(s, rgba);
+    }
+    else
+    {
+        // no palette, gray scale
+        float clamped = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+        rgba[0] = rgba[1] = rgba[2] = (unsigned char)(clamped * 255.0f + 0.5f);
+        rgba[3] = 255;
+    }
+}
+
+// directory of the running executable, from executable (argv[0]) where the
+// system does not tell; empty if it has no directory part
+static std::string ExecutableDirectory(const char* executable)
+{
+    std::string path;
+#if defined(_WIN32)
+    char buffer[MAX_PATH];
+    DWORD length = GetModuleFileNameA(0, buffer, MAX_PATH);
+    if ( length > 0 && length < MAX_PATH )
+        path.assign(buffer, length);
+#elif defined(__linux__)
+    char buffer[4096];
+    ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+    if ( length > 0 && length < ssize_t(sizeof(buffer)) )
+        path.assign(buffer, size_t(length));
+#endif
+    if ( path.empty() && executable )
+        path = executable;
+
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+}
+
+bool LoadToolPalette(MandelbrotPalette& palette, const std::string& fileName, const char* executable,
+                     std::string& path)
+{
+    palette = MandelbrotPalette();
+
+    if ( !fileName.empty() )
+    {
+        path = fileName;
+        return palette.LoadFromPng(path.c_str());
+    }
+
+    std::string directory = ExecutableDirectory(executable);
+    for ( int level = 0; level <= TOOL_PALETTE_LEVELS && !directory.empty(); level ++)
+    {
+        path = directory + "/Resources/lookup.png";
+        if ( palette.LoadFromPng(path.c_str()) )
+            return true;
+        directory += "/..";
+    }
+
+    path = "Resources/lookup.png";
+    return palette.LoadFromPng(path.c_str());
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MANDELBROTPALETTE_H
+#define MANDELBROTPALETTE_H
+
+#include <string>
+#include <vector>
+
+// cpu copy of the lookUpTexture
+//
+// Lookup() does what texture2D(lookUpTexture, vec2(s, 0.0)) does with the
+// GL_LINEAR / GL_CLAMP_TO_EDGE parameters set in MandelGLWidget::initializeGL
+class MandelbrotPalette
+{
+public:
+    MandelbrotPalette();
+
+    // loads Resources/lookup.png (or any other png), only the first row is used
+    bool LoadFromPng(const char* fileName);
+
+    // 4 bytes per color, RGBA
+    void SetColors(const unsigned char* rgba, int count);
+
+    int Size() const { return int(colors.size() / 4); }
+    bool IsEmpty() const { return colors.empty(); }
+
+    // Size() RGBA colors, 0 if there are none
+    const unsigned char* Colors() const { return colors.empty() ? 0 : &colors[0]; }
+
+    // writes the RGBA color for the lookup coordinate s, opaque black if
+    // the palette is empty
+    void Lookup(float s, unsigned char* rgba) const;
+
+private:
+    std::vector<unsigned char> colors;
+};
+
+// maps a continuous iteration count to a color, smooth / maxIterations is the
+// lookup coordinate like in the shader; gray scale if there is no palette or
+// an empty one
+void ColorizeIteration(const MandelbrotPalette* palette, float smooth, int maxIterations, unsigned char* rgba);
+
+// palette of the command line tools: fileName, or if that is empty
+// Resources/lookup.png of the source tree the executable was built in (up
+// to a few directories above it) or of the working directory. False and an
+// empty palette, which renders gray scale, if it cannot be read; path is
+// the file that was looked for
+bool LoadToolPalette(MandelbrotPalette& palette, const std::string& fileName, const char* executable,
+                     std::string& path);
+
+#endif // MANDELBROTPALETTE_H
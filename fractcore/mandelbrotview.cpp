@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mandelbrotview.h"
+#include <math.h>
+
+MandelbrotView::MandelbrotView()
+{
+    // same defaults as MandelGLWidget
+    width = 1280;
+    height = 720;
+    centerX = -0.5;
+    centerY = 0.0;
+    preciseCenterX = BigFloat(centerX);
+    preciseCenterY = BigFloat(centerY);
+    pivotX = centerX;
+    pivotY = centerY;
+    scale = 0.8;
+    rotation = 0.0;
+    maxIterations = 64;
+}
+
+void MandelbrotView::SetCenter(const BigFloat& x, const BigFloat& y)
+{
+    preciseCenterX = x;
+    preciseCenterY = y;
+    centerX = x.ToDouble();
+    centerY = y.ToDouble();
+}
+
+BigFloat MandelbrotView::PreciseCenterX() const
+{
+    if ( preciseCenterX.ToDouble() != centerX )
+        return BigFloat(centerX);
+    return preciseCenterX;
+}
+
+BigFloat MandelbrotView::PreciseCenterY() const
+{
+    if ( preciseCenterY.ToDouble() != centerY )
+        return BigFloat(centerY);
+    return preciseCenterY;
+}
+
+void MandelbrotView::PixelToComplex(double px, double py, double& cx, double& cy) const
+{
+    ViewTransform(*this).Map(px, py, cx, cy);
+}
+
+bool MandelbrotView::operator==(const MandelbrotView& other) const
+{
+    return width == other.width && height == other.height &&
+           centerX == other.centerX && centerY == other.centerY &&
+           PreciseCenterX() == other.PreciseCenterX() &&
+           PreciseCenterY() == other.PreciseCenterY() &&
+           pivotX == other.pivotX && pivotY == other.pivotY &&
+           scale == other.scale && rotation == other.rotation &&
+           maxIterations == other.maxIterations;
+}
+
+ViewTransform::ViewTransform(const MandelbrotView& view)
+{
+    width = double(view.width);
+    height = double(view.height);
+    stepX = view.WHScale() * 4.0 / view.scale;
+    stepY = 4.0 / view.scale;
+    centerX = view.centerX;
+    centerY = view.centerY;
+    pivotX = view.pivotX;
+    pivotY = view.pivotY;
+    cosRot = cos(view.rotation);
+    sinRot = sin(view.rotation);
+}
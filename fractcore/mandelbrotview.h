@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MANDELBROTVIEW_H
+#define MANDELBROTVIEW_H
+
+#include "bigfloat.h"
+
+// view parameters of the mandelbrot pass
+//
+// the members mirror the uniforms MandelGLWidget::RenderFractal uploads to
+// mandelbrot_vert.glsl / mandelbrot_frag.glsl, so a widget state can be handed
+// to the cpu renderer without any conversion
+struct MandelbrotView
+{
+    MandelbrotView();
+
+    int width;              // image size in pixels
+    int height;
+
+    double centerX;         // center
+    double centerY;
+    double pivotX;          // rotatePivot
+    double pivotY;
+    double scale;           // scale
+    double rotation;        // rotRadian
+    int maxIterations;      // maxIterations
+
+    // exact center for deep zooms, centerX / centerY hold its double
+    // rounding; set both through SetCenter()
+    BigFloat preciseCenterX;
+    BigFloat preciseCenterY;
+
+    void SetCenter(const BigFloat& x, const BigFloat& y);
+
+    // the precise center, or centerX / centerY if the doubles were changed
+    // without SetCenter()
+    BigFloat PreciseCenterX() const;
+    BigFloat PreciseCenterY() const;
+
+    // use to keep the proportion of mandelbrot set (whScale)
+    double WHScale() const { return double(width) / double(height); }
+
+    // size of one pixel in the complex plane
+    double PixelSize() const { return 4.0 / (scale * double(height)); }
+
+    // maps an image position (origin at the top-left corner, pixel centers at
+    // +0.5) to the complex plane, the same transform as mandelbrot_vert.glsl
+    // followed by the rotation at the top of mandelbrot_frag.glsl
+    void PixelToComplex(double px, double py, double& cx, double& cy) const;
+
+    bool operator==(const MandelbrotView& other) const;
+    bool operator!=(const MandelbrotView& other) const { return !(*this == other); }
+};
+
+// PixelToComplex() with the rotation terms computed once, for the inner
+// loops of the renderers
+class ViewTransform
+{
+public:
+    ViewTransform(const MandelbrotView& view);
+
+    void Map(double px, double py, double& cx, double& cy) const
+    {
+        // mandelbrot_vert.glsl, the quad uv runs from (0, 1) at the bottom-left
+        // corner to (1, 0) at the top-right one, so the image row is flipped
+        double u = px / width;
+        double v = 1.0 - py / height;
+
+        double texCoordX = (u - 0.5) * stepX;
+        double texCoordY = (v - 0.5) * stepY;
+
+        // mandelbrot_frag.glsl, rotate around the pivot
+        double texCoordModX = texCoordX - pivotX + centerX;
+        double texCoordModY = texCoordY - pivotY + centerY;
+
+        cx = texCoordModX * cosRot - texCoordModY * sinRot + pivotX;
+        cy = texCoordModY * cosRot + texCoordModX * sinRot + pivotY;
+    }
+
+    // inverse of Map(), the image position a point of the complex plane
+    // is shown at
+    void Unmap(double cx, double cy, double& px, double& py) const
+    {
+        double offsetX = cx - pivotX;
+        double offsetY = cy - pivotY;
+
+        double texCoordX = offsetX * cosRot + offsetY * sinRot + pivotX - centerX;
+        double texCoordY = offsetY * cosRot - offsetX * sinRot + pivotY - centerY;
+
+        px = (texCoordX / stepX + 0.5) * width;
+        py = (0.5 - texCoordY / stepY) * height;
+    }
+
+private:
+    double width, height;
+    double stepX, stepY;
+    double centerX, centerY;
+    double pivotX, pivotY;
+    double cosRot, sinRot;
+};
+
+#endif // MANDELBROTVIEW_H
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perturbationrenderer.h"
+#include "mandelbrotkernel.h"
+#include "mandelbrotpalette.h"
+#include "tilescheduler.h"
+
+#include <chrono>
+#include <math.h>
+
+ReferenceOrbit::ReferenceOrbit()
+{
+    escaped = false;
+}
+
+PerturbationStats::PerturbationStats()
+{
+    references = 0;
+    referenceLength = 0;
+    glitchedPixels = 0;
+    unresolvedPixels = 0;
+    referenceSeconds = 0.0;
+    seriesOrder = 0;
+    skippedIterations = 0;
+}
+
+PerturbationRenderer::PerturbationRenderer()
+{
+    palette = 0;
+    maxReferences = 32;
+    glitchTolerance = 1e-6;
+    seriesEnabled = true;
+    seriesMaxOrder = SeriesApproximation().MaxOrder();
+}
+
+void PerturbationRenderer::SetPalette(const MandelbrotPalette* palette)
+{
+    this->palette = palette;
+}
+
+void PerturbationRenderer::SetMaxReferences(int maxReferences)
+{
+    this->maxReferences = maxReferences < 0 ? 0 : maxReferences;
+}
+
+void PerturbationRenderer::SetGlitchTolerance(double tolerance)
+{
+    glitchTolerance = tolerance;
+}
+
+void PerturbationRenderer::SetSeriesApproximation(bool enabled)
+{
+    seriesEnabled = enabled;
+}
+
+void PerturbationRenderer::SetSeriesMaxOrder(int maxOrder)
+{
+    seriesMaxOrder = maxOrder;
+}
+
+bool PerturbationRenderer::IsDeepView(const MandelbrotView& view)
+{
+    return view.PixelSize() < PERTURBATION_PIXEL_SIZE;
+}
+
+void PerturbationRenderer::ComputeReference(const BigFloat& cx, const BigFloat& cy, int maxIterations,
+                                            ReferenceOrbit& orbit) const
+{
+    orbit.centerX = cx;
+    orbit.centerY = cy;
+    orbit.zx.clear();
+    orbit.zy.clear();
+    orbit.glitchNorm2.clear();
+    orbit.escaped = false;
+
+    BigFloat zx(cx);
+    BigFloat zy(cy);
+
+    for ( int n = 0; n < maxIterations; n ++)
+    {
+        double x = zx.ToDouble();
+        double y = zy.ToDouble();
+        double norm2 = x * x + y * y;
+
+        orbit.zx.push_back(x);
+        orbit.zy.push_back(y);
+        orbit.glitchNorm2.push_back(glitchTolerance * norm2);
+
+        if ( norm2 >= MANDEL_BAILOUT )
+        {
+            orbit.escaped = true;
+            break;
+        }
+
+        BigFloat zx2 = zx * zx;
+        BigFloat zy2 = zy * zy;
+        BigFloat zxy = zx * zy;
+
+        zx = zx2 - zy2 + cx;
+        zy = zxy.Doubled() + cy;
+    }
+}
+
+void PerturbationRenderer::IteratePoints(const ReferenceOrbit& orbit, const double* dcx, const double* dcy, int count,
+                                         int maxIterations, int* iterations, float* smooth, unsigned char* glitched,
+                                         KernelStats* stats) const
+{
+    // z starts at c, so the offset starts at dc
+    IteratePoints(orbit, 0, dcx, dcy, dcx, dcy, count, maxIterations, iterations, smooth, glitched, stats);
+}
+
+void PerturbationRenderer::IteratePoints(const ReferenceOrbit& orbit, int startIteration, const double* startDx, const double* startDy,
+                                         const double* dcx, const double* dcy, int count, int maxIterations,
+                                         int* iterations, float* smooth, unsigned char* glitched, KernelStats* stats) const
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const int length = int(orbit.zx.size());
+    const double* zx = orbit.zx.empty() ? 0 : &orbit.zx[0];
+    const double* zy = orbit.zy.empty() ? 0 : &orbit.zy[0];
+    const double* glitchNorm2 = orbit.glitchNorm2.empty() ? 0 : &orbit.glitchNorm2[0];
+
+    long long totalIterations = 0;
+
+    for ( int i = 0; i < count; i ++)
+    {
+        const double cx = dcx[i];
+        const double cy = dcy[i];
+
+        double dx = startDx[i];
+        double dy = startDy[i];
+        double norm2 = 0.0;
+        bool glitch = false;
+
+        int n;
+        for ( n = startIteration; n < maxIterations; n ++)
+        {
+            // the reference escaped before this point did
+            if ( n >= length )
+            {
+                glitch = true;
+                break;
+            }
+
+            double x = zx[n] + dx;
+            double y = zy[n] + dy;
+            norm2 = x * x + y * y;
+
+            if ( norm2 >= MANDEL_BAILOUT )
+                break;
+
+            if ( norm2 < glitchNorm2[n] )
+            {
+                glitch = true;
+                break;
+            }
+
+            // d' = 2 Z d + d^2 + dc
+            double tx = 2.0 * (zx[n] * dx - zy[n] * dy) + (dx * dx - dy * dy) + cx;
+            dy = 2.0 * (zx[n] * dy + zy[n] * dx) + 2.0 * dx * dy + cy;
+            dx = tx;
+        }
+
+        iterations[i] = n;
+        smooth[i] = glitch ? float(n) : SmoothIteration(n, norm2, maxIterations);
+        glitched[i] = glitch ? 1 : 0;
+        totalIterations += n - startIteration;
+    }
+
+    if ( stats )
+    {
+        KernelStats callStats;
+        callStats.pixels = count;
+        callStats.iterations = totalIterations;
+        callStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats->Add(callStats);
+    }
+}
+
+// probes of the series: SERIES_BORDER_PROBES along every edge of the
+// frame, where the offsets are the largest, and a grid of
+// SERIES_INTERIOR_PROBES^2 inside it
+static const int SERIES_BORDER_PROBES = 16;
+static const int SERIES_INTERIOR_PROBES = 5;
+
+// fits the series to the frame
+static bool FitSeries(const ViewTransform& transform, int width, int height, double pixelSize,
+                      const ReferenceOrbit& orbit, SeriesApproximation& series)
+{
+    std::vector<double> probeX, probeY;
+    double radius = 0.0;
+
+    for ( int edge = 0; edge < 4; edge ++)
+    {
+        for ( int i = 0; i < SERIES_BORDER_PROBES; i ++)
+        {
+            double t = double(i) / SERIES_BORDER_PROBES;
+            double u = edge == 0 ? t : edge == 1 ? 1.0 : edge == 2 ? 1.0 - t : 0.0;
+            double v = edge == 0 ? 0.0 : edge == 1 ? t : edge == 2 ? 1.0 : 1.0 - t;
+
+            double px, py;
+            transform.Map(u * width, v * height, px, py);
+            probeX.push_back(px);
+            probeY.push_back(py);
+
+            double distance = sqrt(px * px + py * py);
+            if ( distance > radius )
+                radius = distance;
+        }
+    }
+
+    for ( int i = 1; i <= SERIES_INTERIOR_PROBES; i ++)
+    {
+        for ( int j = 1; j <= SERIES_INTERIOR_PROBES; j ++)
+        {
+            double px, py;
+            transform.Map(width * double(j) / (SERIES_INTERIOR_PROBES + 1),
+                          height * double(i) / (SERIES_INTERIOR_PROBES + 1), px, py);
+            probeX.push_back(px);
+            probeY.push_back(py);
+        }
+    }
+
+    return series.Compute(orbit, radius, pixelSize, &probeX[0], &probeY[0], int(probeX.size()));
+}
+
+bool PerturbationRenderer::Render(const MandelbrotView& view, FractalBuffer& buffer,
+                                  TileScheduler* scheduler, PerturbationStats* stats) const
+{
+    const int width = view.width;
+    const int height = view.height;
+    const int maxIterations = view.maxIterations;
+    const size_t pixelCount = size_t(width) * height;
+
+    PerturbationStats frameStats;
+
+    // pixel offsets from the view center: the usual transform with the
+    // center moved to the origin
+    MandelbrotView local(view);
+    local.centerX = 0.0;
+    local.centerY = 0.0;
+    local.pivotX = view.pivotX - view.centerX;
+    local.pivotY = view.pivotY - view.centerY;
+    const ViewTransform transform(local);
+
+    const int bits = BigFloat::BitsForPixelSize(view.PixelSize());
+    BigFloat centerX = view.PreciseCenterX();
+    BigFloat centerY = view.PreciseCenterY();
+    centerX.SetFractionBits(bits);
+    centerY.SetFractionBits(bits);
+
+    std::vector<int> pixelIterations(pixelCount);
+    std::vector<float> pixelSmooth(pixelCount);
+
+    // 1 for the pixels the next pass has to render
+    std::vector<unsigned char> pixelGlitched(pixelCount, 1);
+
+    // the reference c relative to the view center
+    double referenceX = 0.0;
+    double referenceY = 0.0;
+    BigFloat referenceCenterX(centerX);
+    BigFloat referenceCenterY(centerY);
+
+    ReferenceOrbit orbit;
+    SeriesApproximation series;
+    series.SetMaxOrder(seriesMaxOrder);
+    const int threadCount = scheduler ? scheduler->ThreadCount() : 1;
+
+    // the cardioid and bulb test takes c in double, past the double engine
+    // every pixel of the frame rounds to about the same c there
+    const bool interiorTest = !IsDeepView(view);
+
+    for ( int pass = 0; pass <= maxReferences; pass ++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ComputeReference(referenceCenterX, referenceCenterY, maxIterations, orbit);
+        frameStats.referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        frameStats.references ++;
+        if ( pass == 0 )
+            frameStats.referenceLength = int(orbit.zx.size());
+
+        // the series is fitted to the primary reference only, the few
+        // pixels left for secondary references iterate from the start
+        bool useSeries = false;
+        if ( pass == 0 && seriesEnabled )
+        {
+            start = std::chrono::steady_clock::now();
+            useSeries = FitSeries(transform, width, height, view.PixelSize(), orbit, series);
+            frameStats.referenceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if ( useSeries )
+            {
+                frameStats.seriesOrder = series.Order();
+                frameStats.skippedIterations = series.SkippedIterations();
+            }
+        }
+
+        std::vector<KernelStats> workerStats(threadCount);
+
+        TileScheduler::TileFunction renderTile = [&](const RenderTile& tile, int worker)
+        {
+            std::vector<double> packedDx(tile.width), packedDy(tile.width);
+            std::vector<double> packedStartDx(tile.width), packedStartDy(tile.width);
+            std::vector<int> packedColumn(tile.width), packedIterations(tile.width);
+            std::vector<float> packedSmooth(tile.width);
+            std::vector<unsigned char> packedGlitched(tile.width);
+
+            for ( int row = tile.y; row < tile.y + tile.height; row ++)
+            {
+                int count = 0;
+
+                for ( int column = tile.x; column < tile.x + tile.width; column ++)
+                {
+                    size_t offset = size_t(row) * width + column;
+                    if ( !pixelGlitched[offset] )
+                        continue;
+
+                    double dcx, dcy;
+                    transform.Map(column + 0.5, row + 0.5, dcx, dcy);
+
+                    if ( pass == 0 && interiorTest && IsInCardioidOrBulb(view.centerX + dcx, view.centerY + dcy) )
+                    {
+                        pixelIterations[offset] = maxIterations;
+                        pixelSmooth[offset] = float(maxIterations);
+                        pixelGlitched[offset] = 0;
+                        continue;
+                    }
+
+                    packedDx[count] = dcx - referenceX;
+                    packedDy[count] = dcy - referenceY;
+                    packedColumn[count] = column;
+
+                    if ( useSeries )
+                        series.Evaluate(packedDx[count], packedDy[count], packedStartDx[count], packedStartDy[count]);
+                    count ++;
+                }
+
+                if ( count == 0 )
+                    continue;
+
+                if ( useSeries )
+                {
+                    IteratePoints(orbit, series.SkippedIterations(), &packedStartDx[0], &packedStartDy[0],
+                                  &packedDx[0], &packedDy[0], count, maxIterations,
+                                  &packedIterations[0], &packedSmooth[0], &packedGlitched[0], &workerStats[worker]);
+                }
+                else
+                {
+                    IteratePoints(orbit, &packedDx[0], &packedDy[0], count, maxIterations,
+                                  &packedIterations[0], &packedSmooth[0], &packedGlitched[0], &workerStats[worker]);
+                }
+
+                for ( int i = 0; i < count; i ++)
+                {
+                    size_t offset = size_t(row) * width + packedColumn[i];
+                    pixelIterations[offset] = packedIterations[i];
+                    pixelSmooth[offset] = packedSmooth[i];
+                    pixelGlitched[offset] = packedGlitched[i];
+                }
+            }
+        };
+
+        if ( scheduler )
+        {
+            if ( !scheduler->Run(width, height, renderTile) )
+                return false;
+        }
+        else
+        {
+            RenderTile whole = { 0, 0, width, height };
+            renderTile(whole, 0);
+        }
+
+        for ( size_t i = 0; i < workerStats.size(); i ++)
+            frameStats.kernel.Add(workerStats[i]);
+
+        // what is left for the next reference
+        long long glitchCount = 0;
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for ( int y = 0; y < height; y ++)
+        {
+            for ( int x = 0; x < width; x ++)
+            {
+                if ( pixelGlitched[size_t(y) * width + x] )
+                {
+                    glitchCount ++;
+                    sumX += x;
+                    sumY += y;
+                }
+            }
+        }
+
+        if ( pass == 0 )
+            frameStats.glitchedPixels = glitchCount;
+        frameStats.unresolvedPixels = glitchCount;
+
+        if ( glitchCount == 0 || pass == maxReferences )
+            break;
+
+        // the next reference is the glitched pixel closest to the centroid
+        // of all glitched pixels, it resolves at least itself
+        double centroidX = sumX / double(glitchCount);
+        double centroidY = sumY / double(glitchCount);
+        int bestX = 0;
+        int bestY = 0;
+        double bestDistance = -1.0;
+        for ( int y = 0; y < height; y ++)
+        {
+            for ( int x = 0; x < width; x ++)
+            {
+                if ( !pixelGlitched[size_t(y) * width + x] )
+                    continue;
+
+                double distance = (x - centroidX) * (x - centroidX) + (y - centroidY) * (y - centroidY);
+                if ( bestDistance < 0.0 || distance < bestDistance )
+                {
+                    bestDistance = distance;
+                    bestX = x;
+                    bestY = y;
+                }
+            }
+        }
+
+        transform.Map(bestX + 0.5, bestY + 0.5, referenceX, referenceY);
+        referenceCenterX = centerX + BigFloat(referenceX, bits);
+        referenceCenterY = centerY + BigFloat(referenceY, bits);
+    }
+
+    for ( int y = 0; y < height; y ++)
+    {
+        for ( int x = 0; x < width; x ++)
+        {
+            size_t source = size_t(y) * width + x;
+            size_t target = size_t(y) * buffer.stride + x;
+
+            if ( buffer.iterations )
+                buffer.iterations[target] = pixelIterations[source];
+            if ( buffer.smooth )
+                buffer.smooth[target] = pixelSmooth[source];
+            if ( buffer.rgba )
+                ColorizeIteration(palette, pixelSmooth[source], maxIterations, buffer.rgba + target * 4);
+        }
+    }
+
+    if ( stats )
+        *stats = frameStats;
+
+    return true;
+}
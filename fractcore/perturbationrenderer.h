@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERTURBATIONRENDERER_H
+#define PERTURBATIONRENDERER_H
+
+#include <vector>
+
+#include "bigfloat.h"
+#include "mandelbrotengine.h"
+#include "seriesapproximation.h"
+
+class MandelbrotPalette;
+class TileScheduler;
+
+// below this pixel size the double precision engine runs out of bits
+const double PERTURBATION_PIXEL_SIZE = 1e-12;
+
+// arbitrary precision orbit of one point, rounded to double
+//
+// z[0] = c like in the shader, the orbit stops at the first escaped value
+// or at maxIterations - 1, whatever comes first
+struct ReferenceOrbit
+{
+    ReferenceOrbit();
+
+    BigFloat centerX;               // c of the reference
+    BigFloat centerY;
+
+    std::vector<double> zx;         // Z_n
+    std::vector<double> zy;
+    std::vector<double> glitchNorm2;    // tolerance * |Z_n|^2
+
+    bool escaped;                   // the reference itself left the set
+};
+
+// counters of one Render() call
+struct PerturbationStats
+{
+    PerturbationStats();
+
+    int references;                 // reference orbits, the primary one included
+    int referenceLength;            // iterations of the primary reference
+    long long glitchedPixels;       // pixels the primary reference could not resolve
+    long long unresolvedPixels;     // pixels still glitched after the last reference
+    double referenceSeconds;        // time spent in arbitrary precision
+    int seriesOrder;                // order of the series approximation, 0 if unused
+    int skippedIterations;          // iterations every pixel skipped thanks to it
+    KernelStats kernel;             // delta iterations
+};
+
+// deep zoom renderer
+//
+// only one orbit per frame is computed in arbitrary precision, at the view
+// center. Every pixel c = C + dc then iterates the difference to it in
+// double precision:
+//
+//      d(n+1) = 2 * Z(n) * d(n) + d(n)^2 + dc
+//
+// which stays accurate as long as |Z(n) + d(n)| does not get much smaller
+// than |Z(n)|. Pixels where it does (Pauldelbrot's criterion) are flagged
+// as glitched and rendered again against a secondary reference picked
+// inside the glitched area.
+//
+// like MandelbrotEngine the renderer is immutable while rendering
+class PerturbationRenderer
+{
+public:
+    PerturbationRenderer();
+
+    void SetPalette(const MandelbrotPalette* palette);
+
+    // secondary references per frame, 0 leaves glitched pixels alone
+    void SetMaxReferences(int maxReferences);
+    int MaxReferences() const { return maxReferences; }
+
+    // |Z + d|^2 < tolerance * |Z|^2 marks a glitch
+    void SetGlitchTolerance(double tolerance);
+    double GlitchTolerance() const { return glitchTolerance; }
+
+    // skips the iterations all pixels of the frame share with a series
+    // approximation, on by default
+    void SetSeriesApproximation(bool enabled);
+    bool SeriesApproximationEnabled() const { return seriesEnabled; }
+    void SetSeriesMaxOrder(int maxOrder);
+
+    // true if the view is too deep for MandelbrotEngine
+    static bool IsDeepView(const MandelbrotView& view);
+
+    // iterates the reference point (cx, cy) at its own precision
+    void ComputeReference(const BigFloat& cx, const BigFloat& cy, int maxIterations,
+                          ReferenceOrbit& orbit) const;
+
+    // iterates count points given as offsets (dcx, dcy) from the reference
+    // c; glitched[i] is set to 1 for the points the orbit cannot resolve,
+    // their iteration count is where the glitch was found
+    void IteratePoints(const ReferenceOrbit& orbit, const double* dcx, const double* dcy, int count,
+                       int maxIterations, int* iterations, float* smooth, unsigned char* glitched,
+                       KernelStats* stats = 0) const;
+
+    // same, but the points are already at startIteration with the offsets
+    // (startDx, startDy), see SeriesApproximation
+    void IteratePoints(const ReferenceOrbit& orbit, int startIteration, const double* startDx, const double* startDy,
+                       const double* dcx, const double* dcy, int count, int maxIterations,
+                       int* iterations, float* smooth, unsigned char* glitched, KernelStats* stats = 0) const;
+
+    // renders the whole view around view.PreciseCenterX/Y(), the tiles are
+    // spread over the scheduler if given; returns false if it was cancelled
+    bool Render(const MandelbrotView& view, FractalBuffer& buffer,
+                TileScheduler* scheduler = 0, PerturbationStats* stats = 0) const;
+
+private:
+    const MandelbrotPalette* palette;
+    int maxReferences;
+    double glitchTolerance;
+    bool seriesEnabled;
+    int seriesMaxOrder;
+};
+
+#endif // PERTURBATIONRENDERER_H
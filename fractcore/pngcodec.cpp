@@ -0,0 +1,516 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pngcodec.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+static const unsigned char PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+static unsigned int ReadBE32(const unsigned char* p)
+{
+    return (unsigned int)(p[0]) << 24 | (unsigned int)(p[1]) << 16 |
+           (unsigned int)(p[2]) << 8  | (unsigned int)(p[3]);
+}
+
+static void WriteBE32(unsigned char* p, unsigned int value)
+{
+    p[0] = (unsigned char)(value >> 24);
+    p[1] = (unsigned char)(value >> 16);
+    p[2] = (unsigned char)(value >> 8);
+    p[3] = (unsigned char)(value);
+}
+
+// length, type, body and the crc over type and body
+static void AppendChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* body, size_t length)
+{
+    size_t pos = png.size();
+    png.resize(pos + 12 + length);
+
+    WriteBE32(&png[pos], (unsigned int)(length));
+    memcpy(&png[pos + 4], type, 4);
+    if ( length > 0 )
+        memcpy(&png[pos + 8], body, length);
+
+    uLong crc = crc32(0L, &png[pos + 4], uInt(4 + length));
+    WriteBE32(&png[pos + 8 + length], (unsigned int)(crc));
+}
+
+static int PaethPredictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if ( pa <= pb && pa <= pc )
+        return a;
+    if ( pb <= pc )
+        return b;
+    return c;
+}
+
+// every row with the filter that leaves the smallest sum of absolute
+// values, the usual heuristic; line and previous are the unfiltered rows,
+// row receives the filter byte and rowBytes filtered bytes
+static void FilterRow(const unsigned char* line, const unsigned char* previous, size_t rowBytes, int channels,
+                      unsigned char* filtered, unsigned char* row)
+{
+    long bestSum = -1;
+
+    for ( int filter = 0; filter < 5; filter ++)
+    {
+        long sum = 0;
+        for ( size_t x = 0; x < rowBytes; x ++)
+        {
+            int a = x >= size_t(channels) ? line[x - channels] : 0;
+            int b = previous[x];
+            int c = x >= size_t(channels) ? previous[x - channels] : 0;
+            int predicted = 0;
+
+            switch ( filter )
+            {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) >> 1; break;
+            case 4: predicted = PaethPredictor(a, b, c); break;
+            }
+
+            filtered[x] = (unsigned char)(line[x] - predicted);
+            sum += filtered[x] < 128 ? filtered[x] : 256 - filtered[x];
+        }
+
+        if ( bestSum < 0 || sum < bestSum )
+        {
+            bestSum = sum;
+            row[0] = (unsigned char)(filter);
+            memcpy(row + 1, filtered, rowBytes);
+        }
+    }
+}
+
+static void WriteHeader(unsigned char* header, int width, int height, bool alpha)
+{
+    WriteBE32(header, (unsigned int)(width));
+    WriteBE32(header + 4, (unsigned int)(height));
+    header[8] = 8;                      // bit depth
+    header[9] = alpha ? 6 : 2;          // rgb or rgba
+    header[10] = 0;                     // deflate
+    header[11] = 0;                     // adaptive filtering
+    header[12] = 0;                     // not interlaced
+}
+
+bool ReadPng(const char* fileName, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+    FILE* file = fopen(fileName, "rb");
+    if ( file == 0 )
+        return false;
+
+    std::vector<unsigned char> data;
+    unsigned char chunk[4096];
+    size_t count;
+    while ( (count = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+    {
+        data.insert(data.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    if ( data.empty() )
+        return false;
+
+    return DecodePng(&data[0], data.size(), width, height, rgba);
+}
+
+bool DecodePng(const unsigned char* data, size_t size, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+    if ( size < 8 || memcmp(data, PNG_SIGNATURE, 8) != 0 )
+        return false;
+
+    int bitDepth = 0;
+    int colorType = 0;
+    int interlace = 0;
+    std::vector<unsigned char> palette;
+    std::vector<unsigned char> transparency;
+    std::vector<unsigned char> compressed;
+
+    width = 0;
+    height = 0;
+
+    // walk the chunks
+    size_t pos = 8;
+    while ( pos + 12 <= size )
+    {
+        unsigned int length = ReadBE32(data + pos);
+        const unsigned char* type = data + pos + 4;
+        const unsigned char* body = data + pos + 8;
+
+        if ( length > size - pos - 12 )
+            return false;
+
+        if ( memcmp(type, "IHDR", 4) == 0 && length >= 13 )
+        {
+            width = int(ReadBE32(body));
+            height = int(ReadBE32(body + 4));
+            bitDepth = body[8];
+            colorType = body[9];
+            interlace = body[12];
+        }
+        else if ( memcmp(type, "PLTE", 4) == 0 )
+        {
+            palette.assign(body, body + length);
+        }
+        else if ( memcmp(type, "tRNS", 4) == 0 )
+        {
+            transparency.assign(body, body + length);
+        }
+        else if ( memcmp(type, "IDAT", 4) == 0 )
+        {
+            compressed.insert(compressed.end(), body, body + length);
+        }
+        else if ( memcmp(type, "IEND", 4) == 0 )
+        {
+            break;
+        }
+
+        pos += 12 + length;
+    }
+
+    if ( width <= 0 || height <= 0 || bitDepth != 8 || interlace != 0 || compressed.empty() )
+        return false;
+
+    int channels;
+    switch ( colorType )
+    {
+    case 0: channels = 1; break;    // gray
+    case 2: channels = 3; break;    // rgb
+    case 3: channels = 1; break;    // palette
+    case 4: channels = 2; break;    // gray + alpha
+    case 6: channels = 4; break;    // rgba
+    default:
+        return false;
+    }
+
+    size_t rowBytes = size_t(width) * channels;
+    std::vector<unsigned char> raw((rowBytes + 1) * height);
+
+    uLongf rawSize = uLongf(raw.size());
+    if ( uncompress(&raw[0], &rawSize, &compressed[0], uLong(compressed.size())) != Z_OK ||
+         rawSize != raw.size() )
+        return false;
+
+    // undo the scanline filters in place
+    std::vector<unsigned char> previous(rowBytes, 0);
+    for ( int y = 0; y < height; y ++)
+    {
+        unsigned char* row = &raw[y * (rowBytes + 1)];
+        unsigned char filter = row[0];
+        unsigned char* line = row + 1;
+
+        for ( size_t x = 0; x < rowBytes; x ++)
+        {
+            int a = x >= size_t(channels) ? line[x - channels] : 0;
+            int b = previous[x];
+            int c = x >= size_t(channels) ? previous[x - channels] : 0;
+
+            switch ( filter )
+            {
+            case 0: break;
+            case 1: line[x] = (unsigned char)(line[x] + a); break;
+            case 2: line[x] = (unsigned char)(line[x] + b); break;
+            case 3: line[x] = (unsigned char)(line[x] + ((a + b) >> 1)); break;
+            case 4: line[x] = (unsigned char)(line[x] + PaethPredictor(a, b, c)); break;
+            default:
+                return false;
+            }
+        }
+
+        memcpy(&previous[0], line, rowBytes);
+    }
+
+    // expand to rgba
+    rgba.resize(size_t(width) * height * 4);
+    for ( int y = 0; y < height; y ++)
+    {
+        const unsigned char* line = &raw[y * (rowBytes + 1) + 1];
+        unsigned char* out = &rgba[size_t(y) * width * 4];
+
+        for ( int x = 0; x < width; x ++, out += 4)
+        {
+            const unsigned char* in = line + x * channels;
+            switch ( colorType )
+            {
+            case 0:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = 255;
+                break;
+            case 2:
+                out[0] = in[0];
+                out[1] = in[1];
+                out[2] = in[2];
+                out[3] = 255;
+                break;
+            case 3:
+                if ( size_t(in[0]) * 3 + 2 >= palette.size() )
+                    return false;
+                out[0] = palette[in[0] * 3];
+                out[1] = palette[in[0] * 3 + 1];
+                out[2] = palette[in[0] * 3 + 2];
+                out[3] = in[0] < transparency.size() ? transparency[in[0]] : 255;
+                break;
+            case 4:
+                out[0] = out[1] = out[2] = in[0];
+                out[3] = in[1];
+                break;
+            case 6:
+                memcpy(out, in, 4);
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool EncodePng(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& png, int level)
+{
+    if ( width <= 0 || height <= 0 )
+        return false;
+
+    const size_t pixels = size_t(width) * height;
+    bool opaque = true;
+    for ( size_t i = 0; i < pixels && opaque; i ++)
+        opaque = rgba[i * 4 + 3] == 255;
+
+    const int channels = opaque ? 3 : 4;
+    const size_t rowBytes = size_t(width) * channels;
+
+    std::vector<unsigned char> raw((rowBytes + 1) * height);
+    std::vector<unsigned char> line(rowBytes);
+    std::vector<unsigned char> previous(rowBytes, 0);
+    std::vector<unsigned char> filtered(rowBytes);
+
+    for ( int y = 0; y < height; y ++)
+    {
+        const unsigned char* in = rgba + size_t(y) * width * 4;
+        for ( int x = 0; x < width; x ++)
+            memcpy(&line[size_t(x) * channels], in + x * 4, channels);
+
+        FilterRow(&line[0], &previous[0], rowBytes, channels, &filtered[0], &raw[y * (rowBytes + 1)]);
+
+        line.swap(previous);
+    }
+
+    uLongf compressedSize = compressBound(uLong(raw.size()));
+    std::vector<unsigned char> compressed(compressedSize);
+    if ( compress2(&compressed[0], &compressedSize, &raw[0], uLong(raw.size()), level) != Z_OK )
+        return false;
+
+    unsigned char header[13];
+    WriteHeader(header, width, height, !opaque);
+
+    png.assign(PNG_SIGNATURE, PNG_SIGNATURE + 8);
+    AppendChunk(png, "IHDR", header, sizeof(header));
+    AppendChunk(png, "IDAT", &compressed[0], compressedSize);
+    AppendChunk(png, "IEND", 0, 0);
+
+    return true;
+}
+
+bool WritePng(const char* fileName, const unsigned char* rgba, int width, int height, int level)
+{
+    std::vector<unsigned char> png;
+    if ( !EncodePng(rgba, width, height, png, level) )
+        return false;
+
+    FILE* file = fopen(fileName, "wb");
+    if ( file == 0 )
+        return false;
+
+    bool ok = fwrite(&png[0], 1, png.size(), file) == png.size();
+    return fclose(file) == 0 && ok;
+}
+
+PngWriter::PngWriter()
+{
+    file = 0;
+    stream = 0;
+    width = 0;
+    height = 0;
+    channels = 3;
+    rowsWritten = 0;
+    bytesWritten = 0;
+    failed = false;
+}
+
+PngWriter::~PngWriter()
+{
+    if ( stream )
+    {
+        deflateEnd(stream);
+        delete stream;
+    }
+    if ( file )
+        fclose(file);
+}
+
+bool PngWriter::Open(const char* fileName, int width, int height, bool alpha, int level)
+{
+    if ( file || width <= 0 || height <= 0 )
+        return false;
+
+    file = fopen(fileName, "wb");
+    if ( file == 0 )
+        return false;
+
+    stream = new z_stream();
+    if ( deflateInit(stream, level) != Z_OK )
+    {
+        delete stream;
+        stream = 0;
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    channels = alpha ? 4 : 3;
+    rowsWritten = 0;
+    bytesWritten = 0;
+    failed = false;
+
+    size_t rowBytes = size_t(width) * channels;
+    line.resize(rowBytes);
+    previous.assign(rowBytes, 0);
+    filtered.resize(rowBytes);
+    row.resize(rowBytes + 1);
+    compressed.resize(CHUNK_SIZE);
+
+    unsigned char header[13];
+    WriteHeader(header, width, height, alpha);
+
+    failed = fwrite(PNG_SIGNATURE, 1, 8, file) != 8;
+    bytesWritten = 8;
+    return WriteChunk("IHDR", header, sizeof(header));
+}
+
+bool PngWriter::WriteRows(const unsigned char* rgba, int rows, size_t rowStride)
+{
+    if ( !file || failed || rows < 0 || rowsWritten + rows > height )
+        return false;
+
+    if ( rowStride == 0 )
+        rowStride = size_t(width) * 4;
+
+    size_t rowBytes = size_t(width) * channels;
+    for ( int y = 0; y < rows; y ++)
+    {
+        const unsigned char* in = rgba + y * rowStride;
+        for ( int x = 0; x < width; x ++)
+            memcpy(&line[size_t(x) * channels], in + x * 4, channels);
+
+        FilterRow(&line[0], &previous[0], rowBytes, channels, &filtered[0], &row[0]);
+        line.swap(previous);
+
+        if ( !Deflate(&row[0], row.size(), false) )
+            return false;
+        rowsWritten ++;
+    }
+
+    return true;
+}
+
+bool PngWriter::Close()
+{
+    if ( !file )
+        return false;
+
+    bool ok = !failed && rowsWritten == height && Deflate(0, 0, true) && WriteChunk("IEND", 0, 0);
+
+    deflateEnd(stream);
+    delete stream;
+    stream = 0;
+
+    ok = fclose(file) == 0 && ok;
+    file = 0;
+    return ok;
+}
+
+bool PngWriter::Deflate(const unsigned char* data, size_t size, bool finish)
+{
+    stream->next_in = const_cast<Bytef*>(data);
+    stream->avail_in = uInt(size);
+
+    // a full output buffer becomes an IDAT chunk, the rest stays in it
+    // for the next rows
+    for ( ;; )
+    {
+        if ( stream->avail_out == 0 || stream->next_out == 0 )
+        {
+            if ( stream->next_out != 0 && !WriteChunk("IDAT", &compressed[0], compressed.size()) )
+                return false;
+            stream->next_out = &compressed[0];
+            stream->avail_out = uInt(compressed.size());
+        }
+
+        int status = deflate(stream, finish ? Z_FINISH : Z_NO_FLUSH);
+        if ( status == Z_STREAM_ERROR )
+        {
+            failed = true;
+            return false;
+        }
+
+        if ( finish ? status == Z_STREAM_END : stream->avail_in == 0 && stream->avail_out > 0 )
+            break;
+    }
+
+    if ( finish )
+    {
+        size_t pending = compressed.size() - stream->avail_out;
+        if ( pending > 0 && !WriteChunk("IDAT", &compressed[0], pending) )
+            return false;
+    }
+
+    return true;
+}
+
+bool PngWriter::WriteChunk(const char* type, const unsigned char* body, size_t length)
+{
+    unsigned char header[8];
+    WriteBE32(header, (unsigned int)(length));
+    memcpy(header + 4, type, 4);
+
+    uLong crc = crc32(0L, header + 4, 4);
+    if ( length > 0 )
+        crc = crc32(crc, body, uInt(length));
+    unsigned char trailer[4];
+    WriteBE32(trailer, (unsigned int)(crc));
+
+    if ( failed || fwrite(header, 1, 8, file) != 8 ||
+         (length > 0 && fwrite(body, 1, length, file) != length) ||
+         fwrite(trailer, 1, 4, file) != 4 )
+    {
+        failed = true;
+        return false;
+    }
+
+    bytesWritten += 12 + length;
+    return true;
+}
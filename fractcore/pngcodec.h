@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PNGCODEC_H
+#define PNGCODEC_H
+
+// minimal png support on top of zlib, so the headless renderer does not
+// need QImage to read Resources/lookup.png or to write images
+//
+// only 8 bit, non-interlaced gray/rgb/palette/gray-alpha/rgba images are
+// supported, that covers everything the project ships; images are written
+// as 8 bit rgb or rgba
+
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+struct z_stream_s;
+
+// decodes a png file into 4 bytes per pixel RGBA, returns false on error
+bool ReadPng(const char* fileName, int& width, int& height, std::vector<unsigned char>& rgba);
+
+// same as above, from memory
+bool DecodePng(const unsigned char* data, size_t size, int& width, int& height, std::vector<unsigned char>& rgba);
+
+// encodes 4 bytes per pixel RGBA, top row first, into a png; the alpha
+// channel is left out if every pixel is opaque. level is the zlib level,
+// -1 for its default
+bool EncodePng(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& png, int level = -1);
+
+// same as above, into a file
+bool WritePng(const char* fileName, const unsigned char* rgba, int width, int height, int level = -1);
+
+// writes a png a few rows at a time, for images that do not fit in memory
+//
+// the rows are filtered and deflated as they come in and the compressed
+// data goes out in IDAT chunks of CHUNK_SIZE bytes, so only a row and the
+// zlib state are kept. Whether the image has alpha has to be known up front
+class PngWriter
+{
+public:
+    static const int CHUNK_SIZE = 1 << 18;
+
+    PngWriter();
+    ~PngWriter();   // an image that was not finished is left truncated
+
+    bool Open(const char* fileName, int width, int height, bool alpha = false, int level = -1);
+
+    // 4 bytes per pixel RGBA, top row first, rowStride bytes apart (width * 4
+    // if 0); false once a write failed or the rows go beyond the height
+    bool WriteRows(const unsigned char* rgba, int rows, size_t rowStride = 0);
+
+    // the end of the image; false if rows are missing or a write failed
+    bool Close();
+
+    int RowsWritten() const { return rowsWritten; }
+    long long BytesWritten() const { return bytesWritten; }
+
+private:
+    bool Deflate(const unsigned char* data, size_t size, bool finish);
+    bool WriteChunk(const char* type, const unsigned char* body, size_t length);
+
+    FILE* file;
+    z_stream_s* stream;
+    int width;
+    int height;
+    int channels;
+    int rowsWritten;
+    long long bytesWritten;
+    bool failed;
+
+    std::vector<unsigned char> line;
+    std::vector<unsigned char> previous;
+    std::vector<unsigned char> filtered;
+    std::vector<unsigned char> row;         // filter byte and the filtered line
+    std::vector<unsigned char> compressed;
+};
+
+#endif // PNGCODEC_H
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "progressiverenderer.h"
+
+#include <algorithm>
+#include <cstring>
+
+// sample distance of every pass, each grid is a subset of the next one
+static const int PASS_STEPS[PROGRESSIVE_PASSES][2] =
+{
+    { 4, 4 },
+    { 2, 2 },
+    { 1, 2 },
+    { 1, 1 }
+};
+
+ProgressiveStats::ProgressiveStats()
+{
+    pixels = 0;
+    computedPixels = 0;
+}
+
+void ProgressiveStats::Add(const ProgressiveStats& other)
+{
+    pixels += other.pixels;
+    computedPixels += other.computedPixels;
+    kernel.Add(other.kernel);
+}
+
+ProgressiveRenderer::ProgressiveRenderer()
+{
+    engine = 0;
+}
+
+void ProgressiveRenderer::SetEngine(const MandelbrotEngine* engine)
+{
+    this->engine = engine;
+}
+
+void ProgressiveRenderer::PassStep(int pass, int& stepX, int& stepY)
+{
+    pass = std::max(0, std::min(PROGRESSIVE_PASSES - 1, pass));
+    stepX = PASS_STEPS[pass][0];
+    stepY = PASS_STEPS[pass][1];
+}
+
+void ProgressiveRenderer::RenderPass(const MandelbrotView& view, int pass, int x, int y, int width, int height,
+                                     FractalBuffer& buffer, ProgressiveStats* stats) const
+{
+    if ( width <= 0 || height <= 0 || pass < 0 || pass >= PROGRESSIVE_PASSES )
+        return;
+
+    int stepX, stepY;
+    PassStep(pass, stepX, stepY);
+
+    int previousX = 0;
+    int previousY = 0;
+    if ( pass > 0 )
+        PassStep(pass - 1, previousX, previousY);
+
+    ProgressiveStats passStats;
+
+    // the samples the previous passes did not have are at most two grids,
+    // the rows between the previous sample rows and the columns between
+    // the previous samples on their rows; the row kernel renders them in
+    // place, with the periodicity check only where the rows need it
+    if ( pass == 0 )
+    {
+        RenderGrid(view, x, y, width, height, 0, 0, stepX, stepY, buffer, passStats);
+    }
+    else
+    {
+        if ( previousY > stepY )
+            RenderGrid(view, x, y, width, height, 0, stepY, stepX, previousY, buffer, passStats);
+        if ( previousX > stepX )
+            RenderGrid(view, x, y, width, height, stepX, 0, previousX, previousY, buffer, passStats);
+    }
+
+    // the full resolution pass has no blocks to fill
+    if ( stepX == 1 && stepY == 1 )
+    {
+        passStats.pixels = passStats.computedPixels;
+        if ( stats )
+            stats->Add(passStats);
+        return;
+    }
+
+    // the samples are copied over the first row of their blocks, then that
+    // row is copied down; the other samples of the band keep their color
+    // from the previous pass, so the whole row can be copied
+    const bool orbits = buffer.orbitX && buffer.orbitY;
+    for ( int row = 0; row < height; row += stepY )
+    {
+        const int blockHeight = std::min(stepY, height - row);
+        const int target = row * buffer.stride;
+        const bool previousRow = pass > 0 && row % previousY == 0;
+
+        for ( int column = 0; column < width; column += stepX )
+        {
+            if ( previousRow && column % previousX == 0 )
+                continue;
+
+            const int blockWidth = std::min(stepX, width - column);
+            const int sample = target + column;
+            passStats.pixels += (long long)(blockWidth) * blockHeight;
+
+            if ( blockWidth == 1 )
+                continue;
+
+            if ( buffer.iterations )
+                std::fill(buffer.iterations + sample + 1, buffer.iterations + sample + blockWidth, buffer.iterations[sample]);
+            if ( buffer.smooth )
+                std::fill(buffer.smooth + sample + 1, buffer.smooth + sample + blockWidth, buffer.smooth[sample]);
+            if ( orbits )
+            {
+                std::fill(buffer.orbitX + sample + 1, buffer.orbitX + sample + blockWidth, buffer.orbitX[sample]);
+                std::fill(buffer.orbitY + sample + 1, buffer.orbitY + sample + blockWidth, buffer.orbitY[sample]);
+            }
+            if ( buffer.rgba )
+            {
+                unsigned char* rgba = buffer.rgba + sample * 4;
+                for ( int k = 1; k < blockWidth; k ++)
+                    memcpy(rgba + k * 4, rgba, 4);
+            }
+        }
+
+        for ( int blockRow = 1; blockRow < blockHeight; blockRow ++)
+        {
+            const int copy = target + blockRow * buffer.stride;
+
+            if ( buffer.iterations )
+                memcpy(buffer.iterations + copy, buffer.iterations + target, width * sizeof(int));
+            if ( buffer.smooth )
+                memcpy(buffer.smooth + copy, buffer.smooth + target, width * sizeof(float));
+            if ( orbits )
+            {
+                memcpy(buffer.orbitX + copy, buffer.orbitX + target, width * sizeof(double));
+                memcpy(buffer.orbitY + copy, buffer.orbitY + target, width * sizeof(double));
+            }
+            if ( buffer.rgba )
+                memcpy(buffer.rgba + copy * 4, buffer.rgba + target * 4, width * 4);
+        }
+    }
+
+    if ( stats )
+        stats->Add(passStats);
+}
+
+void ProgressiveRenderer::RenderGrid(const MandelbrotView& view, int x, int y, int width, int height,
+                                     int gridX, int gridY, int stepX, int stepY,
+                                     FractalBuffer& buffer, ProgressiveStats& stats) const
+{
+    if ( gridX >= width || gridY >= height )
+        return;
+
+    int gridWidth = width - gridX;
+    int gridHeight = height - gridY;
+    FractalBuffer grid = buffer.SubBuffer(gridX, gridY, gridWidth, gridHeight);
+    engine->RenderGrid(view, x + gridX, y + gridY, gridWidth, gridHeight, stepX, stepY, grid, &stats.kernel);
+
+    stats.computedPixels += (long long)((gridWidth + stepX - 1) / stepX) * ((gridHeight + stepY - 1) / stepY);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PROGRESSIVERENDERER_H
+#define PROGRESSIVERENDERER_H
+
+#include "mandelbrotengine.h"
+
+// passes of a progressive frame, the last one is the full resolution
+const int PROGRESSIVE_PASSES = 4;
+
+// counters of the progressive renderer
+struct ProgressiveStats
+{
+    ProgressiveStats();
+
+    void Add(const ProgressiveStats& other);
+
+    long long pixels;           // pixels written, the copies of a sample included
+    long long computedPixels;   // pixels that went through the escape kernel
+    KernelStats kernel;         // the computed pixels
+};
+
+// coarse-to-fine rendering on top of MandelbrotEngine
+//
+// a frame is rendered in PROGRESSIVE_PASSES passes on nested sample grids
+// of 1/16, 1/4, 1/2 and all of the pixels. Every sample is copied over the
+// block of pixels up to the next sample of its pass, so the buffer holds a
+// complete, blocky picture after each pass.
+//
+// a pass only iterates the samples the previous passes did not have. They
+// keep their pixel in the buffer, the blocks of the new samples never
+// cover it, so a frame that runs all passes iterates every pixel exactly
+// once. The grid starts at the region origin, the passes of one frame have
+// to be called with the same regions.
+//
+// like MandelbrotEngine the renderer is immutable while rendering
+class ProgressiveRenderer
+{
+public:
+    ProgressiveRenderer();
+
+    // engine that evaluates the samples, also used for the colors
+    void SetEngine(const MandelbrotEngine* engine);
+
+    // sample distance of a pass, in pixels
+    static void PassStep(int pass, int& stepX, int& stepY);
+
+    // same contract as MandelbrotEngine::RenderRegion() for one pass, the
+    // buffer has to hold the result of the previous passes; the counters of
+    // the call are added to stats if given
+    void RenderPass(const MandelbrotView& view, int pass, int x, int y, int width, int height,
+                    FractalBuffer& buffer, ProgressiveStats* stats = 0) const;
+
+private:
+    // the samples every stepX-th column of every stepY-th row from (gridX,
+    // gridY) of the region on, in place
+    void RenderGrid(const MandelbrotView& view, int x, int y, int width, int height,
+                    int gridX, int gridY, int stepX, int stepY,
+                    FractalBuffer& buffer, ProgressiveStats& stats) const;
+
+    const MandelbrotEngine* engine;
+};
+
+#endif // PROGRESSIVERENDERER_H
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "reprojectionrenderer.h"
+
+#include <chrono>
+#include <cstring>
+#include <math.h>
+
+// pixels per side of the grid EstimateReuse() checks
+static const int ESTIMATE_GRID = 32;
+
+ReprojectionFrame::ReprojectionFrame()
+{
+    valid = false;
+    hasOrbits = false;
+}
+
+void ReprojectionFrame::Reset(const MandelbrotView& view)
+{
+    size_t pixels = size_t(view.width) * view.height;
+
+    this->view = view;
+    valid = false;
+    hasOrbits = false;
+    iterations.resize(pixels);
+    smooth.resize(pixels);
+    error.assign(pixels, 0.0f);
+    orbitX.resize(pixels);
+    orbitY.resize(pixels);
+}
+
+FractalBuffer ReprojectionFrame::Buffer(unsigned char* rgba)
+{
+    if ( iterations.empty() )
+        return FractalBuffer(view.width, view.height, rgba, 0, 0);
+
+    return FractalBuffer(view.width, view.height, rgba, &iterations[0], &smooth[0], &orbitX[0], &orbitY[0]);
+}
+
+ReprojectionStats::ReprojectionStats()
+{
+    pixels = 0;
+    reusedPixels = 0;
+    computedPixels = 0;
+    reprojectSeconds = 0.0;
+}
+
+void ReprojectionStats::Add(const ReprojectionStats& other)
+{
+    pixels += other.pixels;
+    reusedPixels += other.reusedPixels;
+    computedPixels += other.computedPixels;
+    reprojectSeconds += other.reprojectSeconds;
+    kernel.Add(other.kernel);
+}
+
+// affine map from the pixel centers of the new view to positions in the
+// previous frame, in pixels
+struct ReprojectionRenderer::Mapping
+{
+    double originX;         // position of the center of pixel (0, 0)
+    double originY;
+    double columnX;         // change per column
+    double columnY;
+    double rowX;            // change per row
+    double rowY;
+    double pixelRatio;      // previous pixel size / new pixel size
+
+    double previousWidth;   // size of the previous frame
+    double previousHeight;
+    int previousStride;
+
+    const int* previousIterationPlane;
+    const float* previousErrorPlane;
+
+    int previousIterations; // iteration limit of the previous frame
+};
+
+ReprojectionRenderer::ReprojectionRenderer()
+{
+    engine = 0;
+    maxError = 0.25;
+}
+
+void ReprojectionRenderer::SetEngine(const MandelbrotEngine* engine)
+{
+    this->engine = engine;
+}
+
+void ReprojectionRenderer::SetMaxError(double maxError)
+{
+    this->maxError = maxError < 0.0 ? 0.0 : maxError;
+}
+
+bool ReprojectionRenderer::BuildMapping(const MandelbrotView& view, const ReprojectionFrame& previous,
+                                        Mapping& mapping) const
+{
+    const MandelbrotView& old = previous.view;
+
+    if ( !previous.valid || previous.iterations.empty() || view.width <= 0 || view.height <= 0 )
+        return false;
+
+    // pixels are square and both views rotate around a point, so the linear
+    // part only depends on the zoom and the rotation between them; working
+    // it out instead of differencing mapped points keeps it exact
+    const double ratio = view.PixelSize() / old.PixelSize();
+    const double angle = view.rotation - old.rotation;
+
+    mapping.columnX = ratio * cos(angle);
+    mapping.columnY = -ratio * sin(angle);
+    mapping.rowX = ratio * sin(angle);
+    mapping.rowY = ratio * cos(angle);
+    mapping.pixelRatio = 1.0 / ratio;
+    mapping.previousWidth = double(old.width);
+    mapping.previousHeight = double(old.height);
+    mapping.previousStride = old.width;
+    mapping.previousIterationPlane = &previous.iterations[0];
+    mapping.previousErrorPlane = &previous.error[0];
+    mapping.previousIterations = old.maxIterations;
+
+    double cx, cy;
+    ViewTransform(view).Map(0.5, 0.5, cx, cy);
+    ViewTransform(old).Unmap(cx, cy, mapping.originX, mapping.originY);
+
+    return true;
+}
+
+int ReprojectionRenderer::Reproject(const Mapping& mapping, int px, int py, int maxIterations, float& error) const
+{
+    const double u = mapping.originX + px * mapping.columnX + py * mapping.rowX;
+    const double v = mapping.originY + px * mapping.columnY + py * mapping.rowY;
+
+    // also rejects negative positions before the int conversion rounds
+    // them towards 0
+    if ( !(u >= 0.0 && v >= 0.0 && u < mapping.previousWidth && v < mapping.previousHeight) )
+        return -1;
+
+    const int column = int(u);
+    const int row = int(v);
+    const int index = row * mapping.previousStride + column;
+
+    // interior under the old limit may still escape under a higher one
+    if ( maxIterations > mapping.previousIterations && mapping.previousIterationPlane[index] >= mapping.previousIterations )
+        return -1;
+
+    const double du = u - column - 0.5;
+    const double dv = v - row - 0.5;
+    const double distance2 = du * du + dv * dv;
+
+    // cheap reject before the square root, the carried error only adds
+    if ( distance2 * mapping.pixelRatio * mapping.pixelRatio > maxError * maxError )
+        return -1;
+
+    error = float((sqrt(distance2) + mapping.previousErrorPlane[index]) * mapping.pixelRatio);
+
+    return error <= maxError ? index : -1;
+}
+
+double ReprojectionRenderer::EstimateReuse(const MandelbrotView& view, const ReprojectionFrame& previous) const
+{
+    Mapping mapping;
+    if ( !BuildMapping(view, previous, mapping) )
+        return 0.0;
+
+    int reused = 0;
+    for ( int row = 0; row < ESTIMATE_GRID; row ++)
+    {
+        for ( int column = 0; column < ESTIMATE_GRID; column ++)
+        {
+            // spread over the cells, a regular grid lines up with the zoom
+            // center and sees either all or none of the reused pixels
+            int px = (column * view.width + (row * 7 + column * 3) % 16 * view.width / 16) / ESTIMATE_GRID;
+            int py = (row * view.height + (column * 5 + row * 11) % 16 * view.height / 16) / ESTIMATE_GRID;
+
+            float error;
+            if ( Reproject(mapping, px, py, view.maxIterations, error) >= 0 )
+                reused ++;
+        }
+    }
+
+    return double(reused) / double(ESTIMATE_GRID * ESTIMATE_GRID);
+}
+
+void ReprojectionRenderer::RenderRegion(const MandelbrotView& view, const ReprojectionFrame& previous,
+                                        int x, int y, int width, int height,
+                                        FractalBuffer& buffer, float* error, const unsigned char* previousRgba,
+                                        ReprojectionStats* stats) const
+{
+    if ( width <= 0 || height <= 0 )
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    Mapping mapping;
+    const bool mapped = BuildMapping(view, previous, mapping);
+
+    const int maxIterations = view.maxIterations;
+    ReprojectionStats regionStats;
+
+    // same limit, same palette spread, the old colors are still right
+    if ( !mapped || maxIterations != mapping.previousIterations )
+        previousRgba = 0;
+
+    std::vector<int> missX;
+    std::vector<int> missY;
+
+    for ( int row = 0; row < height; row ++)
+    {
+        float* errorRow = error + row * buffer.stride;
+        int* iterationsRow = buffer.iterations + row * buffer.stride;
+        float* smoothRow = buffer.smooth + row * buffer.stride;
+
+        for ( int column = 0; column < width; column ++)
+        {
+            int index = mapped ? Reproject(mapping, x + column, y + row, maxIterations, errorRow[column]) : -1;
+            if ( index < 0 )
+            {
+                missX.push_back(x + column);
+                missY.push_back(y + row);
+                continue;
+            }
+
+            // escaped below the old limit but not below the new one
+            int iterations = previous.iterations[index];
+            float smooth = previous.smooth[index];
+            if ( iterations >= maxIterations )
+            {
+                iterations = maxIterations;
+                smooth = float(maxIterations);
+            }
+
+            iterationsRow[column] = iterations;
+            smoothRow[column] = smooth;
+
+            // the palette is spread over the iteration limit, reused pixels
+            // change color with it
+            unsigned char* rgba = buffer.rgba + (row * buffer.stride + column) * 4;
+            if ( buffer.rgba && previousRgba )
+                memcpy(rgba, previousRgba + index * 4, 4);
+            else if ( buffer.rgba )
+                engine->Colorize(smooth, maxIterations, rgba);
+        }
+    }
+
+    const int count = int(missX.size());
+    regionStats.pixels = (long long)(width) * height;
+    regionStats.reusedPixels = regionStats.pixels - count;
+    regionStats.computedPixels = count;
+    regionStats.reprojectSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if ( count > 0 )
+    {
+        std::vector<int> iterations(count);
+        std::vector<float> smooth(count);
+
+        engine->RenderPixels(view, &missX[0], &missY[0], count, &iterations[0], &smooth[0], 0, 0, &regionStats.kernel);
+
+        for ( int i = 0; i < count; i ++)
+        {
+            const int target = (missY[i] - y) * buffer.stride + missX[i] - x;
+
+            buffer.iterations[target] = iterations[i];
+            buffer.smooth[target] = smooth[i];
+            error[target] = 0.0f;
+
+            if ( buffer.rgba )
+                engine->Colorize(smooth[i], maxIterations, buffer.rgba + target * 4);
+        }
+    }
+
+    if ( stats )
+        stats->Add(regionStats);
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef REPROJECTIONRENDERER_H
+#define REPROJECTIONRENDERER_H
+
+#include <vector>
+
+#include "mandelbrotengine.h"
+
+// iteration planes of a finished frame, the next frame reprojects them or
+// resumes them with a higher iteration limit
+struct ReprojectionFrame
+{
+    ReprojectionFrame();
+
+    // sizes the planes for the view, the content is undefined until the
+    // frame is rendered and the error plane is 0
+    void Reset(const MandelbrotView& view);
+
+    // buffer over the iteration and orbit planes, writing into rgba
+    FractalBuffer Buffer(unsigned char* rgba);
+
+    MandelbrotView view;
+    bool valid;                 // holds a finished frame of view
+    bool hasOrbits;             // the orbit planes were written too
+
+    std::vector<int> iterations;
+    std::vector<float> smooth;
+    std::vector<float> error;   // distance of the evaluated point to the pixel center, in pixels
+    std::vector<double> orbitX; // see FractalBuffer
+    std::vector<double> orbitY;
+};
+
+// counters of the reprojection renderer
+struct ReprojectionStats
+{
+    ReprojectionStats();
+
+    void Add(const ReprojectionStats& other);
+
+    long long pixels;           // pixels written
+    long long reusedPixels;     // pixels taken over from the previous frame
+    long long computedPixels;   // pixels that went through the escape kernel
+    double reprojectSeconds;    // time spent mapping and recoloring the reused pixels
+    KernelStats kernel;         // the computed pixels
+
+    double ReusedFraction() const { return pixels > 0 ? double(reusedPixels) / double(pixels) : 0.0; }
+
+    // kernel time the reused pixels would have cost at secondsPerPixel,
+    // less the time spent on reusing them
+    double SavedSeconds(double secondsPerPixel) const { return double(reusedPixels) * secondsPerPixel - reprojectSeconds; }
+};
+
+// incremental re-render after a pan, zoom or rotation
+//
+// every pixel of the new view is mapped into the previous frame. If it
+// lands close enough to the center of a previous pixel that value is taken
+// over, otherwise the pixel is iterated again. A pan by whole pixels maps
+// onto the old pixel centers, so only the newly exposed strips are
+// iterated; a zoom or a rotation only keeps the pixels that happen to land
+// within the error bound.
+//
+// the error of a taken over value is carried along in the frame, a pixel
+// reused over and over again never drifts more than the bound away from
+// the point it shows. Interior pixels are only reused if the iteration
+// limit did not grow, escaped ones as long as they escaped below it.
+//
+// like MandelbrotEngine the renderer is immutable while rendering
+class ReprojectionRenderer
+{
+public:
+    ReprojectionRenderer();
+
+    // engine that evaluates the misses, also used for the colors
+    void SetEngine(const MandelbrotEngine* engine);
+
+    // largest distance in pixels between a pixel center and the point its
+    // value was computed for, 0.25 by default
+    void SetMaxError(double maxError);
+    double MaxError() const { return maxError; }
+
+    // fraction of the view that can be taken over from previous, from a
+    // coarse grid of pixels; 0 if the frames do not fit together at all
+    double EstimateReuse(const MandelbrotView& view, const ReprojectionFrame& previous) const;
+
+    // same contract as MandelbrotEngine::RenderRegion(), buffer needs the
+    // iteration and smooth planes; error is the error plane of the region
+    // with the stride of buffer
+    //
+    // previousRgba are the colors of the whole previous frame, if the
+    // caller still has them they are copied instead of looked up again;
+    // the counters of the call are added to stats if given
+    void RenderRegion(const MandelbrotView& view, const ReprojectionFrame& previous,
+                      int x, int y, int width, int height, FractalBuffer& buffer, float* error,
+                      const unsigned char* previousRgba = 0, ReprojectionStats* stats = 0) const;
+
+private:
+    struct Mapping;
+
+    bool BuildMapping(const MandelbrotView& view, const ReprojectionFrame& previous, Mapping& mapping) const;
+
+    // index of the previous frame pixel that image pixel (px, py) can take
+    // over, -1 if there is none
+    int Reproject(const Mapping& mapping, int px, int py, int maxIterations, float& error) const;
+
+    const MandelbrotEngine* engine;
+    double maxError;
+};
+
+#endif // REPROJECTIONRENDERER_H
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "seriesapproximation.h"
+#include "perturbationrenderer.h"
+#include "mandelbrotkernel.h"
+
+#include <math.h>
+
+// plain perturbation of the offset c up to the given iteration, false if
+// it escapes before
+static bool IterateProbe(const ReferenceOrbit& orbit, double cx, double cy, int iterations,
+                         double& dx, double& dy, int& escape)
+{
+    dx = cx;
+    dy = cy;
+
+    for ( int n = 0; n < iterations; n ++)
+    {
+        double zx = orbit.zx[n] + dx;
+        double zy = orbit.zy[n] + dy;
+        if ( zx * zx + zy * zy >= MANDEL_BAILOUT )
+        {
+            escape = n;
+            return false;
+        }
+
+        double tx = 2.0 * (orbit.zx[n] * dx - orbit.zy[n] * dy) + (dx * dx - dy * dy) + cx;
+        dy = 2.0 * (orbit.zx[n] * dy + orbit.zy[n] * dx) + 2.0 * dx * dy + cy;
+        dx = tx;
+    }
+
+    return true;
+}
+
+// one iteration of the scaled coefficients, a -> 2 Z a + a * a (+ radius)
+static void StepCoefficients(double zx, double zy, double radius, int terms,
+                             const std::vector<double>& ax, const std::vector<double>& ay,
+                             std::vector<double>& nx, std::vector<double>& ny)
+{
+    for ( int k = 1; k <= terms; k ++)
+    {
+        double x = 2.0 * (zx * ax[k] - zy * ay[k]);
+        double y = 2.0 * (zx * ay[k] + zy * ax[k]);
+
+        if ( k == 1 )
+            x += radius;
+
+        for ( int j = 1; j < k; j ++)
+        {
+            x += ax[j] * ax[k - j] - ay[j] * ay[k - j];
+            y += ax[j] * ay[k - j] + ay[j] * ax[k - j];
+        }
+
+        nx[k] = x;
+        ny[k] = y;
+    }
+}
+
+SeriesApproximation::SeriesApproximation()
+{
+    maxOrder = 24;
+    // escape times next to the set change with offsets far below a pixel,
+    // at 1e-3 hundreds of pixels of a seahorse valley view moved by
+    // hundreds of iterations
+    tolerance = 1e-9;
+    order = 0;
+    skippedIterations = 0;
+    inverseRadius = 0.0;
+}
+
+void SeriesApproximation::SetMaxOrder(int maxOrder)
+{
+    this->maxOrder = maxOrder < 1 ? 1 : maxOrder;
+}
+
+void SeriesApproximation::SetTolerance(double tolerance)
+{
+    this->tolerance = tolerance;
+}
+
+void SeriesApproximation::Advance(const ReferenceOrbit& orbit, int iterations, int terms,
+                                  std::vector<double>& ax, std::vector<double>& ay) const
+{
+    double radius = 1.0 / inverseRadius;
+
+    ax.assign(terms + 1, 0.0);
+    ay.assign(terms + 1, 0.0);
+    ax[1] = radius;
+
+    std::vector<double> nx(terms + 1, 0.0), ny(terms + 1, 0.0);
+    for ( int n = 0; n < iterations; n ++)
+    {
+        StepCoefficients(orbit.zx[n], orbit.zy[n], radius, terms, ax, ay, nx, ny);
+        ax.swap(nx);
+        ay.swap(ny);
+    }
+}
+
+bool SeriesApproximation::Compute(const ReferenceOrbit& orbit, double radius, double pixelSize,
+                                  const double* probeX, const double* probeY, int probeCount)
+{
+    order = 0;
+    skippedIterations = 0;
+    coefficientX.clear();
+    coefficientY.clear();
+
+    const int length = int(orbit.zx.size());
+    if ( length < 2 || !(radius > 0.0) )
+        return false;
+
+    inverseRadius = 1.0 / radius;
+
+    // every order up to maxOrder at once, the low terms do not depend on
+    // the high ones; order k is truncated at term k + 1
+    const int terms = maxOrder + 1;
+    std::vector<double> ax(terms + 1, 0.0), ay(terms + 1, 0.0);
+    std::vector<double> nx(terms + 1, 0.0), ny(terms + 1, 0.0);
+    ax[1] = radius;
+
+    std::vector<int> skip(maxOrder + 1, 0);
+    std::vector<bool> active(maxOrder + 1, true);
+    int activeCount = maxOrder;
+
+    // the pixels continue at the last iteration, so Z of it has to exist
+    for ( int n = 0; n + 1 < length && activeCount > 0; n ++)
+    {
+        StepCoefficients(orbit.zx[n], orbit.zy[n], radius, terms, ax, ay, nx, ny);
+        ax.swap(nx);
+        ay.swap(ny);
+
+        // a pixel step at this iteration is about |A1| * pixelSize, the
+        // dropped term has to stay a small fraction of it
+        double a1 = ax[1] * ax[1] + ay[1] * ay[1];
+        double limit = tolerance * pixelSize * inverseRadius;
+        double limit2 = a1 * limit * limit;
+
+        if ( !(limit2 < HUGE_VAL) )
+            break;
+
+        for ( int k = 1; k <= maxOrder; k ++)
+        {
+            if ( !active[k] )
+                continue;
+
+            double dropped = ax[k + 1] * ax[k + 1] + ay[k + 1] * ay[k + 1];
+            if ( dropped <= limit2 )
+            {
+                skip[k] = n + 1;
+            }
+            else
+            {
+                active[k] = false;
+                activeCount --;
+            }
+        }
+    }
+
+    // evaluating order k costs about k iterations per pixel
+    int bestOrder = 0;
+    int bestGain = 0;
+    for ( int k = 1; k <= maxOrder; k ++)
+    {
+        if ( skip[k] - k > bestGain )
+        {
+            bestGain = skip[k] - k;
+            bestOrder = k;
+        }
+    }
+
+    if ( bestOrder == 0 )
+        return false;
+
+    // the truncation bound only holds near the center and says nothing
+    // about the rounding errors, so the probes are iterated the plain way
+    // and the series has to agree with them to a fraction of the distance
+    // to their neighbour pixel at that iteration, measured the same way;
+    // it backs off until all of them do
+    int candidate = skip[bestOrder];
+    std::vector<double> cx, cy;
+
+    for ( int attempt = 0; attempt < 16 && candidate > bestOrder; attempt ++)
+    {
+        Advance(orbit, candidate, bestOrder, cx, cy);
+
+        order = bestOrder;
+        coefficientX = cx;
+        coefficientY = cy;
+
+        bool passed = true;
+        for ( int p = 0; p < probeCount && passed; p ++)
+        {
+            // the probe or its neighbour escapes before the series ends,
+            // so would the pixels around them
+            double dx, dy, nx, ny;
+            int escape = candidate;
+            if ( !IterateProbe(orbit, probeX[p], probeY[p], candidate, dx, dy, escape) ||
+                 !IterateProbe(orbit, probeX[p] + pixelSize, probeY[p], candidate, nx, ny, escape) )
+            {
+                candidate = escape;
+                passed = false;
+                break;
+            }
+
+            double spacing = (nx - dx) * (nx - dx) + (ny - dy) * (ny - dy);
+            double limit2 = tolerance * tolerance * spacing;
+
+            double sx, sy;
+            Evaluate(probeX[p], probeY[p], sx, sy);
+
+            double error = (sx - dx) * (sx - dx) + (sy - dy) * (sy - dy);
+            if ( !(error <= limit2) )
+            {
+                candidate = candidate * 3 / 4;
+                passed = false;
+            }
+        }
+
+        if ( passed )
+        {
+            skippedIterations = candidate;
+            return true;
+        }
+    }
+
+    order = 0;
+    coefficientX.clear();
+    coefficientY.clear();
+    return false;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SERIESAPPROXIMATION_H
+#define SERIESAPPROXIMATION_H
+
+#include <vector>
+
+struct ReferenceOrbit;
+
+// iteration skipping for the perturbation renderer
+//
+// as long as the offsets d(n) of a frame stay tiny, they are a polynomial
+// in the pixel offset dc:
+//
+//      d(n) = A1(n) dc + A2(n) dc^2 + ... + AK(n) dc^K
+//
+//      A1(n+1) = 2 Z(n) A1(n) + 1
+//      Ak(n+1) = 2 Z(n) Ak(n) + sum(Aj(n) A(k-j)(n), j = 1 .. k-1)
+//
+// so the coefficients are iterated once per frame instead of d(n) once per
+// pixel. The coefficients are kept scaled by radius^k, radius being the
+// largest |dc| of the frame, so they neither overflow nor underflow at
+// any zoom level.
+//
+// Compute() advances the series while the first dropped term stays below
+// the tolerance, picks the order that saves the most work and verifies
+// the result against probe points all over the frame iterated the normal
+// way, each within the tolerance of its own pixel spacing
+class SeriesApproximation
+{
+public:
+    SeriesApproximation();
+
+    // highest order tried by Compute()
+    void SetMaxOrder(int maxOrder);
+    int MaxOrder() const { return maxOrder; }
+
+    // allowed error, in pixels of the frame at the skipped iteration
+    void SetTolerance(double tolerance);
+    double Tolerance() const { return tolerance; }
+
+    // fits the series to the orbit for offsets up to radius away from the
+    // reference, probes are offsets on the border and inside of the frame;
+    // returns false if no iteration can be skipped safely
+    bool Compute(const ReferenceOrbit& orbit, double radius, double pixelSize,
+                 const double* probeX, const double* probeY, int probeCount);
+
+    // iterations all points start at, 0 if the series is not used
+    int SkippedIterations() const { return skippedIterations; }
+    int Order() const { return order; }
+
+    // d(SkippedIterations()) of the point dc
+    void Evaluate(double dcx, double dcy, double& dx, double& dy) const
+    {
+        // Horner in dc / radius, the coefficients are scaled by radius^k
+        double ux = dcx * inverseRadius;
+        double uy = dcy * inverseRadius;
+
+        double sx = 0.0;
+        double sy = 0.0;
+        for ( int k = order; k >= 1; k --)
+        {
+            double tx = (sx + coefficientX[k]) * ux - (sy + coefficientY[k]) * uy;
+            double ty = (sx + coefficientX[k]) * uy + (sy + coefficientY[k]) * ux;
+            sx = tx;
+            sy = ty;
+        }
+
+        dx = sx;
+        dy = sy;
+    }
+
+private:
+    // coefficients of d(iterations) up to the given order
+    void Advance(const ReferenceOrbit& orbit, int iterations, int terms,
+                 std::vector<double>& ax, std::vector<double>& ay) const;
+
+    int maxOrder;
+    double tolerance;
+
+    int order;
+    int skippedIterations;
+    double inverseRadius;
+    std::vector<double> coefficientX;   // index k holds Ak * radius^k
+    std::vector<double> coefficientY;
+};
+
+#endif // SERIESAPPROXIMATION_H
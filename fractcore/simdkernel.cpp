@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "simdkernel.h"
+#include "mandelbrotkernel.h"
+
+template <typename Real>
+static void EscapeScalar(const Real* cx, const Real* cy, int count, int maxIterations,
+                         Real epsilon2, int* iterations, Real* norm2, Real* zxInOut, Real* zyInOut)
+{
+    for ( int i = 0; i < count; i ++)
+    {
+        Real zx = cx[i];
+        Real zy = cy[i];
+        int start = 0;
+
+        if ( zxInOut )
+        {
+            zx = zxInOut[i];
+            zy = zyInOut[i];
+            start = iterations[i];
+        }
+
+        if ( epsilon2 > Real(0) )
+        {
+            bool periodic;
+            int found = ContinueEscapePeriodic<Real>(cx[i], cy[i], start, maxIterations, epsilon2, zx, zy, periodic);
+            iterations[i] = periodic ? maxIterations : found;
+            norm2[i] = periodic ? -Real(found) : zx * zx + zy * zy;
+        }
+        else
+        {
+            iterations[i] = ContinueEscape<Real>(cx[i], cy[i], start, maxIterations, zx, zy);
+            norm2[i] = zx * zx + zy * zy;
+        }
+
+        if ( zxInOut )
+        {
+            zxInOut[i] = zx;
+            zyInOut[i] = zy;
+        }
+    }
+}
+
+void EscapeScalarDouble(const double* cx, const double* cy, int count, int maxIterations,
+                        double epsilon2, int* iterations, double* norm2, double* zx, double* zy)
+{
+    EscapeScalar<double>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+void EscapeScalarFloat(const float* cx, const float* cy, int count, int maxIterations,
+                       float epsilon2, int* iterations, float* norm2, float* zx, float* zy)
+{
+    EscapeScalar<float>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+EscapeKernels GetEscapeKernels(SimdLevel level)
+{
+    EscapeKernels kernels;
+    kernels.level = SIMD_SCALAR;
+    kernels.doubleLanes = 1;
+    kernels.floatLanes = 1;
+    kernels.escapeDouble = EscapeScalarDouble;
+    kernels.escapeFloat = EscapeScalarFloat;
+
+    switch ( level )
+    {
+#if defined(FRACT_X86)
+    case SIMD_AVX512:
+        kernels.level = SIMD_AVX512;
+        kernels.doubleLanes = 8;
+        kernels.floatLanes = 16;
+        kernels.escapeDouble = EscapeAvx512Double;
+        kernels.escapeFloat = EscapeAvx512Float;
+        break;
+    case SIMD_AVX2:
+        kernels.level = SIMD_AVX2;
+        kernels.doubleLanes = 4;
+        kernels.floatLanes = 8;
+        kernels.escapeDouble = EscapeAvx2Double;
+        kernels.escapeFloat = EscapeAvx2Float;
+        break;
+    case SIMD_SSE2:
+        kernels.level = SIMD_SSE2;
+        kernels.doubleLanes = 2;
+        kernels.floatLanes = 4;
+        kernels.escapeDouble = EscapeSse2Double;
+        kernels.escapeFloat = EscapeSse2Float;
+        break;
+#endif
+#if defined(FRACT_NEON)
+    case SIMD_NEON:
+        kernels.level = SIMD_NEON;
+        kernels.floatLanes = 4;
+        kernels.escapeFloat = EscapeNeonFloat;
+#if defined(__aarch64__) || defined(_M_ARM64)
+        // armv7 neon has no double lanes, the scalar loop stays for those
+        kernels.doubleLanes = 2;
+        kernels.escapeDouble = EscapeNeonDouble;
+#endif
+        break;
+#endif
+    default:
+        break;
+    }
+
+    return kernels;
+}
+
+KernelStats::KernelStats()
+{
+    pixels = 0;
+    iterations = 0;
+    periodicPixels = 0;
+    seconds = 0.0;
+}
+
+void KernelStats::Add(const KernelStats& other)
+{
+    pixels += other.pixels;
+    iterations += other.iterations;
+    periodicPixels += other.periodicPixels;
+    seconds += other.seconds;
+}
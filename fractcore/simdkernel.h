@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SIMDKERNEL_H
+#define SIMDKERNEL_H
+
+#include "cpufeatures.h"
+
+// vectorized escape time loop
+//
+// a kernel runs IterateEscape() (mandelbrotkernel.h) for a batch of points
+// that already passed the cardioid / bulb tests. Each vector lane holds one
+// point; when a lane escapes (or hits maxIterations) its result is written
+// out and the lane is refilled with the next point of the batch, so the
+// lanes stay busy no matter how uneven the iteration counts are.
+//
+// the lane math is the same sequence of adds and multiplies as the scalar
+// loop, the results are identical to IterateEscape() as long as the
+// compiler does not contract a*b+c into an fma (see fractcore.pri)
+//
+// with epsilon2 > 0 the kernels run IterateEscapePeriodic() instead. A point
+// caught in a cycle gets maxIterations like any interior point, its norm2
+// is the negated iteration the cycle was found at
+//
+// with zx / zy given the points do not start at c but continue from z =
+// (zx, zy) after the iterations[i] steps done already, which has to be
+// below maxIterations; the z every point stopped at is written back. The
+// cycle check starts over from the resumed z.
+
+typedef void (*EscapeKernelDouble)(const double* cx, const double* cy, int count, int maxIterations,
+                                   double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+
+typedef void (*EscapeKernelFloat)(const float* cx, const float* cy, int count, int maxIterations,
+                                  float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+
+struct EscapeKernels
+{
+    SimdLevel level;
+    int doubleLanes;
+    int floatLanes;
+    EscapeKernelDouble escapeDouble;
+    EscapeKernelFloat escapeFloat;
+};
+
+// kernels for the given level, level has to be supported by the cpu
+EscapeKernels GetEscapeKernels(SimdLevel level);
+
+// per kernel implementations, only defined where the compiler supports them
+void EscapeScalarDouble(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+void EscapeScalarFloat(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+
+#if defined(FRACT_X86)
+void EscapeSse2Double(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+void EscapeSse2Float(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+void EscapeAvx2Double(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+void EscapeAvx2Float(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+void EscapeAvx512Double(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+void EscapeAvx512Float(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+#endif
+
+#if defined(FRACT_NEON)
+void EscapeNeonFloat(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy);
+#if defined(__aarch64__) || defined(_M_ARM64)
+void EscapeNeonDouble(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy);
+#endif
+#endif
+
+// throughput counters of a render call
+struct KernelStats
+{
+    KernelStats();
+
+    void Add(const KernelStats& other);
+
+    long long pixels;       // pixels written
+    long long iterations;   // z = z^2 + c steps
+    long long periodicPixels;   // interior pixels the periodicity check stopped early
+    double seconds;         // time spent inside the render calls
+
+    double PixelsPerSecond() const { return seconds > 0.0 ? double(pixels) / seconds : 0.0; }
+    double IterationsPerSecond() const { return seconds > 0.0 ? double(iterations) / seconds : 0.0; }
+};
+
+#endif // SIMDKERNEL_H
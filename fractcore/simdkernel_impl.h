@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// lane scheduling shared by all simd kernels, NOT a regular header
+//
+// include it once per instruction set, after defining FRACT_SIMD_TARGET and
+// a vector traits struct (see simdkernel_sse2.cpp, simdkernel_avx2.cpp and
+// simdkernel_avx512.cpp). Everything in here lives in an anonymous namespace
+// and must not call inline functions from other headers: a copy compiled for
+// avx512 would otherwise be free to replace the sse2 one at link time.
+//
+// V::Real / V::Vec / V::LANES, V::Load(), V::Store(), V::Set1(), V::Add(),
+// V::Sub(), V::Mul() and V::EscapeMask(norm, bailout), the mask has bit n
+// set when lane n is NOT below the bailout (NaN included, like the shader)
+//
+// the constants of mandelbrotkernel.h are fine to use
+
+namespace
+{
+
+// deadline and save step of an idle lane
+const long long NEVER = 0x7fffffffffffffffLL;
+
+// per lane bookkeeping, only touched when a lane finishes or has to save
+template <class V>
+struct LaneState
+{
+    typedef typename V::Real Real;
+    enum { LANES = V::LANES };
+
+    const Real* cxIn;
+    const Real* cyIn;
+    Real* zxInOut;      // resumed points, 0 if they start at c
+    Real* zyInOut;
+    const int* iterationsIn;
+    int count;
+    int maxIterations;
+    int next;       // next point to load
+    int busy;       // lanes holding a point
+    int liveMask;   // bit l set while lane l holds a point
+
+    Real zx[LANES], zy[LANES], cx[LANES], cy[LANES], norm[LANES];
+    Real savedX[LANES], savedY[LANES];
+    long long start[LANES], deadline[LANES], save[LANES];
+    int index[LANES];
+
+    // loads the next point into lane l, or parks it; has to share the
+    // target of the loop, a plain function would mix sse and avx code
+    FRACT_SIMD_TARGET void Refill(int l, long long step)
+    {
+        if ( next < count )
+        {
+            cx[l] = zx[l] = cxIn[next];
+            cy[l] = zy[l] = cyIn[next];
+            start[l] = step;
+
+            // a resumed point counts as filled that many steps ago
+            if ( zxInOut )
+            {
+                zx[l] = zxInOut[next];
+                zy[l] = zyInOut[next];
+                start[l] = step - iterationsIn[next];
+            }
+
+            savedX[l] = zx[l];
+            savedY[l] = zy[l];
+            deadline[l] = start[l] + maxIterations;
+            save[l] = step + PERIODICITY_FIRST_SAVE;
+            index[l] = next ++;
+            liveMask |= 1 << l;
+        }
+        else
+        {
+            // idle lane, z stays at zero and never escapes
+            cx[l] = zx[l] = savedX[l] = Real(0);
+            cy[l] = zy[l] = savedY[l] = Real(0);
+            deadline[l] = NEVER;
+            save[l] = NEVER;
+            if ( index[l] >= 0 )
+                busy --;
+            index[l] = -1;
+            liveMask &= ~(1 << l);
+        }
+    }
+};
+
+// with PERIODIC every lane also runs Brent's cycle check: it keeps the z of
+// its local iteration 16, 32, 64, ... and compares every new z against it,
+// see IterateEscapePeriodic(). Lanes save at different steps, so like the
+// deadlines the earliest save point of all lanes is tracked and the lanes
+// are only stored and reloaded when one of them is due.
+template <class V, bool PERIODIC>
+FRACT_SIMD_TARGET void EscapeLanes(const typename V::Real* cxIn, const typename V::Real* cyIn, int count,
+                                   int maxIterations, typename V::Real epsilon2,
+                                   int* iterations, typename V::Real* norm2,
+                                   typename V::Real* zxInOut, typename V::Real* zyInOut)
+{
+    typedef typename V::Real Real;
+    typedef typename V::Vec Vec;
+    const int LANES = V::LANES;
+
+    LaneState<V> lanes;
+    lanes.cxIn = cxIn;
+    lanes.cyIn = cyIn;
+    lanes.zxInOut = zxInOut;
+    lanes.zyInOut = zyInOut;
+    lanes.iterationsIn = iterations;
+    lanes.count = count;
+    lanes.maxIterations = maxIterations;
+    lanes.next = 0;
+    lanes.busy = 0;
+    lanes.liveMask = 0;
+
+    // step counter shared by all lanes, a lane's iteration count is the
+    // number of steps since it was filled
+    long long step = 0;
+
+    for ( int l = 0; l < LANES; l ++)
+    {
+        lanes.index[l] = -1;
+        lanes.Refill(l, step);
+        if ( lanes.index[l] >= 0 )
+            lanes.busy ++;
+    }
+
+    long long firstDeadline = NEVER;
+    long long nextSave = NEVER;
+    for ( int l = 0; l < LANES; l ++)
+    {
+        firstDeadline = lanes.deadline[l] < firstDeadline ? lanes.deadline[l] : firstDeadline;
+        nextSave = lanes.save[l] < nextSave ? lanes.save[l] : nextSave;
+    }
+
+    Vec zx = V::Load(lanes.zx);
+    Vec zy = V::Load(lanes.zy);
+    Vec cx = V::Load(lanes.cx);
+    Vec cy = V::Load(lanes.cy);
+    Vec savedX = V::Load(lanes.savedX);
+    Vec savedY = V::Load(lanes.savedY);
+    const Vec bailout = V::Set1(Real(4.0));
+    const Vec closeness = V::Set1(epsilon2);
+
+    while ( lanes.busy > 0 )
+    {
+        Vec x2 = V::Mul(zx, zx);
+        Vec y2 = V::Mul(zy, zy);
+        Vec norm = V::Add(x2, y2);
+
+        int escaped = V::EscapeMask(norm, bailout);
+
+        if ( escaped != 0 || step == firstDeadline )
+        {
+            // retire the finished lanes and refill them, then test again
+            // since a fresh point may escape at its very first step
+            V::Store(lanes.zx, zx);
+            V::Store(lanes.zy, zy);
+            V::Store(lanes.cx, cx);
+            V::Store(lanes.cy, cy);
+            V::Store(lanes.norm, norm);
+            if ( PERIODIC )
+            {
+                V::Store(lanes.savedX, savedX);
+                V::Store(lanes.savedY, savedY);
+            }
+
+            firstDeadline = NEVER;
+            nextSave = NEVER;
+
+            for ( int l = 0; l < LANES; l ++)
+            {
+                if ( lanes.index[l] >= 0 && ((escaped >> l) & 1 || step == lanes.deadline[l]) )
+                {
+                    iterations[lanes.index[l]] = int(step - lanes.start[l]);
+                    norm2[lanes.index[l]] = lanes.norm[l];
+                    if ( zxInOut )
+                    {
+                        zxInOut[lanes.index[l]] = lanes.zx[l];
+                        zyInOut[lanes.index[l]] = lanes.zy[l];
+                    }
+                    lanes.Refill(l, step);
+                }
+
+                firstDeadline = lanes.deadline[l] < firstDeadline ? lanes.deadline[l] : firstDeadline;
+                nextSave = lanes.save[l] < nextSave ? lanes.save[l] : nextSave;
+            }
+
+            zx = V::Load(lanes.zx);
+            zy = V::Load(lanes.zy);
+            cx = V::Load(lanes.cx);
+            cy = V::Load(lanes.cy);
+            if ( PERIODIC )
+            {
+                savedX = V::Load(lanes.savedX);
+                savedY = V::Load(lanes.savedY);
+            }
+            continue;
+        }
+
+        // z = dvec2(z.x*z.x - z.y*z.y, 2.0*z.x*z.y) + c
+        zy = V::Add(V::Mul(V::Add(zx, zx), zy), cy);
+        zx = V::Add(V::Sub(x2, y2), cx);
+        step ++;
+
+        if ( !PERIODIC )
+            continue;
+
+        Vec dx = V::Sub(zx, savedX);
+        Vec dy = V::Sub(zy, savedY);
+        int close = ~V::EscapeMask(V::Add(V::Mul(dx, dx), V::Mul(dy, dy)), closeness) & lanes.liveMask;
+
+        if ( close == 0 && step != nextSave )
+            continue;
+
+        // retire the lanes caught in a cycle, move the saved z of the lanes
+        // that reached their save point
+        V::Store(lanes.zx, zx);
+        V::Store(lanes.zy, zy);
+        V::Store(lanes.cx, cx);
+        V::Store(lanes.cy, cy);
+        V::Store(lanes.savedX, savedX);
+        V::Store(lanes.savedY, savedY);
+
+        firstDeadline = NEVER;
+        nextSave = NEVER;
+
+        for ( int l = 0; l < LANES; l ++)
+        {
+            if ( (close >> l) & 1 )
+            {
+                iterations[lanes.index[l]] = maxIterations;
+                norm2[lanes.index[l]] = -Real(step - lanes.start[l]);
+                if ( zxInOut )
+                {
+                    zxInOut[lanes.index[l]] = lanes.zx[l];
+                    zyInOut[lanes.index[l]] = lanes.zy[l];
+                }
+                lanes.Refill(l, step);
+            }
+            else if ( step == lanes.save[l] )
+            {
+                lanes.savedX[l] = lanes.zx[l];
+                lanes.savedY[l] = lanes.zy[l];
+                lanes.save[l] = step + (step - lanes.start[l]);
+            }
+
+            firstDeadline = lanes.deadline[l] < firstDeadline ? lanes.deadline[l] : firstDeadline;
+            nextSave = lanes.save[l] < nextSave ? lanes.save[l] : nextSave;
+        }
+
+        zx = V::Load(lanes.zx);
+        zy = V::Load(lanes.zy);
+        cx = V::Load(lanes.cx);
+        cy = V::Load(lanes.cy);
+        savedX = V::Load(lanes.savedX);
+        savedY = V::Load(lanes.savedY);
+    }
+}
+
+template <class V>
+FRACT_SIMD_TARGET void EscapeLoop(const typename V::Real* cx, const typename V::Real* cy, int count,
+                                  int maxIterations, typename V::Real epsilon2,
+                                  int* iterations, typename V::Real* norm2,
+                                  typename V::Real* zx, typename V::Real* zy)
+{
+    if ( epsilon2 > typename V::Real(0) )
+        EscapeLanes<V, true>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+    else
+        EscapeLanes<V, false>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+} // namespace
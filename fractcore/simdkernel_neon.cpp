@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "simdkernel.h"
+#include "mandelbrotkernel.h"
+
+#if defined(FRACT_NEON)
+
+#include <arm_neon.h>
+
+#define FRACT_SIMD_TARGET
+
+namespace
+{
+
+struct NeonFloat
+{
+    typedef float Real;
+    typedef float32x4_t Vec;
+    enum { LANES = 4 };
+
+    static Vec Load(const Real* p) { return vld1q_f32(p); }
+    static void Store(Real* p, Vec v) { vst1q_f32(p, v); }
+    static Vec Set1(Real r) { return vdupq_n_f32(r); }
+    static Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+    static Vec Sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+    static Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+
+    static int EscapeMask(Vec norm, Vec bailout)
+    {
+        // lanes below the bailout are all ones, NaN compares false
+        uint32x4_t below = vcltq_f32(norm, bailout);
+        return (vgetq_lane_u32(below, 0) ? 0 : 1) | (vgetq_lane_u32(below, 1) ? 0 : 2) |
+               (vgetq_lane_u32(below, 2) ? 0 : 4) | (vgetq_lane_u32(below, 3) ? 0 : 8);
+    }
+};
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+struct NeonDouble
+{
+    typedef double Real;
+    typedef float64x2_t Vec;
+    enum { LANES = 2 };
+
+    static Vec Load(const Real* p) { return vld1q_f64(p); }
+    static void Store(Real* p, Vec v) { vst1q_f64(p, v); }
+    static Vec Set1(Real r) { return vdupq_n_f64(r); }
+    static Vec Add(Vec a, Vec b) { return vaddq_f64(a, b); }
+    static Vec Sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+    static Vec Mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+
+    static int EscapeMask(Vec norm, Vec bailout)
+    {
+        uint64x2_t below = vcltq_f64(norm, bailout);
+        return (vgetq_lane_u64(below, 0) ? 0 : 1) | (vgetq_lane_u64(below, 1) ? 0 : 2);
+    }
+};
+#endif
+
+} // namespace
+
+#include "simdkernel_impl.h"
+
+void EscapeNeonFloat(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy)
+{
+    EscapeLoop<NeonFloat>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+void EscapeNeonDouble(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy)
+{
+    EscapeLoop<NeonDouble>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+#endif
+
+#endif // FRACT_NEON
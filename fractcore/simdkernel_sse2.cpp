@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "simdkernel.h"
+#include "mandelbrotkernel.h"
+
+#if defined(FRACT_X86)
+
+#include <emmintrin.h>
+
+#define FRACT_SIMD_TARGET FRACT_TARGET("sse2")
+
+namespace
+{
+
+struct Sse2Double
+{
+    typedef double Real;
+    typedef __m128d Vec;
+    enum { LANES = 2 };
+
+    static FRACT_SIMD_TARGET Vec Load(const Real* p) { return _mm_loadu_pd(p); }
+    static FRACT_SIMD_TARGET void Store(Real* p, Vec v) { _mm_storeu_pd(p, v); }
+    static FRACT_SIMD_TARGET Vec Set1(Real r) { return _mm_set1_pd(r); }
+    static FRACT_SIMD_TARGET Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+    static FRACT_SIMD_TARGET Vec Sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+    static FRACT_SIMD_TARGET Vec Mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+    static FRACT_SIMD_TARGET int EscapeMask(Vec norm, Vec bailout) { return _mm_movemask_pd(_mm_cmpnlt_pd(norm, bailout)); }
+};
+
+struct Sse2Float
+{
+    typedef float Real;
+    typedef __m128 Vec;
+    enum { LANES = 4 };
+
+    static FRACT_SIMD_TARGET Vec Load(const Real* p) { return _mm_loadu_ps(p); }
+    static FRACT_SIMD_TARGET void Store(Real* p, Vec v) { _mm_storeu_ps(p, v); }
+    static FRACT_SIMD_TARGET Vec Set1(Real r) { return _mm_set1_ps(r); }
+    static FRACT_SIMD_TARGET Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    static FRACT_SIMD_TARGET Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    static FRACT_SIMD_TARGET Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    static FRACT_SIMD_TARGET int EscapeMask(Vec norm, Vec bailout) { return _mm_movemask_ps(_mm_cmpnlt_ps(norm, bailout)); }
+};
+
+} // namespace
+
+#include "simdkernel_impl.h"
+
+FRACT_SIMD_TARGET void EscapeSse2Double(const double* cx, const double* cy, int count, int maxIterations, double epsilon2, int* iterations, double* norm2, double* zx, double* zy)
+{
+    EscapeLoop<Sse2Double>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+FRACT_SIMD_TARGET void EscapeSse2Float(const float* cx, const float* cy, int count, int maxIterations, float epsilon2, int* iterations, float* norm2, float* zx, float* zy)
+{
+    EscapeLoop<Sse2Float>(cx, cy, count, maxIterations, epsilon2, iterations, norm2, zx, zy);
+}
+
+#endif // FRACT_X86
@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "subdivisionrenderer.h"
+
+#include <algorithm>
+#include <vector>
+
+SubdivisionStats::SubdivisionStats()
+{
+    pixels = 0;
+    computedPixels = 0;
+    filledPixels = 0;
+    rejectedFills = 0;
+}
+
+void SubdivisionStats::Add(const SubdivisionStats& other)
+{
+    pixels += other.pixels;
+    computedPixels += other.computedPixels;
+    filledPixels += other.filledPixels;
+    rejectedFills += other.rejectedFills;
+    kernel.Add(other.kernel);
+}
+
+// iteration and smooth planes of one RenderRegion() call, in region
+// coordinates
+struct SubdivisionRenderer::Region
+{
+    const MandelbrotView* view;
+    int originX;
+    int originY;
+
+    std::vector<int> iterations;
+    std::vector<float> smooth;
+    FractalBuffer buffer;
+
+    // pixels waiting for the next Evaluate(), in region coordinates
+    std::vector<int> pendingX;
+    std::vector<int> pendingY;
+    std::vector<int> pendingIterations;
+    std::vector<float> pendingSmooth;
+
+    SubdivisionStats stats;
+};
+
+SubdivisionRenderer::SubdivisionRenderer()
+{
+    engine = 0;
+    minimumSize = 6;
+    safeguard = true;
+}
+
+void SubdivisionRenderer::SetEngine(const MandelbrotEngine* engine)
+{
+    this->engine = engine;
+}
+
+void SubdivisionRenderer::SetMinimumSize(int minimumSize)
+{
+    this->minimumSize = minimumSize < 3 ? 3 : minimumSize;
+}
+
+void SubdivisionRenderer::SetSafeguard(bool enabled)
+{
+    safeguard = enabled;
+}
+
+void SubdivisionRenderer::RenderRegion(const MandelbrotView& view, int x, int y, int width, int height,
+                                       FractalBuffer& buffer, SubdivisionStats* stats) const
+{
+    if ( width <= 0 || height <= 0 )
+        return;
+
+    Region region;
+    region.view = &view;
+    region.originX = x;
+    region.originY = y;
+    region.iterations.resize(size_t(width) * height);
+    region.smooth.resize(size_t(width) * height);
+    region.buffer = FractalBuffer(width, height, 0, &region.iterations[0], &region.smooth[0]);
+
+    if ( width < 3 || height < 3 )
+    {
+        Queue(region, 0, 0, width, height);
+        Evaluate(region);
+    }
+    else
+    {
+        // outer border, then the recursion only ever iterates the lines
+        // it cuts along
+        Queue(region, 0, 0, width, 1);
+        Queue(region, 0, height - 1, width, 1);
+        Queue(region, 0, 1, 1, height - 2);
+        Queue(region, width - 1, 1, 1, height - 2);
+        Evaluate(region);
+
+        Subdivide(region, 0, 0, width - 1, height - 1);
+    }
+
+    // colors last, the kernel pass left them out
+    const int maxIterations = view.maxIterations;
+    for ( int row = 0; row < height; row ++)
+    {
+        for ( int column = 0; column < width; column ++)
+        {
+            int source = row * width + column;
+            int target = row * buffer.stride + column;
+
+            if ( buffer.iterations )
+                buffer.iterations[target] = region.iterations[source];
+            if ( buffer.smooth )
+                buffer.smooth[target] = region.smooth[source];
+            if ( buffer.rgba )
+                engine->Colorize(region.smooth[source], maxIterations, buffer.rgba + target * 4);
+        }
+    }
+
+    region.stats.pixels = (long long)(width) * height;
+
+    if ( stats )
+        stats->Add(region.stats);
+}
+
+void SubdivisionRenderer::Queue(Region& region, int x, int y, int width, int height) const
+{
+    for ( int row = y; row < y + height; row ++)
+    {
+        for ( int column = x; column < x + width; column ++)
+        {
+            region.pendingX.push_back(column);
+            region.pendingY.push_back(row);
+        }
+    }
+}
+
+// one kernel call for all queued pixels, the lines of a rectangle are far
+// too short to keep the vector lanes busy one by one
+void SubdivisionRenderer::Evaluate(Region& region) const
+{
+    const int count = int(region.pendingX.size());
+    if ( count == 0 )
+        return;
+
+    region.pendingIterations.resize(count);
+    region.pendingSmooth.resize(count);
+
+    // the engine wants image coordinates
+    for ( int i = 0; i < count; i ++)
+    {
+        region.pendingX[i] += region.originX;
+        region.pendingY[i] += region.originY;
+    }
+
+    engine->RenderPixels(*region.view, &region.pendingX[0], &region.pendingY[0], count,
+                         &region.pendingIterations[0], &region.pendingSmooth[0], 0, 0, &region.stats.kernel);
+
+    const int stride = region.buffer.stride;
+    for ( int i = 0; i < count; i ++)
+    {
+        int offset = (region.pendingY[i] - region.originY) * stride + region.pendingX[i] - region.originX;
+        region.iterations[offset] = region.pendingIterations[i];
+        region.smooth[offset] = region.pendingSmooth[i];
+    }
+
+    region.stats.computedPixels += count;
+    region.pendingX.clear();
+    region.pendingY.clear();
+}
+
+// the rectangle [x0, x1] x [y0, y1] has its border computed already
+void SubdivisionRenderer::Subdivide(Region& region, int x0, int y0, int x1, int y1) const
+{
+    const int innerWidth = x1 - x0 - 1;
+    const int innerHeight = y1 - y0 - 1;
+
+    if ( innerWidth <= 0 || innerHeight <= 0 )
+        return;
+
+    if ( innerWidth + 2 < minimumSize || innerHeight + 2 < minimumSize )
+    {
+        Queue(region, x0 + 1, y0 + 1, innerWidth, innerHeight);
+        Evaluate(region);
+        return;
+    }
+
+    const int value = region.iterations[y0 * region.buffer.stride + x0];
+    bool uniform = SpanIsUniform(region, x0, y0, x1 - x0 + 1, 1, value)
+                && SpanIsUniform(region, x0, y1, x1 - x0 + 1, 1, value)
+                && SpanIsUniform(region, x0, y0 + 1, 1, innerHeight, value)
+                && SpanIsUniform(region, x1, y0 + 1, 1, innerHeight, value);
+
+    const int xm = (x0 + x1) / 2;
+    const int ym = (y0 + y1) / 2;
+
+    if ( uniform && safeguard )
+    {
+        // a filament that got past the border most likely crosses one of
+        // the middle lines
+        Queue(region, x0 + 1, ym, innerWidth, 1);
+        Queue(region, xm, y0 + 1, 1, ym - y0 - 1);
+        Queue(region, xm, ym + 1, 1, y1 - ym - 1);
+        Evaluate(region);
+
+        if ( SpanIsUniform(region, x0 + 1, ym, innerWidth, 1, value)
+             && SpanIsUniform(region, xm, y0 + 1, 1, innerHeight, value) )
+        {
+            Fill(region, x0, y0, x1, y1, value);
+            return;
+        }
+
+        region.stats.rejectedFills ++;
+
+        Subdivide(region, x0, y0, xm, ym);
+        Subdivide(region, xm, y0, x1, ym);
+        Subdivide(region, x0, ym, xm, y1);
+        Subdivide(region, xm, ym, x1, y1);
+        return;
+    }
+
+    if ( uniform )
+    {
+        Fill(region, x0, y0, x1, y1, value);
+        return;
+    }
+
+    if ( x1 - x0 >= y1 - y0 )
+    {
+        Queue(region, xm, y0 + 1, 1, innerHeight);
+        Evaluate(region);
+        Subdivide(region, x0, y0, xm, y1);
+        Subdivide(region, xm, y0, x1, y1);
+    }
+    else
+    {
+        Queue(region, x0 + 1, ym, innerWidth, 1);
+        Evaluate(region);
+        Subdivide(region, x0, y0, x1, ym);
+        Subdivide(region, x0, ym, x1, y1);
+    }
+}
+
+bool SubdivisionRenderer::SpanIsUniform(const Region& region, int x, int y, int width, int height, int value) const
+{
+    for ( int row = y; row < y + height; row ++)
+    {
+        const int* line = &region.iterations[row * region.buffer.stride];
+        for ( int column = x; column < x + width; column ++)
+        {
+            if ( line[column] != value )
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// fills the pixels of [x0, x1] x [y0, y1] that were not computed yet
+void SubdivisionRenderer::Fill(Region& region, int x0, int y0, int x1, int y1, int value) const
+{
+    const int stride = region.buffer.stride;
+    const int maxIterations = region.view->maxIterations;
+    int* iterations = &region.iterations[0];
+    float* smooth = &region.smooth[0];
+
+    // the safeguard lines are computed already, they keep their own values
+    const bool skipMiddle = safeguard;
+    const int xm = (x0 + x1) / 2;
+    const int ym = (y0 + y1) / 2;
+
+    // escape bands blend the four borders, the corners are counted twice
+    const float topLeft = smooth[y0 * stride + x0];
+    const float topRight = smooth[y0 * stride + x1];
+    const float bottomLeft = smooth[y1 * stride + x0];
+    const float bottomRight = smooth[y1 * stride + x1];
+
+    float low = topLeft;
+    float high = topLeft;
+    for ( int column = x0; column <= x1; column ++)
+    {
+        low = std::min(low, std::min(smooth[y0 * stride + column], smooth[y1 * stride + column]));
+        high = std::max(high, std::max(smooth[y0 * stride + column], smooth[y1 * stride + column]));
+    }
+    for ( int row = y0; row <= y1; row ++)
+    {
+        low = std::min(low, std::min(smooth[row * stride + x0], smooth[row * stride + x1]));
+        high = std::max(high, std::max(smooth[row * stride + x0], smooth[row * stride + x1]));
+    }
+
+    const float inverseWidth = 1.0f / float(x1 - x0);
+    const float inverseHeight = 1.0f / float(y1 - y0);
+    long long filled = 0;
+
+    for ( int row = y0 + 1; row < y1; row ++)
+    {
+        if ( skipMiddle && row == ym )
+            continue;
+
+        float v = float(row - y0) * inverseHeight;
+        float left = smooth[row * stride + x0];
+        float right = smooth[row * stride + x1];
+
+        for ( int column = x0 + 1; column < x1; column ++)
+        {
+            if ( skipMiddle && column == xm )
+                continue;
+
+            int offset = row * stride + column;
+            iterations[offset] = value;
+            filled ++;
+
+            if ( value >= maxIterations )
+            {
+                smooth[offset] = float(maxIterations);
+                continue;
+            }
+
+            float u = float(column - x0) * inverseWidth;
+            float top = smooth[y0 * stride + column];
+            float bottom = smooth[y1 * stride + column];
+
+            float s = (1.0f - v) * top + v * bottom + (1.0f - u) * left + u * right
+                    - ((1.0f - u) * (1.0f - v) * topLeft + u * (1.0f - v) * topRight
+                       + (1.0f - u) * v * bottomLeft + u * v * bottomRight);
+
+            smooth[offset] = std::min(high, std::max(low, s));
+        }
+    }
+
+    region.stats.filledPixels += filled;
+}
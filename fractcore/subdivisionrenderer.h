@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUBDIVISIONRENDERER_H
+#define SUBDIVISIONRENDERER_H
+
+#include "mandelbrotengine.h"
+
+// counters of the subdivision renderer
+struct SubdivisionStats
+{
+    SubdivisionStats();
+
+    void Add(const SubdivisionStats& other);
+
+    long long pixels;           // pixels written
+    long long computedPixels;   // pixels that went through the escape kernel
+    long long filledPixels;     // pixels taken over from a uniform border
+    long long rejectedFills;    // uniform rectangles the safeguard had to split
+    KernelStats kernel;         // the computed pixels
+
+    double SkippedFraction() const { return pixels > 0 ? double(filledPixels) / double(pixels) : 0.0; }
+};
+
+// Mariani-Silver rectangle subdivision on top of MandelbrotEngine
+//
+// only the border of a rectangle is iterated. If every border pixel has the
+// same iteration count the inside is filled with it, otherwise the
+// rectangle is cut in two along its longer side and both halves go on with
+// the shared line as their new border.
+//
+// the set is connected, so a border that stays inside encloses nothing but
+// interior pixels. Escape bands have no such guarantee, a filament thinner
+// than a pixel can slip between two border samples; the safeguard iterates
+// the middle row and column of every rectangle before filling it and splits
+// it into quarters if they disagree.
+//
+// filled escape pixels get a smooth value interpolated from the border
+// (Coons patch), so their color is off by a small fraction of an
+// iteration; a feature that neither the border nor the safeguard lines hit
+// is lost, which in practice is a handful of isolated pixels per frame
+//
+// like MandelbrotEngine the renderer is immutable while rendering
+class SubdivisionRenderer
+{
+public:
+    SubdivisionRenderer();
+
+    // engine that evaluates the borders, also used for the colors
+    void SetEngine(const MandelbrotEngine* engine);
+
+    // rectangles with a side below this are iterated in full
+    void SetMinimumSize(int minimumSize);
+    int MinimumSize() const { return minimumSize; }
+
+    // check the middle lines before filling, on by default
+    void SetSafeguard(bool enabled);
+    bool SafeguardEnabled() const { return safeguard; }
+
+    // same contract as MandelbrotEngine::RenderRegion(), the counters of the
+    // call are added to stats if given
+    void RenderRegion(const MandelbrotView& view, int x, int y, int width, int height,
+                      FractalBuffer& buffer, SubdivisionStats* stats = 0) const;
+
+private:
+    struct Region;
+
+    void Queue(Region& region, int x, int y, int width, int height) const;
+    void Evaluate(Region& region) const;
+    void Subdivide(Region& region, int x0, int y0, int x1, int y1) const;
+    bool SpanIsUniform(const Region& region, int x, int y, int width, int height, int value) const;
+    void Fill(Region& region, int x0, int y0, int x1, int y1, int value) const;
+
+    const MandelbrotEngine* engine;
+    int minimumSize;
+    bool safeguard;
+};
+
+#endif // SUBDIVISIONRENDERER_H
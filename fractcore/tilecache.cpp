@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tilecache.h"
+#include "perturbationrenderer.h"
+#include "tilepyramid.h"
+
+#include <algorithm>
+#include <cstring>
+#include <math.h>
+
+// bits kept of the pixel size and the rotation; at the deepest double
+// precision view a grid position is about 2^40 pixels from the origin,
+// so the rounding has to stay far below a pixel there
+static const int PIXEL_SIZE_BITS = 44;
+static const int ROTATION_BITS = 48;
+
+static long long RoundPixelSize(double pixelSize)
+{
+    int exponent;
+    long long mantissa = llround(ldexp(frexp(pixelSize, &exponent), PIXEL_SIZE_BITS));
+
+    // rounded up to the next power of two
+    if ( mantissa == (1LL << PIXEL_SIZE_BITS) )
+    {
+        mantissa >>= 1;
+        exponent ++;
+    }
+
+    return (long long)(exponent) * (1LL << PIXEL_SIZE_BITS) + mantissa;
+}
+
+static long long FloorDivide(long long value, long long divisor)
+{
+    long long quotient = value / divisor;
+    return quotient * divisor > value ? quotient - 1 : quotient;
+}
+
+bool TileKey::operator==(const TileKey& other) const
+{
+    return column == other.column && row == other.row && pixelSize == other.pixelSize &&
+           rotation == other.rotation && maxIterations == other.maxIterations;
+}
+
+unsigned long long TileKey::Hash() const
+{
+    // splitmix64 finalizer over the fields one after another
+    unsigned long long fields[5] = { (unsigned long long)(column), (unsigned long long)(row),
+                                     (unsigned long long)(pixelSize), (unsigned long long)(rotation),
+                                     (unsigned long long)(maxIterations) };
+    unsigned long long hash = 0;
+
+    for ( int i = 0; i < 5; i ++)
+    {
+        hash += fields[i] + 0x9e3779b97f4a7c15ULL;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        hash ^= hash >> 31;
+    }
+
+    return hash;
+}
+
+size_t TileKeyHash::operator()(const TileKey& key) const
+{
+    return size_t(key.Hash());
+}
+
+TileCacheStats::TileCacheStats()
+{
+    hits = 0;
+    pyramidHits = 0;
+    misses = 0;
+}
+
+void TileCacheStats::Add(const TileCacheStats& other)
+{
+    hits += other.hits;
+    pyramidHits += other.pyramidHits;
+    misses += other.misses;
+    kernel.Add(other.kernel);
+}
+
+TileCache::TileCache(size_t budget, int tileSize)
+{
+    this->budget = budget;
+    this->tileSize = tileSize < 8 ? 8 : tileSize;
+    pyramid = 0;
+    bytes = 0;
+    evictions = 0;
+}
+
+void TileCache::SetBudget(size_t budget)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->budget = budget;
+    Evict(budget);
+}
+
+bool TileCache::SetPyramid(const TilePyramid* pyramid)
+{
+    if ( pyramid && pyramid->TileSize() != tileSize )
+        return false;
+
+    this->pyramid = pyramid;
+    return true;
+}
+
+size_t TileCache::Bytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
+
+int TileCache::TileCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return int(index.size());
+}
+
+long long TileCache::Evictions() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return evictions;
+}
+
+void TileCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    tiles.clear();
+    index.clear();
+    bytes = 0;
+}
+
+bool TileCache::IsCacheable(const MandelbrotView& view)
+{
+    return view.width > 0 && view.height > 0 && !PerturbationRenderer::IsDeepView(view);
+}
+
+MandelbrotView TileCache::AlignView(const MandelbrotView& view)
+{
+    if ( !IsCacheable(view) )
+        return view;
+
+    // the pixel center of the image center, turned back to the image axes
+    // where the grid runs along the rows and columns
+    const ViewTransform transform(view);
+    const double pixelSize = view.PixelSize();
+    const double cosRot = cos(view.rotation);
+    const double sinRot = sin(view.rotation);
+
+    double cx, cy;
+    transform.Map(0.5 * view.width, 0.5 * view.height, cx, cy);
+
+    double originX = (cx * cosRot + cy * sinRot) / pixelSize - 0.5 * view.width;
+    double originY = (cx * sinRot - cy * cosRot) / pixelSize - 0.5 * view.height;
+
+    // the center is added before the rotation in mandelbrot_frag.glsl, so
+    // it moves the grid position along the image axes; rows grow downwards
+    MandelbrotView aligned = view;
+    double centerX = view.centerX + (double(llround(originX)) - originX) * pixelSize;
+    double centerY = view.centerY - (double(llround(originY)) - originY) * pixelSize;
+    aligned.SetCenter(BigFloat(centerX), BigFloat(centerY));
+
+    return aligned;
+}
+
+TileCache::Grid TileCache::ComputeGrid(const MandelbrotView& view)
+{
+    const ViewTransform transform(view);
+    const double pixelSize = view.PixelSize();
+    const double cosRot = cos(view.rotation);
+    const double sinRot = sin(view.rotation);
+
+    double cx, cy;
+    transform.Map(0.5 * view.width, 0.5 * view.height, cx, cy);
+
+    Grid grid;
+    grid.originX = llround((cx * cosRot + cy * sinRot) / pixelSize - 0.5 * view.width);
+    grid.originY = llround((cx * sinRot - cy * cosRot) / pixelSize - 0.5 * view.height);
+    grid.key.column = 0;
+    grid.key.row = 0;
+    grid.key.pixelSize = RoundPixelSize(pixelSize);
+    grid.key.rotation = llround(ldexp(view.rotation, ROTATION_BITS));
+    grid.key.maxIterations = view.maxIterations;
+
+    return grid;
+}
+
+TileKey TileCache::KeyOf(const Grid& grid, const RenderTile& tile) const
+{
+    TileKey key = grid.key;
+    key.column = FloorDivide(grid.originX + tile.x, tileSize);
+    key.row = FloorDivide(grid.originY + tile.y, tileSize);
+
+    return key;
+}
+
+TileKey TileCache::Key(const MandelbrotView& view, const RenderTile& tile) const
+{
+    return KeyOf(ComputeGrid(view), tile);
+}
+
+std::vector<RenderTile> TileCache::Tiles(const MandelbrotView& view) const
+{
+    std::vector<RenderTile> result;
+
+    if ( !IsCacheable(view) )
+        return result;
+
+    Grid grid = ComputeGrid(view);
+    long long firstColumn = FloorDivide(grid.originX, tileSize);
+    long long lastColumn = FloorDivide(grid.originX + view.width - 1, tileSize);
+    long long firstRow = FloorDivide(grid.originY, tileSize);
+    long long lastRow = FloorDivide(grid.originY + view.height - 1, tileSize);
+
+    for ( long long row = firstRow; row <= lastRow; row ++)
+    {
+        for ( long long column = firstColumn; column <= lastColumn; column ++)
+        {
+            RenderTile tile;
+            tile.x = int(column * tileSize - grid.originX);
+            tile.y = int(row * tileSize - grid.originY);
+            tile.width = tileSize;
+            tile.height = tileSize;
+            result.push_back(tile);
+        }
+    }
+
+    return result;
+}
+
+double TileCache::Coverage(const MandelbrotView& view) const
+{
+    std::vector<RenderTile> viewTiles = Tiles(view);
+
+    if ( viewTiles.empty() )
+        return 0.0;
+
+    Grid grid = ComputeGrid(view);
+    long long cachedPixels = 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for ( size_t i = 0; i < viewTiles.size(); i ++)
+    {
+        const RenderTile& tile = viewTiles[i];
+        TileKey key = KeyOf(grid, tile);
+        if ( index.find(key) == index.end() && !(pyramid && pyramid->Contains(key)) )
+            continue;
+
+        int visibleWidth = std::min(tile.x + tile.width, view.width) - std::max(tile.x, 0);
+        int visibleHeight = std::min(tile.y + tile.height, view.height) - std::max(tile.y, 0);
+        cachedPixels += (long long)(visibleWidth) * visibleHeight;
+    }
+
+    return double(cachedPixels) / (double(view.width) * double(view.height));
+}
+
+void TileCache::FillTile(const MandelbrotEngine& engine, const MandelbrotView& view, const RenderTile& tile,
+                         FractalBuffer& buffer, TileCacheStats* stats)
+{
+    TileCacheStats tileStats;
+    TileKey key = KeyOf(ComputeGrid(view), tile);
+    TilePointer cached = Find(key);
+
+    if ( cached )
+    {
+        tileStats.hits ++;
+    }
+    else
+    {
+        // the whole tile, the part outside of the image is there for the
+        // next pan
+        std::shared_ptr<Tile> rendered(new Tile());
+        rendered->iterations.resize(size_t(tileSize) * tileSize);
+        rendered->smooth.resize(size_t(tileSize) * tileSize);
+
+        if ( pyramid && pyramid->Read(key, &rendered->iterations[0], &rendered->smooth[0]) )
+        {
+            tileStats.pyramidHits ++;
+        }
+        else
+        {
+            FractalBuffer tileBuffer(tileSize, tileSize, 0, &rendered->iterations[0], &rendered->smooth[0]);
+            engine.RenderRegion(view, tile.x, tile.y, tileSize, tileSize, tileBuffer, &tileStats.kernel);
+            tileStats.misses ++;
+        }
+
+        cached = rendered;
+        Insert(key, cached);
+    }
+
+    // visible part of the tile
+    int x0 = std::max(tile.x, 0);
+    int y0 = std::max(tile.y, 0);
+    int x1 = std::min(tile.x + tileSize, view.width);
+    int y1 = std::min(tile.y + tileSize, view.height);
+
+    for ( int y = y0; y < y1; y ++)
+    {
+        size_t source = size_t(y - tile.y) * tileSize + (x0 - tile.x);
+        size_t target = size_t(y) * buffer.stride + x0;
+
+        memcpy(buffer.iterations + target, &cached->iterations[source], (x1 - x0) * sizeof(int));
+        memcpy(buffer.smooth + target, &cached->smooth[source], (x1 - x0) * sizeof(float));
+
+        if ( buffer.rgba )
+        {
+            for ( int x = 0; x < x1 - x0; x ++)
+                engine.Colorize(cached->smooth[source + x], view.maxIterations, buffer.rgba + (target + x) * 4);
+        }
+    }
+
+    if ( stats )
+        stats->Add(tileStats);
+}
+
+void TileCache::StoreFrame(const MandelbrotView& view, const FractalBuffer& buffer, const float* error)
+{
+    if ( budget < TileBytes() || !buffer.iterations || !buffer.smooth )
+        return;
+
+    std::vector<RenderTile> viewTiles = Tiles(view);
+    Grid grid = ComputeGrid(view);
+
+    for ( size_t i = 0; i < viewTiles.size(); i ++)
+    {
+        const RenderTile& tile = viewTiles[i];
+        if ( tile.x < 0 || tile.y < 0 || tile.x + tileSize > view.width || tile.y + tileSize > view.height )
+            continue;
+
+        TileKey key = KeyOf(grid, tile);
+        if ( Contains(key) )
+            continue;
+
+        bool exact = true;
+        for ( int y = 0; error && exact && y < tileSize; y ++)
+        {
+            const float* row = error + size_t(tile.y + y) * buffer.stride + tile.x;
+            for ( int x = 0; x < tileSize; x ++)
+            {
+                if ( row[x] != 0.0f )
+                {
+                    exact = false;
+                    break;
+                }
+            }
+        }
+
+        if ( !exact )
+            continue;
+
+        std::shared_ptr<Tile> stored(new Tile());
+        stored->iterations.resize(size_t(tileSize) * tileSize);
+        stored->smooth.resize(size_t(tileSize) * tileSize);
+
+        for ( int y = 0; y < tileSize; y ++)
+        {
+            size_t source = size_t(tile.y + y) * buffer.stride + tile.x;
+            memcpy(&stored->iterations[size_t(y) * tileSize], buffer.iterations + source, tileSize * sizeof(int));
+            memcpy(&stored->smooth[size_t(y) * tileSize], buffer.smooth + source, tileSize * sizeof(float));
+        }
+
+        Insert(key, stored);
+    }
+}
+
+TileCache::TilePointer TileCache::Find(const TileKey& key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHash>::iterator found = index.find(key);
+    if ( found == index.end() )
+        return TilePointer();
+
+    tiles.splice(tiles.begin(), tiles, found->second);
+    return found->second->second;
+}
+
+bool TileCache::Contains(const TileKey& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return index.find(key) != index.end();
+}
+
+void TileCache::Insert(const TileKey& key, const TilePointer& tile)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if ( budget < TileBytes() )
+        return;
+
+    // two workers rendered the same tile
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHash>::iterator found = index.find(key);
+    if ( found != index.end() )
+    {
+        tiles.splice(tiles.begin(), tiles, found->second);
+        return;
+    }
+
+    tiles.push_front(std::make_pair(key, tile));
+    index[key] = tiles.begin();
+    bytes += TileBytes();
+
+    Evict(budget);
+}
+
+void TileCache::Evict(size_t limit)
+{
+    while ( bytes > limit && !tiles.empty() )
+    {
+        index.erase(tiles.back().first);
+        tiles.pop_back();
+        bytes -= TileBytes();
+        evictions ++;
+    }
+}
+
+size_t TileCache::TileBytes() const
+{
+    return size_t(tileSize) * tileSize * (sizeof(int) + sizeof(float));
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mandelbrotengine.h"
+#include "tilescheduler.h"
+
+class TilePyramid;
+
+// position of a cache tile
+//
+// all views with the same pixel size and rotation share one grid of pixel
+// centers in the complex plane (see TileCache::AlignView()), column and
+// row count tiles on that grid. Pixel size and rotation are rounded to a
+// few bits less than a double, so a zoom step undone again still meets
+// its tiles.
+struct TileKey
+{
+    long long column;
+    long long row;
+    long long pixelSize;
+    long long rotation;
+    int maxIterations;
+
+    bool operator==(const TileKey& other) const;
+
+    // 64 bits on every platform, the tile pyramid stores it
+    unsigned long long Hash() const;
+};
+
+struct TileKeyHash
+{
+    size_t operator()(const TileKey& key) const;
+};
+
+// counters of the tile cache
+struct TileCacheStats
+{
+    TileCacheStats();
+
+    void Add(const TileCacheStats& other);
+
+    long long hits;         // tiles taken from the cache
+    long long pyramidHits;  // tiles read from the tile pyramid
+    long long misses;       // tiles that had to be rendered
+    KernelStats kernel;     // the rendered tiles
+
+    double HitRate() const
+    {
+        long long found = hits + pyramidHits;
+        return found + misses > 0 ? double(found) / double(found + misses) : 0.0;
+    }
+};
+
+// iteration and smooth planes of finished tiles, least recently used ones
+// are dropped once the memory budget is used up
+//
+// frames are cut into tiles on the grid of their pixel size and rotation,
+// a frame over a known region is assembled from the cached tiles and only
+// the missing ones are rendered. Tiles keep the whole tile even if only a
+// part of it was visible, so the next pan finds the rest.
+//
+// views are moved onto the grid first, by less than half a pixel; only
+// double precision views are cached, a deep zoom does not fit the grid.
+//
+// tiles that are not in memory are looked up in the tile pyramid if there
+// is one, before they are rendered
+//
+// FillTile() may be called from any number of threads
+class TileCache
+{
+public:
+    TileCache(size_t budget = 0, int tileSize = 64);
+
+    // memory for the planes in bytes, 0 turns the cache off; evicts right
+    // away if it shrinks
+    void SetBudget(size_t budget);
+    size_t Budget() const { return budget; }
+    int TileSize() const { return tileSize; }
+
+    // file of precomputed tiles, 0 for none; it has to stay open while the
+    // cache is used. False if its tiles have another size, set it while no
+    // FillTile() is running
+    bool SetPyramid(const TilePyramid* pyramid);
+    const TilePyramid* Pyramid() const { return pyramid; }
+
+    // bytes and tiles held right now, tiles evicted so far
+    size_t Bytes() const;
+    int TileCount() const;
+    long long Evictions() const;
+
+    void Clear();
+
+    // the view with its center moved by less than half a pixel, so that
+    // its pixel centers lie on the grid
+    static MandelbrotView AlignView(const MandelbrotView& view);
+
+    // whether the view can use the cache at all
+    static bool IsCacheable(const MandelbrotView& view);
+
+    // cache tiles covering the aligned view, in image coordinates; the
+    // tiles at the border reach out of the image
+    std::vector<RenderTile> Tiles(const MandelbrotView& view) const;
+
+    // key of one of the Tiles() of the view
+    TileKey Key(const MandelbrotView& view, const RenderTile& tile) const;
+
+    // fraction of the view's pixels that are cached, in memory or in the
+    // tile pyramid
+    double Coverage(const MandelbrotView& view) const;
+
+    // writes the visible part of one of the Tiles() into the whole frame
+    // buffer, from the cache or rendered by engine; buffer needs the
+    // iteration and smooth planes, colors are written if it has them
+    //
+    // the counters of the call are added to stats if given
+    void FillTile(const MandelbrotEngine& engine, const MandelbrotView& view, const RenderTile& tile,
+                  FractalBuffer& buffer, TileCacheStats* stats = 0);
+
+    // stores the tiles that lie completely inside a finished frame of the
+    // aligned view; tiles with pixels of a non zero error (pixels that show
+    // a nearby point, see ReprojectionRenderer) are skipped
+    void StoreFrame(const MandelbrotView& view, const FractalBuffer& buffer, const float* error = 0);
+
+private:
+    struct Tile
+    {
+        std::vector<int> iterations;
+        std::vector<float> smooth;
+    };
+
+    typedef std::shared_ptr<const Tile> TilePointer;
+    typedef std::list<std::pair<TileKey, TilePointer> > TileList;
+
+    // image pixel (0, 0) on the grid and the rounded view parameters
+    struct Grid
+    {
+        long long originX;
+        long long originY;
+        TileKey key;
+    };
+
+    static Grid ComputeGrid(const MandelbrotView& view);
+    TileKey KeyOf(const Grid& grid, const RenderTile& tile) const;
+
+    TilePointer Find(const TileKey& key);
+    bool Contains(const TileKey& key) const;
+    void Insert(const TileKey& key, const TilePointer& tile);
+    void Evict(size_t limit);
+
+    size_t TileBytes() const;
+
+    int tileSize;
+    size_t budget;
+    const TilePyramid* pyramid;
+
+    // most recently used tile first
+    mutable std::mutex mutex;
+    TileList tiles;
+    std::unordered_map<TileKey, TileList::iterator, TileKeyHash> index;
+    size_t bytes;
+    long long evictions;
+};
+
+#endif // TILECACHE_H
@@ -0,0 +1,535 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tilepyramid.h"
+#include "tilescheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const unsigned char PYRAMID_MAGIC[8] = { 'F', 'D', 'G', 'L', 'P', 'Y', 'R', 0 };
+static const unsigned int PYRAMID_VERSION = 1;
+static const size_t HEADER_SIZE = 64;
+static const size_t ENTRY_SIZE = 48;
+
+static unsigned long long ReadLE64(const unsigned char* p)
+{
+    unsigned long long value = 0;
+    for ( int i = 7; i >= 0; i --)
+        value = value << 8 | p[i];
+    return value;
+}
+
+static unsigned int ReadLE32(const unsigned char* p)
+{
+    return (unsigned int)(p[0]) | (unsigned int)(p[1]) << 8 |
+           (unsigned int)(p[2]) << 16 | (unsigned int)(p[3]) << 24;
+}
+
+static void WriteLE64(unsigned char* p, unsigned long long value)
+{
+    for ( int i = 0; i < 8; i ++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+static void WriteLE32(unsigned char* p, unsigned int value)
+{
+    for ( int i = 0; i < 4; i ++)
+        p[i] = (unsigned char)(value >> (8 * i));
+}
+
+// 64 bit file positions, long has 32 bits on windows
+static bool SeekFile(FILE* file, unsigned long long position)
+{
+#if defined(_WIN32)
+    return _fseeki64(file, (long long)(position), SEEK_SET) == 0;
+#else
+    return fseeko(file, off_t(position), SEEK_SET) == 0;
+#endif
+}
+
+static bool FileSize(FILE* file, unsigned long long& size)
+{
+#if defined(_WIN32)
+    long long end = _fseeki64(file, 0, SEEK_END) == 0 ? _ftelli64(file) : -1;
+#else
+    long long end = fseeko(file, 0, SEEK_END) == 0 ? (long long)(ftello(file)) : -1;
+#endif
+    size = (unsigned long long)(end);
+    return end >= 0;
+}
+
+// byte i of every value goes to plane i, lowest byte first
+static void SplitBytes(const void* values, size_t count, unsigned char* planes)
+{
+    const unsigned char* source = (const unsigned char*)(values);
+    for ( size_t j = 0; j < count; j ++)
+    {
+        unsigned int value;
+        memcpy(&value, source + j * 4, 4);
+        for ( int i = 0; i < 4; i ++)
+            planes[i * count + j] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void JoinBytes(const unsigned char* planes, size_t count, void* values)
+{
+    unsigned char* target = (unsigned char*)(values);
+    for ( size_t j = 0; j < count; j ++)
+    {
+        unsigned int value = (unsigned int)(planes[j]) | (unsigned int)(planes[count + j]) << 8 |
+                             (unsigned int)(planes[2 * count + j]) << 16 | (unsigned int)(planes[3 * count + j]) << 24;
+        memcpy(target + j * 4, &value, 4);
+    }
+}
+
+// index entry: column, row, pixel size and rotation as 64 bits, the
+// iteration limit and the deflated size as 32 bits, the file position
+// as 64 bits; a size of 0 marks an empty entry
+static TileKey ReadKey(const unsigned char* entry)
+{
+    TileKey key;
+    key.column = (long long)(ReadLE64(entry));
+    key.row = (long long)(ReadLE64(entry + 8));
+    key.pixelSize = (long long)(ReadLE64(entry + 16));
+    key.rotation = (long long)(ReadLE64(entry + 24));
+    key.maxIterations = int(ReadLE32(entry + 32));
+    return key;
+}
+
+static void WriteEntry(unsigned char* entry, const TileKey& key, unsigned int size, unsigned long long offset)
+{
+    WriteLE64(entry, (unsigned long long)(key.column));
+    WriteLE64(entry + 8, (unsigned long long)(key.row));
+    WriteLE64(entry + 16, (unsigned long long)(key.pixelSize));
+    WriteLE64(entry + 24, (unsigned long long)(key.rotation));
+    WriteLE32(entry + 32, (unsigned int)(key.maxIterations));
+    WriteLE32(entry + 36, size);
+    WriteLE64(entry + 40, offset);
+}
+
+TilePyramid::TilePyramid()
+{
+    data = 0;
+    dataSize = 0;
+    tileSize = 0;
+    tileCount = 0;
+    entries = 0;
+    capacity = 0;
+#if defined(_WIN32)
+    file = 0;
+    mapping = 0;
+#endif
+}
+
+TilePyramid::~TilePyramid()
+{
+    Close();
+}
+
+bool TilePyramid::Open(const std::string& path)
+{
+    Close();
+
+#if defined(_WIN32)
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if ( fileHandle == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER fileSize;
+    HANDLE mappingHandle = 0;
+    const void* view = 0;
+    if ( GetFileSizeEx(fileHandle, &fileSize) && fileSize.QuadPart >= LONGLONG(HEADER_SIZE) )
+        mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if ( mappingHandle )
+        view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if ( !view )
+    {
+        if ( mappingHandle )
+            CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    file = fileHandle;
+    mapping = mappingHandle;
+    data = (const unsigned char*)(view);
+    dataSize = size_t(fileSize.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if ( fd < 0 )
+        return false;
+
+    struct stat fileStat;
+    void* view = MAP_FAILED;
+    if ( fstat(fd, &fileStat) == 0 && fileStat.st_size >= off_t(HEADER_SIZE) )
+        view = mmap(0, size_t(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping keeps the file
+    close(fd);
+    if ( view == MAP_FAILED )
+        return false;
+
+    data = (const unsigned char*)(view);
+    dataSize = size_t(fileStat.st_size);
+#endif
+
+    unsigned long long indexOffset = ReadLE64(data + 24);
+    capacity = ReadLE64(data + 32);
+    tileSize = int(ReadLE32(data + 12));
+    tileCount = (long long)(ReadLE64(data + 16));
+
+    // the index has to be a power of two and lie inside the file
+    bool valid = memcmp(data, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC)) == 0 && ReadLE32(data + 8) == PYRAMID_VERSION &&
+                 tileSize > 0 && capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+                 indexOffset >= HEADER_SIZE && indexOffset <= dataSize &&
+                 capacity <= (dataSize - indexOffset) / ENTRY_SIZE;
+
+    if ( !valid )
+    {
+        Close();
+        return false;
+    }
+
+    entries = data + indexOffset;
+    return true;
+}
+
+void TilePyramid::Close()
+{
+#if defined(_WIN32)
+    if ( data )
+        UnmapViewOfFile(data);
+    if ( mapping )
+        CloseHandle(mapping);
+    if ( file )
+        CloseHandle(file);
+    file = 0;
+    mapping = 0;
+#else
+    if ( data )
+        munmap(const_cast<unsigned char*>(data), dataSize);
+#endif
+
+    data = 0;
+    dataSize = 0;
+    tileSize = 0;
+    tileCount = 0;
+    entries = 0;
+    capacity = 0;
+}
+
+const unsigned char* TilePyramid::Find(const TileKey& key, size_t& size) const
+{
+    if ( !data )
+        return 0;
+
+    // linear probing, the table is never more than half full
+    unsigned long long slot = key.Hash() & (capacity - 1);
+    for ( unsigned long long probe = 0; probe < capacity; probe ++)
+    {
+        const unsigned char* entry = entries + slot * ENTRY_SIZE;
+        unsigned int entrySize = ReadLE32(entry + 36);
+        if ( entrySize == 0 )
+            return 0;
+
+        if ( ReadKey(entry) == key )
+        {
+            unsigned long long offset = ReadLE64(entry + 40);
+            if ( offset < HEADER_SIZE || offset > dataSize || entrySize > dataSize - offset )
+                return 0;
+
+            size = entrySize;
+            return data + offset;
+        }
+
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return 0;
+}
+
+bool TilePyramid::Contains(const TileKey& key) const
+{
+    size_t size;
+    return Find(key, size) != 0;
+}
+
+bool TilePyramid::Read(const TileKey& key, int* iterations, float* smooth) const
+{
+    size_t size;
+    const unsigned char* compressed = Find(key, size);
+    if ( !compressed )
+        return false;
+
+    const size_t count = size_t(tileSize) * tileSize;
+    std::vector<unsigned char> planes(8 * count);
+
+    uLongf rawSize = uLongf(planes.size());
+    if ( uncompress(&planes[0], &rawSize, compressed, uLong(size)) != Z_OK || rawSize != planes.size() )
+        return false;
+
+    JoinBytes(&planes[0], count, iterations);
+    JoinBytes(&planes[4 * count], count, smooth);
+    return true;
+}
+
+std::vector<TileKey> TilePyramid::Keys() const
+{
+    std::vector<TileKey> keys;
+
+    for ( unsigned long long slot = 0; data && slot < capacity; slot ++)
+    {
+        const unsigned char* entry = entries + slot * ENTRY_SIZE;
+        if ( ReadLE32(entry + 36) != 0 )
+            keys.push_back(ReadKey(entry));
+    }
+
+    return keys;
+}
+
+TilePyramidWriter::TilePyramidWriter(int tileSize) :
+    grid(0, tileSize)
+{
+}
+
+bool TilePyramidWriter::Open(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->path = path;
+    tiles.clear();
+    pyramid.Close();
+
+    // no file yet, the pyramid starts empty
+    FILE* file = fopen(path.c_str(), "rb");
+    if ( file == 0 )
+        return true;
+    fclose(file);
+
+    if ( !pyramid.Open(path) || pyramid.TileSize() != grid.TileSize() )
+    {
+        pyramid.Close();
+        return false;
+    }
+
+    return true;
+}
+
+long long TilePyramidWriter::TileCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pyramid.TileCount() + (long long)(tiles.size());
+}
+
+bool TilePyramidWriter::Contains(const TileKey& key) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tiles.find(key) != tiles.end() || pyramid.Contains(key);
+}
+
+void TilePyramidWriter::Add(const TileKey& key, const int* iterations, const float* smooth)
+{
+    const size_t count = size_t(TileSize()) * TileSize();
+
+    std::vector<unsigned char> planes(8 * count);
+    SplitBytes(iterations, count, &planes[0]);
+    SplitBytes(smooth, count, &planes[4 * count]);
+
+    uLongf compressedSize = compressBound(uLong(planes.size()));
+    std::vector<unsigned char> compressed(compressedSize);
+    if ( compress2(&compressed[0], &compressedSize, &planes[0], uLong(planes.size()), Z_DEFAULT_COMPRESSION) != Z_OK )
+        return;
+    compressed.resize(compressedSize);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    tiles[key].swap(compressed);
+}
+
+int TilePyramidWriter::FillView(const MandelbrotEngine& engine, const MandelbrotView& view,
+                                TileScheduler* scheduler, KernelStats* stats)
+{
+    if ( !TileCache::IsCacheable(view) )
+        return 0;
+
+    const MandelbrotView aligned = TileCache::AlignView(view);
+    const int tileSize = TileSize();
+
+    std::vector<RenderTile> viewTiles = grid.Tiles(aligned);
+    std::vector<RenderTile> missing;
+    for ( size_t i = 0; i < viewTiles.size(); i ++)
+    {
+        if ( !Contains(grid.Key(aligned, viewTiles[i])) )
+            missing.push_back(viewTiles[i]);
+    }
+
+    int workerCount = scheduler ? scheduler->ThreadCount() : 1;
+    std::vector<KernelStats> workerStats(workerCount);
+    std::vector<int> workerTiles(workerCount, 0);
+
+    // whole tiles, the same as TileCache::FillTile() renders them
+    TileScheduler::TileFunction renderTile = [&](const RenderTile& tile, int worker)
+    {
+        std::vector<int> iterations(size_t(tileSize) * tileSize);
+        std::vector<float> smooth(size_t(tileSize) * tileSize);
+
+        FractalBuffer tileBuffer(tileSize, tileSize, 0, &iterations[0], &smooth[0]);
+        engine.RenderRegion(aligned, tile.x, tile.y, tileSize, tileSize, tileBuffer, &workerStats[worker]);
+        Add(grid.Key(aligned, tile), &iterations[0], &smooth[0]);
+        workerTiles[worker] ++;
+    };
+
+    if ( scheduler )
+    {
+        scheduler->Run(missing, renderTile);
+    }
+    else
+    {
+        for ( size_t i = 0; i < missing.size(); i ++)
+            renderTile(missing[i], 0);
+    }
+
+    int rendered = 0;
+    for ( int i = 0; i < workerCount; i ++)
+    {
+        rendered += workerTiles[i];
+        if ( stats )
+            stats->Add(workerStats[i]);
+    }
+
+    return rendered;
+}
+
+bool TilePyramidWriter::Save()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if ( path.empty() )
+        return false;
+    if ( tiles.empty() && pyramid.IsOpen() )
+        return true;
+
+    // the mapping goes, windows does not write to a mapped file
+    const bool append = pyramid.IsOpen();
+    const long long oldCount = pyramid.TileCount();
+    pyramid.Close();
+
+    FILE* file = fopen(path.c_str(), append ? "r+b" : "w+b");
+    if ( file == 0 )
+        return false;
+
+    unsigned char header[HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    unsigned long long indexOffset = 0;
+    unsigned long long oldCapacity = 0;
+    std::vector<unsigned char> index;
+    bool ok = true;
+
+    if ( append )
+    {
+        // Open() checked the header and the index
+        ok = fread(header, 1, sizeof(header), file) == sizeof(header);
+        indexOffset = ReadLE64(header + 24);
+        oldCapacity = ReadLE64(header + 32);
+        index.resize(size_t(oldCapacity) * ENTRY_SIZE);
+        ok = ok && SeekFile(file, indexOffset) && fread(&index[0], 1, index.size(), file) == index.size();
+    }
+    else
+    {
+        ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    }
+
+    // twice as many entries as tiles at least, so probing stays short;
+    // a larger index goes after the new tiles, the old one is left
+    const unsigned long long count = (unsigned long long)(oldCount) + tiles.size();
+    unsigned long long capacity = append ? oldCapacity : 16;
+    while ( capacity < 2 * count )
+        capacity *= 2;
+
+    if ( capacity != oldCapacity )
+    {
+        std::vector<unsigned char> grown(size_t(capacity) * ENTRY_SIZE, 0);
+        for ( unsigned long long slot = 0; slot < oldCapacity; slot ++)
+        {
+            const unsigned char* entry = &index[size_t(slot) * ENTRY_SIZE];
+            if ( ReadLE32(entry + 36) == 0 )
+                continue;
+
+            unsigned long long target = ReadKey(entry).Hash() & (capacity - 1);
+            while ( ReadLE32(&grown[size_t(target) * ENTRY_SIZE + 36]) != 0 )
+                target = (target + 1) & (capacity - 1);
+            memcpy(&grown[size_t(target) * ENTRY_SIZE], entry, ENTRY_SIZE);
+        }
+        index.swap(grown);
+    }
+
+    unsigned long long offset = HEADER_SIZE;
+    ok = ok && FileSize(file, offset);
+
+    std::unordered_map<TileKey, std::vector<unsigned char>, TileKeyHash>::const_iterator tile;
+    for ( tile = tiles.begin(); ok && tile != tiles.end(); ++ tile)
+    {
+        const std::vector<unsigned char>& compressed = tile->second;
+        ok = fwrite(&compressed[0], 1, compressed.size(), file) == compressed.size();
+
+        unsigned long long slot = tile->first.Hash() & (capacity - 1);
+        while ( ReadLE32(&index[size_t(slot) * ENTRY_SIZE + 36]) != 0 )
+            slot = (slot + 1) & (capacity - 1);
+
+        WriteEntry(&index[size_t(slot) * ENTRY_SIZE], tile->first, (unsigned int)(compressed.size()), offset);
+        offset += compressed.size();
+    }
+
+    if ( capacity != oldCapacity )
+        indexOffset = offset;
+
+    memcpy(header, PYRAMID_MAGIC, sizeof(PYRAMID_MAGIC));
+    WriteLE32(header + 8, PYRAMID_VERSION);
+    WriteLE32(header + 12, (unsigned int)(TileSize()));
+    WriteLE64(header + 16, count);
+    WriteLE64(header + 24, indexOffset);
+    WriteLE64(header + 32, capacity);
+
+    // the tiles are on disk before the index points at them, the header
+    // goes in last, a file cut short is still the old pyramid
+    ok = ok && fflush(file) == 0;
+    ok = ok && SeekFile(file, indexOffset) && fwrite(&index[0], 1, index.size(), file) == index.size();
+    ok = ok && fflush(file) == 0;
+    ok = ok && SeekFile(file, 0) && fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = fclose(file) == 0 && ok;
+
+    if ( ok )
+        tiles.clear();
+    else if ( !append )
+        remove(path.c_str());
+
+    if ( ok || append )
+        pyramid.Open(path);
+    return ok;
+}
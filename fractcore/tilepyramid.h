@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <unordered_map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "mandelbrotengine.h"
+#include "tilecache.h"
+
+class TileScheduler;
+
+// file of precomputed cache tiles, for regions that are shown over and
+// over
+//
+// the tiles are the ones of TileCache, on the grid of their pixel size
+// and rotation; halving the pixel size splits every tile into four, so the
+// zoom levels of a region form a quadtree. The file is
+//
+//   header      magic, version, tile size, tile count, index position
+//   tiles       iteration and smooth plane of every tile, split into
+//               byte planes (the slowly changing high bytes of the values
+//               compress a lot better on their own) and deflated
+//   index       open addressing hash table of TileKey -> tile position,
+//               a power of two entries, at most half of them used
+//
+// all numbers little endian, the hash is TileKey::Hash() on every platform
+//
+// TilePyramid maps the file into memory and looks tiles up in the index
+// right there, nothing is read until a tile is asked for. Read() may be
+// called from any number of threads.
+class TilePyramid
+{
+public:
+    TilePyramid();
+    ~TilePyramid();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    bool IsOpen() const { return data != 0; }
+    int TileSize() const { return tileSize; }
+    long long TileCount() const { return tileCount; }
+
+    bool Contains(const TileKey& key) const;
+
+    // inflates the tile into tileSize x tileSize iterations and smooth
+    // values, false if it is not in the file or does not inflate
+    bool Read(const TileKey& key, int* iterations, float* smooth) const;
+
+    // the deflated tile right in the mapping, 0 if it is not in the file
+    const unsigned char* Find(const TileKey& key, size_t& size) const;
+
+    // keys of all tiles in the file
+    std::vector<TileKey> Keys() const;
+
+private:
+    TilePyramid(const TilePyramid&);
+    TilePyramid& operator=(const TilePyramid&);
+
+    const unsigned char* data;
+    size_t dataSize;
+    int tileSize;
+    long long tileCount;
+    const unsigned char* entries;
+    unsigned long long capacity;
+
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#endif
+};
+
+// adds the missing tiles of some views to a pyramid file
+//
+// the tiles of an existing file stay on disk, only the ones it does not
+// have yet are rendered and kept in memory until Save(). Save() appends
+// them to the file and adds them to its index, in place while the index
+// has room and otherwise in a twice as large one after them; the header
+// goes in last, so until then the file is the old pyramid. A TilePyramid
+// that has the file open already does not see the new tiles.
+class TilePyramidWriter
+{
+public:
+    TilePyramidWriter(int tileSize = 64);
+
+    // opens the file if there is one, false if it is not a pyramid or its
+    // tiles have another size
+    bool Open(const std::string& path);
+
+    int TileSize() const { return grid.TileSize(); }
+    long long TileCount() const;
+
+    bool Contains(const TileKey& key) const;
+
+    // deflates the tile, may be called from any number of threads
+    void Add(const TileKey& key, const int* iterations, const float* smooth);
+
+    // renders the tiles of the view that are missing, whole; the view is
+    // aligned to the grid first. Returns the number of tiles rendered, the
+    // kernel counters are added to stats if given
+    int FillView(const MandelbrotEngine& engine, const MandelbrotView& view,
+                 TileScheduler* scheduler, KernelStats* stats = 0);
+
+    // writes the tiles added since the last call to the file, they are
+    // freed then
+    bool Save();
+
+private:
+    TileCache grid;         // no budget, only for the tile grid
+    std::string path;
+
+    mutable std::mutex mutex;
+    TilePyramid pyramid;    // the file as it is on disk
+    std::unordered_map<TileKey, std::vector<unsigned char>, TileKeyHash> tiles;    // not in the file yet
+};
+
+#endif // TILEPYRAMID_H
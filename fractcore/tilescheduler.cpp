@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tilescheduler.h"
+
+#include <chrono>
+
+WorkerStats::WorkerStats()
+{
+    tiles = 0;
+    stolenTiles = 0;
+    busySeconds = 0.0;
+}
+
+TileScheduler::TileScheduler(int threadCount, int tileSize)
+{
+    this->tileSize = tileSize > 0 ? tileSize : 64;
+    generation = 0;
+    idleWorkers = 0;
+    quit = false;
+    jobTiles = 0;
+    jobFunction = 0;
+    runTicket = 0;
+    issuedTickets = 0;
+    cancelledTickets = 0;
+    jobTicket = 0;
+    lastWallSeconds = 0.0;
+
+    StartWorkers(threadCount);
+}
+
+TileScheduler::~TileScheduler()
+{
+    StopWorkers();
+}
+
+void TileScheduler::SetThreadCount(int threadCount)
+{
+    StopWorkers();
+    StartWorkers(threadCount);
+}
+
+void TileScheduler::SetTileSize(int tileSize)
+{
+    if ( tileSize > 0 )
+        this->tileSize = tileSize;
+}
+
+void TileScheduler::StartWorkers(int threadCount)
+{
+    if ( threadCount <= 0 )
+        threadCount = int(std::thread::hardware_concurrency());
+    if ( threadCount <= 0 )
+        threadCount = 1;
+
+    quit = false;
+    idleWorkers = 0;
+
+    for ( int i = 0; i < threadCount; i ++)
+        workers.push_back(new Worker);
+
+    for ( int i = 0; i < threadCount; i ++)
+        workers[i]->thread = std::thread(&TileScheduler::WorkerLoop, this, i);
+
+    // wait until every worker sits in the job loop, Run() relies on it
+    std::unique_lock<std::mutex> lock(jobMutex);
+    while ( idleWorkers < threadCount )
+        jobFinished.wait(lock);
+}
+
+void TileScheduler::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        quit = true;
+    }
+    jobStarted.notify_all();
+
+    for ( size_t i = 0; i < workers.size(); i ++)
+    {
+        workers[i]->thread.join();
+        delete workers[i];
+    }
+    workers.clear();
+}
+
+bool TileScheduler::Run(int width, int height, const TileFunction& function)
+{
+    std::vector<RenderTile> tiles;
+
+    for ( int y = 0; y < height; y += tileSize)
+    {
+        for ( int x = 0; x < width; x += tileSize)
+        {
+            RenderTile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = x + tileSize < width ? tileSize : width - x;
+            tile.height = y + tileSize < height ? tileSize : height - y;
+            tiles.push_back(tile);
+        }
+    }
+
+    return Run(tiles, function);
+}
+
+bool TileScheduler::Run(const std::vector<RenderTile>& tiles, const TileFunction& function)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const int workerCount = int(workers.size());
+    const int tileCount = int(tiles.size());
+
+    // a job that was cancelled before its first run does not start it
+    long long ticket = jobTicket != 0 ? jobTicket : NewTicket();
+    if ( Cancelled(ticket) )
+    {
+        lastStats.assign(workerCount, WorkerStats());
+        lastWallSeconds = 0.0;
+        return false;
+    }
+
+    // every worker starts with a contiguous band of the frame
+    for ( int w = 0; w < workerCount; w ++)
+    {
+        Worker* worker = workers[w];
+        std::lock_guard<std::mutex> lock(worker->queueMutex);
+
+        worker->queue.clear();
+        worker->stats = WorkerStats();
+
+        int first = int((long long)(tileCount) * w / workerCount);
+        int last = int((long long)(tileCount) * (w + 1) / workerCount);
+        for ( int t = first; t < last; t ++)
+            worker->queue.push_back(t);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        runTicket = ticket;
+        jobTiles = &tiles;
+        jobFunction = &function;
+        idleWorkers = 0;
+        generation ++;
+        jobStarted.notify_all();
+
+        while ( idleWorkers < workerCount )
+            jobFinished.wait(lock);
+
+        jobTiles = 0;
+        jobFunction = 0;
+    }
+
+    lastStats.resize(workerCount);
+    for ( int w = 0; w < workerCount; w ++)
+        lastStats[w] = workers[w]->stats;
+
+    lastWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return !Cancelled(ticket);
+}
+
+long long TileScheduler::NewTicket()
+{
+    return ++ issuedTickets;
+}
+
+void TileScheduler::Cancel()
+{
+    // both counters only grow, a late Cancel() must not take back an
+    // earlier one
+    long long issued = issuedTickets;
+    long long cancelled = cancelledTickets;
+    while ( cancelled < issued && !cancelledTickets.compare_exchange_weak(cancelled, issued) )
+        ;
+}
+
+double TileScheduler::LastUtilization() const
+{
+    if ( lastStats.empty() || lastWallSeconds <= 0.0 )
+        return 0.0;
+
+    double busy = 0.0;
+    for ( size_t i = 0; i < lastStats.size(); i ++)
+        busy += lastStats[i].busySeconds;
+
+    return busy / (lastWallSeconds * double(lastStats.size()));
+}
+
+void TileScheduler::WorkerLoop(int index)
+{
+    Worker* self = workers[index];
+    long long seenGeneration;
+
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        seenGeneration = generation;
+        idleWorkers ++;
+    }
+    jobFinished.notify_all();
+
+    for ( ;; )
+    {
+        const std::vector<RenderTile>* tiles;
+        const TileFunction* function;
+        long long ticket;
+
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            while ( !quit && generation == seenGeneration )
+                jobStarted.wait(lock);
+
+            if ( quit )
+                return;
+
+            seenGeneration = generation;
+            tiles = jobTiles;
+            function = jobFunction;
+            ticket = runTicket;
+        }
+
+        // own tiles first, then steal until every queue is empty
+        for ( ;; )
+        {
+            if ( Cancelled(ticket) )
+                break;
+
+            int tile;
+            if ( PopLocal(index, tile) == false )
+            {
+                if ( Steal(index, tile) == false )
+                    break;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            (*function)((*tiles)[tile], index);
+            self->stats.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            self->stats.tiles ++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            idleWorkers ++;
+        }
+        jobFinished.notify_all();
+    }
+}
+
+bool TileScheduler::PopLocal(int index, int& tile)
+{
+    Worker* self = workers[index];
+    std::lock_guard<std::mutex> lock(self->queueMutex);
+
+    if ( self->queue.empty() )
+        return false;
+
+    tile = self->queue.front();
+    self->queue.pop_front();
+    return true;
+}
+
+bool TileScheduler::Steal(int index, int& tile)
+{
+    const int workerCount = int(workers.size());
+    Worker* self = workers[index];
+
+    // the victim with the longest queue, sizes are only a hint
+    int victim = -1;
+    size_t longest = 0;
+    for ( int i = 1; i < workerCount; i ++)
+    {
+        int w = (index + i) % workerCount;
+        std::lock_guard<std::mutex> lock(workers[w]->queueMutex);
+        if ( workers[w]->queue.size() > longest )
+        {
+            longest = workers[w]->queue.size();
+            victim = w;
+        }
+    }
+
+    if ( victim < 0 )
+        return false;
+
+    // take half of its remaining tiles from the back, the victim keeps
+    // working on the front
+    std::vector<int> stolen;
+    {
+        std::lock_guard<std::mutex> lock(workers[victim]->queueMutex);
+        size_t count = (workers[victim]->queue.size() + 1) / 2;
+        for ( size_t i = 0; i < count; i ++)
+        {
+            stolen.push_back(workers[victim]->queue.back());
+            workers[victim]->queue.pop_back();
+        }
+    }
+
+    // somebody else was faster, look again
+    if ( stolen.empty() )
+        return Steal(index, tile);
+
+    self->stats.stolenTiles += (long long)(stolen.size());
+
+    tile = stolen.back();
+    stolen.pop_back();
+
+    if ( !stolen.empty() )
+    {
+        std::lock_guard<std::mutex> lock(self->queueMutex);
+        // keep the frame order, the last stolen tile is the first in the frame
+        for ( size_t i = stolen.size(); i > 0; i --)
+            self->queue.push_back(stolen[i - 1]);
+    }
+
+    return true;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct RenderTile
+{
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// per worker counters of the last Run()
+struct WorkerStats
+{
+    WorkerStats();
+
+    long long tiles;        // tiles rendered by this worker
+    long long stolenTiles;  // how many of them were taken from another worker
+    double busySeconds;     // time spent inside the tile function
+};
+
+// work-stealing thread pool for frame tiles
+//
+// Run() cuts the frame into tiles and hands every worker a contiguous band
+// of them. Iteration cost is very uneven across a mandelbrot view, so a
+// worker that runs out of tiles steals half of the remaining ones from the
+// back of the busiest looking queue instead of waiting.
+//
+// thread count and tile size can be changed between two runs
+//
+// Cancel() works on tickets: it stops the runs of every ticket handed out
+// before it. A run takes a ticket of its own unless SetJob() gave it one,
+// so a cancel for a job that has not reached its first run yet is not lost
+class TileScheduler
+{
+public:
+    typedef std::function<void (const RenderTile& tile, int worker)> TileFunction;
+
+    // 0 threads means one per hardware thread
+    TileScheduler(int threadCount = 0, int tileSize = 64);
+    ~TileScheduler();
+
+    void SetThreadCount(int threadCount);
+    int ThreadCount() const { return int(workers.size()); }
+
+    void SetTileSize(int tileSize);
+    int TileSize() const { return tileSize; }
+
+    // renders all tiles of a width x height frame, blocks until every tile is
+    // done; returns false if its ticket was cancelled, before or meanwhile
+    bool Run(int width, int height, const TileFunction& function);
+
+    // runs an explicit tile list instead of a full frame
+    bool Run(const std::vector<RenderTile>& tiles, const TileFunction& function);
+
+    // a ticket for the runs of one job, safe to call from any thread
+    long long NewTicket();
+    bool Cancelled(long long ticket) const { return ticket <= cancelledTickets; }
+
+    // the runs from now on belong to the ticket, the ones of helpers that
+    // get the scheduler included; 0 gives every run a ticket of its own.
+    // From the thread that calls Run(), see ScopedTileJob
+    void SetJob(long long ticket) { jobTicket = ticket; }
+
+    // stops handing out tiles to the runs of every ticket so far, safe to
+    // call from any thread
+    void Cancel();
+
+    // statistics of the last run
+    const std::vector<WorkerStats>& LastWorkerStats() const { return lastStats; }
+    double LastWallSeconds() const { return lastWallSeconds; }
+
+    // busy time of all workers divided by (wall time * workers)
+    double LastUtilization() const;
+
+private:
+    struct Worker
+    {
+        std::thread thread;
+        std::mutex queueMutex;
+        std::deque<int> queue;
+        WorkerStats stats;
+    };
+
+    void StartWorkers(int threadCount);
+    void StopWorkers();
+    void WorkerLoop(int index);
+    bool PopLocal(int index, int& tile);
+    bool Steal(int index, int& tile);
+
+    std::vector<Worker*> workers;
+    int tileSize;
+
+    // job hand-off between Run() and the workers
+    std::mutex jobMutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+    long long generation;
+    int idleWorkers;
+    bool quit;
+
+    const std::vector<RenderTile>* jobTiles;
+    const TileFunction* jobFunction;
+    long long runTicket;                        // ticket of the run in flight
+
+    std::atomic<long long> issuedTickets;
+    std::atomic<long long> cancelledTickets;    // tickets up to this one are cancelled
+    long long jobTicket;
+
+    std::vector<WorkerStats> lastStats;
+    double lastWallSeconds;
+};
+
+// TileScheduler::SetJob() for the lifetime of the object
+class ScopedTileJob
+{
+public:
+    ScopedTileJob(TileScheduler* scheduler, long long ticket) : scheduler(scheduler)
+    {
+        if ( scheduler )
+            scheduler->SetJob(ticket);
+    }
+
+    ~ScopedTileJob()
+    {
+        if ( scheduler )
+            scheduler->SetJob(0);
+    }
+
+private:
+    TileScheduler* scheduler;
+};
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frameprofiler.h"
+#include <QFile>
+#include <QTextStream>
+#include <QtOpenGL/QtOpenGL>
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+// timer query enums, the same values in desktop GL and the GL ES extension
+const GLenum TIME_ELAPSED = 0x88BF;             // GL_TIME_ELAPSED(_EXT)
+const GLenum QUERY_RESULT = 0x8866;             // GL_QUERY_RESULT(_EXT)
+const GLenum QUERY_RESULT_AVAILABLE = 0x8867;   // GL_QUERY_RESULT_AVAILABLE(_EXT)
+const GLenum GPU_DISJOINT = 0x8FBB;             // GL_GPU_DISJOINT_EXT
+
+const double FrameProfiler::HISTOGRAM_LIMITS[FrameProfiler::HISTOGRAM_BUCKETS - 1] =
+{
+    0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0, 32.0, 64.0
+};
+
+static const char* STAGE_NAMES[FrameProfiler::STAGE_COUNT] =
+{
+    "paint", "fractal", "upload", "post_effect", "hud", "swap", "readback", "delivery"
+};
+
+// stages that only make sense on the cpu clock: paint holds the others, the
+// gpu part of swapBuffers is the work of the stages before it and delivery
+// only maps buffers the gpu is done with
+static bool IsGpuStage(FrameProfiler::Stage stage)
+{
+    return stage != FrameProfiler::STAGE_PAINT && stage != FrameProfiler::STAGE_SWAP &&
+           stage != FrameProfiler::STAGE_DELIVERY;
+}
+
+FrameProfiler::StageStats::StageStats()
+{
+    samples = 0;
+    meanMs = 0.0;
+    p50Ms = 0.0;
+    p95Ms = 0.0;
+    p99Ms = 0.0;
+    maxMs = 0.0;
+    for ( int i = 0; i < HISTOGRAM_BUCKETS; i ++)
+        histogram[i] = 0;
+}
+
+void FrameProfiler::SampleRing::Add(float sampleMs)
+{
+    ms[next] = sampleMs;
+    next = (next + 1) % RING_SIZE;
+    count = qMin(count + 1, int(RING_SIZE));
+}
+
+FrameProfiler::QueryRing::QueryRing()
+{
+    for ( int i = 0; i < QUERY_RING_SIZE; i ++)
+    {
+        queries[i] = 0;
+        pending[i] = false;
+        tags[i] = 0.0;
+    }
+    next = 0;
+    created = false;
+    hasResult = false;
+    resultMs = 0.0;
+    resultTag = 0.0;
+}
+
+FrameProfiler::FrameProfiler()
+{
+    timerKind = NO_TIMER;
+    gpuTiming = false;
+    genQueries = 0;
+    beginQuery = 0;
+    endQuery = 0;
+    getQueryObjectuiv = 0;
+    getQueryObjectui64v = 0;
+
+    for ( int i = 0; i < STAGE_COUNT; i ++)
+    {
+        stageStart[i] = 0;
+        gpuStages[i] = false;
+    }
+    openQueryStage = -1;
+
+    dumpInterval = 0;
+    dumpFrames = 0;
+
+    clock.start();
+    dumpTimer.start();
+}
+
+const char* FrameProfiler::StageName(Stage stage)
+{
+    return stage >= 0 && stage < STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+void FrameProfiler::InitializeGL()
+{
+    const QGLContext* context = QGLContext::currentContext();
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if ( !context || !extensions )
+        return;
+
+    // the query functions carry the EXT suffix on GL ES only, the 64 bit
+    // result getter on EXT_timer_query as well
+    QString suffix;
+    QString resultSuffix;
+    if ( strstr(extensions, "GL_EXT_disjoint_timer_query") )
+    {
+        timerKind = EXT_DISJOINT_TIMER;
+        suffix = "EXT";
+        resultSuffix = "EXT";
+    }
+    else if ( strstr(extensions, "GL_ARB_timer_query") )
+        timerKind = ARB_TIMER;
+    else if ( strstr(extensions, "GL_EXT_timer_query") )
+    {
+        timerKind = EXT_TIMER;
+        resultSuffix = "EXT";
+    }
+    else
+        return;
+
+    genQueries = reinterpret_cast<GenQueriesProc>(context->getProcAddress("glGenQueries" + suffix));
+    beginQuery = reinterpret_cast<BeginQueryProc>(context->getProcAddress("glBeginQuery" + suffix));
+    endQuery = reinterpret_cast<EndQueryProc>(context->getProcAddress("glEndQuery" + suffix));
+    getQueryObjectuiv = reinterpret_cast<GetQueryObjectuivProc>(context->getProcAddress("glGetQueryObjectuiv" + suffix));
+    getQueryObjectui64v = reinterpret_cast<GetQueryObjectui64vProc>(context->getProcAddress("glGetQueryObjectui64v" + resultSuffix));
+
+    if ( !genQueries || !beginQuery || !endQuery || !getQueryObjectuiv || !getQueryObjectui64v )
+        timerKind = NO_TIMER;
+}
+
+void FrameProfiler::SetGpuTiming(bool enabled)
+{
+    gpuTiming = enabled;
+}
+
+QString FrameProfiler::GpuTimerName() const
+{
+    switch ( timerKind )
+    {
+    case ARB_TIMER:
+        return "GL_ARB_timer_query";
+    case EXT_TIMER:
+        return "GL_EXT_timer_query";
+    case EXT_DISJOINT_TIMER:
+        return "GL_EXT_disjoint_timer_query";
+    default:
+        return "none";
+    }
+}
+
+void FrameProfiler::Begin(Stage stage, double tag)
+{
+    stageStart[stage] = clock.nsecsElapsed();
+
+    if ( !HasGpuTimer() || !(gpuTiming || gpuStages[stage]) || !IsGpuStage(stage) || openQueryStage >= 0 )
+        return;
+
+    // the query names belong to the context of the stage, so they are
+    // created on its first run; they go away with that context
+    QueryRing& ring = queryRings[stage];
+    if ( !ring.created )
+    {
+        genQueries(QUERY_RING_SIZE, ring.queries);
+        ring.created = true;
+    }
+
+    CollectQueries(stage);
+    if ( ring.pending[ring.next] )
+        return;
+
+    ring.tags[ring.next] = tag;
+    beginQuery(TIME_ELAPSED, ring.queries[ring.next]);
+    openQueryStage = stage;
+}
+
+void FrameProfiler::End(Stage stage)
+{
+    cpuSamples[stage].Add(float((clock.nsecsElapsed() - stageStart[stage]) * 1e-6));
+
+    if ( openQueryStage != stage )
+        return;
+
+    QueryRing& ring = queryRings[stage];
+    endQuery(TIME_ELAPSED);
+    ring.pending[ring.next] = true;
+    ring.next = (ring.next + 1) % QUERY_RING_SIZE;
+    openQueryStage = -1;
+}
+
+void FrameProfiler::CollectQueries(Stage stage)
+{
+    QueryRing& ring = queryRings[stage];
+
+    // a disjoint event (frequency change, context loss, ...) makes the
+    // queries in flight meaningless
+    if ( timerKind == EXT_DISJOINT_TIMER )
+    {
+        GLint disjoint = 0;
+        glGetIntegerv(GPU_DISJOINT, &disjoint);
+        if ( disjoint )
+        {
+            for ( int i = 0; i < QUERY_RING_SIZE; i ++)
+                ring.pending[i] = false;
+            return;
+        }
+    }
+
+    // the queries finish in the order they were issued, next is the oldest
+    for ( int i = 0; i < QUERY_RING_SIZE; i ++)
+    {
+        int slot = (ring.next + i) % QUERY_RING_SIZE;
+        if ( !ring.pending[slot] )
+            continue;
+
+        GLuint available = 0;
+        getQueryObjectuiv(ring.queries[slot], QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+            break;
+
+        quint64 nanoseconds = 0;
+        getQueryObjectui64v(ring.queries[slot], QUERY_RESULT, &nanoseconds);
+        gpuSamples[stage].Add(float(nanoseconds * 1e-6));
+        ring.pending[slot] = false;
+
+        ring.hasResult = true;
+        ring.resultMs = nanoseconds * 1e-6;
+        ring.resultTag = ring.tags[slot];
+    }
+}
+
+bool FrameProfiler::TakeGpuResult(Stage stage, double& milliseconds, double& tag)
+{
+    QueryRing& ring = queryRings[stage];
+    if ( !ring.hasResult )
+        return false;
+
+    milliseconds = ring.resultMs;
+    tag = ring.resultTag;
+    ring.hasResult = false;
+    return true;
+}
+
+void FrameProfiler::FrameFinished()
+{
+    dumpFrames ++;
+
+    if ( !dumpPath.isEmpty() && dumpTimer.elapsed() >= qint64(dumpInterval) * 1000 )
+    {
+        WriteDump();
+        dumpTimer.start();
+        dumpFrames = 0;
+    }
+}
+
+void FrameProfiler::SetDump(const QString& path, int intervalSeconds)
+{
+    dumpPath = path;
+    dumpInterval = qMax(1, intervalSeconds);
+    dumpTimer.start();
+    dumpFrames = 0;
+}
+
+double FrameProfiler::FramesPerSecond() const
+{
+    qint64 elapsed = dumpTimer.elapsed();
+    return elapsed > 0 ? dumpFrames * 1000.0 / elapsed : 0.0;
+}
+
+FrameProfiler::StageStats FrameProfiler::ComputeStats(const SampleRing& samples)
+{
+    StageStats stats;
+    if ( samples.count == 0 )
+        return stats;
+
+    std::vector<float> sorted(samples.ms, samples.ms + samples.count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for ( size_t i = 0; i < sorted.size(); i ++)
+    {
+        sum += sorted[i];
+
+        int bucket = 0;
+        while ( bucket < HISTOGRAM_BUCKETS - 1 && sorted[i] >= HISTOGRAM_LIMITS[bucket] )
+            bucket ++;
+        stats.histogram[bucket] ++;
+    }
+
+    int last = samples.count - 1;
+    stats.samples = samples.count;
+    stats.meanMs = sum / samples.count;
+    stats.p50Ms = sorted[qMin(last, samples.count / 2)];
+    stats.p95Ms = sorted[qMin(last, int(samples.count * 0.95))];
+    stats.p99Ms = sorted[qMin(last, int(samples.count * 0.99))];
+    stats.maxMs = sorted[last];
+    return stats;
+}
+
+QString FrameProfiler::StatsToJson(const StageStats& stats)
+{
+    QString json;
+    QTextStream out(&json);
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(3);
+
+    out << "{\"samples\": " << stats.samples
+        << ", \"mean_ms\": " << stats.meanMs
+        << ", \"p50_ms\": " << stats.p50Ms
+        << ", \"p95_ms\": " << stats.p95Ms
+        << ", \"p99_ms\": " << stats.p99Ms
+        << ", \"max_ms\": " << stats.maxMs
+        << ", \"histogram\": [";
+    for ( int i = 0; i < HISTOGRAM_BUCKETS; i ++)
+        out << (i ? ", " : "") << stats.histogram[i];
+    out << "]}";
+    out.flush();
+    return json;
+}
+
+QString FrameProfiler::ToJson() const
+{
+    QString json;
+    QTextStream out(&json);
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(3);
+
+    out << "{\"uptime_s\": " << clock.elapsed() * 0.001
+        << ", \"fps\": " << FramesPerSecond()
+        << ", \"gpu_timer\": \"" << (GpuTiming() ? GpuTimerName() : QString("none")) << "\""
+        << ", \"histogram_limits_ms\": [";
+    for ( int i = 0; i < HISTOGRAM_BUCKETS - 1; i ++)
+        out << (i ? ", " : "") << HISTOGRAM_LIMITS[i];
+    out << "], \"stages\": {";
+
+    for ( int i = 0; i < STAGE_COUNT; i ++)
+    {
+        Stage stage = Stage(i);
+        out << (i ? ", " : "") << "\"" << StageName(stage) << "\": {\"cpu\": " << StatsToJson(CpuStats(stage));
+        if ( gpuSamples[i].count > 0 )
+            out << ", \"gpu\": " << StatsToJson(GpuStats(stage));
+        out << "}";
+    }
+    out << "}}";
+    out.flush();
+    return json;
+}
+
+void FrameProfiler::WriteDump()
+{
+    QFile file(dumpPath);
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text) )
+        return;
+
+    QTextStream out(&file);
+    out << ToJson() << "\n";
+}
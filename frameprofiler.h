@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <QGLFunctions>
+
+// time spent in each stage of a frame of MandelGLWidget
+//
+// every stage is timed on the cpu, and on the gpu as well where the context
+// has timer queries (GL_EXT_disjoint_timer_query, GL_ARB_timer_query or
+// GL_EXT_timer_query). Gpu results are read back a few frames later without
+// waiting for them. The last RING_SIZE samples of each stage are kept for the
+// percentiles and the histogram; gui thread only
+class FrameProfiler
+{
+public:
+
+    enum Stage
+    {
+        STAGE_PAINT = 0,        // all of paintGL, cpu only
+        STAGE_FRACTAL,          // RenderFractal, the mandelbrot shader into the fbo
+        STAGE_UPLOAD,           // a finished cpu frame into the fbo texture
+        STAGE_POST_EFFECT,      // post effect quad
+        STAGE_HUD,              // HUD message built and drawn with QPainter
+        STAGE_SWAP,             // swapBuffers, cpu only
+        STAGE_READBACK,         // reads of the shown frame into the pack buffers
+        STAGE_DELIVERY,         // finished reads mapped and handed out, cpu only
+        STAGE_COUNT
+    };
+
+    // samples kept per stage and clock
+    static const int RING_SIZE = 256;
+
+    // queries in flight per stage, a stage that still waits for all of them
+    // goes without a gpu sample
+    static const int QUERY_RING_SIZE = 4;
+
+    // milliseconds, bucket i counts the samples below HISTOGRAM_LIMITS[i]
+    // that are not in an earlier one, the last bucket the rest
+    static const int HISTOGRAM_BUCKETS = 10;
+    static const double HISTOGRAM_LIMITS[HISTOGRAM_BUCKETS - 1];
+
+    struct StageStats
+    {
+        StageStats();
+
+        int samples;
+        double meanMs;
+        double p50Ms;
+        double p95Ms;
+        double p99Ms;
+        double maxMs;
+        int histogram[HISTOGRAM_BUCKETS];
+    };
+
+    FrameProfiler();
+
+    static const char* StageName(Stage stage);
+
+    // looks up the timer queries of the current context; gpu timing stays
+    // off until SetGpuTiming(true)
+    void InitializeGL();
+    void SetGpuTiming(bool enabled);
+    bool HasGpuTimer() const { return timerKind != NO_TIMER; }
+    bool GpuTiming() const { return gpuTiming && HasGpuTimer(); }
+    QString GpuTimerName() const;
+
+    // times a stage on the gpu whatever SetGpuTiming says, for a caller that
+    // uses its results
+    void SetGpuStage(Stage stage, bool enabled) { gpuStages[stage] = enabled; }
+
+    // a stage may run on another context than the others, as RenderFractal
+    // does, but always on the same one; only one gpu query is open at a
+    // time, a stage that starts inside another one is timed on the cpu only;
+    // the tag comes back with the gpu result of that run
+    void Begin(Stage stage, double tag = 0.0);
+    void End(Stage stage);
+
+    // the gpu time of the latest run of a stage that finished since the last
+    // call and the tag it began with, false if none did; the results come
+    // in at the next Begin of the stage, a frame or more late
+    bool TakeGpuResult(Stage stage, double& milliseconds, double& tag);
+
+    // counts the frame and appends the statistics to the dump file once
+    // its interval is over
+    void FrameFinished();
+
+    // one json object per line every intervalSeconds, empty path = no dump
+    void SetDump(const QString& path, int intervalSeconds);
+
+    StageStats CpuStats(Stage stage) const { return ComputeStats(cpuSamples[stage]); }
+    StageStats GpuStats(Stage stage) const { return ComputeStats(gpuSamples[stage]); }
+
+    // frames per second since the last dump or Reset()
+    double FramesPerSecond() const;
+
+    QString ToJson() const;
+
+private:
+
+    enum TimerKind
+    {
+        NO_TIMER = 0,
+        ARB_TIMER,              // GL 3.3 / GL_ARB_timer_query
+        EXT_TIMER,              // desktop GL_EXT_timer_query
+        EXT_DISJOINT_TIMER      // GL ES GL_EXT_disjoint_timer_query
+    };
+
+    struct SampleRing
+    {
+        SampleRing() : next(0), count(0) {}
+        void Add(float ms);
+
+        float ms[RING_SIZE];
+        int next;
+        int count;
+    };
+
+    struct QueryRing
+    {
+        QueryRing();
+
+        GLuint queries[QUERY_RING_SIZE];
+        bool pending[QUERY_RING_SIZE];
+        double tags[QUERY_RING_SIZE];
+        int next;
+        bool created;
+
+        // latest finished query not taken yet
+        bool hasResult;
+        double resultMs;
+        double resultTag;
+    };
+
+    static StageStats ComputeStats(const SampleRing& samples);
+    static QString StatsToJson(const StageStats& stats);
+
+    // reads back the finished queries of a stage, oldest first
+    void CollectQueries(Stage stage);
+    void WriteDump();
+
+    typedef void (QGLF_APIENTRYP GenQueriesProc)(GLsizei n, GLuint* ids);
+    typedef void (QGLF_APIENTRYP BeginQueryProc)(GLenum target, GLuint id);
+    typedef void (QGLF_APIENTRYP EndQueryProc)(GLenum target);
+    typedef void (QGLF_APIENTRYP GetQueryObjectuivProc)(GLuint id, GLenum pname, GLuint* params);
+    typedef void (QGLF_APIENTRYP GetQueryObjectui64vProc)(GLuint id, GLenum pname, quint64* params);
+
+    TimerKind timerKind;
+    bool gpuTiming;
+    bool gpuStages[STAGE_COUNT];
+    GenQueriesProc genQueries;
+    BeginQueryProc beginQuery;
+    EndQueryProc endQuery;
+    GetQueryObjectuivProc getQueryObjectuiv;
+    GetQueryObjectui64vProc getQueryObjectui64v;
+
+    QElapsedTimer clock;
+    qint64 stageStart[STAGE_COUNT];
+    int openQueryStage;         // stage with the open gpu query, -1 if none
+
+    SampleRing cpuSamples[STAGE_COUNT];
+    SampleRing gpuSamples[STAGE_COUNT];
+    QueryRing queryRings[STAGE_COUNT];
+
+    // dump file and the frames since the last dump
+    QString dumpPath;
+    int dumpInterval;
+    QElapsedTimer dumpTimer;
+    int dumpFrames;
+};
+
+// times the scope it lives in as one stage
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(FrameProfiler& profiler, FrameProfiler::Stage stage, double tag = 0.0) :
+        profiler(profiler), stage(stage) { profiler.Begin(stage, tag); }
+    ~ScopedStageTimer() { profiler.End(stage); }
+
+private:
+    FrameProfiler& profiler;
+    FrameProfiler::Stage stage;
+};
+
+#endif // FRAMEPROFILER_H
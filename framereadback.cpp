@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "framereadback.h"
+#include <QtOpenGL/QtOpenGL>
+#include <string.h>
+
+// pack buffer and sync enums, the same values in desktop GL and GL ES 3.0
+const GLenum PIXEL_PACK_BUFFER = 0x88EB;        // GL_PIXEL_PACK_BUFFER
+const GLenum STREAM_READ = 0x88E1;              // GL_STREAM_READ
+const GLenum READ_ONLY = 0x88B8;                // GL_READ_ONLY
+const GLbitfield MAP_READ_BIT = 0x0001;         // GL_MAP_READ_BIT
+const GLenum SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+const GLbitfield SYNC_FLUSH_COMMANDS_BIT = 0x0001;
+const GLenum ALREADY_SIGNALED = 0x911A;
+const GLenum CONDITION_SATISFIED = 0x911C;
+
+FrameReadback::FrameReadback()
+{
+    mode = SYNCHRONOUS;
+    fenceSync = 0;
+    clientWaitSync = 0;
+    deleteSync = 0;
+    mapBufferRange = 0;
+    mapBuffer = 0;
+    unmapBuffer = 0;
+
+    next = 0;
+    frame = 0;
+    delivered = 0;
+    dropped = 0;
+}
+
+const char* FrameReadback::ModeName(Mode mode)
+{
+    switch ( mode )
+    {
+    case PACK_BUFFERS:
+        return "pack buffers";
+    case FENCED_PACK_BUFFERS:
+        return "fenced pack buffers";
+    default:
+        return "synchronous";
+    }
+}
+
+void FrameReadback::InitializeGL()
+{
+    const QGLContext* context = QGLContext::currentContext();
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    if ( !context || !extensions || !version )
+        return;
+
+    functions.initializeGLFunctions(context);
+
+    // GL ES 3.0 has both in core, GL ES 2.0 has neither
+    bool es3 = strncmp(version, "OpenGL ES 3", 11) == 0;
+    bool packBuffers = es3 || strstr(extensions, "GL_ARB_pixel_buffer_object") ||
+                       strstr(extensions, "GL_EXT_pixel_buffer_object");
+    bool fences = es3 || strstr(extensions, "GL_ARB_sync");
+    if ( !packBuffers )
+        return;
+
+    mapBufferRange = reinterpret_cast<MapBufferRangeProc>(context->getProcAddress("glMapBufferRange"));
+    mapBuffer = reinterpret_cast<MapBufferProc>(context->getProcAddress("glMapBuffer"));
+    unmapBuffer = reinterpret_cast<UnmapBufferProc>(context->getProcAddress("glUnmapBuffer"));
+    if ( (!mapBufferRange && !mapBuffer) || !unmapBuffer )
+        return;
+
+    mode = PACK_BUFFERS;
+
+    if ( fences )
+    {
+        fenceSync = reinterpret_cast<FenceSyncProc>(context->getProcAddress("glFenceSync"));
+        clientWaitSync = reinterpret_cast<ClientWaitSyncProc>(context->getProcAddress("glClientWaitSync"));
+        deleteSync = reinterpret_cast<DeleteSyncProc>(context->getProcAddress("glDeleteSync"));
+        if ( fenceSync && clientWaitSync && deleteSync )
+            mode = FENCED_PACK_BUFFERS;
+    }
+}
+
+void FrameReadback::ReleaseGL()
+{
+    for ( int i = 0; i < RING_SIZE; i ++)
+    {
+        Slot& slot = slots[i];
+        if ( slot.fence )
+            deleteSync(slot.fence);
+        if ( slot.buffer )
+            functions.glDeleteBuffers(1, &slot.buffer);
+        slot = Slot();
+    }
+}
+
+int FrameReadback::Pending() const
+{
+    int count = 0;
+    for ( int i = 0; i < RING_SIZE; i ++)
+        count += slots[i].pending ? 1 : 0;
+    return count;
+}
+
+bool FrameReadback::Request(int width, int height, const Callback& callback)
+{
+    if ( width <= 0 || height <= 0 )
+        return false;
+
+    int bytes = width * height * 4;
+
+    if ( mode == SYNCHRONOUS )
+    {
+        pixels.resize(bytes);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+        callback(&pixels[0], width, height);
+        delivered ++;
+        return true;
+    }
+
+    // never wait for a buffer, the caller asks again with a later frame
+    Slot& slot = slots[next];
+    if ( slot.pending )
+    {
+        dropped ++;
+        return false;
+    }
+
+    if ( !slot.buffer )
+        functions.glGenBuffers(1, &slot.buffer);
+
+    functions.glBindBuffer(PIXEL_PACK_BUFFER, slot.buffer);
+    if ( slot.capacity < bytes )
+    {
+        functions.glBufferData(PIXEL_PACK_BUFFER, bytes, 0, STREAM_READ);
+        slot.capacity = bytes;
+    }
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    functions.glBindBuffer(PIXEL_PACK_BUFFER, 0);
+
+    if ( mode == FENCED_PACK_BUFFERS )
+        slot.fence = fenceSync(SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    slot.pending = true;
+    slot.frame = frame;
+    slot.width = width;
+    slot.height = height;
+    slot.callback = callback;
+
+    next = (next + 1) % RING_SIZE;
+    return true;
+}
+
+void FrameReadback::Poll()
+{
+    frame ++;
+
+    // next is the oldest slot, the reads finish in the order they went out
+    for ( int i = 0; i < RING_SIZE; i ++)
+    {
+        Slot& slot = slots[(next + i) % RING_SIZE];
+        if ( !slot.pending )
+            continue;
+
+        bool ready;
+        if ( slot.fence )
+        {
+            // no timeout, only the first check flushes the fence out
+            GLenum status = clientWaitSync(slot.fence, SYNC_FLUSH_COMMANDS_BIT, 0);
+            ready = status == ALREADY_SIGNALED || status == CONDITION_SATISFIED;
+        }
+        else
+        {
+            ready = frame - slot.frame >= UNFENCED_LATENCY;
+        }
+
+        if ( !ready )
+            break;
+
+        Deliver(slot);
+    }
+}
+
+void FrameReadback::Deliver(Slot& slot)
+{
+    int bytes = slot.width * slot.height * 4;
+
+    functions.glBindBuffer(PIXEL_PACK_BUFFER, slot.buffer);
+    const void* mapped = mapBufferRange ? mapBufferRange(PIXEL_PACK_BUFFER, 0, bytes, MAP_READ_BIT)
+                                        : mapBuffer(PIXEL_PACK_BUFFER, READ_ONLY);
+    if ( mapped )
+    {
+        slot.callback(static_cast<const unsigned char*>(mapped), slot.width, slot.height);
+        unmapBuffer(PIXEL_PACK_BUFFER);
+        delivered ++;
+    }
+    else
+    {
+        dropped ++;
+    }
+    functions.glBindBuffer(PIXEL_PACK_BUFFER, 0);
+
+    if ( slot.fence )
+        deleteSync(slot.fence);
+    slot.fence = 0;
+    slot.pending = false;
+    slot.callback = Callback();
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAMEREADBACK_H
+#define FRAMEREADBACK_H
+
+#include <QGLFunctions>
+
+#include <functional>
+#include <vector>
+
+// reads frames back from the framebuffer without waiting for the gpu
+//
+// glReadPixels goes into one of RING_SIZE pixel pack buffers and returns
+// right away, the copy runs on the gpu while the next frame renders. A
+// fence behind each read tells when the buffer can be mapped; contexts
+// with pack buffers but without fences map it UNFENCED_LATENCY frames
+// later, which may still wait a little. Contexts without pack buffers (GL
+// ES 2.0) read synchronously. All calls on the gui thread, with the context
+// current that InitializeGL() saw
+class FrameReadback
+{
+public:
+
+    enum Mode
+    {
+        SYNCHRONOUS = 0,        // glReadPixels into memory, stalls
+        PACK_BUFFERS,           // pack buffers, mapped a few frames later
+        FENCED_PACK_BUFFERS     // pack buffers, mapped once their fence is signaled
+    };
+
+    // RGBA rows of a finished read, bottom row first as glReadPixels has
+    // them; the pixels are the mapped buffer and only valid during the call
+    typedef std::function<void (const unsigned char* rgba, int width, int height)> Callback;
+
+    static const int RING_SIZE = 3;
+    static const int UNFENCED_LATENCY = 2;
+
+    FrameReadback();
+
+    // looks up pack buffers and fences of the current context
+    void InitializeGL();
+
+    // deletes the buffers and fences, with the same context current
+    void ReleaseGL();
+
+    Mode GetMode() const { return mode; }
+    static const char* ModeName(Mode mode);
+
+    // reads width x height pixels from the origin of the bound framebuffer;
+    // false when all buffers are in flight, the callback is not kept then
+    // and the caller asks again with a later frame
+    bool Request(int width, int height, const Callback& callback);
+
+    // hands the finished reads to their callbacks, in the order they were
+    // requested; once per frame
+    void Poll();
+
+    int Pending() const;
+    long long Delivered() const { return delivered; }
+    long long Dropped() const { return dropped; }
+
+private:
+
+    struct Slot
+    {
+        Slot() : buffer(0), capacity(0), fence(0), pending(false), frame(0), width(0), height(0) {}
+
+        GLuint buffer;
+        int capacity;           // bytes
+        void* fence;            // GLsync
+        bool pending;
+        long long frame;        // Poll() count at the request
+        int width;
+        int height;
+        Callback callback;
+    };
+
+    void Deliver(Slot& slot);
+
+    typedef void* (QGLF_APIENTRYP FenceSyncProc)(GLenum condition, GLbitfield flags);
+    typedef GLenum (QGLF_APIENTRYP ClientWaitSyncProc)(void* sync, GLbitfield flags, quint64 timeout);
+    typedef void (QGLF_APIENTRYP DeleteSyncProc)(void* sync);
+    typedef void* (QGLF_APIENTRYP MapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    typedef void* (QGLF_APIENTRYP MapBufferProc)(GLenum target, GLenum access);
+    typedef GLboolean (QGLF_APIENTRYP UnmapBufferProc)(GLenum target);
+
+    QGLFunctions functions;
+    Mode mode;
+    FenceSyncProc fenceSync;
+    ClientWaitSyncProc clientWaitSync;
+    DeleteSyncProc deleteSync;
+    MapBufferRangeProc mapBufferRange;
+    MapBufferProc mapBuffer;
+    UnmapBufferProc unmapBuffer;
+
+    Slot slots[RING_SIZE];
+    int next;                   // slot of the next request, the oldest pending one is next to it
+    long long frame;
+    long long delivered;
+    long long dropped;
+
+    std::vector<unsigned char> pixels;  // synchronous reads
+};
+
+#endif // FRAMEREADBACK_H
@@ -20,6 +20,7 @@
 #include "fractDroidGL.h"
 #include "MandelGLWidget.h"
 #include <QtGui/QApplication>
+#include <QStringList>
 
 int main(int argc, char *argv[])
 {
@@ -27,6 +28,91 @@ int main(int argc, char *argv[])
 	QApplication a(argc, argv);
 
     MandelGLWidget w;
+
+    // render settings
+    //   --cpu              render on the cpu instead of the mandelbrot shader
+    //   --threads <n>      cpu worker threads, one per core by default
+    //   --tile-size <n>    cpu tile edge in pixels
+    //   --subdivide        cpu, fill uniform rectangles from their border
+    //   --subdivide-fast   same without re-checking the filled rectangles
+    //   --progressive      cpu, render every frame in coarse passes first
+    //   --no-reprojection  cpu, render every frame from scratch
+    //   --antialias <n>    cpu, adaptive antialiasing with at most n samples
+    //                      per pixel on average
+    //   --tile-cache <mb>  cpu, memory for the tiles of earlier frames, 0 = off
+    //   --histogram-coloring  spread the palette over the escaped pixels
+    //                      of every frame instead of the iteration range
+    //   --pyramid <file>   cpu, precomputed tiles read before rendering
+    //   --pyramid-fill <n> render the first n zoom levels of the start view
+    //                      into the pyramid first
+    //   --view <x> <y> <scale>  start view
+    //   --iteration-budget <n>  mean iterations per pixel the adaptive
+    //                      iteration limit may spend, 0 = from the zoom level
+    //   --frame-budget <ms>  gpu frame time during the input, the shader
+    //                      drops its resolution for it, 0 = off
+    //   --frame-stats <file>  append the frame stage timings to the file
+    //                      as json lines, every 5 seconds
+    //   --frame-stats-interval <s>  seconds between two of them
+    //   --readback-every <n>  read the shown frame back every n-th frame,
+    //                      to measure the cost of thumbnails
+    //   --no-shader-cache  compile the shaders from source on every start,
+    //                      for the cold startup time
+    QStringList arguments = a.arguments();
+    QString pyramidPath;
+    int pyramidFillLevels = 0;
+    QString frameStatsPath;
+    int frameStatsInterval = 5;
+    for (int i = 1; i < arguments.size(); i++)
+    {
+        if (arguments[i] == "--cpu")
+            w.SetCpuRendering(true);
+        else if (arguments[i] == "--threads" && i + 1 < arguments.size())
+            w.SetRenderThreads(arguments[++i].toInt());
+        else if (arguments[i] == "--tile-size" && i + 1 < arguments.size())
+            w.SetRenderTileSize(arguments[++i].toInt());
+        else if (arguments[i] == "--subdivide")
+            w.SetSubdivision(true);
+        else if (arguments[i] == "--subdivide-fast")
+            w.SetSubdivision(true, false);
+        else if (arguments[i] == "--progressive")
+            w.SetProgressive(true);
+        else if (arguments[i] == "--no-reprojection")
+            w.SetReprojection(false);
+        else if (arguments[i] == "--antialias" && i + 1 < arguments.size())
+            w.SetSupersampling(arguments[++i].toDouble());
+        else if (arguments[i] == "--histogram-coloring")
+            w.SetHistogramColoring(true);
+        else if (arguments[i] == "--tile-cache" && i + 1 < arguments.size())
+            w.SetTileCacheSize(arguments[++i].toInt());
+        else if (arguments[i] == "--pyramid" && i + 1 < arguments.size())
+            pyramidPath = arguments[++i];
+        else if (arguments[i] == "--pyramid-fill" && i + 1 < arguments.size())
+            pyramidFillLevels = arguments[++i].toInt();
+        else if (arguments[i] == "--iteration-budget" && i + 1 < arguments.size())
+            w.SetIterationBudget(arguments[++i].toDouble());
+        else if (arguments[i] == "--frame-budget" && i + 1 < arguments.size())
+            w.SetFrameBudget(arguments[++i].toDouble());
+        else if (arguments[i] == "--frame-stats" && i + 1 < arguments.size())
+            frameStatsPath = arguments[++i];
+        else if (arguments[i] == "--frame-stats-interval" && i + 1 < arguments.size())
+            frameStatsInterval = arguments[++i].toInt();
+        else if (arguments[i] == "--readback-every" && i + 1 < arguments.size())
+            w.SetReadbackInterval(arguments[++i].toInt());
+        else if (arguments[i] == "--no-shader-cache")
+            w.SetShaderCache(false);
+        else if (arguments[i] == "--view" && i + 3 < arguments.size())
+        {
+            double x = arguments[++i].toDouble();
+            double y = arguments[++i].toDouble();
+            w.SetStartView(x, y, arguments[++i].toDouble());
+        }
+    }
+
+    if (!pyramidPath.isEmpty())
+        w.SetTilePyramid(pyramidPath, pyramidFillLevels);
+    if (!frameStatsPath.isEmpty())
+        w.SetFrameStatsDump(frameStatsPath, frameStatsInterval);
+
 #if !defined (Q_OS_ANDROID)
     w.resize(1280, 720);
     w.show();
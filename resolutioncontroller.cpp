@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "resolutioncontroller.h"
+#include <math.h>
+#include <algorithm>
+
+// weight of the newest pass in the estimate
+const double SMOOTHING = 0.5;
+
+// the next larger scale has to stay this far below the target
+const double HEADROOM = 0.8;
+
+ResolutionController::ResolutionController()
+{
+    target = 0.0;
+    minimumSteps = SCALE_STEPS / 4;
+    steps = SCALE_STEPS;
+    nativeMilliseconds = 0.0;
+}
+
+void ResolutionController::SetTarget(double milliseconds)
+{
+    target = std::max(0.0, milliseconds);
+    if ( target == 0.0 )
+        steps = SCALE_STEPS;
+}
+
+void ResolutionController::SetMinimumScale(double scale)
+{
+    minimumSteps = std::max(1, std::min(int(SCALE_STEPS), int(ceil(scale * SCALE_STEPS))));
+    steps = std::max(steps, minimumSteps);
+}
+
+void ResolutionController::AddPass(double scale, double milliseconds)
+{
+    if ( scale <= 0.0 || milliseconds <= 0.0 )
+        return;
+
+    // the time goes with the pixel count
+    double native = milliseconds / (scale * scale);
+    nativeMilliseconds = nativeMilliseconds > 0.0 ? nativeMilliseconds + SMOOTHING * (native - nativeMilliseconds) : native;
+
+    if ( target == 0.0 )
+        return;
+
+    // largest step that is predicted to meet the target
+    double fitting = sqrt(target / nativeMilliseconds);
+    int fittingSteps = std::max(minimumSteps, std::min(int(SCALE_STEPS), int(floor(fitting * SCALE_STEPS))));
+
+    if ( fittingSteps < steps )
+    {
+        steps = fittingSteps;
+    }
+    else if ( steps < SCALE_STEPS )
+    {
+        double larger = double(steps + 1) / SCALE_STEPS;
+        if ( nativeMilliseconds * larger * larger <= target * HEADROOM )
+            steps ++;
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOLUTIONCONTROLLER_H
+#define RESOLUTIONCONTROLLER_H
+
+// resolution of the mandelbrot pass that keeps it within a frame time
+//
+// a pass costs about the same per pixel from one frame to the next, so the
+// measured time of the last passes over their pixel count predicts the
+// scale that meets the target. The estimate is smoothed and the scale moves
+// in steps of 1 / SCALE_STEPS, down right away but up only when the next
+// step still leaves some headroom, so a single slow frame does not make
+// the image pump
+class ResolutionController
+{
+public:
+
+    static const int SCALE_STEPS = 16;     // scale = steps / SCALE_STEPS
+
+    ResolutionController();
+
+    // frame time of a pass in milliseconds, 0 = always native resolution
+    void SetTarget(double milliseconds);
+    double Target() const { return target; }
+
+    // smallest fraction of the native width and height
+    void SetMinimumScale(double scale);
+
+    // fraction of the native width and height for the next pass
+    double Scale() const { return double(steps) / SCALE_STEPS; }
+
+    // a pass at scale took milliseconds
+    void AddPass(double scale, double milliseconds);
+
+    // estimated time of a pass at native resolution, 0 before the first one
+    double NativeMilliseconds() const { return nativeMilliseconds; }
+
+private:
+    double target;
+    int minimumSteps;
+    int steps;
+    double nativeMilliseconds;
+};
+
+#endif // RESOLUTIONCONTROLLER_H
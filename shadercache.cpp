@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shadercache.h"
+#include <QtOpenGL/QtOpenGL>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <string.h>
+
+// program binary enums, the same values in GL_OES_get_program_binary,
+// GL_ARB_get_program_binary and GL ES 3.0
+const GLenum PROGRAM_BINARY_LENGTH = 0x8741;            // GL_PROGRAM_BINARY_LENGTH
+const GLenum NUM_PROGRAM_BINARY_FORMATS = 0x87FE;       // GL_NUM_PROGRAM_BINARY_FORMATS
+const GLenum PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;  // GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+
+// a cache file is the magic, the binary format and the length of the
+// binary as native quint32, then the binary
+const quint32 CACHE_MAGIC = 0x53474446;     // "FDGS"
+const int CACHE_HEADER = 3 * sizeof(quint32);
+
+static QString ReadSource(const QString& fileName)
+{
+    QFile file(fileName);
+    if ( !file.open(QIODevice::ReadOnly | QIODevice::Text) )
+        return QString();
+
+    return QTextStream(&file).readAll();
+}
+
+ShaderCache::ShaderCache()
+{
+    getProgramBinary = 0;
+    programBinary = 0;
+    programParameteri = 0;
+
+    loaded = 0;
+    compiled = 0;
+    rejected = 0;
+    seconds = 0.0;
+}
+
+QString ShaderCache::DefaultDirectory()
+{
+    QString location = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+    if ( location.isEmpty() )
+        location = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+    if ( location.isEmpty() )
+        return QString();
+
+    return QDir(location).filePath("shaders");
+}
+
+void ShaderCache::InitializeGL(const QString& cacheDirectory)
+{
+    const QGLContext* context = QGLContext::currentContext();
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    if ( !context || !extensions || !version )
+        return;
+
+    functions.initializeGLFunctions(context);
+
+    driver = QByteArray(reinterpret_cast<const char*>(glGetString(GL_VENDOR))) + '\n' +
+             QByteArray(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + '\n' +
+             QByteArray(version);
+
+    if ( cacheDirectory.isEmpty() || !QDir().mkpath(cacheDirectory) )
+        return;
+
+    directory = cacheDirectory;
+
+    // GL ES 3.0 has them in core, GL ES 2.0 behind the OES extension which
+    // keeps every program retrievable without the hint
+    bool es3 = strncmp(version, "OpenGL ES 3", 11) == 0;
+    if ( es3 || strstr(extensions, "GL_ARB_get_program_binary") )
+    {
+        getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(context->getProcAddress("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinaryProc>(context->getProcAddress("glProgramBinary"));
+        programParameteri = reinterpret_cast<ProgramParameteriProc>(context->getProcAddress("glProgramParameteri"));
+    }
+    else if ( strstr(extensions, "GL_OES_get_program_binary") )
+    {
+        getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(context->getProcAddress("glGetProgramBinaryOES"));
+        programBinary = reinterpret_cast<ProgramBinaryProc>(context->getProcAddress("glProgramBinaryOES"));
+    }
+
+    // drivers may have the functions but no format to write (Mesa does)
+    GLint formats = 0;
+    if ( getProgramBinary && programBinary )
+        glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+    if ( formats <= 0 )
+    {
+        getProgramBinary = 0;
+        programBinary = 0;
+        programParameteri = 0;
+    }
+}
+
+QString ShaderCache::Defines(int options)
+{
+    QString defines;
+
+    if ( options & FP64 )
+        defines += "#define USE_FP64\n";
+    if ( options & FALL_BACK )
+        defines += "#define FALL_BACK\n";
+    if ( options & PERIODICITY_CHECK )
+        defines += "#define ENABLE_PERIODICITY_CHECK\n";
+    if ( options & SHOW_PERIODICITY )
+        defines += "#define SHOW_PERIODICITY_CHECK\n";
+
+    defines += (options & MEDIUM_PRECISION) ? "#define ITERATION_PRECISION mediump\n"
+                                            : "#define ITERATION_PRECISION highp\n";
+    return defines;
+}
+
+QString ShaderCache::OptionNames(int options)
+{
+    QString names = (options & FP64) ? "fp64" : "float";
+    names += (options & MEDIUM_PRECISION) ? ", mediump" : ", highp";
+
+    if ( options & FALL_BACK )
+        names += ", fall back";
+    if ( options & PERIODICITY_CHECK )
+        names += ", periodicity check";
+    if ( options & SHOW_PERIODICITY )
+        names += ", shown";
+
+    return names;
+}
+
+QString ShaderCache::Key(const QString& vertexSource, const QString& fragmentSource) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(driver);
+    hash.addData("\n", 1);
+    hash.addData(vertexSource.toUtf8());
+    hash.addData("", 1);        // the terminating zero keeps the two sources apart
+    hash.addData(fragmentSource.toUtf8());
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+QGLShaderProgram* ShaderCache::Build(const QString& vertexFile, const QString& fragmentFile, int options, QString* errors)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QString vertexSource = ReadSource(vertexFile);
+    QString fragmentSource = ReadSource(fragmentFile);
+    if ( vertexSource.isEmpty() || fragmentSource.isEmpty() )
+    {
+        Reject(fragmentFile, options, QString(), QString("cannot read the sources\n"), errors);
+        seconds += timer.nsecsElapsed() * 1e-9;
+        return 0;
+    }
+
+    // the defines go first, only the preprocessor may come before #extension
+    QString defines = Defines(options);
+    vertexSource.prepend(defines);
+    fragmentSource.prepend(defines);
+
+    QString key = directory.isEmpty() ? QString() : Key(vertexSource, fragmentSource);
+    if ( !key.isEmpty() && QFile::exists(QDir(directory).filePath(key + ".rejected")) )
+    {
+        rejected ++;
+        if ( errors )
+            *errors += QString("%1 (%2): refused at an earlier start\n").arg(fragmentFile, OptionNames(options));
+        seconds += timer.nsecsElapsed() * 1e-9;
+        return 0;
+    }
+
+    const QGLContext* context = QGLContext::currentContext();
+    QGLShaderProgram* program = new QGLShaderProgram(context);
+
+    QString path = Binaries() ? QDir(directory).filePath(key + ".bin") : QString();
+    if ( !path.isEmpty() )
+    {
+        if ( Load(program, path) )
+        {
+            loaded ++;
+            seconds += timer.nsecsElapsed() * 1e-9;
+            return program;
+        }
+
+        // a binary the driver refused leaves a failed link behind
+        delete program;
+        program = new QGLShaderProgram(context);
+
+        if ( programParameteri )
+            programParameteri(program->programId(), PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    if ( !program->addShaderFromSourceCode(QGLShader::Vertex, vertexSource) ||
+         !program->addShaderFromSourceCode(QGLShader::Fragment, fragmentSource) ||
+         !program->link() )
+    {
+        Reject(fragmentFile, options, key, program->log(), errors);
+        delete program;
+        seconds += timer.nsecsElapsed() * 1e-9;
+        return 0;
+    }
+
+    if ( !path.isEmpty() )
+        Save(program, path);
+
+    compiled ++;
+    seconds += timer.nsecsElapsed() * 1e-9;
+    return program;
+}
+
+QGLShaderProgram* ShaderCache::BuildFirst(const QString& vertexFile, const QString& fragmentFile,
+                                          const QList<int>& variants, int* variant, QString* errors)
+{
+    QString variantErrors;
+
+    for ( int i = 0; i < variants.size(); i ++)
+    {
+        QGLShaderProgram* program = Build(vertexFile, fragmentFile, variants[i], &variantErrors);
+        if ( program )
+        {
+            if ( variant )
+                *variant = variants[i];
+            return program;
+        }
+    }
+
+    if ( errors )
+        *errors += variantErrors;
+    return 0;
+}
+
+void ShaderCache::Reject(const QString& fragmentFile, int options, const QString& key, const QString& log, QString* errors)
+{
+    rejected ++;
+
+    if ( errors )
+        *errors += QString("%1 (%2):\n%3").arg(fragmentFile, OptionNames(options), log);
+
+    // an empty file, the next start skips the variant
+    if ( !key.isEmpty() )
+    {
+        QFile marker(QDir(directory).filePath(key + ".rejected"));
+        marker.open(QIODevice::WriteOnly);
+    }
+}
+
+bool ShaderCache::Load(QGLShaderProgram* program, const QString& path)
+{
+    QFile file(path);
+    if ( !file.open(QIODevice::ReadOnly) )
+        return false;
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    quint32 header[3] = { 0, 0, 0 };    // magic, binary format, length
+    if ( data.size() > CACHE_HEADER )
+        memcpy(header, data.constData(), CACHE_HEADER);
+
+    if ( data.size() <= CACHE_HEADER || header[0] != CACHE_MAGIC ||
+         header[2] != quint32(data.size() - CACHE_HEADER) )
+    {
+        QFile::remove(path);
+        return false;
+    }
+
+    programBinary(program->programId(), GLenum(header[1]), data.constData() + CACHE_HEADER, GLint(header[2]));
+
+    // a format the driver no longer knows is a GL_INVALID_ENUM, anything
+    // else it refuses fails the link status; QGLShaderProgram::link() only
+    // reads the status of a program without shaders
+    glGetError();
+    if ( !program->link() )
+    {
+        QFile::remove(path);
+        return false;
+    }
+
+    return true;
+}
+
+void ShaderCache::Save(QGLShaderProgram* program, const QString& path)
+{
+    GLint length = 0;
+    functions.glGetProgramiv(program->programId(), PROGRAM_BINARY_LENGTH, &length);
+    if ( length <= 0 )
+        return;
+
+    QByteArray data(CACHE_HEADER + length, 0);
+    GLsizei written = 0;
+    GLenum format = 0;
+    getProgramBinary(program->programId(), length, &written, &format, data.data() + CACHE_HEADER);
+    if ( written <= 0 )
+        return;
+
+    quint32 header[3] = { CACHE_MAGIC, quint32(format), quint32(written) };
+    memcpy(data.data(), header, CACHE_HEADER);
+    data.resize(CACHE_HEADER + written);
+
+    // written next to it and renamed, a start that dies half way leaves no
+    // truncated binary behind
+    QString temporary = path + ".tmp";
+    QFile file(temporary);
+    if ( !file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size() )
+    {
+        file.close();
+        QFile::remove(temporary);
+        return;
+    }
+    file.close();
+
+    QFile::remove(path);
+    QFile::rename(temporary, path);
+}
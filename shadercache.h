@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QGLFunctions>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+class QGLShaderProgram;
+
+// builds the shader programs in the variant the driver takes, and keeps
+// the linked programs on disk between two starts
+//
+// the variants are switched by defines put in front of both sources (see
+// Defines()), instead of editing the text of the shader. Where the context
+// has program binaries (GL_OES_get_program_binary, GL_ARB_get_program_binary
+// or GL ES 3.0) a linked program goes into the cache directory, under the
+// sha1 of the vendor, renderer and version strings and of the sources it was
+// built from; the next start loads it instead of compiling again. A new
+// driver or a changed shader gives a new key, a binary the driver rejects is
+// deleted and built from source. A variant the compiler refused leaves an
+// empty marker under its key, so the fallbacks of a driver cost one start
+// only. All calls on the gui thread, with the context current that
+// InitializeGL() saw
+class ShaderCache
+{
+public:
+
+    enum Option
+    {
+        FP64 = 1,                   // doubles through GL_ARB_gpu_shader_fp64, desktop only
+        FALL_BACK = 2,              // constant loop count for the Tegra 2
+        PERIODICITY_CHECK = 4,      // Brent's cycle detection for interior points
+        SHOW_PERIODICITY = 8,       // paints the pixels it stopped in magenta
+        MEDIUM_PRECISION = 16       // mediump iterations, for fragment shaders without highp
+    };
+
+    ShaderCache();
+
+    // looks up program binaries of the current context; with an empty
+    // directory every program is compiled from source
+    void InitializeGL(const QString& cacheDirectory);
+
+    // the cache directory of the application
+    static QString DefaultDirectory();
+
+    // the #define lines of the options, and their names for the log
+    static QString Defines(int options);
+    static QString OptionNames(int options);
+
+    // the program of the two files with the defines of the options in
+    // front, loaded from the cache or compiled and linked; 0 with the
+    // compiler log appended to errors if it does not build
+    QGLShaderProgram* Build(const QString& vertexFile, const QString& fragmentFile, int options, QString* errors);
+
+    // the first of the variants that builds, its options go to variant;
+    // errors only gets the logs if none of them does
+    QGLShaderProgram* BuildFirst(const QString& vertexFile, const QString& fragmentFile,
+                                 const QList<int>& variants, int* variant, QString* errors);
+
+    bool Binaries() const { return programBinary != 0 && !directory.isEmpty(); }
+    int Loaded() const { return loaded; }           // programs from the cache
+    int Compiled() const { return compiled; }       // programs compiled from source
+    int Rejected() const { return rejected; }       // variants that did not build
+    double Seconds() const { return seconds; }      // time spent in Build()
+
+private:
+
+    QString Key(const QString& vertexSource, const QString& fragmentSource) const;
+    void Reject(const QString& fragmentFile, int options, const QString& key, const QString& log, QString* errors);
+    bool Load(QGLShaderProgram* program, const QString& path);
+    void Save(QGLShaderProgram* program, const QString& path);
+
+    typedef void (QGLF_APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (QGLF_APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLint length);
+    typedef void (QGLF_APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    QGLFunctions functions;
+    GetProgramBinaryProc getProgramBinary;
+    ProgramBinaryProc programBinary;
+    ProgramParameteriProc programParameteri;    // 0 with the OES extension, it needs no hint
+
+    QString directory;
+    QByteArray driver;          // vendor, renderer and version, part of every key
+
+    int loaded;
+    int compiled;
+    int rejected;
+    double seconds;
+};
+
+#endif // SHADERCACHE_H
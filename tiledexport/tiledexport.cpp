@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// tiled export of one view at print sizes
+//
+//   tiledexport --view -0.743643887037 0.131825904205 3000 --size 32768 32768 --output print.png
+//
+// the image is rendered one band of --tile rows at a time. Every band is a
+// view of its own with the pixel size and the transform of the whole image
+// (see BandView()) and is cut into --tile sized tiles for the work-stealing
+// pool, so the pixels come out as the widget would show them. The finished
+// band is filtered and deflated into a PngWriter on a thread of its own
+// while the next one renders: two bands are all the image memory there is,
+// whatever the height of the image. Views past double precision go through
+// the PerturbationRenderer, band by band. --antialias n refines every band
+// with the AdaptiveSupersampler; the rows at the band edges only see their
+// neighbours inside the band. --histogram-coloring equalizes the palette
+// over a render of the whole view at an eighth of its width and height
+// first, every band takes the same colors then. Progress, tiles/s and the
+// peak resident set are logged to stderr.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "adaptivesampler.h"
+#include "histogramcoloring.h"
+#include "mandelbrotengine.h"
+#include "mandelbrotpalette.h"
+#include "perturbationrenderer.h"
+#include "pngcodec.h"
+#include "tilescheduler.h"
+
+// the widget starts at INIT_ITERATION and adds as much for every
+// scale factor of LOG_BASE beyond that (AutoIterations() in MandelGLWidget.cpp)
+static const double INIT_ITERATION = 64.0;
+static const double LOG_BASE = 8.0;
+
+// the histogram of --histogram-coloring comes from a render this many times
+// smaller in both directions
+static const int PREVIEW_DIVISOR = 8;
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int AutoIterations(double scale)
+{
+    return int((scale < LOG_BASE ? 1.0 : log(scale) / log(LOG_BASE)) * INIT_ITERATION + 0.5);
+}
+
+// most memory the process had resident so far
+static double PeakRssMegabytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if ( !GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+        return 0.0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) != 0 )
+        return 0.0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);     // bytes
+#else
+    return usage.ru_maxrss / 1024.0;                // kilobytes
+#endif
+#endif
+}
+
+// rows [y, y + rows) of the view as a view of their own with the same pixel
+// size; the view has to rotate around its center
+static MandelbrotView BandView(const MandelbrotView& view, int y, int rows)
+{
+    double pixelSize = view.PixelSize();
+
+    // the band center is straight above or below the view center in the
+    // image, the image y axis points down; rotated as in mandelbrot_frag.glsl
+    double offset = (0.5 * view.height - y - 0.5 * rows) * pixelSize;
+    int bits = BigFloat::BitsForPixelSize(pixelSize);
+
+    MandelbrotView band = view;
+    band.height = rows;
+    band.scale = view.scale * double(view.height) / double(rows);
+    band.SetCenter(view.PreciseCenterX() + BigFloat(-sin(view.rotation) * offset, bits),
+                   view.PreciseCenterY() + BigFloat(cos(view.rotation) * offset, bits));
+    band.pivotX = band.centerX;
+    band.pivotY = band.centerY;
+    return band;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: tiledexport --view <centerX> <centerY> <scale> --output <png> [options]\n"
+            "  --view <x> <y> <scale>    center and scale as in the widget, the whole\n"
+            "                            height of the image is 4 / scale\n"
+            "  --rotation <radians>      default 0\n"
+            "  --iterations <n>          default from the scale, as in the widget\n"
+            "  --size <width> <height>   image size, default 8192 8192\n"
+            "  --tile <n>                tile edge and band height, default 256\n"
+            "  --threads <n>             one per core by default\n"
+            "  --level <n>               zlib level 0..9, default 6\n"
+            "  --antialias <n>           adaptive antialiasing with at most n samples\n"
+            "                            per pixel on average, default 1 (off)\n"
+            "  --histogram-coloring      palette spread over the escaped pixels\n"
+            "  --palette <png>           default Resources/lookup.png of the source tree\n"
+            "  --quiet                   no line per band\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string centerXText;
+    std::string centerYText;
+    double scale = 0.0;
+    double rotation = 0.0;
+    int iterations = 0;
+    int width = 8192;
+    int height = 8192;
+    int tileSize = 256;
+    int threads = 0;
+    int level = 6;
+    double samplesPerPixel = 1.0;
+    bool histogramColoring = false;
+    std::string outputPath;
+    std::string palettePath;
+    bool quiet = false;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument = argv[i];
+        if ( argument == "--view" && i + 3 < argc )
+        {
+            centerXText = argv[++i];
+            centerYText = argv[++i];
+            scale = atof(argv[++i]);
+        }
+        else if ( argument == "--rotation" && i + 1 < argc )
+            rotation = atof(argv[++i]);
+        else if ( argument == "--iterations" && i + 1 < argc )
+            iterations = atoi(argv[++i]);
+        else if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if ( argument == "--tile" && i + 1 < argc )
+            tileSize = atoi(argv[++i]);
+        else if ( argument == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++i]);
+        else if ( argument == "--level" && i + 1 < argc )
+            level = atoi(argv[++i]);
+        else if ( argument == "--antialias" && i + 1 < argc )
+            samplesPerPixel = atof(argv[++i]);
+        else if ( argument == "--histogram-coloring" )
+            histogramColoring = true;
+        else if ( argument == "--output" && i + 1 < argc )
+            outputPath = argv[++i];
+        else if ( argument == "--palette" && i + 1 < argc )
+            palettePath = argv[++i];
+        else if ( argument == "--quiet" )
+            quiet = true;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( centerXText.empty() || outputPath.empty() || !(scale > 0.0) || width <= 0 || height <= 0 ||
+         tileSize <= 0 || level < 0 || level > 9 )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    MandelbrotView view;
+    view.width = width;
+    view.height = height;
+    view.scale = scale;
+    view.rotation = rotation;
+    view.maxIterations = iterations > 0 ? iterations : AutoIterations(scale);
+
+    BigFloat centerX;
+    BigFloat centerY;
+    int bits = BigFloat::BitsForPixelSize(view.PixelSize());
+    if ( !BigFloat::FromString(centerXText, bits, centerX) || !BigFloat::FromString(centerYText, bits, centerY) )
+    {
+        fprintf(stderr, "bad center %s %s\n", centerXText.c_str(), centerYText.c_str());
+        return 1;
+    }
+    view.SetCenter(centerX, centerY);
+    view.pivotX = view.centerX;
+    view.pivotY = view.centerY;
+
+    // same colors as the widget, gray scale without them
+    MandelbrotPalette palette;
+    std::string paletteFile;
+    if ( !LoadToolPalette(palette, palettePath, argv[0], paletteFile) )
+        fprintf(stderr, "could not load %s, rendering gray scale\n", paletteFile.c_str());
+
+    MandelbrotEngine engine;
+    engine.SetPalette(&palette);
+    PerturbationRenderer perturbation;
+    perturbation.SetPalette(&palette);
+    AdaptiveSupersampler supersampler;
+    supersampler.SetEngine(&engine);
+    supersampler.SetSampleBudget(samplesPerPixel);
+    SupersamplingStats supersamplingStats;
+    TileScheduler scheduler(threads, tileSize);
+
+    bool deep = PerturbationRenderer::IsDeepView(view);
+
+    // the bands cannot be equalized one by one without seams, they all
+    // take the palette of a small render of the whole view
+    HistogramColoring coloring;
+    HistogramColoringStats coloringStats;
+    if ( histogramColoring )
+    {
+        MandelbrotView preview = view;
+        preview.width = std::max(1, width / PREVIEW_DIVISOR);
+        preview.height = std::max(1, height / PREVIEW_DIVISOR);
+
+        size_t previewPixels = size_t(preview.width) * preview.height;
+        std::vector<int> previewIterations(previewPixels);
+        std::vector<float> previewSmooth(previewPixels);
+        FractalBuffer buffer(preview.width, preview.height, 0, &previewIterations[0], &previewSmooth[0]);
+
+        double previewStart = Now();
+        if ( deep )
+        {
+            perturbation.Render(preview, buffer, &scheduler);
+        }
+        else
+        {
+            scheduler.Run(preview.width, preview.height, [&](const RenderTile& tile, int)
+            {
+                FractalBuffer target = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                engine.RenderRegion(preview, tile.x, tile.y, tile.width, tile.height, target);
+            });
+        }
+
+        coloring.SetPalette(&palette);
+        coloring.Collect(buffer, view.maxIterations, &scheduler, &coloringStats);
+        coloring.Equalize();
+        engine.SetPalette(&coloring.Palette());
+        perturbation.SetPalette(&coloring.Palette());
+
+        fprintf(stderr, "histogram coloring: %dx%d preview, %.1f%% escaped, %.2f s\n",
+                preview.width, preview.height,
+                coloringStats.pixels > 0 ? 100.0 * coloringStats.escaped / coloringStats.pixels : 0.0,
+                Now() - previewStart);
+    }
+
+    PngWriter writer;
+    if ( !writer.Open(outputPath.c_str(), width, height, false, level) )
+    {
+        fprintf(stderr, "could not open %s\n", outputPath.c_str());
+        return 1;
+    }
+
+    int bandCount = (height + tileSize - 1) / tileSize;
+    int tilesAcross = (width + tileSize - 1) / tileSize;
+    long long tileCount = (long long)(tilesAcross) * ((height + tileSize - 1) / tileSize);
+
+    fprintf(stderr, "rendering %dx%d, scale %.3g, %d iterations%s, in %d bands of %d tiles with %d threads\n",
+            width, height, scale, view.maxIterations, deep ? ", deep" : "", bandCount, tilesAcross,
+            scheduler.ThreadCount());
+
+    // one band renders while the one before is encoded
+    std::vector<unsigned char> bands[2];
+    bands[0].resize(size_t(width) * tileSize * 4);
+    bands[1].resize(size_t(width) * tileSize * 4);
+
+    std::thread encoder;
+    bool encoded = true;
+    double start = Now();
+    double renderSeconds = 0.0;
+    double encodeSeconds = 0.0;
+    long long tilesDone = 0;
+
+    for ( int band = 0; band < bandCount; band ++)
+    {
+        int y = band * tileSize;
+        int rows = std::min(tileSize, height - y);
+        unsigned char* rgba = &bands[band % 2][0];
+
+        double bandStart = Now();
+        MandelbrotView bandView = BandView(view, y, rows);
+        FractalBuffer buffer(width, rows, rgba, 0, 0);
+        if ( deep )
+        {
+            perturbation.Render(bandView, buffer, &scheduler);
+        }
+        else
+        {
+            scheduler.Run(width, rows, [&](const RenderTile& tile, int)
+            {
+                FractalBuffer target = buffer.SubBuffer(tile.x, tile.y, tile.width, tile.height);
+                engine.RenderRegion(bandView, tile.x, tile.y, tile.width, tile.height, target);
+            });
+        }
+        if ( samplesPerPixel > 1.0 )
+            supersampler.Refine(bandView, buffer, scheduler, &supersamplingStats);
+        renderSeconds += Now() - bandStart;
+        tilesDone += (long long)(tilesAcross) * ((rows + tileSize - 1) / tileSize);
+
+        if ( encoder.joinable() )
+            encoder.join();
+        if ( !encoded )
+            break;
+
+        encoder = std::thread([&writer, &encoded, &encodeSeconds, rgba, rows]()
+        {
+            double encodeStart = Now();
+            encoded = writer.WriteRows(rgba, rows);
+            encodeSeconds += Now() - encodeStart;
+        });
+
+        if ( !quiet )
+        {
+            double seconds = Now() - start;
+            double done = double(y + rows) / height;
+            fprintf(stderr, "band %d/%d: %.1f%%, %.2f s, %.1f tiles/s, %.1f Mpixels/s, %.0f s left, peak rss %.0f MB\n",
+                    band + 1, bandCount, done * 100.0, seconds, tilesDone / seconds,
+                    double(width) * (y + rows) / seconds * 1e-6, seconds / done - seconds, PeakRssMegabytes());
+        }
+    }
+
+    if ( encoder.joinable() )
+        encoder.join();
+
+    if ( !encoded || !writer.Close() )
+    {
+        fprintf(stderr, "could not write %s\n", outputPath.c_str());
+        return 1;
+    }
+
+    double seconds = Now() - start;
+    if ( supersamplingStats.pixels > 0 )
+    {
+        fprintf(stderr, "antialiasing: %.2f samples per pixel, %.1f%% of the pixels refined, %lld stopped by the budget\n",
+                supersamplingStats.SamplesPerPixel(), supersamplingStats.RefinedFraction() * 100.0,
+                supersamplingStats.budgetPixels);
+    }
+    fprintf(stderr, "%lld tiles in %.2f s: %.1f tiles/s, %.1f Mpixels/s, %.2f s rendering, %.2f s encoding, %.1f MB png, peak rss %.0f MB\n",
+            tileCount, seconds, tileCount / seconds, double(width) * height / seconds * 1e-6,
+            renderSeconds, encodeSeconds, writer.BytesWritten() / (1024.0 * 1024.0), PeakRssMegabytes());
+
+    return 0;
+}
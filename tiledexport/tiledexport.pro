@@ -0,0 +1,19 @@
+#-----------------------------------------------------------
+#
+# tiled export of one view at print sizes, streamed into a png
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = tiledexport
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += tiledexport.cpp
+
+include(../fractcore/fractcore.pri)
+
+# peak working set
+win32:LIBS += -lpsapi
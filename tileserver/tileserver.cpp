@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// headless xyz tile server for slippy map viewers
+//
+//   GET /z/x/y.png[?iterations=n]  a 256 x 256 tile, see TileService; n up
+//                                  to --max-iterations, 400 beyond
+//   GET /stats                     counters, latency and throughput
+//
+// every connection is kept alive and served by one of a fixed number of
+// connection threads, the tiles themselves are rendered by the workers of
+// the TileService. A full render queue is answered with 503 and a
+// Retry-After header, so a viewer backs off instead of queueing up more.
+// Posix sockets, it binds to the loopback address unless told otherwise.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mandelbrotpalette.h"
+#include "tileservice.h"
+
+// a connection that sends nothing for this long is closed
+static const int IDLE_SECONDS = 30;
+
+// requests are a line and a few headers, anything longer is not a viewer
+static const size_t MAX_REQUEST_BYTES = 16384;
+
+// largest ?iterations=n a request may ask for, a 256 x 256 tile at this
+// limit is a few seconds of a worker at most
+static const int DEFAULT_MAX_ITERATIONS = 16384;
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// accepted sockets waiting for a connection thread
+class ConnectionQueue
+{
+public:
+    ConnectionQueue(size_t limit) : limit(limit) {}
+
+    // false if there are too many waiting already
+    bool Push(int socket)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( sockets.size() >= limit )
+            return false;
+
+        sockets.push_back(socket);
+        available.notify_one();
+        return true;
+    }
+
+    int Pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while ( sockets.empty() )
+            available.wait(lock);
+
+        int socket = sockets.front();
+        sockets.pop_front();
+        return socket;
+    }
+
+private:
+    size_t limit;
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<int> sockets;
+};
+
+static bool SendAll(int socket, const void* data, size_t size)
+{
+    const char* bytes = (const char*)(data);
+    while ( size > 0 )
+    {
+        ssize_t sent = send(socket, bytes, size, MSG_NOSIGNAL);
+        if ( sent < 0 && errno == EINTR )
+            continue;
+        if ( sent <= 0 )
+            return false;
+
+        bytes += sent;
+        size -= size_t(sent);
+    }
+
+    return true;
+}
+
+static bool SendResponse(int socket, const char* status, const char* contentType, const void* body, size_t size,
+                         const char* extraHeaders = "", bool keepAlive = true)
+{
+    char header[512];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %s\r\n"
+                          "Content-Type: %s\r\n"
+                          "Content-Length: %zu\r\n"
+                          "Connection: %s\r\n"
+                          "%s"
+                          "\r\n", status, contentType, size, keepAlive ? "keep-alive" : "close", extraHeaders);
+
+    return SendAll(socket, header, size_t(length)) && (size == 0 || SendAll(socket, body, size));
+}
+
+static bool SendText(int socket, const char* status, const std::string& text, const char* extraHeaders = "",
+                     bool keepAlive = true)
+{
+    return SendResponse(socket, status, "text/plain", text.data(), text.size(), extraHeaders, keepAlive);
+}
+
+static std::string FormatStats(const TileServiceStats& stats)
+{
+    char text[512];
+    snprintf(text, sizeof(text),
+             "requests %lld rendered %lld coalesced %lld rejected %lld seconds %.1f tiles/s %.1f p50 %.2f ms p99 %.2f ms\n",
+             stats.requests, stats.rendered, stats.coalesced, stats.rejected, stats.seconds, stats.TilesPerSecond(),
+             stats.latency.Percentile(0.5) * 1000.0, stats.latency.Percentile(0.99) * 1000.0);
+    return text;
+}
+
+// "/z/x/y.png" or "/z/x/y", query is what follows a '?'
+static bool ParseTilePath(const std::string& path, int& zoom, long long& x, long long& y, std::string& query)
+{
+    query.clear();
+
+    std::string tile = path;
+    size_t queryStart = path.find('?');
+    if ( queryStart != std::string::npos )
+    {
+        tile = path.substr(0, queryStart);
+        query = path.substr(queryStart + 1);
+    }
+
+    char suffix[8] = { 0 };
+    int consumed = 0;
+    if ( sscanf(tile.c_str(), "/%d/%lld/%lld%n", &zoom, &x, &y, &consumed) != 3 )
+        return false;
+    if ( tile.c_str()[consumed] != 0 && (sscanf(tile.c_str() + consumed, "%7s", suffix) != 1 || strcmp(suffix, ".png") != 0) )
+        return false;
+
+    return true;
+}
+
+// an optional "iterations=n" anywhere in the query, 0 without it; false
+// for anything but a number from 0 to maxIterations
+static bool ParseIterations(const std::string& query, int maxIterations, int& iterations)
+{
+    iterations = 0;
+
+    size_t start = 0;
+    while ( start < query.size() )
+    {
+        size_t end = query.find('&', start);
+        if ( end == std::string::npos )
+            end = query.size();
+        std::string parameter = query.substr(start, end - start);
+        start = end + 1;
+
+        if ( parameter == "iterations" )
+            return false;
+        if ( parameter.compare(0, 11, "iterations=") != 0 )
+            continue;
+
+        const char* text = parameter.c_str() + 11;
+        char* last = 0;
+        errno = 0;
+        long value = strtol(text, &last, 10);
+        if ( last == text || *last != 0 || errno == ERANGE || value < 0 || value > maxIterations )
+            return false;
+
+        iterations = int(value);
+    }
+
+    return true;
+}
+
+static void ServeConnection(int socket, TileService& service, int maxIterations)
+{
+    struct timeval timeout;
+    timeout.tv_sec = IDLE_SECONDS;
+    timeout.tv_usec = 0;
+    setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int noDelay = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    std::string received;
+    char chunk[4096];
+
+    for ( ;; )
+    {
+        // one request, the viewers send no bodies with GET
+        size_t headerEnd;
+        while ( (headerEnd = received.find("\r\n\r\n")) == std::string::npos )
+        {
+            if ( received.size() > MAX_REQUEST_BYTES )
+                return;
+
+            ssize_t count = recv(socket, chunk, sizeof(chunk), 0);
+            if ( count < 0 && errno == EINTR )
+                continue;
+            if ( count <= 0 )
+                return;
+            received.append(chunk, size_t(count));
+        }
+
+        double start = Now();
+        std::string request = received.substr(0, headerEnd);
+        received.erase(0, headerEnd + 4);
+
+        char method[16] = { 0 };
+        char target[2048] = { 0 };
+        if ( sscanf(request.c_str(), "%15s %2047s", method, target) != 2 )
+        {
+            SendText(socket, "400 Bad Request", "bad request\n", "", false);
+            return;
+        }
+
+        // a client that asked to close gets its answer first
+        bool closeAfter = request.find("Connection: close") != std::string::npos ||
+                          request.find("connection: close") != std::string::npos;
+
+        int zoom, iterations;
+        long long x, y;
+        std::string query;
+        bool sent;
+
+        if ( strcmp(method, "GET") != 0 )
+        {
+            sent = SendText(socket, "405 Method Not Allowed", "only GET\n");
+        }
+        else if ( strcmp(target, "/stats") == 0 )
+        {
+            sent = SendText(socket, "200 OK", FormatStats(service.TotalStats()));
+        }
+        else if ( !ParseTilePath(target, zoom, x, y, query) )
+        {
+            sent = SendText(socket, "404 Not Found", "not found\n");
+        }
+        else if ( !ParseIterations(query, maxIterations, iterations) )
+        {
+            sent = SendText(socket, "400 Bad Request", "iterations must be 0 to " + std::to_string(maxIterations) + "\n");
+        }
+        else
+        {
+            TileService::PngPointer png;
+            TileService::Status status = service.GetTile(zoom, x, y, iterations, png);
+
+            if ( status == TileService::TILE_OK )
+            {
+                sent = SendResponse(socket, "200 OK", "image/png", &(*png)[0], png->size(),
+                                    "Cache-Control: public, max-age=86400\r\n");
+                service.AddLatency(Now() - start);
+            }
+            else if ( status == TileService::TILE_BUSY )
+            {
+                sent = SendText(socket, "503 Service Unavailable", "render queue full\n", "Retry-After: 1\r\n");
+            }
+            else if ( status == TileService::TILE_FAILED )
+            {
+                sent = SendText(socket, "500 Internal Server Error", "could not render the tile\n");
+            }
+            else
+            {
+                sent = SendText(socket, "404 Not Found", "no such tile\n");
+            }
+        }
+
+        if ( !sent || closeAfter )
+            return;
+    }
+}
+
+static void PrintUsage()
+{
+    printf("usage: tileserver [--port n] [--bind address] [--threads n] [--queue n] [--connections n]\n"
+           "                  [--iterations n] [--max-iterations n] [--palette lookup.png]\n"
+           "                  [--log-interval seconds]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int port = 8080;
+    std::string bindAddress = "127.0.0.1";
+    int threads = 0;
+    int queueLimit = 64;
+    int connectionThreads = 64;
+    int iterations = 0;
+    int maxIterations = DEFAULT_MAX_ITERATIONS;
+    std::string palettePath;
+    double logInterval = 10.0;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument = argv[i];
+        if ( argument == "--port" && i + 1 < argc )
+            port = atoi(argv[++i]);
+        else if ( argument == "--bind" && i + 1 < argc )
+            bindAddress = argv[++i];
+        else if ( argument == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++i]);
+        else if ( argument == "--queue" && i + 1 < argc )
+            queueLimit = atoi(argv[++i]);
+        else if ( argument == "--connections" && i + 1 < argc )
+            connectionThreads = atoi(argv[++i]);
+        else if ( argument == "--iterations" && i + 1 < argc )
+            iterations = atoi(argv[++i]);
+        else if ( argument == "--max-iterations" && i + 1 < argc )
+            maxIterations = atoi(argv[++i]);
+        else if ( argument == "--palette" && i + 1 < argc )
+            palettePath = argv[++i];
+        else if ( argument == "--log-interval" && i + 1 < argc )
+            logInterval = atof(argv[++i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // same colors as the widget, gray scale without them
+    MandelbrotPalette palette;
+    std::string paletteFile;
+    if ( !LoadToolPalette(palette, palettePath, argv[0], paletteFile) )
+        fprintf(stderr, "could not load %s, rendering gray scale\n", paletteFile.c_str());
+
+    TileService service(threads, queueLimit);
+    service.SetPalette(&palette);
+    service.SetMaxIterations(iterations);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)(port));
+    if ( listener < 0 || inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1 ||
+         bind(listener, (sockaddr*)(&address), sizeof(address)) != 0 || listen(listener, 256) != 0 )
+    {
+        fprintf(stderr, "could not listen on %s:%d: %s\n", bindAddress.c_str(), port, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // as many connections may wait for a thread as there are threads
+    if ( connectionThreads <= 0 )
+        connectionThreads = 1;
+    size_t waitingLimit = size_t(connectionThreads);
+    ConnectionQueue connections(waitingLimit);
+    for ( int i = 0; i < connectionThreads; i ++)
+    {
+        std::thread([&connections, &service, maxIterations]()
+        {
+            for ( ;; )
+            {
+                int socket = connections.Pop();
+                ServeConnection(socket, service, maxIterations);
+                close(socket);
+            }
+        }).detach();
+    }
+
+    if ( logInterval > 0.0 )
+    {
+        std::thread([&service, logInterval]()
+        {
+            for ( ;; )
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(logInterval));
+                TileServiceStats stats = service.TakeIntervalStats();
+                if ( stats.requests + stats.rejected > 0 )
+                    fprintf(stderr, "%s", FormatStats(stats).c_str());
+            }
+        }).detach();
+    }
+
+    fprintf(stderr, "serving %dx%d tiles on http://%s:%d/{z}/{x}/{y}.png with %d render threads, queue %d\n",
+            service.TileSize(), service.TileSize(), bindAddress.c_str(), port, service.ThreadCount(), service.QueueLimit());
+
+    for ( ;; )
+    {
+        int socket = accept(listener, 0, 0);
+        if ( socket < 0 )
+        {
+            if ( errno == EINTR || errno == ECONNABORTED )
+                continue;
+            fprintf(stderr, "accept failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if ( !connections.Push(socket) )
+        {
+            SendText(socket, "503 Service Unavailable", "too many connections\n", "Retry-After: 1\r\n", false);
+            close(socket);
+        }
+    }
+
+    close(listener);
+    return 1;
+}
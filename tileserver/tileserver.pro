@@ -0,0 +1,19 @@
+#-----------------------------------------------------------
+#
+# headless xyz tile server, posix sockets
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = tileserver
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += tileserver.cpp \
+    tileservice.cpp
+
+HEADERS += tileservice.h
+
+include(../fractcore/fractcore.pri)
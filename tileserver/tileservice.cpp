@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "tileservice.h"
+#include "perturbationrenderer.h"
+#include "pngcodec.h"
+
+#include <chrono>
+#include <math.h>
+
+// level 0 is one tile over this square
+static const double WORLD_LEFT = -2.5;
+static const double WORLD_TOP = 2.0;
+static const double WORLD_SIZE = 4.0;
+
+// the widget starts at INIT_ITERATION and adds as much for every
+// scale factor of LOG_BASE beyond that (AutoIterations() in MandelGLWidget.cpp)
+static const double INIT_ITERATION = 64.0;
+static const double LOG_BASE = 8.0;
+
+// the tile coordinates have to fit a long long
+static const int MAX_ZOOM = 60;
+
+static const double MIN_LATENCY = 1e-5;
+static const double LATENCY_STEP = 1.05;
+
+LatencyHistogram::LatencyHistogram()
+{
+    Clear();
+}
+
+void LatencyHistogram::Add(double seconds)
+{
+    int bucket = seconds <= MIN_LATENCY ? 0 : int(ceil(log(seconds / MIN_LATENCY) / log(LATENCY_STEP)));
+    buckets[bucket < BUCKETS ? bucket : BUCKETS - 1] ++;
+    count ++;
+}
+
+void LatencyHistogram::Add(const LatencyHistogram& other)
+{
+    for ( int i = 0; i < BUCKETS; i ++)
+        buckets[i] += other.buckets[i];
+    count += other.count;
+}
+
+void LatencyHistogram::Clear()
+{
+    for ( int i = 0; i < BUCKETS; i ++)
+        buckets[i] = 0;
+    count = 0;
+}
+
+double LatencyHistogram::Percentile(double p) const
+{
+    if ( count == 0 )
+        return 0.0;
+
+    long long rank = (long long)(ceil(p * double(count)));
+    long long seen = 0;
+    for ( int i = 0; i < BUCKETS; i ++)
+    {
+        seen += buckets[i];
+        if ( seen >= rank && seen > 0 )
+            return MIN_LATENCY * pow(LATENCY_STEP, double(i));
+    }
+
+    return MIN_LATENCY * pow(LATENCY_STEP, double(BUCKETS - 1));
+}
+
+TileServiceStats::TileServiceStats()
+{
+    requests = 0;
+    rendered = 0;
+    coalesced = 0;
+    rejected = 0;
+    seconds = 0.0;
+}
+
+bool TileService::TileKey::operator==(const TileKey& other) const
+{
+    return zoom == other.zoom && x == other.x && y == other.y && maxIterations == other.maxIterations;
+}
+
+size_t TileService::TileKeyHash::operator()(const TileKey& key) const
+{
+    unsigned long long hash = (unsigned long long)(key.x) * 0x9e3779b97f4a7c15ULL;
+    hash ^= (unsigned long long)(key.y) + 0xbf58476d1ce4e5b9ULL + (hash << 6) + (hash >> 2);
+    hash ^= (unsigned long long)(key.zoom) << 32 ^ (unsigned long long)(key.maxIterations);
+    return size_t(hash ^ (hash >> 31));
+}
+
+TileService::TileService(int threadCount, int queueLimit, int tileSize)
+{
+    this->tileSize = tileSize > 0 ? tileSize : 256;
+    this->queueLimit = queueLimit > 0 ? queueLimit : 1;
+    fixedIterations = 0;
+    waiting = 0;
+    quit = false;
+    startSeconds = Now();
+    intervalStartSeconds = startSeconds;
+
+    if ( threadCount <= 0 )
+        threadCount = int(std::thread::hardware_concurrency());
+    if ( threadCount <= 0 )
+        threadCount = 1;
+
+    for ( int i = 0; i < threadCount; i ++)
+        workers.push_back(std::thread(&TileService::WorkerLoop, this));
+}
+
+TileService::~TileService()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        quit = true;
+
+        // the requests still waiting give up, without a png; the workers
+        // only finish the tiles they are on
+        for ( std::unordered_map<TileKey, JobPointer, TileKeyHash>::iterator i = pending.begin(); i != pending.end(); ++ i)
+            i->second->done = true;
+        pending.clear();
+        queue.clear();
+        jobDone.notify_all();
+
+        // and are out of GetTile() before the mutex goes away
+        while ( waiting > 0 )
+            jobDone.wait(lock);
+    }
+    jobQueued.notify_all();
+
+    for ( size_t i = 0; i < workers.size(); i ++)
+        workers[i].join();
+}
+
+void TileService::SetPalette(const MandelbrotPalette* palette)
+{
+    engine.SetPalette(palette);
+}
+
+void TileService::SetMaxIterations(int maxIterations)
+{
+    fixedIterations = maxIterations > 0 ? maxIterations : 0;
+}
+
+int TileService::DefaultIterations(int zoom)
+{
+    double scale = ldexp(1.0, zoom);
+    return int((scale < LOG_BASE ? 1.0 : log(scale) / log(LOG_BASE)) * INIT_ITERATION + 0.5);
+}
+
+bool TileService::TileView(int zoom, long long x, long long y, int maxIterations, MandelbrotView& view) const
+{
+    if ( zoom < 0 || zoom > MAX_ZOOM || x < 0 || y < 0 || x >= (1LL << zoom) || y >= (1LL << zoom) )
+        return false;
+
+    double size = ldexp(WORLD_SIZE, -zoom);
+
+    view.width = tileSize;
+    view.height = tileSize;
+    view.SetCenter(BigFloat(WORLD_LEFT + (double(x) + 0.5) * size), BigFloat(WORLD_TOP - (double(y) + 0.5) * size));
+    view.pivotX = view.centerX;
+    view.pivotY = view.centerY;
+    view.scale = ldexp(1.0, zoom);
+    view.rotation = 0.0;
+    view.maxIterations = maxIterations > 0 ? maxIterations : DefaultIterations(zoom);
+
+    // past double precision only the perturbation renderer would do
+    return !PerturbationRenderer::IsDeepView(view);
+}
+
+TileService::Status TileService::GetTile(int zoom, long long x, long long y, int maxIterations, PngPointer& png)
+{
+    if ( fixedIterations > 0 )
+        maxIterations = fixedIterations;
+
+    MandelbrotView view;
+    if ( !TileView(zoom, x, y, maxIterations, view) )
+        return TILE_OUT_OF_RANGE;
+
+    TileKey key;
+    key.zoom = zoom;
+    key.x = x;
+    key.y = y;
+    key.maxIterations = view.maxIterations;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if ( quit )
+        return TILE_FAILED;
+
+    JobPointer job;
+    std::unordered_map<TileKey, JobPointer, TileKeyHash>::iterator found = pending.find(key);
+    if ( found != pending.end() )
+    {
+        job = found->second;
+        total.coalesced ++;
+        interval.coalesced ++;
+    }
+    else
+    {
+        if ( int(queue.size()) >= queueLimit )
+        {
+            total.rejected ++;
+            interval.rejected ++;
+            return TILE_BUSY;
+        }
+
+        job.reset(new Job());
+        job->key = key;
+        job->view = view;
+        job->done = false;
+
+        pending[key] = job;
+        queue.push_back(job);
+        jobQueued.notify_one();
+    }
+
+    waiting ++;
+    while ( !job->done )
+        jobDone.wait(lock);
+    waiting --;
+
+    // the destructor waits for the last one
+    if ( quit )
+    {
+        jobDone.notify_all();
+        return TILE_FAILED;
+    }
+
+    png = job->png;
+    total.requests ++;
+    interval.requests ++;
+    return png ? TILE_OK : TILE_FAILED;
+}
+
+void TileService::AddLatency(double seconds)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    total.latency.Add(seconds);
+    interval.latency.Add(seconds);
+}
+
+TileServiceStats TileService::TotalStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    TileServiceStats stats = total;
+    stats.seconds = Now() - startSeconds;
+    return stats;
+}
+
+TileServiceStats TileService::TakeIntervalStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    double now = Now();
+    TileServiceStats stats = interval;
+    stats.seconds = now - intervalStartSeconds;
+
+    interval = TileServiceStats();
+    intervalStartSeconds = now;
+    return stats;
+}
+
+int TileService::QueueLength() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return int(queue.size());
+}
+
+double TileService::Now() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TileService::WorkerLoop()
+{
+    std::vector<unsigned char> rgba(size_t(tileSize) * tileSize * 4);
+
+    for ( ;; )
+    {
+        JobPointer job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while ( !quit && queue.empty() )
+                jobQueued.wait(lock);
+            if ( quit )
+                return;
+
+            job = queue.front();
+            queue.pop_front();
+        }
+
+        // one tile per worker, the tiles of a map view come in parallel
+        FractalBuffer buffer(tileSize, tileSize, &rgba[0], 0, 0);
+        engine.Render(job->view, buffer);
+
+        std::shared_ptr<std::vector<unsigned char> > png(new std::vector<unsigned char>());
+        if ( !EncodePng(&rgba[0], tileSize, tileSize, *png) )
+            png.reset();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->png = png;
+            job->done = true;
+            pending.erase(job->key);
+            total.rendered ++;
+            interval.rendered ++;
+        }
+        jobDone.notify_all();
+    }
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TILESERVICE_H
+#define TILESERVICE_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mandelbrotengine.h"
+
+class MandelbrotPalette;
+
+// request latencies in buckets of about 5%, from 10 us up to 100 s
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void Add(double seconds);
+    void Add(const LatencyHistogram& other);
+    void Clear();
+
+    long long Count() const { return count; }
+
+    // upper end of the bucket holding the fraction p of the samples,
+    // 0 if there are none
+    double Percentile(double p) const;
+
+private:
+    enum { BUCKETS = 330 };
+
+    long long buckets[BUCKETS];
+    long long count;
+};
+
+// counters of the tile service
+struct TileServiceStats
+{
+    TileServiceStats();
+
+    long long requests;     // tiles handed out
+    long long rendered;     // tiles rendered
+    long long coalesced;    // requests that got the tile of a request rendering it already
+    long long rejected;     // requests turned away with a full queue
+    double seconds;         // time the counters cover
+    LatencyHistogram latency;
+
+    double TilesPerSecond() const { return seconds > 0.0 ? double(requests) / seconds : 0.0; }
+};
+
+// renders map tiles as png on a pool of workers
+//
+// the tiles follow the xyz scheme of slippy maps: zoom level z has 2^z x
+// 2^z tiles, x to the right and y downwards, and level 0 is one tile over
+// the square [-2.5, 1.5] x [-2, 2]. A tile is the MandelbrotView of the
+// widget at scale 2^z, so it looks like the widget at the same zoom.
+//
+// requests for a tile that is being rendered wait for that one instead of
+// rendering it again. New tiles go into a queue of limited length, once
+// it is full requests are turned away at once instead of piling up; the
+// caller answers them with a retry later.
+//
+// GetTile() may be called from any number of threads
+class TileService
+{
+public:
+    enum Status
+    {
+        TILE_OK = 0,
+        TILE_OUT_OF_RANGE = 1,  // no such tile, or beyond double precision
+        TILE_BUSY = 2,          // the queue is full
+        TILE_FAILED = 3         // the png could not be encoded, or the service shut down
+    };
+
+    typedef std::shared_ptr<const std::vector<unsigned char> > PngPointer;
+
+    // 0 threads means one per hardware thread
+    TileService(int threadCount = 0, int queueLimit = 64, int tileSize = 256);
+    ~TileService();
+
+    void SetPalette(const MandelbrotPalette* palette);
+
+    // iteration limit of all tiles, 0 for the one of the widget at the
+    // tile's scale
+    void SetMaxIterations(int maxIterations);
+
+    int ThreadCount() const { return int(workers.size()); }
+    int QueueLimit() const { return queueLimit; }
+    int TileSize() const { return tileSize; }
+
+    // view of a tile, false if there is no such tile
+    bool TileView(int zoom, long long x, long long y, int maxIterations, MandelbrotView& view) const;
+
+    // the iteration limit of the widget for a zoom level
+    static int DefaultIterations(int zoom);
+
+    // blocks until the tile is rendered, maxIterations 0 for the default;
+    // the destructor lets the callers that still wait go with TILE_FAILED
+    Status GetTile(int zoom, long long x, long long y, int maxIterations, PngPointer& png);
+
+    // adds the time a request took to answer, as the caller measured it
+    void AddLatency(double seconds);
+
+    // counters since the service started, and since the last call of
+    // TakeIntervalStats()
+    TileServiceStats TotalStats() const;
+    TileServiceStats TakeIntervalStats();
+
+    int QueueLength() const;
+
+private:
+    TileService(const TileService&);
+    TileService& operator=(const TileService&);
+
+    struct TileKey
+    {
+        int zoom;
+        long long x;
+        long long y;
+        int maxIterations;
+
+        bool operator==(const TileKey& other) const;
+    };
+
+    struct TileKeyHash
+    {
+        size_t operator()(const TileKey& key) const;
+    };
+
+    struct Job
+    {
+        TileKey key;
+        MandelbrotView view;
+        PngPointer png;
+        bool done;
+    };
+
+    typedef std::shared_ptr<Job> JobPointer;
+
+    void WorkerLoop();
+    double Now() const;
+
+    MandelbrotEngine engine;
+    int tileSize;
+    int queueLimit;
+    int fixedIterations;
+
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable jobQueued;
+    std::condition_variable jobDone;
+    std::deque<JobPointer> queue;
+    std::unordered_map<TileKey, JobPointer, TileKeyHash> pending;
+    int waiting;            // callers of GetTile() waiting for a job
+    bool quit;
+
+    TileServiceStats total;
+    TileServiceStats interval;
+    double startSeconds;
+    double intervalStartSeconds;
+};
+
+#endif // TILESERVICE_H
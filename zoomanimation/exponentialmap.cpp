@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "exponentialmap.h"
+#include "mandelbrotkernel.h"
+#include "mandelbrotpalette.h"
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+static const double PI = 3.14159265358979323846;
+
+// innermost ring a frame reads, in pixels from the center
+static const double MIN_RADIUS = 0.5;
+
+// strip rows per scheduler tile
+static const int TILE_ROWS = 16;
+
+// secondary references per band, glitches left after them stay as they are
+static const int MAX_REFERENCES = 8;
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+ExponentialMapStats::ExponentialMapStats()
+{
+    bands = 0;
+    samples = 0;
+    deepSamples = 0;
+    glitchedSamples = 0;
+    references = 0;
+    stripSeconds = 0.0;
+    resampleSeconds = 0.0;
+}
+
+void ExponentialMapStats::Add(const ExponentialMapStats& other)
+{
+    bands += other.bands;
+    samples += other.samples;
+    deepSamples += other.deepSamples;
+    glitchedSamples += other.glitchedSamples;
+    references += other.references;
+    stripSeconds += other.stripSeconds;
+    resampleSeconds += other.resampleSeconds;
+}
+
+ExponentialMap::ExponentialMap(int threadCount)
+    : scheduler(threadCount)
+{
+    palette = 0;
+    kernels = GetEscapeKernels(DetectSimdLevel());
+
+    frameWidth = 0;
+    frameHeight = 0;
+    firstFrame = 0;
+    halfDiagonal = 0.0;
+    columns = 0;
+    rows = 0;
+    step = 0.0;
+    outerRadius = 0.0;
+    maxIterations = 0;
+    firstBand = 0;
+}
+
+void ExponentialMap::SetPalette(const MandelbrotPalette* palette)
+{
+    this->palette = palette;
+    perturbation.SetPalette(palette);
+}
+
+bool ExponentialMap::Setup(const KeyframePath& path, int firstFrame, int endFrame, int width, int height, std::string& error)
+{
+    if ( endFrame <= firstFrame || width <= 0 || height <= 0 )
+    {
+        error = "no frames to render";
+        return false;
+    }
+
+    frameWidth = width;
+    frameHeight = height;
+    this->firstFrame = firstFrame;
+    halfDiagonal = 0.5 * sqrt(double(width) * width + double(height) * height);
+
+    // a sample per pixel on the ring through the corners, the mip levels
+    // halve the columns down to the last one
+    int alignment = 1 << (MIP_LEVELS - 1);
+    columns = (int(ceil(2.0 * PI * halfDiagonal)) + alignment - 1) / alignment * alignment;
+    step = 2.0 * PI / columns;
+
+    frameScales.clear();
+    frameRotations.clear();
+    frameIterations.clear();
+    frameRows.clear();
+
+    MandelbrotView last;
+    for ( int frame = firstFrame; frame < endFrame; frame ++)
+    {
+        MandelbrotView view = path.View(frame, width, height);
+        if ( !frameScales.empty() && view.scale < frameScales.back() )
+        {
+            char message[128];
+            snprintf(message, sizeof(message), "the scale goes down at frame %d, the exponential map only zooms in", frame);
+            error = message;
+            return false;
+        }
+
+        frameScales.push_back(view.scale);
+        frameRotations.push_back(view.rotation);
+        frameIterations.push_back(view.maxIterations);
+        frameRows.push_back(log(view.scale / frameScales[0]) / step);
+        last = view;
+    }
+
+    centerX = last.PreciseCenterX();
+    centerY = last.PreciseCenterY();
+    maxIterations = *std::max_element(frameIterations.begin(), frameIterations.end());
+    outerRadius = halfDiagonal * 4.0 / (frameScales[0] * double(height));
+
+    // the last frame reads down to MIN_RADIUS, plus a row for the filter
+    int lastRow = int(ceil(frameRows.back() + log(halfDiagonal / MIN_RADIUS) / step)) + 1;
+    rows = (lastRow / BAND_ROWS + 1) * BAND_ROWS;
+
+    cosTable.resize(columns);
+    sinTable.resize(columns);
+    for ( int column = 0; column < columns; column ++)
+    {
+        cosTable[column] = cos(column * step);
+        sinTable[column] = sin(column * step);
+    }
+
+    // a pixel covers 1 / (radius * step) samples each way
+    pixelColumns.resize(size_t(width) * height);
+    pixelRows.resize(size_t(width) * height);
+    pixelLevels.resize(size_t(width) * height);
+    for ( int y = 0; y < height; y ++)
+    {
+        for ( int x = 0; x < width; x ++)
+        {
+            // offset from the center, y up like in ViewTransform
+            double dx = x + 0.5 - 0.5 * width;
+            double dy = 0.5 * height - (y + 0.5);
+            double radius = std::max(sqrt(dx * dx + dy * dy), MIN_RADIUS);
+            double level = -log(radius * step) / log(2.0);
+
+            size_t pixel = size_t(y) * width + x;
+            pixelColumns[pixel] = atan2(dy, dx) / step;
+            pixelRows[pixel] = log(halfDiagonal / radius) / step;
+            pixelLevels[pixel] = float(std::min(std::max(level, 0.0), double(MIP_LEVELS - 1)));
+        }
+    }
+
+    orbit = ReferenceOrbit();
+    bands.clear();
+    firstBand = 0;
+    return true;
+}
+
+double ExponentialMap::RowRadius(int row) const
+{
+    return outerRadius * exp(-double(row) * step);
+}
+
+int ExponentialMap::RowIterations(int row) const
+{
+    std::vector<double>::const_iterator next = std::upper_bound(frameRows.begin(), frameRows.end(), double(row));
+    if ( next == frameRows.begin() )
+        return frameIterations.front();
+    if ( next == frameRows.end() )
+        return frameIterations.back();
+
+    size_t frame = size_t(next - frameRows.begin());
+    double t = (double(row) - frameRows[frame - 1]) / (frameRows[frame] - frameRows[frame - 1]);
+    return int(frameIterations[frame - 1] + (frameIterations[frame] - frameIterations[frame - 1]) * t + 0.5);
+}
+
+void ExponentialMap::RenderBands(int lastBand, ExponentialMapStats& stats)
+{
+    int nextBand = firstBand + int(bands.size());
+    lastBand = std::min(lastBand, rows / BAND_ROWS - 1);
+    if ( lastBand < nextBand )
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const int bandCount = lastBand - nextBand + 1;
+    const size_t bandSamples = size_t(columns) * BAND_ROWS;
+    std::vector<unsigned char> glitched(bandSamples * bandCount);
+
+    for ( int band = nextBand; band <= lastBand; band ++)
+    {
+        bands.push_back(StripBand());
+        bands.back().index = band;
+        for ( int level = 0; level < MIP_LEVELS; level ++)
+            bands.back().levels[level].resize(size_t(columns >> level) * (BAND_ROWS >> level));
+    }
+
+    // the new bands are written in place
+    std::vector<float*> bandSmooth(bandCount);
+    for ( int band = 0; band < bandCount; band ++)
+        bandSmooth[band] = &bands[nextBand + band - firstBand].levels[0][0];
+
+    // rows past double precision iterate against the zoom point
+    if ( orbit.zx.empty() && RowRadius((lastBand + 1) * BAND_ROWS - 1) * step < PERTURBATION_PIXEL_SIZE )
+    {
+        perturbation.ComputeReference(centerX, centerY, maxIterations, orbit);
+        stats.references ++;
+    }
+
+    const double centerDoubleX = centerX.ToDouble();
+    const double centerDoubleY = centerY.ToDouble();
+
+    std::vector<RenderTile> tiles;
+    for ( int local = 0; local < bandCount * BAND_ROWS; local += TILE_ROWS)
+    {
+        RenderTile tile = { 0, local, columns, TILE_ROWS };
+        tiles.push_back(tile);
+    }
+
+    std::vector<long long> workerDeep(scheduler.ThreadCount());
+    std::vector<long long> workerGlitched(scheduler.ThreadCount());
+
+    scheduler.Run(tiles, [&](const RenderTile& tile, int worker)
+    {
+        std::vector<double> packedX(columns), packedY(columns), packedNorm2(columns);
+        std::vector<int> packedColumn(columns), packedIterations(columns);
+        std::vector<float> packedSmooth(columns);
+        std::vector<unsigned char> packedGlitched(columns);
+
+        for ( int local = tile.y; local < tile.y + tile.height; local ++)
+        {
+            int row = nextBand * BAND_ROWS + local;
+            double radius = RowRadius(row);
+            int limit = RowIterations(row);
+            bool deep = radius * step < PERTURBATION_PIXEL_SIZE;
+            float* rowSmooth = bandSmooth[local / BAND_ROWS] + size_t(local % BAND_ROWS) * columns;
+            unsigned char* rowGlitched = &glitched[size_t(local) * columns];
+
+            int count = 0;
+            for ( int column = 0; column < columns; column ++)
+            {
+                double dx = radius * cosTable[column];
+                double dy = radius * sinTable[column];
+                rowGlitched[column] = 0;
+
+                if ( IsInCardioidOrBulb(centerDoubleX + dx, centerDoubleY + dy) )
+                {
+                    rowSmooth[column] = float(limit);
+                    continue;
+                }
+
+                packedX[count] = deep ? dx : centerDoubleX + dx;
+                packedY[count] = deep ? dy : centerDoubleY + dy;
+                packedColumn[count] = column;
+                count ++;
+            }
+
+            if ( count == 0 )
+                continue;
+
+            if ( deep )
+            {
+                perturbation.IteratePoints(orbit, &packedX[0], &packedY[0], count, limit,
+                                           &packedIterations[0], &packedSmooth[0], &packedGlitched[0]);
+                for ( int i = 0; i < count; i ++)
+                {
+                    rowSmooth[packedColumn[i]] = packedSmooth[i];
+                    rowGlitched[packedColumn[i]] = packedGlitched[i];
+                    workerGlitched[worker] += packedGlitched[i];
+                }
+                workerDeep[worker] += columns;
+            }
+            else
+            {
+                double epsilon = PeriodicityEpsilon(radius * step);
+                kernels.escapeDouble(&packedX[0], &packedY[0], count, limit, epsilon * epsilon,
+                                     &packedIterations[0], &packedNorm2[0], 0, 0);
+                for ( int i = 0; i < count; i ++)
+                    rowSmooth[packedColumn[i]] = SmoothIteration(packedIterations[i], packedNorm2[i], limit);
+            }
+        }
+    });
+
+    for ( size_t i = 0; i < workerDeep.size(); i ++)
+    {
+        stats.deepSamples += workerDeep[i];
+        stats.glitchedSamples += workerGlitched[i];
+    }
+
+    // glitches of a band get secondary references, each at the glitched
+    // sample closest to the centroid of those that are left
+    std::vector<double> packedX(columns), packedY(columns);
+    std::vector<int> packedColumn(columns), packedIterations(columns);
+    std::vector<float> packedSmooth(columns);
+    std::vector<unsigned char> packedGlitched(columns);
+    for ( int band = 0; band < bandCount; band ++)
+    {
+        float* smooth = bandSmooth[band];
+        unsigned char* bandGlitched = &glitched[bandSamples * band];
+        int bandRow = (nextBand + band) * BAND_ROWS;
+
+        for ( int pass = 0; pass < MAX_REFERENCES; pass ++)
+        {
+            long long glitchCount = 0;
+            double sumX = 0.0;
+            double sumY = 0.0;
+            for ( int local = 0; local < BAND_ROWS; local ++)
+            {
+                double radius = RowRadius(bandRow + local);
+                for ( int column = 0; column < columns; column ++)
+                {
+                    if ( bandGlitched[size_t(local) * columns + column] )
+                    {
+                        glitchCount ++;
+                        sumX += radius * cosTable[column];
+                        sumY += radius * sinTable[column];
+                    }
+                }
+            }
+
+            if ( glitchCount == 0 )
+                break;
+
+            double centroidX = sumX / double(glitchCount);
+            double centroidY = sumY / double(glitchCount);
+            double referenceX = 0.0;
+            double referenceY = 0.0;
+            double bestDistance = -1.0;
+            int bestRow = bandRow;
+            for ( int local = 0; local < BAND_ROWS; local ++)
+            {
+                double radius = RowRadius(bandRow + local);
+                for ( int column = 0; column < columns; column ++)
+                {
+                    if ( !bandGlitched[size_t(local) * columns + column] )
+                        continue;
+
+                    double dx = radius * cosTable[column];
+                    double dy = radius * sinTable[column];
+                    double distance = (dx - centroidX) * (dx - centroidX) + (dy - centroidY) * (dy - centroidY);
+                    if ( bestDistance < 0.0 || distance < bestDistance )
+                    {
+                        bestDistance = distance;
+                        referenceX = dx;
+                        referenceY = dy;
+                        bestRow = bandRow + local;
+                    }
+                }
+            }
+
+            int bits = BigFloat::BitsForPixelSize(RowRadius(bestRow) * step);
+            ReferenceOrbit secondary;
+            perturbation.ComputeReference(centerX + BigFloat(referenceX, bits), centerY + BigFloat(referenceY, bits),
+                                          RowIterations(bandRow + BAND_ROWS - 1), secondary);
+            stats.references ++;
+
+            for ( int local = 0; local < BAND_ROWS; local ++)
+            {
+                int row = bandRow + local;
+                double radius = RowRadius(row);
+                int count = 0;
+                for ( int column = 0; column < columns; column ++)
+                {
+                    if ( !bandGlitched[size_t(local) * columns + column] )
+                        continue;
+
+                    packedX[count] = radius * cosTable[column] - referenceX;
+                    packedY[count] = radius * sinTable[column] - referenceY;
+                    packedColumn[count] = column;
+                    count ++;
+                }
+
+                if ( count == 0 )
+                    continue;
+
+                int limit = RowIterations(row);
+                perturbation.IteratePoints(secondary, &packedX[0], &packedY[0], count, limit,
+                                           &packedIterations[0], &packedSmooth[0], &packedGlitched[0]);
+                for ( int i = 0; i < count; i ++)
+                {
+                    size_t offset = size_t(local) * columns + packedColumn[i];
+                    smooth[offset] = packedSmooth[i];
+                    bandGlitched[offset] = packedGlitched[i];
+                }
+            }
+        }
+    }
+
+    std::vector<RenderTile> bandTiles;
+    for ( int band = 0; band < bandCount; band ++)
+    {
+        RenderTile tile = { band, 0, 1, 1 };
+        bandTiles.push_back(tile);
+    }
+
+    scheduler.Run(bandTiles, [&](const RenderTile& tile, int)
+    {
+        StripBand& strip = bands[nextBand + tile.x - firstBand];
+        for ( int level = 1; level < MIP_LEVELS; level ++)
+        {
+            int levelColumns = columns >> level;
+            int levelRows = BAND_ROWS >> level;
+            const float* source = &strip.levels[level - 1][0];
+            float* target = &strip.levels[level][0];
+            for ( int row = 0; row < levelRows; row ++)
+            {
+                const float* top = source + size_t(2 * row) * (2 * levelColumns);
+                const float* bottom = top + 2 * levelColumns;
+                for ( int column = 0; column < levelColumns; column ++, top += 2, bottom += 2)
+                    *target ++ = 0.25f * (top[0] + top[1] + bottom[0] + bottom[1]);
+            }
+        }
+    });
+
+    stats.bands += bandCount;
+    stats.samples += (long long)(bandSamples) * bandCount;
+    stats.stripSeconds += SecondsSince(start);
+}
+
+void ExponentialMap::UpdateRows()
+{
+    for ( int level = 0; level < MIP_LEVELS; level ++)
+    {
+        int levelRows = BAND_ROWS >> level;
+        int levelColumns = columns >> level;
+        rowPointers[level].resize(bands.size() * levelRows);
+        for ( size_t band = 0; band < bands.size(); band ++)
+        {
+            for ( int row = 0; row < levelRows; row ++)
+                rowPointers[level][band * levelRows + row] = &bands[band].levels[level][size_t(row) * levelColumns];
+        }
+    }
+}
+
+const float* ExponentialMap::Row(int level, int row) const
+{
+    const std::vector<const float*>& pointers = rowPointers[level];
+    int index = row - (firstBand << (BAND_SHIFT - level));
+    index = std::min(std::max(index, 0), int(pointers.size()) - 1);
+    return pointers[index];
+}
+
+float ExponentialMap::SampleBilinear(int level, double column, double row) const
+{
+    // sample k of a level covers the level 0 samples [k, k + 1) * 2^level
+    int levelColumns = columns >> level;
+    double levelScale = 1.0 / double(1 << level);
+    double u = (column + 0.5) * levelScale - 0.5;
+    if ( u < 0.0 )
+        u += levelColumns;
+    else if ( u >= levelColumns )
+        u -= levelColumns;
+    double v = (row + 0.5) * levelScale - 0.5;
+    double v0 = floor(v);
+    int left = std::min(int(u), levelColumns - 1);
+    int right = left + 1 < levelColumns ? left + 1 : 0;
+    float fu = float(u - left);
+    float fv = float(v - v0);
+
+    const float* upper = Row(level, int(v0));
+    const float* lower = Row(level, int(v0) + 1);
+    float topLeft = upper[left];
+    float topRight = upper[right];
+    float bottomLeft = lower[left];
+    float bottomRight = lower[right];
+    float top = topLeft + (topRight - topLeft) * fu;
+    float bottom = bottomLeft + (bottomRight - bottomLeft) * fu;
+    return top + (bottom - top) * fv;
+}
+
+void ExponentialMap::RenderFrame(int frame, unsigned char* rgba, ExponentialMapStats* stats)
+{
+    ExponentialMapStats frameStats;
+    int index = std::min(std::max(frame - firstFrame, 0), int(frameScales.size()) - 1);
+    const double edgeRow = frameRows[index];
+    const double rotation = frameRotations[index];
+    const int limit = frameIterations[index];
+
+    // bands the frame edge has passed are not needed any more
+    int firstRow = std::max(int(floor(edgeRow)) - 1, 0);
+    while ( !bands.empty() && (firstBand + 1) * BAND_ROWS <= firstRow )
+    {
+        bands.pop_front();
+        firstBand ++;
+    }
+    if ( bands.empty() )
+        firstBand = firstRow / BAND_ROWS;
+
+    int lastRow = int(ceil(edgeRow + log(halfDiagonal / MIN_RADIUS) / step)) + 1;
+    RenderBands(lastRow / BAND_ROWS, frameStats);
+    UpdateRows();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    // the pixel columns are within half a turn of 0, this keeps them
+    // within a turn of [0, columns)
+    const double rotationColumns = fmod(rotation / step, double(columns)) + (rotation < 0.0 ? columns : 0);
+
+    scheduler.Run(frameWidth, frameHeight, [&](const RenderTile& tile, int)
+    {
+        for ( int y = tile.y; y < tile.y + tile.height; y ++)
+        {
+            unsigned char* target = rgba + (size_t(y) * frameWidth + tile.x) * 4;
+            for ( int x = tile.x; x < tile.x + tile.width; x ++, target += 4)
+            {
+                size_t pixel = size_t(y) * frameWidth + x;
+                double column = pixelColumns[pixel] + rotationColumns;
+                double row = edgeRow + pixelRows[pixel];
+                int level = int(pixelLevels[pixel]);
+                float blend = pixelLevels[pixel] - float(level);
+
+                float smooth = SampleBilinear(level, column, row);
+                if ( blend > 0.0f && level + 1 < MIP_LEVELS )
+                    smooth += (SampleBilinear(level + 1, column, row) - smooth) * blend;
+
+                // the row may have gone on past the limit of this frame
+                ColorizeIteration(palette, std::min(smooth, float(limit)), limit, target);
+            }
+        }
+    });
+
+    frameStats.resampleSeconds = SecondsSince(start);
+    if ( stats )
+        stats->Add(frameStats);
+}
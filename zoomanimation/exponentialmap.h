@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPONENTIALMAP_H
+#define EXPONENTIALMAP_H
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "keyframepath.h"
+#include "perturbationrenderer.h"
+#include "tilescheduler.h"
+
+class MandelbrotPalette;
+
+// counters of ExponentialMap::RenderFrame() calls
+struct ExponentialMapStats
+{
+    ExponentialMapStats();
+    void Add(const ExponentialMapStats& other);
+
+    int bands;                  // strip bands rendered
+    long long samples;          // strip samples rendered
+    long long deepSamples;      // of those through the perturbation renderer
+    long long glitchedSamples;  // samples the primary reference could not resolve
+    int references;             // arbitrary precision orbits, the primary one included
+    double stripSeconds;        // rendering the strip
+    double resampleSeconds;     // frames out of the strip
+};
+
+// zoom video out of one log-polar strip
+//
+// a zoom into a fixed point shows the same rings around it in every frame,
+// only at another size. The strip samples the plane around the point at
+//
+//      c = center + r0 * exp(-row * step) * (cos(column * step), sin(column * step))
+//
+// with step = 2 pi / columns: a row goes once around and every row is a
+// factor exp(step) deeper than the one before, so a sample is as high as it
+// is wide. A frame is a window of rows, from the ring through its corners
+// down to half a pixel around the center, and its rotation a shift of the
+// columns; every point of the zoom is rendered once instead of in every
+// frame it shows up in. Closer to the center an image pixel covers more
+// samples, the strip is mip-mapped for that.
+//
+// a row is iterated up to the limit of the deepest frame that shows it and
+// keeps the continuous iteration count, every frame is colored with its
+// own limit afterwards; apart from the filtering a frame looks the same
+// as rendered on its own.
+//
+// there are enough columns to give the ring through the frame corners a
+// sample per pixel. The strip is rendered in bands of rows as the frames
+// need them and dropped once the frame edge has passed, it takes about the
+// memory of the rows one frame covers, log(half diagonal / 0.5) / step.
+class ExponentialMap
+{
+public:
+    // 0 threads means one per hardware thread
+    ExponentialMap(int threadCount = 0);
+
+    void SetPalette(const MandelbrotPalette* palette);
+
+    // prepares frames [firstFrame, endFrame) of the path at width x height,
+    // false if the path is not a zoom in. The zoom goes into the center of
+    // the last frame, the centers of the others are ignored
+    bool Setup(const KeyframePath& path, int firstFrame, int endFrame, int width, int height, std::string& error);
+
+    int StripColumns() const { return columns; }
+    int StripRows() const { return rows; }
+
+    // renders a frame of the path into width x height RGBA pixels, the
+    // frames have to come in order; the counters are added to stats
+    void RenderFrame(int frame, unsigned char* rgba, ExponentialMapStats* stats = 0);
+
+private:
+    // level k has 1 / 2^k of the columns and rows of level 0
+    static const int MIP_LEVELS = 9;
+
+    // rows per band, a multiple of 2^(MIP_LEVELS - 1) like the columns
+    static const int BAND_SHIFT = 8;
+    static const int BAND_ROWS = 1 << BAND_SHIFT;
+
+    struct StripBand
+    {
+        int index;
+        std::vector<float> levels[MIP_LEVELS];  // continuous iteration count
+    };
+
+    // renders the bands up to and including lastBand
+    void RenderBands(int lastBand, ExponentialMapStats& stats);
+
+    // iteration limit of a strip row, that of the frame whose corners it
+    // passes; the frames before show it closer to the center with less
+    int RowIterations(int row) const;
+
+    // radius of strip row
+    double RowRadius(int row) const;
+
+    // row of a mip level, clamped to the bands there are
+    void UpdateRows();
+    const float* Row(int level, int row) const;
+
+    // the columns wrap around
+    float SampleBilinear(int level, double column, double row) const;
+
+    const MandelbrotPalette* palette;
+    TileScheduler scheduler;
+    PerturbationRenderer perturbation;
+    EscapeKernels kernels;
+
+    int frameWidth;
+    int frameHeight;
+    int firstFrame;
+    double halfDiagonal;        // pixels
+    int columns;
+    int rows;
+    double step;                // radians per column, log radius per row
+    double outerRadius;         // radius of row 0
+
+    BigFloat centerX;           // zoom point
+    BigFloat centerY;
+    ReferenceOrbit orbit;       // at the zoom point, once a band needs it
+    int maxIterations;
+
+    // per frame of the path from firstFrame on
+    std::vector<double> frameScales;
+    std::vector<double> frameRotations;
+    std::vector<int> frameIterations;
+    std::vector<double> frameRows;  // strip row of the frame corners
+
+    std::vector<double> cosTable;
+    std::vector<double> sinTable;
+
+    // per image pixel, the same for every frame: strip column at rotation
+    // 0, strip row below the frame corners and mip level
+    std::vector<double> pixelColumns;
+    std::vector<double> pixelRows;
+    std::vector<float> pixelLevels;
+
+    std::deque<StripBand> bands;    // bands firstBand, firstBand + 1, ...
+    int firstBand;
+    std::vector<const float*> rowPointers[MIP_LEVELS];
+};
+
+#endif // EXPONENTIALMAP_H
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyframepath.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+// the widget starts at INIT_ITERATION and adds as much for every
+// scale factor of LOG_BASE beyond that (AutoIterations() in MandelGLWidget.cpp)
+static const double INIT_ITERATION = 64.0;
+static const double LOG_BASE = 8.0;
+
+// the centers are read with the bits a frame of this height needs at the
+// scale of the keyframe
+static const int MAX_FRAME_HEIGHT = 16384;
+
+// the weight of the center gets this many bits beyond those of the view
+static const int WEIGHT_GUARD_BITS = 64;
+
+Keyframe::Keyframe()
+{
+    frame = 0;
+    centerX = BigFloat(-0.5);
+    centerY = BigFloat(0.0);
+    scale = 0.8;
+    rotation = 0.0;
+    maxIterations = 0;
+}
+
+KeyframePath::KeyframePath()
+{
+}
+
+bool KeyframePath::Parse(const std::string& text, std::string& error)
+{
+    std::vector<Keyframe> parsed;
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+    while ( std::getline(lines, line) )
+    {
+        lineNumber ++;
+        size_t comment = line.find('#');
+        if ( comment != std::string::npos )
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        std::vector<std::string> values;
+        std::string value;
+        while ( fields >> value )
+            values.push_back(value);
+        if ( values.empty() )
+            continue;
+
+        std::ostringstream where;
+        where << "line " << lineNumber << ": ";
+
+        Keyframe keyframe;
+        char* end = 0;
+        if ( values.size() < 4 || values.size() > 6 )
+        {
+            error = where.str() + "expected frame centerX centerY scale [rotation [iterations]]";
+            return false;
+        }
+
+        keyframe.frame = int(strtol(values[0].c_str(), &end, 10));
+        if ( *end != '\0' || keyframe.frame < 0 )
+        {
+            error = where.str() + "bad frame number " + values[0];
+            return false;
+        }
+        if ( !parsed.empty() && keyframe.frame <= parsed.back().frame )
+        {
+            error = where.str() + "frame numbers have to go up";
+            return false;
+        }
+
+        keyframe.scale = strtod(values[3].c_str(), &end);
+        if ( *end != '\0' || !(keyframe.scale > 0.0) || keyframe.scale > 1e300 )
+        {
+            error = where.str() + "bad scale " + values[3];
+            return false;
+        }
+
+        int bits = BigFloat::BitsForPixelSize(4.0 / (keyframe.scale * MAX_FRAME_HEIGHT));
+        if ( !BigFloat::FromString(values[1], bits, keyframe.centerX) ||
+             !BigFloat::FromString(values[2], bits, keyframe.centerY) )
+        {
+            error = where.str() + "bad center " + values[1] + " " + values[2];
+            return false;
+        }
+
+        if ( values.size() > 4 )
+        {
+            keyframe.rotation = strtod(values[4].c_str(), &end);
+            if ( *end != '\0' )
+            {
+                error = where.str() + "bad rotation " + values[4];
+                return false;
+            }
+        }
+
+        if ( values.size() > 5 )
+        {
+            keyframe.maxIterations = int(strtol(values[5].c_str(), &end, 10));
+            if ( *end != '\0' || keyframe.maxIterations <= 0 )
+            {
+                error = where.str() + "bad iteration limit " + values[5];
+                return false;
+            }
+        }
+
+        parsed.push_back(keyframe);
+    }
+
+    if ( parsed.empty() )
+    {
+        error = "no keyframes";
+        return false;
+    }
+
+    keyframes.swap(parsed);
+    return true;
+}
+
+bool KeyframePath::Load(const std::string& path, std::string& error)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if ( !file )
+    {
+        error = "could not open " + path;
+        return false;
+    }
+
+    std::string text;
+    char chunk[4096];
+    size_t read;
+    while ( (read = fread(chunk, 1, sizeof(chunk), file)) > 0 )
+        text.append(chunk, read);
+    fclose(file);
+
+    return Parse(text, error);
+}
+
+int KeyframePath::FrameCount() const
+{
+    return keyframes.empty() ? 0 : keyframes.back().frame + 1;
+}
+
+int KeyframePath::AutoIterations(double scale)
+{
+    return int((scale < LOG_BASE ? 1.0 : log(scale) / log(LOG_BASE)) * INIT_ITERATION + 0.5);
+}
+
+MandelbrotView KeyframePath::View(int frame, int width, int height) const
+{
+    MandelbrotView view;
+    view.width = width;
+    view.height = height;
+    if ( keyframes.empty() )
+        return view;
+
+    size_t next = 0;
+    while ( next < keyframes.size() && keyframes[next].frame <= frame )
+        next ++;
+
+    const Keyframe& a = keyframes[next > 0 ? next - 1 : 0];
+    const Keyframe& b = keyframes[next < keyframes.size() ? next : keyframes.size() - 1];
+    double t = b.frame > a.frame ? double(frame - a.frame) / double(b.frame - a.frame) : 0.0;
+    if ( t <= 0.0 )
+        t = 0.0;
+
+    BigFloat centerX;
+    BigFloat centerY;
+    if ( t == 0.0 )
+    {
+        view.scale = a.scale;
+        centerX = a.centerX;
+        centerY = a.centerY;
+    }
+    else
+    {
+        view.scale = exp(log(a.scale) + (log(b.scale) - log(a.scale)) * t);
+
+        int bits = BigFloat::BitsForPixelSize(4.0 / (view.scale * double(height))) + WEIGHT_GUARD_BITS;
+        if ( a.scale == b.scale )
+        {
+            centerX = a.centerX + (b.centerX - a.centerX) * BigFloat(t, bits);
+            centerY = a.centerY + (b.centerY - a.centerY) * BigFloat(t, bits);
+        }
+        else
+        {
+            // share of the way that is left to the deeper keyframe, small
+            // numbers near it keep their precision this way round
+            const Keyframe& deep = b.scale > a.scale ? b : a;
+            const Keyframe& shallow = b.scale > a.scale ? a : b;
+            double left = (1.0 / view.scale - 1.0 / deep.scale) / (1.0 / shallow.scale - 1.0 / deep.scale);
+            centerX = deep.centerX + (shallow.centerX - deep.centerX) * BigFloat(left, bits);
+            centerY = deep.centerY + (shallow.centerY - deep.centerY) * BigFloat(left, bits);
+        }
+    }
+
+    // not more bits than the frame needs, the reference orbit costs per bit
+    int bits = BigFloat::BitsForPixelSize(view.PixelSize());
+    if ( centerX.FractionBits() > bits )
+        centerX.SetFractionBits(bits);
+    if ( centerY.FractionBits() > bits )
+        centerY.SetFractionBits(bits);
+    view.SetCenter(centerX, centerY);
+    view.pivotX = view.centerX;
+    view.pivotY = view.centerY;
+    view.rotation = a.rotation + (b.rotation - a.rotation) * t;
+
+    if ( a.maxIterations == 0 && b.maxIterations == 0 )
+        view.maxIterations = AutoIterations(view.scale);
+    else
+    {
+        double from = a.maxIterations > 0 ? a.maxIterations : AutoIterations(a.scale);
+        double to = b.maxIterations > 0 ? b.maxIterations : AutoIterations(b.scale);
+        view.maxIterations = int(from + (to - from) * t + 0.5);
+    }
+
+    return view;
+}
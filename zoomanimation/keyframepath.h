@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYFRAMEPATH_H
+#define KEYFRAMEPATH_H
+
+#include <string>
+#include <vector>
+
+#include "bigfloat.h"
+#include "mandelbrotview.h"
+
+// view state of a zoom animation at one frame, the same values
+// MandelGLWidget keeps while zooming around
+struct Keyframe
+{
+    Keyframe();
+
+    int frame;
+    BigFloat centerX;
+    BigFloat centerY;
+    double scale;
+    double rotation;        // radian
+    int maxIterations;      // 0 = follows the scale as in the widget
+};
+
+// frames of a zoom animation between keyframes
+//
+// the scale is interpolated exponentially, so a zoom runs at the same speed
+// from start to end; the center is weighted by 1/scale, which keeps the
+// point a zoom heads for in place on screen instead of drifting past it.
+// Rotation is interpolated linearly and the iteration limit linearly in
+// log(scale), a keyframe without one gets AutoIterations() of its scale.
+class KeyframePath
+{
+public:
+    KeyframePath();
+
+    // text, one keyframe per line, '#' starts a comment:
+    //
+    //   frame  centerX  centerY  scale  [rotation  [iterations]]
+    //
+    // the frames have to go up; the centers may have any number of digits
+    bool Parse(const std::string& text, std::string& error);
+    bool Load(const std::string& path, std::string& error);
+
+    const std::vector<Keyframe>& Keyframes() const { return keyframes; }
+
+    // frames up to and including the last keyframe
+    int FrameCount() const;
+
+    // view of a frame at the given image size, frames outside the path get
+    // the nearest keyframe
+    MandelbrotView View(int frame, int width, int height) const;
+
+    // the widget's iteration limit for a scale factor
+    static int AutoIterations(double scale);
+
+private:
+    std::vector<Keyframe> keyframes;
+};
+
+#endif // KEYFRAMEPATH_H
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2012 Eric Feng
+ *
+ * This file is part of 'FractDroidGL' - an mandelbrot set rendering app for Android
+ *
+ * FractDroidGL is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FractDroidGL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// offline renderer for zoom animations
+//
+//   zoomanimation zoom.txt --size 1280 720 | ffmpeg -i - zoom.mp4
+//
+// renders every frame of a keyframe path (see KeyframePath) at a fixed size
+// and streams them as YUV4MPEG2 or raw rgb24 to stdout or a file. Whole
+// frames are rendered in parallel, one per thread, and a reorder buffer in
+// front of the writer puts them back in order; it holds a bounded number of
+// frames, threads that get too far ahead wait for the writer. Frames past
+// double precision go through the PerturbationRenderer. The time of every
+// frame and the throughput are logged to stderr.
+//
+// with --exponential-map the frames are resampled from one log-polar strip
+// of the zoom instead (see ExponentialMap), a long zoom then costs a few
+// hundred frames instead of all of them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exponentialmap.h"
+#include "keyframepath.h"
+#include "mandelbrotengine.h"
+#include "mandelbrotpalette.h"
+#include "perturbationrenderer.h"
+
+enum OutputFormat
+{
+    FORMAT_Y4M = 0,     // 4:2:0 full range BT.601, what ffmpeg reads from a pipe
+    FORMAT_RGB = 1      // rgb24, ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH
+};
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct RenderedFrame
+{
+    RenderedFrame() : seconds(0.0), deep(false), maxIterations(0), scale(0.0) {}
+
+    std::vector<unsigned char> data;    // the frame as it goes to the output
+    double seconds;                     // render and conversion time
+    bool deep;                          // went through the perturbation renderer
+    int maxIterations;
+    double scale;
+};
+
+typedef std::shared_ptr<RenderedFrame> FramePointer;
+
+// finished frames waiting for the writer
+//
+// frames are handed out in order, so the one the writer waits for is always
+// being rendered and a thread only has to wait while its frame is capacity
+// or more frames ahead of it
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(int firstFrame, int capacity)
+        : next(firstFrame), capacity(std::max(capacity, 1)), cancelled(false), peak(0) {}
+
+    // blocks until the frame may be put, false if the output went away
+    bool WaitForSlot(int frame)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while ( !cancelled && frame >= next + capacity )
+            changed.wait(lock);
+        return !cancelled;
+    }
+
+    void Put(int frame, const FramePointer& image)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames[frame] = image;
+        peak = std::max(peak, int(frames.size()));
+        changed.notify_all();
+    }
+
+    // blocks until the next frame in order is there, 0 if cancelled
+    FramePointer Take()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::map<int, FramePointer>::iterator found;
+        while ( !cancelled && (found = frames.find(next)) == frames.end() )
+            changed.wait(lock);
+        if ( cancelled )
+            return FramePointer();
+
+        FramePointer image = found->second;
+        frames.erase(found);
+        next ++;
+        changed.notify_all();
+        return image;
+    }
+
+    void Cancel()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        changed.notify_all();
+    }
+
+    // most frames that were waiting at the same time
+    int Peak()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::map<int, FramePointer> frames;
+    int next;
+    int capacity;
+    bool cancelled;
+    int peak;
+};
+
+// 2x2 blocks share their chroma, the frame size has to be even
+static void ConvertToYuv420(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& yuv)
+{
+    static const char FRAME_HEADER[] = "FRAME\n";
+    size_t headerBytes = sizeof(FRAME_HEADER) - 1;
+    size_t lumaBytes = size_t(width) * height;
+    size_t chromaBytes = lumaBytes / 4;
+    yuv.resize(headerBytes + lumaBytes + 2 * chromaBytes);
+    memcpy(&yuv[0], FRAME_HEADER, headerBytes);
+
+    unsigned char* luma = &yuv[headerBytes];
+    unsigned char* cb = luma + lumaBytes;
+    unsigned char* cr = cb + chromaBytes;
+
+    for ( int y = 0; y < height; y ++)
+    {
+        const unsigned char* source = rgba + size_t(y) * width * 4;
+        for ( int x = 0; x < width; x ++, source += 4)
+            luma[size_t(y) * width + x] = (unsigned char)(0.299f * source[0] + 0.587f * source[1] + 0.114f * source[2] + 0.5f);
+    }
+
+    for ( int y = 0; y < height / 2; y ++)
+    {
+        for ( int x = 0; x < width / 2; x ++)
+        {
+            const unsigned char* top = rgba + (size_t(2 * y) * width + 2 * x) * 4;
+            const unsigned char* bottom = top + size_t(width) * 4;
+            float r = 0.25f * (top[0] + top[4] + bottom[0] + bottom[4]);
+            float g = 0.25f * (top[1] + top[5] + bottom[1] + bottom[5]);
+            float b = 0.25f * (top[2] + top[6] + bottom[2] + bottom[6]);
+            size_t target = size_t(y) * (width / 2) + x;
+            cb[target] = (unsigned char)(std::min(std::max(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f, 0.0f), 255.0f));
+            cr[target] = (unsigned char)(std::min(std::max(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f, 0.0f), 255.0f));
+        }
+    }
+}
+
+static void ConvertToRgb(const unsigned char* rgba, int width, int height, std::vector<unsigned char>& rgb)
+{
+    size_t pixels = size_t(width) * height;
+    rgb.resize(pixels * 3);
+    for ( size_t i = 0; i < pixels; i ++)
+    {
+        rgb[i * 3 + 0] = rgba[i * 4 + 0];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+}
+
+static void ConvertFrame(OutputFormat format, const unsigned char* rgba, int width, int height, std::vector<unsigned char>& data)
+{
+    if ( format == FORMAT_Y4M )
+        ConvertToYuv420(rgba, width, height, data);
+    else
+        ConvertToRgb(rgba, width, height, data);
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr,
+            "usage: zoomanimation <keyframes> [options]\n"
+            "  keyframes: one per line, frame centerX centerY scale [rotation [iterations]]\n"
+            "  --size <width> <height>   frame size, default 1280 720\n"
+            "  --format <y4m|rgb>        output, default y4m\n"
+            "  --output <file>           default - (stdout)\n"
+            "  --fps <n>                 frame rate in the y4m header, default 30\n"
+            "  --frames <first> <count>  part of the path, default all of it\n"
+            "  --threads <n>             frames rendered at once, one per core by default\n"
+            "  --reorder <n>             frames the reorder buffer holds, default 2 per thread\n"
+            "  --exponential-map         resample the frames from one log-polar strip, the\n"
+            "                            zoom goes into the center of the last frame\n"
+            "  --palette <png>           default Resources/lookup.png of the source tree\n"
+            "  --quiet                   no line per frame\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string keyframePath;
+    int width = 1280;
+    int height = 720;
+    OutputFormat format = FORMAT_Y4M;
+    std::string outputPath = "-";
+    int fps = 30;
+    int firstFrame = 0;
+    int frameCount = -1;
+    int threads = 0;
+    int reorderFrames = 0;
+    std::string palettePath;
+    bool quiet = false;
+    bool exponentialMap = false;
+
+    for ( int i = 1; i < argc; i ++)
+    {
+        std::string argument = argv[i];
+        if ( argument == "--size" && i + 2 < argc )
+        {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        }
+        else if ( argument == "--format" && i + 1 < argc && (std::string(argv[i + 1]) == "y4m" || std::string(argv[i + 1]) == "rgb") )
+            format = std::string(argv[++i]) == "y4m" ? FORMAT_Y4M : FORMAT_RGB;
+        else if ( argument == "--output" && i + 1 < argc )
+            outputPath = argv[++i];
+        else if ( argument == "--fps" && i + 1 < argc )
+            fps = atoi(argv[++i]);
+        else if ( argument == "--frames" && i + 2 < argc )
+        {
+            firstFrame = atoi(argv[++i]);
+            frameCount = atoi(argv[++i]);
+        }
+        else if ( argument == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++i]);
+        else if ( argument == "--reorder" && i + 1 < argc )
+            reorderFrames = atoi(argv[++i]);
+        else if ( argument == "--palette" && i + 1 < argc )
+            palettePath = argv[++i];
+        else if ( argument == "--quiet" )
+            quiet = true;
+        else if ( argument == "--exponential-map" )
+            exponentialMap = true;
+        else if ( keyframePath.empty() && argument[0] != '-' )
+            keyframePath = argument;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if ( keyframePath.empty() || width <= 0 || height <= 0 || fps <= 0 )
+    {
+        PrintUsage();
+        return 1;
+    }
+    if ( format == FORMAT_Y4M && (width % 2 != 0 || height % 2 != 0) )
+    {
+        fprintf(stderr, "y4m output needs an even frame size\n");
+        return 1;
+    }
+
+    KeyframePath path;
+    std::string error;
+    if ( !path.Load(keyframePath, error) )
+    {
+        fprintf(stderr, "%s: %s\n", keyframePath.c_str(), error.c_str());
+        return 1;
+    }
+
+    int endFrame = path.FrameCount();
+    if ( frameCount >= 0 )
+        endFrame = std::min(endFrame, firstFrame + frameCount);
+    firstFrame = std::max(firstFrame, 0);
+    if ( firstFrame >= endFrame )
+    {
+        fprintf(stderr, "no frames to render, the path has %d\n", path.FrameCount());
+        return 1;
+    }
+
+    // same colors as the widget, gray scale without them
+    MandelbrotPalette palette;
+    std::string paletteFile;
+    if ( !LoadToolPalette(palette, palettePath, argv[0], paletteFile) )
+        fprintf(stderr, "could not load %s, rendering gray scale\n", paletteFile.c_str());
+
+    MandelbrotEngine engine;
+    engine.SetPalette(&palette);
+    PerturbationRenderer perturbation;
+    perturbation.SetPalette(&palette);
+
+    FILE* output = stdout;
+    if ( outputPath != "-" )
+        output = fopen(outputPath.c_str(), "wb");
+    if ( !output )
+    {
+        fprintf(stderr, "could not open %s\n", outputPath.c_str());
+        return 1;
+    }
+#if defined(_WIN32)
+    if ( output == stdout )
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    if ( threads <= 0 )
+        threads = std::max(int(std::thread::hardware_concurrency()), 1);
+    if ( !exponentialMap )
+        threads = std::min(threads, endFrame - firstFrame);
+    if ( reorderFrames <= 0 )
+        reorderFrames = 2 * threads;
+
+    std::unique_ptr<ExponentialMap> map;
+    if ( exponentialMap )
+    {
+        map.reset(new ExponentialMap(threads));
+        map->SetPalette(&palette);
+        if ( !map->Setup(path, firstFrame, endFrame, width, height, error) )
+        {
+            fprintf(stderr, "%s: %s\n", keyframePath.c_str(), error.c_str());
+            return 1;
+        }
+    }
+
+    if ( format == FORMAT_Y4M )
+        fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, fps);
+
+    if ( map )
+    {
+        fprintf(stderr, "rendering frames %d to %d of %s at %dx%d from a %dx%d strip with %d threads\n",
+                firstFrame, endFrame - 1, keyframePath.c_str(), width, height,
+                map->StripColumns(), map->StripRows(), threads);
+    }
+    else
+    {
+        fprintf(stderr, "rendering frames %d to %d of %s at %dx%d with %d threads, reorder buffer %d frames\n",
+                firstFrame, endFrame - 1, keyframePath.c_str(), width, height, threads, reorderFrames);
+    }
+
+    ReorderBuffer reorder(firstFrame, reorderFrames);
+    std::atomic<int> nextFrame(firstFrame);
+    std::vector<std::thread> workers;
+    for ( int i = 0; i < (map ? 0 : threads); i ++)
+    {
+        workers.push_back(std::thread([&]()
+        {
+            std::vector<unsigned char> rgba(size_t(width) * height * 4);
+            for ( ;; )
+            {
+                int frame = nextFrame ++;
+                if ( frame >= endFrame || !reorder.WaitForSlot(frame) )
+                    break;
+
+                double start = Now();
+                FramePointer image(new RenderedFrame());
+                MandelbrotView view = path.View(frame, width, height);
+                FractalBuffer buffer(width, height, &rgba[0], 0, 0);
+                image->deep = PerturbationRenderer::IsDeepView(view);
+                if ( image->deep )
+                    perturbation.Render(view, buffer);
+                else
+                    engine.Render(view, buffer);
+
+                ConvertFrame(format, &rgba[0], width, height, image->data);
+
+                image->seconds = Now() - start;
+                image->maxIterations = view.maxIterations;
+                image->scale = view.scale;
+                reorder.Put(frame, image);
+            }
+        }));
+    }
+
+    double start = Now();
+    double renderSeconds = 0.0;
+    double slowest = 0.0;
+    int written = 0;
+    bool failed = false;
+    std::vector<unsigned char> mapFrame(map ? size_t(width) * height * 4 : 0);
+    ExponentialMapStats mapStats;
+    for ( int frame = firstFrame; frame < endFrame; frame ++)
+    {
+        FramePointer image;
+        if ( map )
+        {
+            double frameStart = Now();
+            image.reset(new RenderedFrame());
+            map->RenderFrame(frame, &mapFrame[0], &mapStats);
+            ConvertFrame(format, &mapFrame[0], width, height, image->data);
+            image->seconds = Now() - frameStart;
+
+            MandelbrotView view = path.View(frame, width, height);
+            image->deep = PerturbationRenderer::IsDeepView(view);
+            image->maxIterations = view.maxIterations;
+            image->scale = view.scale;
+        }
+        else
+            image = reorder.Take();
+
+        if ( fwrite(&image->data[0], 1, image->data.size(), output) != image->data.size() )
+        {
+            fprintf(stderr, "could not write frame %d, stopping\n", frame);
+            failed = true;
+            break;
+        }
+
+        written ++;
+        renderSeconds += image->seconds;
+        slowest = std::max(slowest, image->seconds);
+        if ( !quiet )
+        {
+            fprintf(stderr, "frame %d: %.1f ms, scale %.3g, %d iterations%s, %.2f frames/s\n",
+                    frame, image->seconds * 1000.0, image->scale, image->maxIterations,
+                    image->deep ? ", deep" : "", written / std::max(Now() - start, 1e-9));
+        }
+    }
+
+    reorder.Cancel();
+    for ( size_t i = 0; i < workers.size(); i ++)
+        workers[i].join();
+    if ( output != stdout )
+        fclose(output);
+    else
+        fflush(output);
+
+    double seconds = Now() - start;
+    if ( written > 0 )
+    {
+        fprintf(stderr, "%d frames in %.2f s: %.2f frames/s, %.1f ms per frame on a thread (slowest %.1f), at most %d frames waited for the writer\n",
+                written, seconds, written / seconds, renderSeconds / written * 1000.0, slowest * 1000.0, reorder.Peak());
+    }
+    if ( map )
+    {
+        fprintf(stderr, "strip: %d bands, %lld samples (%.0f frames), %lld deep, %lld glitched, %d references, %.2f s rendering, %.2f s resampling\n",
+                mapStats.bands, mapStats.samples, double(mapStats.samples) / (double(width) * height),
+                mapStats.deepSamples, mapStats.glitchedSamples, mapStats.references,
+                mapStats.stripSeconds, mapStats.resampleSeconds);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+#-----------------------------------------------------------
+#
+# offline zoom animation renderer, y4m or raw rgb output
+#
+#-----------------------------------------------------------
+
+QT       -= core gui
+
+TARGET = zoomanimation
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += zoomanimation.cpp \
+    exponentialmap.cpp \
+    keyframepath.cpp
+
+HEADERS += exponentialmap.h \
+    keyframepath.h
+
+include(../fractcore/fractcore.pri)